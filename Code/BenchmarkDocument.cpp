@@ -0,0 +1,17 @@
+#include "BenchmarkDocument.h"
+#include <cstdio>
+
+void MakeBenchmarkDocument(unsigned int lines, std::string& outText) {
+    outText.clear();
+    outText.reserve(static_cast<size_t>(lines) * 48);
+    char line[128];
+    for (unsigned int i = 0; i < lines; ++i) {
+        switch (i % 4) {
+        case 0: snprintf(line, sizeof(line), "int function%u(int value) { // Line %u\n", i, i); break;
+        case 1: snprintf(line, sizeof(line), "    float scaled = value * %u.5f + 0x%X;\n", i % 100, i); break;
+        case 2: snprintf(line, sizeof(line), "    return scaled > 0 ? \"positive\" : \"negative\";\n"); break;
+        default: snprintf(line, sizeof(line), "}\n"); break;
+        }
+        outText += line;
+    }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Roughly what a C++ source file looks like to the tokenizer, lines lines of it, UTF-8. The benchmarks,
+// the replays and the tests all make up the same text, so their numbers can be compared.
+void MakeBenchmarkDocument(unsigned int lines, std::string& outText);
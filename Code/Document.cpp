@@ -1,5 +1,6 @@
 #include "Document.h" 
 #include "Platform.h"
+#include "Profiler.h"
 #include <algorithm>  
 #include <utility>    
 #include "Styles.h"
@@ -50,6 +51,7 @@ namespace TextEdit {
         if (!dirty) {
             return;
         }
+        PROFILE_SCOPE(Tokenize);
 
         dirty = false;
         tokens.clear();
@@ -115,9 +117,23 @@ namespace TextEdit {
                 }
             }
         }
+
+        braceBalance = 0;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            if (tokens[i].first != TokenType::Grouping) {
+                continue;
+            }
+            size_t start = static_cast<size_t>(tokens[i].second);
+            size_t end = i + 1 < tokens.size() ? static_cast<size_t>(tokens[i + 1].second) : text.size();
+            for (size_t c = start; c < end && c < text.size(); ++c) {
+                if (text[c] == U'{') braceBalance += 1;
+                else if (text[c] == U'}') braceBalance -= 1;
+            }
+        }
     }
 
-    Document::Document() : mCurrent(0, 0), mAnchor(0, 0), mFirstDirtyLine(0), mDirty(false) {
+    Document::Document() : mCurrent(0, 0), mAnchor(0, 0), mFirstDirtyLine(0), mDirty(false),
+        mEditVersion(0), mLastEditFirstLine(0), mLastEditLastLine(0), mLastEditChangedComment(false) {
         // A document always starts with at least one empty line.
         mActiveHighlighter = Highlighter::Code;
         mLines.emplace_back(U"");
@@ -139,6 +155,7 @@ namespace TextEdit {
         mLines.emplace_back(U"");
         mLines[0].dirty = true;
         mFirstDirtyLine = 0;
+        MarkEdited(0, 0, 0, true);
         mCurrent = Cursor(0, 0);
         mAnchor = Cursor(0, 0);
         mUndoStack.clear();
@@ -176,6 +193,7 @@ namespace TextEdit {
             line.dirty = true;
         }
         mFirstDirtyLine = 0;
+        MarkEdited(0, static_cast<unsigned int>(mLines.size() - 1), 0, true);
     }
 
     unsigned int Document::GetLineCount() const {
@@ -213,6 +231,7 @@ namespace TextEdit {
             line.dirty = true;
         }
         mFirstDirtyLine = 0;
+        MarkEdited(0, static_cast<unsigned int>(mLines.size() - 1));
     }
 
     void Document::UpdateIncrementalHighlight(int linesToProcess) {
@@ -232,6 +251,167 @@ namespace TextEdit {
         mFirstDirtyLine = endLine;
     }
 
+    bool Document::HasPendingHighlight() const {
+        return mActiveHighlighter == Highlighter::Code && mFirstDirtyLine < mLines.size();
+    }
+
+    unsigned int Document::GetFirstDirtyLine() const {
+        return mFirstDirtyLine;
+    }
+
+    unsigned int Document::GetEditVersion() const {
+        return mEditVersion;
+    }
+
+    void Document::GetLastEditedLines(unsigned int& outFirst, unsigned int& outLast) const {
+        outFirst = mLastEditFirstLine;
+        outLast = mLastEditLastLine;
+    }
+
+    bool Document::LastEditChangedCommentState() const {
+        return mLastEditChangedComment;
+    }
+
+    const std::deque<Document::LineEdit>& Document::GetRecentEdits() const {
+        return mRecentEdits;
+    }
+
+    void Document::MarkEdited(unsigned int firstLine, unsigned int lastLine, int lineDelta, bool reset) {
+        mEditVersion += 1;
+        mLastEditFirstLine = firstLine;
+        mLastEditLastLine = lastLine;
+        mLastEditChangedComment = false;
+
+        // Views replay these once per frame, a handful covers anything done between two frames (like a paste over a selection)
+        static const size_t MAX_RECENT_EDITS = 32;
+        mRecentEdits.push_back({ mEditVersion, firstLine, lineDelta, reset });
+        if (mRecentEdits.size() > MAX_RECENT_EDITS) {
+            mRecentEdits.pop_front();
+        }
+    }
+
+    void Document::TokenizeEditedLine(unsigned int line, bool wasTokenized, bool endedInComment) {
+        if (mActiveHighlighter != Highlighter::Code) {
+            return;
+        }
+        TokenizeLine(line);
+        mLastEditChangedComment = !wasTokenized || mLines[line].endsInComment != endedInComment;
+    }
+
+    int Document::GetBraceBalance(unsigned int line) {
+        if (mActiveHighlighter != Highlighter::Code) {
+            return 0;
+        }
+        TokenizeLine(line); // Does nothing unless the line changed, the balance is kept with the tokens
+        return mLines[line].braceBalance;
+    }
+
+    int Document::GetIndent(unsigned int line) const {
+        const std::u32string& text = mLines[line].text;
+        int indent = 0;
+        for (char32_t c : text) {
+            if (c == U' ') indent += 1;
+            else if (c == U'\t') indent += 4;
+            else return indent;
+        }
+        return -1; // Only whitespace
+    }
+
+    bool Document::IsFoldStart(unsigned int line) {
+        if (line + 1 >= mLines.size()) {
+            return false;
+        }
+
+        if (mActiveHighlighter == Highlighter::Code) {
+            return GetBraceBalance(line) > 0;
+        }
+
+        int indent = GetIndent(line);
+        if (indent < 0) {
+            return false;
+        }
+        for (unsigned int next = line + 1; next < mLines.size(); ++next) {
+            int nextIndent = GetIndent(next);
+            if (nextIndent >= 0) {
+                return nextIndent > indent;
+            }
+        }
+        return false;
+    }
+
+    bool Document::FindFoldRegion(unsigned int line, unsigned int& outLastLine) {
+        if (!IsFoldStart(line)) {
+            return false;
+        }
+
+        const unsigned int lineCount = static_cast<unsigned int>(mLines.size());
+        outLastLine = lineCount - 1;
+
+        if (mActiveHighlighter == Highlighter::Code) {
+            // Walk the brace tokens until the one opened on line closes, the closing line stays visible
+            int depth = GetBraceBalance(line);
+            for (unsigned int next = line + 1; next < lineCount; ++next) {
+                depth += GetBraceBalance(next);
+                if (depth <= 0) {
+                    outLastLine = next - 1;
+                    break;
+                }
+            }
+        }
+        else {
+            // Everything indented deeper than line, trailing blank lines excluded
+            int indent = GetIndent(line);
+            unsigned int lastNonBlank = line;
+            for (unsigned int next = line + 1; next < lineCount; ++next) {
+                int nextIndent = GetIndent(next);
+                if (nextIndent < 0) {
+                    continue;
+                }
+                if (nextIndent <= indent) {
+                    break;
+                }
+                lastNonBlank = next;
+            }
+            outLastLine = lastNonBlank;
+        }
+
+        return outLastLine > line;
+    }
+
+    bool Document::FindEnclosingFoldRegion(unsigned int line, bool includeLine, unsigned int& outFirstLine, unsigned int& outLastLine) {
+        if (line >= mLines.size()) {
+            return false;
+        }
+
+        // A region can only contain line if nothing between its first line and line closes it: the
+        // brace depth never drops to zero, or every non blank line is indented deeper. Both are
+        // tracked walking up, FindFoldRegion only runs for lines that pass.
+        int lowestDepth = 0;       // Lowest depth from the candidate down to line, relative to above the candidate
+        int shallowestIndent = -1; // Of the non blank lines below the candidate, up to line
+        for (unsigned int candidate = line + 1; candidate-- > 0;) {
+            bool encloses = false;
+            if (mActiveHighlighter == Highlighter::Code) {
+                int balance = GetBraceBalance(candidate);
+                lowestDepth = candidate == line ? balance : balance + std::min(0, lowestDepth);
+                encloses = lowestDepth > 0;
+            }
+            else {
+                int indent = GetIndent(candidate);
+                encloses = indent >= 0 && (shallowestIndent < 0 || indent < shallowestIndent);
+                if (encloses) {
+                    shallowestIndent = indent;
+                }
+            }
+
+            if (encloses && (includeLine || candidate != line) &&
+                FindFoldRegion(candidate, outLastLine) && outLastLine >= line) {
+                outFirstLine = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
     void Document::TokenizeLine(unsigned int line) {
         if (mActiveHighlighter == Highlighter::Text) {
             mLines[line].ClearTokens();
@@ -312,6 +492,8 @@ namespace TextEdit {
         }
 
         // 2. Perform the insertion
+        bool wasTokenized = !mLines[currentLineIdx].dirty;
+        bool endedInComment = mLines[currentLineIdx].endsInComment;
         std::u32string suffix_of_current_line = mLines[currentLineIdx].text.substr(currentCol);
         mLines[currentLineIdx].text.erase(currentCol);
         mLines[currentLineIdx].text += lines_to_insert[0];
@@ -352,6 +534,13 @@ namespace TextEdit {
             mLines[insert_at_line_idx].dirty = true;
             finalCursorPos.line = insert_at_line_idx;
         }
+
+        // Lines below a multi-line insert shift down, so everything past it changes on screen
+        int linesAdded = static_cast<int>(lines_to_insert.size()) - 1;
+        MarkEdited(currentLineIdx, linesAdded == 0 ? currentLineIdx : static_cast<unsigned int>(mLines.size() - 1), linesAdded);
+        if (linesAdded == 0) {
+            TokenizeEditedLine(currentLineIdx, wasTokenized, endedInComment);
+        }
     }
 
     void Document::RemoveInternal(const Span& span) {
@@ -368,6 +557,8 @@ namespace TextEdit {
         }
 
         mFirstDirtyLine = std::min(mFirstDirtyLine, startPos.line);
+        bool wasTokenized = !mLines[startPos.line].dirty;
+        bool endedInComment = mLines[startPos.line].endsInComment;
 
         if (startPos.line == endPos.line) {
             // Single-line removal
@@ -405,6 +596,12 @@ namespace TextEdit {
                 }
             }
         }
+
+        int linesRemoved = static_cast<int>(endPos.line - startPos.line);
+        MarkEdited(startPos.line, linesRemoved == 0 ? startPos.line : static_cast<unsigned int>(mLines.size() - 1), -linesRemoved);
+        if (linesRemoved == 0) {
+            TokenizeEditedLine(startPos.line, wasTokenized, endedInComment);
+        }
     }
 
     void Document::Insert(const std::u32string& text_to_insert) {
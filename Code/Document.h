@@ -109,10 +109,11 @@ namespace TextEdit {
             bool dirty; // Only re-tokenize if true
             std::vector<std::pair<TokenType, int>> tokens;
             bool endsInComment; // Indicates if this line ends inside a multi-line comment
+            int braceBalance;   // Opening minus closing braces in Grouping tokens, folding asks for it on every draw
 
-            inline Line() : dirty(true), endsInComment(false) {
+            inline Line() : dirty(true), endsInComment(false), braceBalance(0) {
             }
-            inline Line(const std::u32string& _text) : text(_text), dirty(true), endsInComment(false) {
+            inline Line(const std::u32string& _text) : text(_text), dirty(true), endsInComment(false), braceBalance(0) {
             }
         protected:
             void Tokenize(std::vector<SyntaxRule>& syntax_rules, bool startInComment);
@@ -120,6 +121,13 @@ namespace TextEdit {
                 dirty = false;
             }
         };
+        // How an edit moved lines around. Views replay these to keep line anchored state, like folds, in place.
+        struct LineEdit {
+            unsigned int version; // Edit version after the change
+            unsigned int line;    // First line touched
+            int lineDelta;        // Lines inserted (positive) or removed (negative) after line
+            bool reset;           // All of the text was replaced
+        };
         struct UndoRecord {
             ActionType type = ActionType::INSERT;
 
@@ -174,6 +182,23 @@ namespace TextEdit {
         Highlighter GetHighlighter() const;
         void SetHighlighter(Highlighter l);
         void UpdateIncrementalHighlight(int linesToProcess = 5);
+        bool HasPendingHighlight() const; // True until UpdateIncrementalHighlight has caught up with the last edit
+        unsigned int GetFirstDirtyLine() const; // Lines above this one have been highlighted
+
+        // Bumped on every change to the text. Views compare it against the version they last drew
+        // to find out if anything needs repainting, and use the last edited lines to limit how much.
+        unsigned int GetEditVersion() const;
+        void GetLastEditedLines(unsigned int& outFirst, unsigned int& outLast) const;
+        bool LastEditChangedCommentState() const; // Opened or closed a block comment, every line below re-colors
+        const std::deque<LineEdit>& GetRecentEdits() const; // Oldest first, only the last few are kept
+
+        // Folding. Regions are brace based for the Code highlighter and indent based for Text.
+        // A region starts on line and hides the lines after it, up to outLastLine.
+        bool IsFoldStart(unsigned int line); // Cheap check, only looks at line and the next non blank one
+        bool FindFoldRegion(unsigned int line, unsigned int& outLastLine);
+        // Innermost region containing line, found walking up from it once. Regions starting on line
+        // itself only count if includeLine.
+        bool FindEnclosingFoldRegion(unsigned int line, bool includeLine, unsigned int& outFirstLine, unsigned int& outLastLine);
 
         void Undo();
         void Redo();
@@ -209,6 +234,19 @@ namespace TextEdit {
 
         bool mDirty;
 
+        unsigned int mEditVersion;
+        unsigned int mLastEditFirstLine;
+        unsigned int mLastEditLastLine;
+        bool mLastEditChangedComment;
+        std::deque<LineEdit> mRecentEdits;
+        void MarkEdited(unsigned int firstLine, unsigned int lastLine, int lineDelta = 0, bool reset = false);
+        // After a single line edit, with the line's state from before it. Lines that weren't tokenized
+        // before have nothing to compare with and count as changed.
+        void TokenizeEditedLine(unsigned int line, bool wasTokenized, bool endedInComment);
+
+        int GetBraceBalance(unsigned int line); // Opening minus closing braces, strings and comments excluded
+        int GetIndent(unsigned int line) const; // -1 for blank lines
+
         // Internal modification methods that do NOT create undo records
         // to prevent recursion when Undo/Redo are called.
         void InsertInternal(const Cursor& position, const std::u32string& text, Cursor& finalCursorPos);
@@ -1,5 +1,6 @@
 ﻿#include "DocumentContainer.h"
 #include "Styles.h"
+#include "Profiler.h"
 #include <algorithm>
 #include <cmath>
 
@@ -187,6 +188,7 @@ namespace TextEdit {
     }
 
     void DocumentContainer::Display(float x, float y, float w, float h) {
+        PROFILE_SCOPE(ContainerDisplay);
         mBounds = { x, y, w, h };
 
         if (sDraggingTab && sDragStarted) {
@@ -264,10 +266,18 @@ namespace TextEdit {
             TextEdit::Styles::GlobalTint.b = 1.0f;
         }
 
-        ProcessMarkedForClose();
+        mLastDisplayed = CaptureDisplayState();
     }
 
     void DocumentContainer::Update(float deltaTime) {
+        PROFILE_SCOPE(ContainerUpdate);
+
+        // Closing tabs can collapse containers, do it before anything is drawn so that
+        // Display has no side effects and can run once per damage rect.
+        if (IsRoot()) {
+            ProcessMarkedForClose();
+        }
+
         if (mType == ContainerType::TABBED) {
             if (mActiveTabIndex >= 0 && mActiveTabIndex < static_cast<int>(mTabs.size()) && !mTabs[mActiveTabIndex].markedForClose) {
                 mTabs[mActiveTabIndex].view->Update(deltaTime);
@@ -277,9 +287,66 @@ namespace TextEdit {
             if (mLeftOrTop) mLeftOrTop->Update(deltaTime);
             if (mRightOrBottom) mRightOrBottom->Update(deltaTime);
         }
+
+        InvalidateChanges();
+    }
+
+    DocumentContainer::DisplayState DocumentContainer::CaptureDisplayState() const {
+        DisplayState state;
+        state.valid = true;
+        state.type = mType;
+        state.bounds = mBounds;
+        state.splitPosition = mSplitPosition;
+        state.hoverSplitter = IsOnSplitter(static_cast<float>(sDragCurrentPos.x), static_cast<float>(sDragCurrentPos.y));
+        state.isDraggingSplitter = mIsDraggingSplitter;
+        state.activeTabIndex = mActiveTabIndex;
+        state.isActive = IsActive();
+        state.tabScrollOffset = mTabScrollOffset;
+        state.hoverLeftArrow = mLeftArrowRect.Contains(static_cast<float>(sDragCurrentPos.x), static_cast<float>(sDragCurrentPos.y));
+        state.hoverRightArrow = mRightArrowRect.Contains(static_cast<float>(sDragCurrentPos.x), static_cast<float>(sDragCurrentPos.y));
+
+        for (int i = 0; i < static_cast<int>(mTabs.size()); ++i) {
+            const Tab& tab = mTabs[i];
+            if (tab.markedForClose) continue;
+
+            state.tabs.push_back(tab.document.get());
+            state.tabDirty.push_back(tab.document->IsDirty());
+            state.tabTitles.push_back(tab.document->GetName());
+            if (state.hoveredCloseButton == -1 && tab.closeButtonRect.Contains(static_cast<float>(sDragCurrentPos.x), static_cast<float>(sDragCurrentPos.y))) {
+                state.hoveredCloseButton = i;
+            }
+        }
+
+        return state;
+    }
+
+    void DocumentContainer::InvalidateChanges() {
+        if (!mLastDisplayed.valid) {
+            return; // Never displayed, whatever holds this container damages its bounds
+        }
+
+        DisplayState current = CaptureDisplayState();
+        const DisplayState& last = mLastDisplayed;
+
+        // Layout changes damage the whole container, including child containers and views
+        if (current.type != last.type || current.splitPosition != last.splitPosition ||
+            current.hoverSplitter != last.hoverSplitter || current.isDraggingSplitter != last.isDraggingSplitter ||
+            current.tabs != last.tabs || current.activeTabIndex != last.activeTabIndex) {
+            mRenderer->Invalidate(mBounds);
+            return;
+        }
+
+        // Everything else only changes DrawTabBar
+        if (mType == ContainerType::TABBED && (current.isActive != last.isActive ||
+            current.tabScrollOffset != last.tabScrollOffset || current.hoveredCloseButton != last.hoveredCloseButton ||
+            current.hoverLeftArrow != last.hoverLeftArrow || current.hoverRightArrow != last.hoverRightArrow ||
+            current.tabDirty != last.tabDirty || current.tabTitles != last.tabTitles)) {
+            mRenderer->Invalidate(mBounds.x, mBounds.y, mBounds.width, TextEdit::Styles::TAB_BAR_HEIGHT);
+        }
     }
 
     void DocumentContainer::OnInput(const InputEvent& e) {
+        bool wasDraggingTab = sDraggingTab && sDragStarted;
         if (e.type == InputEvent::Type::MOUSE_MOVE) {
             sDragCurrentPos = { e.mouse.x, e.mouse.y };
         }
@@ -304,6 +371,10 @@ namespace TextEdit {
             }
             break;
         }
+
+        if (wasDraggingTab || (sDraggingTab && sDragStarted)) {
+            RequestRedraw(); // A dragged tab tints the whole window and shows docking widgets
+        }
     }
 
     std::shared_ptr<DocumentContainer> DocumentContainer::FindLargestTabbedContainer() {
@@ -84,6 +84,27 @@ namespace TextEdit {
         float mTabBarContentWidth;
         float mVisibleTabBarWidth;
 
+        // What was on screen the last time this container was displayed. Update compares it
+        // to the current state and invalidates the tab bar, or the whole container.
+        struct DisplayState {
+            bool valid = false;
+            ContainerType type = ContainerType::TABBED;
+            Rect bounds;
+            float splitPosition = 0.0f;
+            bool hoverSplitter = false;
+            bool isDraggingSplitter = false;
+            std::vector<const Document*> tabs;
+            int activeTabIndex = -1;
+            bool isActive = false;
+            float tabScrollOffset = 0.0f;
+            int hoveredCloseButton = -1;
+            bool hoverLeftArrow = false;
+            bool hoverRightArrow = false;
+            std::vector<bool> tabDirty;
+            std::vector<std::u32string> tabTitles;
+        };
+        DisplayState mLastDisplayed;
+
     public:
         DocumentContainer(std::shared_ptr<Renderer> renderer,
             std::shared_ptr<Font> font,
@@ -171,5 +192,9 @@ namespace TextEdit {
         void ScrollTabsRight();
         void ScrollTabsToShowTab(int tabIndex);
         void ClampTabScroll();
+
+        // Damage tracking
+        DisplayState CaptureDisplayState() const;
+        void InvalidateChanges();
     };
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 ﻿#include "DocumentView.h"
 #include "Platform.h"
+#include "Profiler.h"
 #include <vector>
 #include <string>
 #include <algorithm> 
@@ -53,6 +54,8 @@ void ExternalCreateNewDocument();
 #define VK_N              0x4E  
 #define VK_OEM_PLUS       0xBB // For Ctrl+= (Zoom In)
 #define VK_OEM_MINUS      0xBD // For Ctrl+- (Zoom Out)
+#define VK_OEM_4          0xDB // [
+#define VK_OEM_6          0xDD // ]
 #endif
 
 std::u32string Utf8ToUtf32(const char* utf8_string, unsigned int bytes);
@@ -63,7 +66,7 @@ namespace TextEdit {
     
     DocumentView::DocumentView(std::shared_ptr<Renderer> renderer, std::shared_ptr<Document> doc, std::shared_ptr<Font> font, std::shared_ptr<Font> small)
         : mRenderer(renderer), mDocument(doc), mFont(font), mSmallFont(small),
-        mScrollX(0.0f), mScrollY(0.0f), mLineNumberWidth(30.0f),
+        mScrollX(0.0f), mScrollY(0.0f),
         mViewX(0.0f), mViewY(0.0f), mViewWidth(0.0f), mViewHeight(0.0f),
         mTotalContentWidth(0.0f), mTotalContentHeight(0.0f),
         mDesiredColumnX(0.0f),
@@ -73,7 +76,9 @@ namespace TextEdit {
         mLastClickTime(0), mClickCount(0),
         mIsHighlighterDropdownOpen(false),
         mSelectedHighlighterIndex(1),
-        mIsContextMenuOpen(false)
+        mIsContextMenuOpen(false),
+        mLineNumberWidth(30.0f),
+        mDigitGlyphGeneration(0), mGutterLineCountMin(0), mGutterLineCountMax(0)
     {
         if (!mDocument) {
             mDocument = Document::Create(); // Ensure a document exists
@@ -83,6 +88,10 @@ namespace TextEdit {
         mIsDraggingHorzScrollbar = false;
         mDragScrollbarOffset = 0.0f;
 
+        mMinimap = Minimap::Create(mRenderer, mDocument, mFont);
+        mIsDraggingMinimap = false;
+        mFoldsEditVersion = mDocument->GetEditVersion();
+
         mLastClickMousePos = { 0, 0 };
         mLastMousePos = { 0,0 };
 
@@ -105,8 +114,7 @@ namespace TextEdit {
             mSelectedHighlighterIndex = 0;
         }
 
-        float digitWidth = mFont->GetGlyph(U'0').advance; // Approximate width of a digit
-        mLineNumberWidth = digitWidth * 4 + 10.0f; // 4 digits + 5px padding on each side
+        UpdateGutter();
     }
 
     void DocumentView::PerformCut() {
@@ -197,12 +205,20 @@ namespace TextEdit {
             mShowCursor = !mShowCursor;
             mCursorBlinkTimer = 0.0f;
         }
+        RequestRedrawIn(TextEdit::Styles::CURSOR_BLINK_RATE - mCursorBlinkTimer); // Wake up for the next blink
+
+        SyncFolds();
+        if (mFolds.HasFolds()) {
+            // Something other than cursor movement (undo, paste) put the cursor inside a fold, open it
+            if (mFolds.IsHidden(mDocument->GetCursor().line)) mFolds.RevealLine(mDocument->GetCursor().line);
+            if (mFolds.IsHidden(mDocument->GetAnchor().line)) mFolds.RevealLine(mDocument->GetAnchor().line);
+        }
 
         if (mIsMouseDown && mIsSelecting && mFont) { // Auto-scroll during selection drag
             float scrollSpeedPixels = TextEdit::Styles::AUTOSCROLL_SPEED_LINES_PER_SEC * mFont->GetLineHeight() * deltaTime;
             bool scrolled = false;
 
-            float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - mLineNumberWidth; // Text area starts after line numbers
+            float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - Styles::MINIMAP_WIDTH - mLineNumberWidth; // Text area starts after line numbers
             float textDisplayHeight = mViewHeight - TextEdit::Styles::SCROLLBAR_SIZE;
 
             if (mLastMousePos.y < mViewY + TextEdit::Styles::AUTOSCROLL_MARGIN) {
@@ -224,6 +240,7 @@ namespace TextEdit {
             }
 
             if (scrolled) {
+                RequestRedrawIn(0.0f); // Keep ticking while the mouse is held in the auto-scroll margin
                 ClampScroll();
                 Document::Cursor docPos = ScreenToDocumentPos(static_cast<float>(mLastMousePos.x), static_cast<float>(mLastMousePos.y));
                 mDocument->MoveCursor(docPos);
@@ -232,33 +249,248 @@ namespace TextEdit {
             }
         }
 
-        if (mDocument->GetHighlighter() == Highlighter::Code) {
+        if (mDocument->GetHighlighter() == Highlighter::Code && mDocument->HasPendingHighlight()) {
+            unsigned int firstProcessed = mDocument->GetFirstDirtyLine();
             mDocument->UpdateIncrementalHighlight();
+            unsigned int lastProcessed = mDocument->GetFirstDirtyLine();
+            if (lastProcessed > firstProcessed) {
+                // Only repaint if the newly highlighted lines are on screen
+                InvalidateLines(firstProcessed, lastProcessed - 1);
+                mMinimap->InvalidateLines(firstProcessed, lastProcessed - 1);
+            }
+            RequestRedrawIn(0.0f); // There may be more to do
         }
 
-        unsigned int numDigits = CountDigits(mDocument->GetLineCount());
-        float digitWidth = mFont->GetGlyph(U'0').advance; // Approximate width of a digit
-        mLineNumberWidth = digitWidth * (numDigits < 3 ? 3 : numDigits) + 10.0f; // 4 digits + 5px padding on each side
+        UpdateGutter();
+
+        InvalidateChanges();
+    }
+
+    void DocumentView::UpdateGutter() {
+        bool fontChanged = mDigitGlyphGeneration != mFont->GetGlyphGeneration();
+        if (fontChanged) {
+            // Bake all of them first, baking can grow the atlas and move the ones already copied
+            for (char32_t c = U'0'; c <= U'9'; ++c) {
+                mFont->BakeGlyph(c);
+            }
+            for (unsigned int i = 0; i < 10; ++i) {
+                mDigitGlyphs[i] = mFont->GetGlyph(U'0' + i);
+            }
+            mDigitGlyphGeneration = mFont->GetGlyphGeneration();
+        }
+
+        unsigned int lineCount = mDocument->GetLineCount();
+        if (!fontChanged && lineCount >= mGutterLineCountMin && lineCount < mGutterLineCountMax) {
+            return;
+        }
+
+        unsigned int numDigits = std::max(3u, CountDigits(lineCount)); // Room for at least 3 digits
+        unsigned long long lower = 1, upper = 10;
+        for (unsigned int i = 1; i < numDigits; ++i) {
+            lower = upper;
+            upper *= 10;
+        }
+        mGutterLineCountMin = (numDigits == 3) ? 0 : static_cast<unsigned int>(lower);
+        mGutterLineCountMax = static_cast<unsigned int>(std::min<unsigned long long>(upper, 0xFFFFFFFFull));
+
+        float digitWidth = mDigitGlyphs[0].advance; // Approximate width of a digit
+        mLineNumberWidth = digitWidth * numDigits + 10.0f + Styles::FOLD_MARKER_WIDTH; // 5px padding on each side, then fold markers
+    }
+
+    void DocumentView::DrawLineNumber(unsigned int number, float rightX, float topY) {
+        // Right to left, so nothing needs to be measured up front
+        float baselineY = topY + mFont->GetScaledAscent();
+        float penX = rightX;
+        do {
+            const GlyphInfo& glyph = mDigitGlyphs[number % 10];
+            penX -= glyph.advance;
+            mRenderer->DrawGlyph(glyph, penX, baselineY, Styles::TextColor.r, Styles::TextColor.g, Styles::TextColor.b);
+            number /= 10;
+        } while (number > 0);
+    }
+
+    DocumentView::DisplayState DocumentView::CaptureDisplayState() const {
+        DisplayState state;
+        state.valid = true;
+        state.view = Rect(mViewX, mViewY, mViewWidth, mViewHeight);
+        state.scrollX = mScrollX;
+        state.scrollY = mScrollY;
+        state.lineNumberWidth = mLineNumberWidth;
+        state.lineHeight = mFont->GetLineHeight();
+        state.lineCount = mDocument->GetLineCount();
+        state.editVersion = mDocument->GetEditVersion();
+        state.cursor = mDocument->GetCursor();
+        state.anchor = mDocument->GetAnchor();
+        state.showCursor = mShowCursor;
+        state.canUndo = mDocument->CanUndo();
+        state.canRedo = mDocument->CanRedo();
+        state.selectedHighlighterIndex = mSelectedHighlighterIndex;
+        state.highlighterDropdownOpen = mIsHighlighterDropdownOpen;
+        state.contextMenuOpen = mIsContextMenuOpen;
+        state.contextMenuPos = mContextMenuPos;
+        state.draggingVert = mIsDraggingVertScrollbar;
+        state.draggingHorz = mIsDraggingHorzScrollbar;
+        state.draggingMinimap = mIsDraggingMinimap;
+        state.hoveredWidget = GetHoveredWidget();
+        state.foldVersion = mFolds.GetVersion();
+        return state;
+    }
+
+    int DocumentView::GetHoveredWidget() const {
+        float mx = static_cast<float>(mLastMousePos.x);
+        float my = static_cast<float>(mLastMousePos.y);
+        float optionHeight = mSmallFont->GetLineHeight() + 4.0f;
+
+        // Menus draw on top of everything else, check them first
+        if (mIsContextMenuOpen && mContextMenuRect.Contains(mx, my)) {
+            return 200 + static_cast<int>((my - mContextMenuRect.y) / optionHeight);
+        }
+        if (mIsHighlighterDropdownOpen) {
+            float menuHeight = optionHeight * mHighlighterOptions.size();
+            Rect menu(mViewX + mViewWidth - Styles::HIGHLIGHTER_BUTTON_WIDTH, mViewY + mViewHeight - Styles::SCROLLBAR_SIZE - menuHeight, Styles::HIGHLIGHTER_BUTTON_WIDTH, menuHeight);
+            if (menu.Contains(mx, my)) {
+                return 100 + static_cast<int>((my - menu.y) / optionHeight);
+            }
+        }
+        if (mVertScrollbarRect.Contains(mx, my)) return 0;
+        if (mHorzScrollbarRect.Contains(mx, my)) return 1;
+        if (mUndoButtonRect.Contains(mx, my)) return 2;
+        if (mRedoButtonRect.Contains(mx, my)) return 3;
+        if (mHighlighterButtonRect.Contains(mx, my)) return 4;
+        if (mMinimap->GetSliderRect().Contains(mx, my)) return 5;
+        return -1;
+    }
+
+    void DocumentView::InvalidateChanges() {
+        if (!mLastDisplayed.valid) {
+            return; // Never drawn, whoever lays us out first damages the whole area
+        }
+
+        const DisplayState& last = mLastDisplayed;
+        DisplayState current = CaptureDisplayState();
+        Rect viewRect(mViewX, mViewY, mViewWidth, mViewHeight);
+
+        // The minimap caches its tiles, it needs to hear about every edit even when the whole view gets repainted
+        if (current.editVersion == last.editVersion + 1) {
+            unsigned int firstLine = 0, lastLine = 0;
+            mDocument->GetLastEditedLines(firstLine, lastLine);
+            mMinimap->InvalidateLines(firstLine, lastLine);
+        }
+        else if (current.editVersion != last.editVersion) {
+            mMinimap->InvalidateAll();
+        }
+
+        // Anything that moves content around or touches the chrome repaints the whole view
+        if (current.view.x != last.view.x || current.view.y != last.view.y ||
+            current.view.width != last.view.width || current.view.height != last.view.height ||
+            current.scrollX != last.scrollX || current.scrollY != last.scrollY ||
+            current.lineNumberWidth != last.lineNumberWidth || current.lineHeight != last.lineHeight ||
+            current.lineCount != last.lineCount ||
+            current.selectedHighlighterIndex != last.selectedHighlighterIndex ||
+            current.highlighterDropdownOpen != last.highlighterDropdownOpen ||
+            current.contextMenuOpen != last.contextMenuOpen ||
+            current.contextMenuPos.x != last.contextMenuPos.x || current.contextMenuPos.y != last.contextMenuPos.y ||
+            current.draggingVert != last.draggingVert || current.draggingHorz != last.draggingHorz ||
+            current.draggingMinimap != last.draggingMinimap ||
+            current.hoveredWidget != last.hoveredWidget ||
+            current.foldVersion != last.foldVersion) {
+            mRenderer->Invalidate(viewRect);
+            return;
+        }
+
+        if (current.editVersion != last.editVersion) {
+            if (current.editVersion != last.editVersion + 1) {
+                mRenderer->Invalidate(viewRect); // Several edits since the last frame, don't bother tracking them
+                return;
+            }
+
+            unsigned int firstLine = 0, lastLine = 0;
+            mDocument->GetLastEditedLines(firstLine, lastLine);
+            if (mDocument->LastEditChangedCommentState()) {
+                lastLine = mDocument->GetLineCount() - 1; // Every line below the edit re-colors
+            }
+            InvalidateLines(firstLine, lastLine);
+
+            // The longest line sets the size of the horizontal scrollbar nib
+            mRenderer->Invalidate(mViewX + mLineNumberWidth, mViewY + mViewHeight - Styles::SCROLLBAR_SIZE, mViewWidth - Styles::HIGHLIGHTER_BUTTON_WIDTH - mLineNumberWidth, Styles::SCROLLBAR_SIZE);
+        }
+
+        if (current.canUndo != last.canUndo || current.canRedo != last.canRedo) {
+            mRenderer->Invalidate(mUndoButtonRect.Union(mRedoButtonRect));
+        }
+
+        if (current.cursor != last.cursor || current.anchor != last.anchor) {
+            bool hadSelection = last.cursor != last.anchor;
+            bool hasSelection = current.cursor != current.anchor;
+            if (hadSelection || hasSelection) {
+                unsigned int firstLine = std::min(std::min(last.cursor.line, last.anchor.line), std::min(current.cursor.line, current.anchor.line));
+                unsigned int lastLine = std::max(std::max(last.cursor.line, last.anchor.line), std::max(current.cursor.line, current.anchor.line));
+                InvalidateLines(firstLine, lastLine);
+            }
+            else {
+                InvalidateCursor(last.cursor);
+                InvalidateCursor(current.cursor);
+            }
+        }
+        else if (current.showCursor != last.showCursor && current.cursor == current.anchor) {
+            InvalidateCursor(current.cursor);
+        }
+    }
+
+    void DocumentView::InvalidateLines(unsigned int firstLine, unsigned int lastLine) {
+        float lineH = mFont->GetLineHeight();
+        float textDisplayHeight = mViewHeight - Styles::SCROLLBAR_SIZE;
+
+        float top = mViewY + static_cast<float>(mFolds.LineToRow(firstLine)) * lineH - mScrollY;
+        float bottom = mViewY + static_cast<float>(mFolds.LineToRow(lastLine) + 1) * lineH - mScrollY;
+        top = std::max(top, mViewY);
+        bottom = std::min(bottom, mViewY + textDisplayHeight);
+
+        if (bottom > top) { // Includes the gutter, line numbers sit on the same rows
+            mRenderer->Invalidate(mViewX, top, mViewWidth - Styles::SCROLLBAR_SIZE, bottom - top);
+        }
+    }
+
+    void DocumentView::InvalidateCursor(const Document::Cursor& cursor) {
+        if (cursor.line >= mDocument->GetLineCount()) {
+            return;
+        }
+
+        const float textAreaStartX = mViewX + mLineNumberWidth + Styles::GUTTER_RIGHT_PAD;
+        float textDisplayWidth = mViewWidth - Styles::SCROLLBAR_SIZE - Styles::MINIMAP_WIDTH - mLineNumberWidth - Styles::GUTTER_RIGHT_PAD;
+        float textDisplayHeight = mViewHeight - Styles::SCROLLBAR_SIZE;
+        float lineH = mFont->GetLineHeight();
+
+        // Same placement as the cursor in Display, with a pixel of slack on either side
+        float cursorScreenX = textAreaStartX + GetColumnPixelOffset(cursor.line, cursor.column) - mScrollX;
+        cursorScreenX = std::max(textAreaStartX, std::min(cursorScreenX, textAreaStartX + textDisplayWidth - 1.0f));
+        float cursorScreenY = mViewY + static_cast<float>(mFolds.LineToRow(cursor.line)) * lineH - mScrollY;
+
+        float top = std::max(cursorScreenY, mViewY);
+        float bottom = std::min(cursorScreenY + lineH, mViewY + textDisplayHeight);
+        if (bottom > top) {
+            mRenderer->Invalidate(cursorScreenX - 1.0f, top, 3.0f, bottom - top);
+        }
     }
 
     void DocumentView::Display(float x, float y, float w, float h) {
+        PROFILE_SCOPE(DocumentViewDisplay);
         mViewX = x;
         mViewY = y;
         mViewWidth = w;
         mViewHeight = h;
 
         mRenderer->SetFont(mFont);
+        UpdateGutter(); // The font may have been re-baked since Update
         const float textAreaStartX = mViewX + mLineNumberWidth + Styles::GUTTER_RIGHT_PAD;
 
         // Calculate content dimensions
-        mTotalContentHeight = static_cast<float>(mDocument->GetLineCount()) * mFont->GetLineHeight();
-        mTotalContentWidth = 0.0f;
-        for (unsigned int i = 0; i < mDocument->GetLineCount(); ++i) {
-            mTotalContentWidth = std::max(mTotalContentWidth, GetLinePixelWidth(i));
-        }
+        const unsigned int rowCount = mFolds.GetRowCount(mDocument->GetLineCount());
+        mTotalContentHeight = static_cast<float>(rowCount) * mFont->GetLineHeight();
+        mTotalContentWidth = mLineLayouts.GetMaxWidth(*mDocument, *mFont); // Folded lines count too
         mTotalContentWidth += mFont->GetSpaceWidthPixels(); // Add some padding
 
-        float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - mLineNumberWidth - Styles::GUTTER_RIGHT_PAD; // Adjust width for padding
+        float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - Styles::MINIMAP_WIDTH - mLineNumberWidth - Styles::GUTTER_RIGHT_PAD; // Adjust width for padding
         float textDisplayHeight = mViewHeight - TextEdit::Styles::SCROLLBAR_SIZE;
         float horzScrollbarTrackWidth = mViewWidth - Styles::HIGHLIGHTER_BUTTON_WIDTH - mLineNumberWidth; // Scrollbar track shortened for dropdown and line numbers
 
@@ -268,28 +500,30 @@ namespace TextEdit {
             mRenderer->SetClip(mViewX, mViewY, mLineNumberWidth, textDisplayHeight);
 
             float lineH = mFont->GetLineHeight(); // Use main font line height for consistency
-            int firstVisibleLine = static_cast<int>(mScrollY / lineH);
-            int lastVisibleLine = static_cast<int>((mScrollY + textDisplayHeight) / lineH) + 1;
-            firstVisibleLine = std::max(0, firstVisibleLine);
-            lastVisibleLine = std::min(static_cast<int>(mDocument->GetLineCount() - 1), lastVisibleLine);
-
-            for (int lineIdx = firstVisibleLine; lineIdx <= lastVisibleLine; ++lineIdx) {
-                float lineScreenY = mViewY + (static_cast<float>(lineIdx) * lineH) - mScrollY;
-                // Convert line number to u32string (1-based for display)
-                std::u32string lineNumStr;
-                unsigned int displayLineNum = lineIdx + 1;
-                do {
-                    lineNumStr.insert(lineNumStr.begin(), U'0' + (displayLineNum % 10));
-                    displayLineNum /= 10;
-                } while (displayLineNum > 0);
-                // Right-align by calculating width and offsetting
-                float textWidth = 0.0f;
-                for (char32_t c : lineNumStr) {
-                    textWidth += mFont->GetGlyph(c).advance;
+            int firstVisibleRow = static_cast<int>(mScrollY / lineH);
+            int lastVisibleRow = static_cast<int>((mScrollY + textDisplayHeight) / lineH) + 1;
+            firstVisibleRow = std::max(0, firstVisibleRow);
+            lastVisibleRow = std::min(static_cast<int>(rowCount - 1), lastVisibleRow);
+
+            unsigned int lineIdx = mFolds.RowToLine(static_cast<unsigned int>(firstVisibleRow));
+            for (int row = firstVisibleRow; row <= lastVisibleRow; ++row, lineIdx = mFolds.NextVisibleLine(lineIdx)) {
+                float lineScreenY = mViewY + (static_cast<float>(row) * lineH) - mScrollY;
+                // 1-based for display, 5px padding from the fold markers
+                DrawLineNumber(lineIdx + 1, mViewX + mLineNumberWidth - Styles::FOLD_MARKER_WIDTH - 5.0f, lineScreenY);
+
+                // Fold marker, a plus for collapsed regions and a minus for open ones
+                bool isFolded = mFolds.IsFolded(lineIdx);
+                if (isFolded || mDocument->IsFoldStart(lineIdx)) {
+                    float markerSize = std::floor(Styles::FOLD_MARKER_WIDTH * 0.5f);
+                    float thickness = std::max(1.0f, std::floor(Styles::DPI));
+                    float markerX = mViewX + mLineNumberWidth - Styles::FOLD_MARKER_WIDTH + std::floor((Styles::FOLD_MARKER_WIDTH - markerSize) / 2.0f);
+                    float markerY = lineScreenY + std::floor((lineH - markerSize) / 2.0f);
+                    const Styles::Color& markerColor = isFolded ? Styles::TextColor : Styles::TokenTypeComment;
+                    mRenderer->DrawRect(markerX, markerY + std::floor((markerSize - thickness) / 2.0f), markerSize, thickness, markerColor.r, markerColor.g, markerColor.b);
+                    if (isFolded) {
+                        mRenderer->DrawRect(markerX + std::floor((markerSize - thickness) / 2.0f), markerY, thickness, markerSize, markerColor.r, markerColor.g, markerColor.b);
+                    }
                 }
-                float textX = mViewX + mLineNumberWidth - textWidth - 5.0f; // 5px padding from right
-                float textY = lineScreenY;
-                mRenderer->DrawText(lineNumStr, textX, textY, Styles::TextColor.r, Styles::TextColor.g, Styles::TextColor.b);
             }
             mRenderer->ClearClip();
         }
@@ -300,19 +534,24 @@ namespace TextEdit {
         float lineH = mFont->GetLineHeight();
         float ascent = mFont->GetScaledAscent();
 
-        int firstVisibleLine = static_cast<int>(mScrollY / lineH);
-        int lastVisibleLine = static_cast<int>((mScrollY + textDisplayHeight) / lineH) + 1;
-        firstVisibleLine = std::max(0, firstVisibleLine);
-        lastVisibleLine = std::min(static_cast<int>(mDocument->GetLineCount() - 1), lastVisibleLine);
+        int firstVisibleRow = static_cast<int>(mScrollY / lineH);
+        int lastVisibleRow = static_cast<int>((mScrollY + textDisplayHeight) / lineH) + 1;
+        firstVisibleRow = std::max(0, firstVisibleRow);
+        lastVisibleRow = std::min(static_cast<int>(rowCount - 1), lastVisibleRow);
+        const unsigned int firstVisibleLine = mFolds.RowToLine(static_cast<unsigned int>(firstVisibleRow));
+        const unsigned int lastVisibleLine = mFolds.RowToLine(static_cast<unsigned int>(lastVisibleRow));
 
         // --- Render Selection ---
         if (mDocument->HasSelection()) {
             Document::Span selection = mDocument->GetSelection(); // Normalized
-            for (unsigned int lineIdx = selection.start.line; lineIdx <= selection.end.line; ++lineIdx) {
-                if (static_cast<int>(lineIdx) < firstVisibleLine || static_cast<int>(lineIdx) > lastVisibleLine) continue;
-
+            unsigned int selectionFirstLine = std::max(selection.start.line, firstVisibleLine);
+            unsigned int selectionLastLine = std::min(selection.end.line, lastVisibleLine);
+            if (mFolds.IsHidden(selectionFirstLine)) {
+                selectionFirstLine = mFolds.NextVisibleLine(selectionFirstLine);
+            }
+            for (unsigned int lineIdx = selectionFirstLine; lineIdx <= selectionLastLine; lineIdx = mFolds.NextVisibleLine(lineIdx)) {
                 const std::u32string& lineText = mDocument->GetLine(lineIdx).text;
-                float lineScreenY = mViewY + (static_cast<float>(lineIdx) * lineH) - mScrollY;
+                float lineScreenY = mViewY + (static_cast<float>(mFolds.LineToRow(lineIdx)) * lineH) - mScrollY;
 
                 unsigned int selStartCol = (lineIdx == selection.start.line) ? selection.start.column : 0;
                 unsigned int selEndCol = (lineIdx == selection.end.line) ? selection.end.column : static_cast<unsigned int>(lineText.length());
@@ -351,10 +590,12 @@ namespace TextEdit {
         }
 
         // --- Render Text ---
-        for (int lineIdx = firstVisibleLine; lineIdx <= lastVisibleLine; ++lineIdx) {
-            const Document::Line& lineObj = mDocument->GetLine(static_cast<unsigned int>(lineIdx));
+        unsigned int textLineIdx = firstVisibleLine;
+        for (int row = firstVisibleRow; row <= lastVisibleRow; ++row, textLineIdx = mFolds.NextVisibleLine(textLineIdx)) {
+            const unsigned int lineIdx = textLineIdx;
+            const Document::Line& lineObj = mDocument->GetLine(lineIdx);
             const std::u32string& lineText = lineObj.text;
-            float lineScreenY_top = mViewY + (static_cast<float>(lineIdx) * lineH) - mScrollY;
+            float lineScreenY_top = mViewY + (static_cast<float>(row) * lineH) - mScrollY;
 
             float lineStartX_world = 0.0f; // Text is drawn relative to this X in world space (before scroll)
             float lineStartX_screen = textAreaStartX + lineStartX_world - mScrollX;
@@ -362,13 +603,14 @@ namespace TextEdit {
             // This forces visible lines to re-tokenize. It's optional since the background tokenizer is always running!
             mDocument->TokenizeLine(lineIdx);
 
+            // Tokens are drawn at their place in the line layout, kerning across token edges included
+            const std::vector<float>& positions = mLineLayouts.GetPositions(*mDocument, *mFont, lineIdx);
             if (mDocument->GetHighlighter() == Highlighter::Text || lineObj.tokens.size() == 0) {
-                mRenderer->DrawText(lineText, lineStartX_screen, lineScreenY_top,
-                    Styles::TextColor.r, Styles::TextColor.g, Styles::TextColor.b,
-                    lineStartX_screen);  // Pass line start for tab calculation
+                mRenderer->DrawPositionedText(lineText, positions, 0, static_cast<int>(lineText.length()),
+                    lineStartX_screen, lineScreenY_top,
+                    Styles::TextColor.r, Styles::TextColor.g, Styles::TextColor.b);
             }
             else {
-                float x_pos_pen = lineStartX_screen;
                 for (unsigned int i = 0, size = (unsigned int)lineObj.tokens.size(); i < size; ++i) {
                     TextEdit::TokenType tokenType = lineObj.tokens[i].first;
                     const Styles::Color& style = Styles::style_map.at(tokenType);
@@ -379,23 +621,28 @@ namespace TextEdit {
                         end_in_string = lineObj.tokens[i + 1].second;
                     }
 
-                    // Pass lineStartX_screen as the line start position for correct tab calculation
-                    x_pos_pen += mRenderer->DrawText(lineText, start_in_string, end_in_string,
-                        x_pos_pen, lineScreenY_top,
-                        style.r, style.g, style.b,
-                        lineStartX_screen);  // IMPORTANT: Pass line start!
+                    mRenderer->DrawPositionedText(lineText, positions, start_in_string, end_in_string,
+                        lineStartX_screen, lineScreenY_top,
+                        style.r, style.g, style.b);
                 }
             }
+
+            // Collapsed regions trail off past the end of their header line
+            if (mFolds.IsFolded(lineIdx)) {
+                float ellipsisX = lineStartX_screen + GetLinePixelWidth(lineIdx) + mFont->GetSpaceWidthPixels();
+                mRenderer->DrawText(U"...", ellipsisX, lineScreenY_top, Styles::TokenTypeComment.r, Styles::TokenTypeComment.g, Styles::TokenTypeComment.b);
+            }
         }
 
 
         // --- Render Cursor ---
         if (mShowCursor && !mDocument->HasSelection()) {
             Document::Cursor cursor = mDocument->GetCursor();
-            if (static_cast<int>(cursor.line) >= firstVisibleLine && static_cast<int>(cursor.line) <= lastVisibleLine) {
+            int cursorRow = static_cast<int>(mFolds.LineToRow(cursor.line));
+            if (!mFolds.IsHidden(cursor.line) && cursorRow >= firstVisibleRow && cursorRow <= lastVisibleRow) {
                 float cursorX_world = GetColumnPixelOffset(cursor.line, cursor.column);
                 float cursorScreenX = textAreaStartX + cursorX_world - mScrollX;
-                float cursorScreenY = mViewY + (static_cast<float>(cursor.line) * lineH) - mScrollY;
+                float cursorScreenY = mViewY + (static_cast<float>(cursorRow) * lineH) - mScrollY;
 
                 // Ensure cursor is within the clipped text area, or at least at the edge
                 cursorScreenX = std::max(textAreaStartX, std::min(cursorScreenX, textAreaStartX + textDisplayWidth - 1.0f));
@@ -406,6 +653,13 @@ namespace TextEdit {
 
         mRenderer->ClearClip(); // Reset clip for scrollbars and dropdown
 
+        // --- Render Minimap ---
+        {
+            Rect minimapArea(mViewX + mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - Styles::MINIMAP_WIDTH, mViewY, Styles::MINIMAP_WIDTH, textDisplayHeight);
+            bool hoverSlider = mMinimap->GetSliderRect().Contains(static_cast<float>(mLastMousePos.x), static_cast<float>(mLastMousePos.y));
+            mMinimap->Display(minimapArea, RowScrollToLineScroll(mScrollY), textDisplayHeight, lineH, hoverSlider || mIsDraggingMinimap);
+        }
+
         // --- Render Scrollbars ---
         { // V scroll bar
             float trackX = mViewX + mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE;
@@ -564,6 +818,7 @@ namespace TextEdit {
             }
         }
 
+        mLastDisplayed = CaptureDisplayState();
     }
 
     void DocumentView::CloseMenus() {
@@ -651,7 +906,7 @@ namespace TextEdit {
             else {
                 if (newPos.column > 0) newPos.column--;
                 else if (newPos.line > 0) {
-                    newPos.line--;
+                    newPos.line = mFolds.RowToLine(mFolds.LineToRow(newPos.line) - 1); // Skip over folds
                     newPos.column = static_cast<unsigned int>(mDocument->GetLine(newPos.line).text.length());
                 }
             }
@@ -667,8 +922,8 @@ namespace TextEdit {
             else {
                 const std::u32string& line = mDocument->GetLine(newPos.line).text;
                 if (newPos.column < line.length()) newPos.column++;
-                else if (newPos.line < mDocument->GetLineCount() - 1) {
-                    newPos.line++;
+                else if (mFolds.NextVisibleLine(newPos.line) < mDocument->GetLineCount()) {
+                    newPos.line = mFolds.NextVisibleLine(newPos.line); // Skip over folds
                     newPos.column = 0;
                 }
             }
@@ -679,8 +934,9 @@ namespace TextEdit {
         {
             Document::Cursor newPos = currentPos;
             int numLinesToMove = ctrl ? 5 : 1;
-            if (static_cast<int>(newPos.line) - numLinesToMove >= 0) {
-                newPos.line -= numLinesToMove;
+            unsigned int row = mFolds.LineToRow(newPos.line); // Move by rows, so folds count as one line
+            if (static_cast<int>(row) - numLinesToMove >= 0) {
+                newPos.line = mFolds.RowToLine(row - numLinesToMove);
                 newPos.column = GetColumnFromPixelOffset(newPos.line, mDesiredColumnX);
             }
             else { // Go to beginning of document
@@ -694,8 +950,9 @@ namespace TextEdit {
         {
             Document::Cursor newPos = currentPos;
             int numLinesToMove = ctrl ? 5 : 1;
-            if (newPos.line + numLinesToMove < mDocument->GetLineCount()) {
-                newPos.line += numLinesToMove;
+            unsigned int row = mFolds.LineToRow(newPos.line);
+            if (row + numLinesToMove < mFolds.GetRowCount(mDocument->GetLineCount())) {
+                newPos.line = mFolds.RowToLine(row + numLinesToMove);
                 newPos.column = GetColumnFromPixelOffset(newPos.line, mDesiredColumnX);
             }
             else { // Go to end of document
@@ -949,6 +1206,16 @@ namespace TextEdit {
                 ExternalCreateNewDocument();
             }
             break;
+        case VK_OEM_4:
+            if (ctrl && shift) { // Ctrl+Shift+[ (Fold)
+                FoldAtCursor();
+            }
+            break;
+        case VK_OEM_6:
+            if (ctrl && shift) { // Ctrl+Shift+] (Unfold)
+                UnfoldAtCursor();
+            }
+            break;
         case VK_Y: 
             if (ctrl) {
                 mDocument->Redo();
@@ -1064,6 +1331,15 @@ namespace TextEdit {
             return; // Absorb click
         }
 
+        // Fold markers sit at the right edge of the gutter
+        if (e.mouse.button == VK_LBUTTON &&
+            e.mouse.x >= mViewX + mLineNumberWidth - Styles::FOLD_MARKER_WIDTH && e.mouse.x < mViewX + mLineNumberWidth &&
+            e.mouse.y < mViewY + mViewHeight - TextEdit::Styles::SCROLLBAR_SIZE) {
+            if (ToggleFold(docPos.line)) {
+                return;
+            }
+        }
+
         // Click detection for double/triple click
         const float MULTI_CLICK_TIME = 0.25f; // Time threshold for multi-click (in seconds)
         bool isDoubleClick = false;
@@ -1118,6 +1394,20 @@ namespace TextEdit {
             }
         }
 
+        if (mMinimap->Contains(static_cast<float>(e.mouse.x), static_cast<float>(e.mouse.y))) {
+            Rect slider = mMinimap->GetSliderRect();
+            if (slider.Contains(static_cast<float>(e.mouse.x), static_cast<float>(e.mouse.y))) {
+                mDragScrollbarOffset = static_cast<float>(e.mouse.y) - slider.y;
+            }
+            else { // Jump to the clicked line, then keep dragging from the middle of the slider
+                mScrollY = LineScrollToRowScroll(mMinimap->GetScrollForClick(static_cast<float>(e.mouse.y)));
+                ClampScroll();
+                mDragScrollbarOffset = slider.height / 2.0f;
+            }
+            mIsDraggingMinimap = true;
+            return;
+        }
+
         if (mVertScrollbarRect.width > 0 && mVertScrollbarRect.Contains(static_cast<float>(e.mouse.x), static_cast<float>(e.mouse.y))) {
             mIsDraggingVertScrollbar = true;
             mDragScrollbarOffset = static_cast<float>(e.mouse.y) - mVertScrollbarRect.y; // Offset from top of nib
@@ -1130,12 +1420,12 @@ namespace TextEdit {
         }
 
         // Check for clicks on scrollbar tracks (outside the nib)
-        float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - mLineNumberWidth; // Text area starts after line numbers
+        float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - Styles::MINIMAP_WIDTH - mLineNumberWidth; // Text area starts after line numbers
         float textDisplayHeight = mViewHeight - TextEdit::Styles::SCROLLBAR_SIZE;
         float horzScrollbarTrackWidth = mViewWidth - Styles::HIGHLIGHTER_BUTTON_WIDTH - mLineNumberWidth;
 
         if (mTotalContentHeight > mViewHeight) { // Vertical scrollbar exists
-            Rect vTrackRect = { mViewX + mLineNumberWidth + textDisplayWidth, mViewY, TextEdit::Styles::SCROLLBAR_SIZE, textDisplayHeight };
+            Rect vTrackRect = { mViewX + mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE, mViewY, TextEdit::Styles::SCROLLBAR_SIZE, textDisplayHeight };
             if (vTrackRect.Contains(static_cast<float>(e.mouse.x), static_cast<float>(e.mouse.y)) && !mVertScrollbarRect.Contains(static_cast<float>(e.mouse.x), static_cast<float>(e.mouse.y))) {
                 float clickRatio = (static_cast<float>(e.mouse.y) - vTrackRect.y) / vTrackRect.height;
                 mScrollY = clickRatio * (mTotalContentHeight - textDisplayHeight); // Center view on click
@@ -1193,6 +1483,7 @@ namespace TextEdit {
         mIsSelecting = false;
         mIsDraggingVertScrollbar = false;
         mIsDraggingHorzScrollbar = false;
+        mIsDraggingMinimap = false;
     }
 
     void DocumentView::HandleMouseMove(const InputEvent& e) {
@@ -1215,6 +1506,11 @@ namespace TextEdit {
             ClampScroll();
             return;
         }
+        if (mIsDraggingMinimap) {
+            mScrollY = LineScrollToRowScroll(mMinimap->GetScrollForSlider(static_cast<float>(e.mouse.y) - mDragScrollbarOffset));
+            ClampScroll();
+            return;
+        }
         if (mIsDraggingHorzScrollbar) {
             float trackX = mViewX;
             float trackW = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE;
@@ -1261,8 +1557,9 @@ namespace TextEdit {
         if (!mFont || mViewHeight <= 0) return { 0,0 };
 
         float textDisplayY = screenY - mViewY; // Y relative to view top
-        unsigned int lineIdx = static_cast<unsigned int>((textDisplayY + mScrollY) / mFont->GetLineHeight());
-        lineIdx = std::min(lineIdx, mDocument->GetLineCount() > 0 ? mDocument->GetLineCount() - 1 : 0);
+        unsigned int row = static_cast<unsigned int>(std::max(0.0f, textDisplayY + mScrollY) / mFont->GetLineHeight());
+        row = std::min(row, mFolds.GetRowCount(mDocument->GetLineCount()) - 1);
+        unsigned int lineIdx = mFolds.RowToLine(row);
 
         // If click is in line number area, return column 0.
         // The padding area to the right of the numbers is treated as part of the text area.
@@ -1280,67 +1577,18 @@ namespace TextEdit {
 
     float DocumentView::GetColumnPixelOffset(unsigned int lineIdx, unsigned int column) const {
         if (!mFont) return 0.0f;
-        const std::u32string& lineText = mDocument->GetLine(lineIdx).text;
-        float currentX = 0.0f;
-        unsigned int tabSpaces = mFont->GetTabNumSpaces();
-        float spaceWidth = static_cast<float>(mFont->GetSpaceWidthPixels());
-        if (spaceWidth == 0.0f) spaceWidth = mFont->GetGlyph(U' ').advance;
-        if (spaceWidth == 0.0f) spaceWidth = 10.0f;
-
-        // Simple fixed-width tabs
-        float tabWidth = spaceWidth * static_cast<float>(tabSpaces);
-
-        for (unsigned int i = 0; i < column; ++i) {
-            if (i >= lineText.length()) break;
-            char32_t c = lineText[i];
-            if (c == U'\t') {
-                // Tab is simply a fixed width
-                currentX += tabWidth;
-            }
-            else {
-                currentX += mFont->GetGlyph(c).advance;
-            }
-        }
-        return currentX;
+        const std::vector<float>& positions = mLineLayouts.GetPositions(*mDocument, *mFont, lineIdx);
+        return positions[std::min(static_cast<size_t>(column), positions.size() - 1)];
     }
 
     unsigned int DocumentView::GetColumnFromPixelOffset(unsigned int lineIdx, float targetX) const {
         if (!mFont) return 0;
-        const std::u32string& lineText = mDocument->GetLine(lineIdx).text;
-        float currentX = 0.0f;
-        unsigned int tabSpaces = mFont->GetTabNumSpaces();
-        float spaceWidth = static_cast<float>(mFont->GetSpaceWidthPixels());
-        if (spaceWidth == 0.0f) spaceWidth = mFont->GetGlyph(U' ').advance;
-        if (spaceWidth == 0.0f) spaceWidth = 10.0f;
-
-        // Simple fixed-width tabs
-        float tabWidth = spaceWidth * static_cast<float>(tabSpaces);
-
-        for (unsigned int i = 0; i < lineText.length(); ++i) {
-            char32_t c = lineText[i];
-            float charWidth;
-            if (c == U'\t') {
-                // Tab is simply a fixed width
-                charWidth = tabWidth;
-            }
-            else {
-                charWidth = mFont->GetGlyph(c).advance;
-            }
-
-            // Check if the target position is within this character
-            if (targetX < currentX + charWidth / 2.0f) {
-                return i;
-            }
-            currentX += charWidth;
-        }
-        return static_cast<unsigned int>(lineText.length());
+        return LineLayoutCache::GetColumnAt(mLineLayouts.GetPositions(*mDocument, *mFont, lineIdx), targetX);
     }
 
     float DocumentView::GetLinePixelWidth(unsigned int lineIdx) const {
         if (!mFont) return 0.0f;
-        const std::u32string& lineText = mDocument->GetLine(lineIdx).text;
-        // This is the same as GetColumnPixelOffset for the full line length
-        return GetColumnPixelOffset(lineIdx, static_cast<unsigned int>(lineText.length()));
+        return mLineLayouts.GetWidth(*mDocument, *mFont, lineIdx);
     }
 
     void DocumentView::ScrollToCursor() {
@@ -1349,11 +1597,11 @@ namespace TextEdit {
         Document::Cursor cursor = mDocument->GetCursor();
         float lineH = mFont->GetLineHeight();
 
-        float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - mLineNumberWidth; // Text area starts after line numbers
+        float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - Styles::MINIMAP_WIDTH - mLineNumberWidth; // Text area starts after line numbers
         float textDisplayHeight = mViewHeight - TextEdit::Styles::SCROLLBAR_SIZE;
 
         // Vertical scroll
-        float cursorTopY_world = static_cast<float>(cursor.line) * lineH;
+        float cursorTopY_world = static_cast<float>(mFolds.LineToRow(cursor.line)) * lineH;
         float cursorBottomY_world = cursorTopY_world + lineH;
 
         if (cursorTopY_world < mScrollY) {
@@ -1379,7 +1627,7 @@ namespace TextEdit {
     }
 
     void DocumentView::ClampScroll() {
-        float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - mLineNumberWidth; // Text area starts after line numbers
+        float textDisplayWidth = mViewWidth - TextEdit::Styles::SCROLLBAR_SIZE - Styles::MINIMAP_WIDTH - mLineNumberWidth; // Text area starts after line numbers
         float textDisplayHeight = mViewHeight - TextEdit::Styles::SCROLLBAR_SIZE;
 
         float maxScrollY = std::max(0.0f, mTotalContentHeight - textDisplayHeight);
@@ -1389,6 +1637,89 @@ namespace TextEdit {
         mScrollX = std::max(0.0f, std::min(mScrollX, maxScrollX));
     }
 
+    void DocumentView::SyncFolds() {
+        unsigned int version = mDocument->GetEditVersion();
+        if (version == mFoldsEditVersion) {
+            return;
+        }
+
+        const std::deque<Document::LineEdit>& edits = mDocument->GetRecentEdits();
+        if (edits.empty() || edits.front().version > mFoldsEditVersion + 1) {
+            mFolds.Clear(); // Too far behind to know where the lines went
+        }
+        else {
+            for (const Document::LineEdit& edit : edits) {
+                if (edit.version <= mFoldsEditVersion) {
+                    continue;
+                }
+                if (edit.reset) {
+                    mFolds.Clear();
+                }
+                else {
+                    mFolds.ApplyEdit(edit.line, edit.lineDelta);
+                }
+            }
+        }
+        mFoldsEditVersion = version;
+    }
+
+    bool DocumentView::ToggleFold(unsigned int line) {
+        if (mFolds.RemoveFold(line)) {
+            return true;
+        }
+
+        unsigned int lastLine = 0;
+        if (!mDocument->FindFoldRegion(line, lastLine)) {
+            return false;
+        }
+        mFolds.AddFold(line, lastLine);
+
+        // Don't leave the cursor inside the fold, Update would open it right back up
+        if (mFolds.IsHidden(mDocument->GetCursor().line) || mFolds.IsHidden(mDocument->GetAnchor().line)) {
+            mDocument->PlaceCursor(Document::Cursor(line, static_cast<unsigned int>(mDocument->GetLine(line).text.length())));
+            UpdateDesiredColumnXFromCursor();
+        }
+        mTotalContentHeight = static_cast<float>(mFolds.GetRowCount(mDocument->GetLineCount())) * mFont->GetLineHeight();
+        ClampScroll();
+        return true;
+    }
+
+    void DocumentView::FoldAtCursor() {
+        // A folded cursor line means the next region out, lines above it can't be folded, they would hide the cursor
+        unsigned int cursorLine = mDocument->GetCursor().line;
+        unsigned int firstLine = 0, lastLine = 0;
+        if (mDocument->FindEnclosingFoldRegion(cursorLine, !mFolds.IsFolded(cursorLine), firstLine, lastLine) &&
+            !mFolds.IsFolded(firstLine)) {
+            ToggleFold(firstLine);
+        }
+    }
+
+    void DocumentView::UnfoldAtCursor() {
+        unsigned int cursorLine = mDocument->GetCursor().line;
+        if (!mFolds.RemoveFold(cursorLine)) {
+            mFolds.RevealLine(cursorLine);
+        }
+    }
+
+    float DocumentView::RowScrollToLineScroll(float scrollY) const {
+        if (!mFolds.HasFolds()) {
+            return scrollY;
+        }
+        float lineH = mFont->GetLineHeight();
+        float row = std::floor(scrollY / lineH);
+        return (static_cast<float>(mFolds.RowToLine(static_cast<unsigned int>(row))) + (scrollY / lineH - row)) * lineH;
+    }
+
+    float DocumentView::LineScrollToRowScroll(float scrollY) const {
+        if (!mFolds.HasFolds()) {
+            return scrollY;
+        }
+        float lineH = mFont->GetLineHeight();
+        float line = std::floor(scrollY / lineH);
+        unsigned int lineIdx = std::min(static_cast<unsigned int>(line), mDocument->GetLineCount() - 1);
+        return (static_cast<float>(mFolds.LineToRow(lineIdx)) + (scrollY / lineH - line)) * lineH;
+    }
+
     void DocumentView::UpdateDesiredColumnXFromCursor() {
         if (!mDocument || !mFont) return;
         Document::Cursor c = mDocument->GetCursor();
@@ -3,6 +3,9 @@
 #include "Renderer.h"
 #include "Document.h"
 #include "Font.h"
+#include "Minimap.h"
+#include "FoldIndex.h"
+#include "LineLayoutCache.h"
 #include "application.h"
 #include <string> // For std::wstring in Clipboard namespace
 
@@ -44,6 +47,16 @@ namespace TextEdit {
         bool mIsDraggingHorzScrollbar;
         float mDragScrollbarOffset; // Offset from nib top/left to mouse click point
 
+        std::shared_ptr<Minimap> mMinimap;
+        bool mIsDraggingMinimap;
+
+        // Collapsed folds. Everything that places lines vertically goes through this, rows are what is drawn.
+        FoldIndex mFolds;
+        unsigned int mFoldsEditVersion; // Last document edit the folds were moved for
+
+        // Kerned character positions of lines, drawing and all the measuring below go through this
+        mutable LineLayoutCache mLineLayouts;
+
         // Highlighter Dropdown State
         Rect mHighlighterButtonRect;   // Screen rect of the highlighter dropdown button
         bool mIsHighlighterDropdownOpen; // True if dropdown is open
@@ -59,6 +72,37 @@ namespace TextEdit {
         float mLineNumberWidth;
         Rect mUndoButtonRect;
         Rect mRedoButtonRect;
+
+        // Gutter. Digit glyphs are looked up once per font bake, and the width only changes when the
+        // line count leaves [mGutterLineCountMin, mGutterLineCountMax), a range of equal digit counts.
+        GlyphInfo mDigitGlyphs[10];
+        unsigned int mDigitGlyphGeneration;
+        unsigned int mGutterLineCountMin;
+        unsigned int mGutterLineCountMax;
+
+        // What the last Display call drew. Update compares it against the current state and only
+        // invalidates the parts of the view that changed, so a blinking cursor repaints a few pixels.
+        struct DisplayState {
+            bool valid = false;
+            Rect view;
+            float scrollX = 0.0f, scrollY = 0.0f;
+            float lineNumberWidth = 0.0f;
+            float lineHeight = 0.0f;
+            unsigned int lineCount = 0;
+            unsigned int editVersion = 0;
+            Document::Cursor cursor;
+            Document::Cursor anchor;
+            bool showCursor = false;
+            bool canUndo = false, canRedo = false;
+            int selectedHighlighterIndex = 0;
+            bool highlighterDropdownOpen = false;
+            bool contextMenuOpen = false;
+            MousePos contextMenuPos = { 0, 0 };
+            bool draggingVert = false, draggingHorz = false, draggingMinimap = false;
+            int hoveredWidget = -1;
+            unsigned int foldVersion = 0;
+        };
+        DisplayState mLastDisplayed;
     public:
         DocumentView(std::shared_ptr<Renderer> renderer, std::shared_ptr<Document> doc, std::shared_ptr<Font> font, std::shared_ptr<Font> smallFont);
         virtual ~DocumentView();
@@ -97,6 +141,25 @@ namespace TextEdit {
         void ClampScroll();
         void UpdateDesiredColumnXFromCursor(); // Sets mDesiredColumnX based on current cursor
 
+        // Gutter
+        void UpdateGutter(); // Refreshes the digit glyphs and width if the font or line count magnitude changed
+        void DrawLineNumber(unsigned int number, float rightX, float topY); // Right aligned to rightX
+
+        // Folding
+        void SyncFolds(); // Moves folds along with the edits made since the last call
+        bool ToggleFold(unsigned int line); // False if nothing can be folded at line
+        void FoldAtCursor(); // Innermost region around the cursor
+        void UnfoldAtCursor();
+        float RowScrollToLineScroll(float scrollY) const; // For things that don't know about folds, like the minimap
+        float LineScrollToRowScroll(float scrollY) const;
+
+        // Damage tracking
+        DisplayState CaptureDisplayState() const;
+        int GetHoveredWidget() const; // Id of the scrollbar nib, button or menu option under the mouse, -1 for none
+        void InvalidateChanges();
+        void InvalidateLines(unsigned int firstLine, unsigned int lastLine);
+        void InvalidateCursor(const Document::Cursor& cursor);
+
         // Word Navigation Helpers
         bool IsWordChar(char32_t c) const;
         bool IsWhitespace(char32_t c) const; // Excludes newline
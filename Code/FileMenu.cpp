@@ -26,6 +26,12 @@ namespace TextEdit {
     }
 
     void FileMenu::OnInput(const InputEvent& e) {
+        int lastOpenMenu = mOpenMenuIndex;
+        int lastHoveredItem = GetHoveredItemIndex();
+        if (lastOpenMenu != -1 && e.type != InputEvent::Type::MOUSE_MOVE) {
+            InvalidateOpenMenu(); // Clicks can close the menu, damage it while the rect is still known
+        }
+
         // Update mouse position on any mouse event for hover tracking
         if (e.type == InputEvent::Type::MOUSE_MOVE || e.type == InputEvent::Type::MOUSE_DOWN || e.type == InputEvent::Type::MOUSE_UP) {
             mLastMousePos = { e.mouse.x, e.mouse.y };
@@ -45,6 +51,42 @@ namespace TextEdit {
             // Other input types are not handled by the menu
             break;
         }
+
+        if (mOpenMenuIndex != lastOpenMenu || GetHoveredItemIndex() != lastHoveredItem) {
+            if (lastOpenMenu != -1 && lastOpenMenu != mOpenMenuIndex) {
+                // Switched from one dropdown to another, the old one uncovers whatever is below it
+                int newOpenMenu = mOpenMenuIndex;
+                mOpenMenuIndex = lastOpenMenu;
+                InvalidateOpenMenu();
+                mOpenMenuIndex = newOpenMenu;
+            }
+            InvalidateOpenMenu();
+        }
+    }
+
+    int FileMenu::GetHoveredItemIndex() const {
+        if (mOpenMenuIndex == -1) {
+            return -1;
+        }
+
+        const auto& openMenu = mMenuOptions[mOpenMenuIndex];
+        Rect dropdownRect = GetOpenMenuRect();
+        if (!dropdownRect.Contains((float)mLastMousePos.x, (float)mLastMousePos.y)) {
+            return -1;
+        }
+        for (size_t i = 0; i < openMenu.items.size(); ++i) {
+            float itemY = GetItemY(openMenu, i);
+            if ((float)mLastMousePos.y >= itemY && (float)mLastMousePos.y < itemY + GetItemHeight(openMenu.items[i])) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    void FileMenu::InvalidateOpenMenu() {
+        if (mOpenMenuIndex != -1) {
+            mRenderer->Invalidate(GetOpenMenuRect());
+        }
     }
 
     float FileMenu::Display(float x, float y, float w, float h) {
@@ -178,6 +220,7 @@ namespace TextEdit {
                 if (itemRect.Contains((float)e.mouse.x, (float)e.mouse.y)) {
                     if (openMenu.items[i].action) {
                         openMenu.items[i].action();
+                        RequestRedraw(); // Menu actions can change anything, fonts, documents, layout
                     }
                     CloseOpenMenu();
                     mIsMouseDown = false;
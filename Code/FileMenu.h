@@ -78,6 +78,10 @@ namespace TextEdit {
         void HandleMouseMove(const InputEvent& e);
         void CloseOpenMenu();
 
+        // Damage tracking, the open dropdown and the item under the mouse are all that can change
+        int GetHoveredItemIndex() const;
+        void InvalidateOpenMenu();
+
         // Helper functions
         bool IsDivider(const MenuItem& item) const;
         float GetItemHeight(const MenuItem& item) const;
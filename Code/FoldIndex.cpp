@@ -0,0 +1,193 @@
+#include "FoldIndex.h"
+#include <algorithm>
+
+namespace TextEdit {
+    FoldIndex::FoldIndex() : mHiddenLineCount(0), mVersion(0) {
+    }
+
+    void FoldIndex::Clear() {
+        if (mFolds.empty()) {
+            return;
+        }
+        mFolds.clear();
+        Rebuild();
+    }
+
+    bool FoldIndex::HasFolds() const {
+        return !mFolds.empty();
+    }
+
+    unsigned int FoldIndex::GetVersion() const {
+        return mVersion;
+    }
+
+    void FoldIndex::AddFold(unsigned int first, unsigned int last) {
+        if (last <= first) {
+            return;
+        }
+
+        auto it = std::lower_bound(mFolds.begin(), mFolds.end(), first,
+            [](const Fold& fold, unsigned int line) { return fold.first < line; });
+        if (it != mFolds.end() && it->first == first) {
+            it->last = last;
+        }
+        else {
+            mFolds.insert(it, { first, last });
+        }
+        Rebuild();
+    }
+
+    bool FoldIndex::RemoveFold(unsigned int first) {
+        auto it = std::lower_bound(mFolds.begin(), mFolds.end(), first,
+            [](const Fold& fold, unsigned int line) { return fold.first < line; });
+        if (it == mFolds.end() || it->first != first) {
+            return false;
+        }
+        mFolds.erase(it);
+        Rebuild();
+        return true;
+    }
+
+    bool FoldIndex::IsFolded(unsigned int first) const {
+        auto it = std::lower_bound(mFolds.begin(), mFolds.end(), first,
+            [](const Fold& fold, unsigned int line) { return fold.first < line; });
+        return it != mFolds.end() && it->first == first;
+    }
+
+    void FoldIndex::RevealLine(unsigned int line) {
+        size_t before = mFolds.size();
+        mFolds.erase(std::remove_if(mFolds.begin(), mFolds.end(),
+            [line](const Fold& fold) { return fold.first < line && line <= fold.last; }), mFolds.end());
+        if (mFolds.size() != before) {
+            Rebuild();
+        }
+    }
+
+    const FoldIndex::HiddenRange* FoldIndex::FindRangeAtOrBefore(unsigned int line) const {
+        // Last range starting at or before line
+        auto it = std::upper_bound(mHidden.begin(), mHidden.end(), line,
+            [](unsigned int l, const HiddenRange& range) { return l < range.first; });
+        if (it == mHidden.begin()) {
+            return nullptr;
+        }
+        return &*(it - 1);
+    }
+
+    bool FoldIndex::IsHidden(unsigned int line) const {
+        const HiddenRange* range = FindRangeAtOrBefore(line);
+        return range && line <= range->last;
+    }
+
+    unsigned int FoldIndex::LineToRow(unsigned int line) const {
+        const HiddenRange* range = FindRangeAtOrBefore(line);
+        if (!range) {
+            return line;
+        }
+        if (line <= range->last) {
+            return range->first - 1 - range->hiddenBefore; // The header is the line right before the range
+        }
+        return line - range->hiddenBefore - (range->last - range->first + 1);
+    }
+
+    unsigned int FoldIndex::RowToLine(unsigned int row) const {
+        // The row a range's first line would have had is where the line after the range ends up.
+        // That row strictly increases from range to range, so it can be searched for.
+        auto it = std::upper_bound(mHidden.begin(), mHidden.end(), row,
+            [](unsigned int r, const HiddenRange& range) { return r < range.first - range.hiddenBefore; });
+        if (it == mHidden.begin()) {
+            return row;
+        }
+        const HiddenRange& range = *(it - 1);
+        return row + range.hiddenBefore + (range.last - range.first + 1);
+    }
+
+    unsigned int FoldIndex::GetRowCount(unsigned int lineCount) const {
+        return lineCount > mHiddenLineCount ? lineCount - mHiddenLineCount : 1;
+    }
+
+    unsigned int FoldIndex::NextVisibleLine(unsigned int line) const {
+        const HiddenRange* range = FindRangeAtOrBefore(line + 1);
+        if (range && line + 1 <= range->last) {
+            return range->last + 1;
+        }
+        return line + 1;
+    }
+
+    void FoldIndex::ApplyEdit(unsigned int line, int lineDelta) {
+        if (mFolds.empty()) {
+            return;
+        }
+
+        unsigned int removedFirst = line + 1;
+        unsigned int removedLast = line + static_cast<unsigned int>(lineDelta < 0 ? -lineDelta : 0);
+
+        std::vector<Fold> kept;
+        kept.reserve(mFolds.size());
+        for (Fold fold : mFolds) {
+            if (fold.first < line && line <= fold.last) {
+                continue; // Edited inside the hidden lines, show them
+            }
+            if (lineDelta < 0 && fold.first == line) {
+                continue; // Joined the header with the lines after it
+            }
+
+            if (lineDelta > 0) {
+                if (fold.first > line) {
+                    fold.first += lineDelta;
+                    fold.last += lineDelta;
+                }
+                else if (fold.last >= line) {
+                    fold.last += lineDelta; // Lines were added to the header line's fold
+                }
+            }
+            else if (lineDelta < 0 && fold.first >= removedFirst) {
+                // Folds above the edit end before it, the checks above dropped any reaching it
+                if (fold.first <= removedLast) {
+                    continue; // Header was removed
+                }
+                fold.first -= static_cast<unsigned int>(-lineDelta);
+                fold.last -= static_cast<unsigned int>(-lineDelta);
+            }
+
+            if (fold.last > fold.first) {
+                kept.push_back(fold);
+            }
+        }
+
+        // Removing lines can move two headers onto the same line, keep the outer one
+        std::stable_sort(kept.begin(), kept.end(), [](const Fold& a, const Fold& b) { return a.first < b.first; });
+        mFolds.clear();
+        for (const Fold& fold : kept) {
+            if (!mFolds.empty() && mFolds.back().first == fold.first) {
+                mFolds.back().last = std::max(mFolds.back().last, fold.last);
+            }
+            else {
+                mFolds.push_back(fold);
+            }
+        }
+        Rebuild();
+    }
+
+    void FoldIndex::Rebuild() {
+        mHidden.clear();
+        mHiddenLineCount = 0;
+
+        // Folds are sorted by header, so nested and touching folds merge in one pass
+        for (const Fold& fold : mFolds) {
+            unsigned int first = fold.first + 1;
+            unsigned int last = fold.last;
+            if (!mHidden.empty() && first <= mHidden.back().last + 1) {
+                mHidden.back().last = std::max(mHidden.back().last, last);
+                continue;
+            }
+            mHidden.push_back({ first, last, 0 });
+        }
+
+        for (HiddenRange& range : mHidden) {
+            range.hiddenBefore = mHiddenLineCount;
+            mHiddenLineCount += range.last - range.first + 1;
+        }
+
+        mVersion += 1;
+    }
+}
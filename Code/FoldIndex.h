@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+namespace TextEdit {
+    // Collapsed folds of one view, and the mapping between document lines and the rows they are drawn on.
+    // Folds may nest, a fold inside a collapsed fold stays collapsed when the outer one is opened.
+    // The hidden lines of all folds are flattened into sorted, disjoint ranges with a running count of
+    // hidden lines, so going from a row to a line (and back) is a binary search over the folds,
+    // no matter how many lines they hide.
+    class FoldIndex {
+    public:
+        struct Fold {
+            unsigned int first; // Header line, stays visible
+            unsigned int last;  // Lines after first, up to and including last, are hidden
+        };
+    protected:
+        struct HiddenRange {
+            unsigned int first;
+            unsigned int last;
+            unsigned int hiddenBefore; // Lines hidden by all ranges before this one
+        };
+
+        std::vector<Fold> mFolds; // Sorted by first, at most one fold per header line
+        std::vector<HiddenRange> mHidden;
+        unsigned int mHiddenLineCount;
+        unsigned int mVersion; // Bumped on every change, views compare it to know when to repaint
+
+        void Rebuild();
+        const HiddenRange* FindRangeAtOrBefore(unsigned int line) const;
+    public:
+        FoldIndex();
+
+        void Clear();
+        bool HasFolds() const;
+        unsigned int GetVersion() const;
+
+        void AddFold(unsigned int first, unsigned int last);
+        bool RemoveFold(unsigned int first); // False if no fold starts on first
+        bool IsFolded(unsigned int first) const;
+        void RevealLine(unsigned int line); // Opens every fold hiding line
+
+        bool IsHidden(unsigned int line) const;
+        unsigned int LineToRow(unsigned int line) const; // Hidden lines map to the row of their header
+        unsigned int RowToLine(unsigned int row) const;
+        unsigned int GetRowCount(unsigned int lineCount) const;
+        unsigned int NextVisibleLine(unsigned int line) const; // First line after line that isn't hidden
+
+        // Keeps folds on the same text after lines were inserted (positive) or removed (negative) after line.
+        // Folds with an edit inside their hidden lines are opened.
+        void ApplyEdit(unsigned int line, int lineDelta);
+    };
+}
@@ -1,67 +1,98 @@
 ﻿#include "Font.h"
+#include "Profiler.h"
 #include <cstring> // for memcpy
 #include <cmath>   // for std::round, std::floor
-#include <algorithm> // for std::min, std::max
+#include <algorithm> // for std::min, std::max, std::sort
+#include <cstdio>
+#include "miniz.h"
 
 namespace TextEdit {
     static constexpr int GLYPH_PADDING = 1; // 1-pixel padding around each glyph
     static constexpr int INITIAL_ATLAS_SIZE = 256; // Initial size for the font atlas texture
     static constexpr unsigned int DEFAULT_MAX_ATLAS_SIZE = 4096; // Default max atlas size
-
-    std::shared_ptr<Font> Font::Create(const void* data, unsigned int bytes, float pixelHeight, float dpiScale) {
+    static constexpr unsigned int DEFAULT_MAX_ATLAS_PAGES = 4; // Pages of the max size before glyphs are evicted
+    static constexpr size_t MAX_ATLAS_CHANGES = 256; // Consumers further behind than this upload the whole atlas
+    static constexpr unsigned int HOT_GLYPH_FRAMES = 60; // Evicted glyphs used this recently are packed back in right away
+    static constexpr char32_t DENSE_GLYPHS = 0x3000; // Latin through CJK punctuation, looked up without hashing
+    static constexpr uint32_t NO_GLYPH = 0xFFFFFFFF;
+    static constexpr unsigned int MIN_SPARSE_GLYPH_BITS = 6;
+    static constexpr int SUBPIXEL_BINS = 4; // Quarter pixel variants
+    static constexpr unsigned int SUBPIXEL_KEY_SHIFT = 24; // Variant bins are stored above the highest codepoint
+    static constexpr unsigned int DEFAULT_SUBPIXEL_VARIANT_BUDGET = 1024;
+    static constexpr char32_t KERNING_TABLE_CHARS = 128; // Pairs below this are looked up once
+    static constexpr int16_t KERNING_UNKNOWN = INT16_MIN;
+
+    static constexpr uint32_t ATLAS_CACHE_MAGIC = 0x54414343; // "CCAT"
+    static constexpr uint32_t ATLAS_CACHE_FORMAT = 2; // Bump whenever what SaveAtlas writes changes
+
+    // Distance field atlases are baked once at this height in device pixels and scaled from there.
+    // The field reaches SDF_SPREAD pixels past the outline, which covers heavy minification.
+    static constexpr float SDF_PIXEL_HEIGHT = 48.0f;
+    static constexpr int SDF_SPREAD = 6;
+
+    std::shared_ptr<Font> Font::Create(const void* data, unsigned int bytes, float pixelHeight, float dpiScale,
+        const std::vector<unsigned char>* cachedAtlas, bool distanceField) {
         if (!data || bytes == 0 || pixelHeight <= 0.0f || dpiScale <= 0.0f) {
             return nullptr;
         }
-        auto font = std::make_shared<Font>(data, bytes, pixelHeight, dpiScale);
+        auto font = std::make_shared<Font>(data, bytes, pixelHeight, dpiScale, cachedAtlas, distanceField);
         if (!font->IsValid()) {
             return nullptr;
         }
         return font;
     }
 
-    Font::Font(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale)
-        : mBaseFontLoaded(false), mBaseFontPixelHeight(pixelHeight), mDpiScale(dpiScale),
+    Font::Font(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale,
+        const std::vector<unsigned char>* cachedAtlas, bool distanceField)
+        : mBaseFontLoaded(false), mBaseFontPixelHeight(pixelHeight), mDpiScale(dpiScale), mBaseFontHash(0),
+        mDistanceField(distanceField),
         mExtFontLoaded(false), mExtFontPixelHeight(pixelHeight), mExtDpiScale(dpiScale),
-        mTextureID(0),
+        mAtlasVersion(1),
         mAtlasWidth(INITIAL_ATLAS_SIZE),
         mAtlasHeight(INITIAL_ATLAS_SIZE),
         mMaxAtlasSize(DEFAULT_MAX_ATLAS_SIZE),
-        mNextX(0), mNextY(0), mRowHeight(0),
+        mMaxAtlasPages(DEFAULT_MAX_ATLAS_PAGES),
+        mGlyphGeneration(1),
+        mFrame(1),
+        mRepacking(false),
+        mSubpixelPositioning(false),
+        mSubpixelVariantBudget(DEFAULT_SUBPIXEL_VARIANT_BUDGET),
+        mSubpixelVariants(0),
+        mSubpixelTrimFrame(0),
+        mAsyncRasterization(true),
+        mFinishedGlyphs(std::make_shared<GlyphRasterizer::Queue>()),
+        mNextGlyphJob(1),
+        mPendingGlyphJobs(0),
         mIsValid(false),
         mTabSize(4),
         mSpaceWidthPixels(0) {
-        mAtlasPixels.resize(static_cast<size_t>(mAtlasWidth) * mAtlasHeight * 4, 0);
-        glGenTextures(1, &mTextureID);
+        ResetAtlas();
         mBaseFontLoaded = LoadTTF(ttfData, bytes, mBaseFont);
         if (mBaseFontLoaded) {
-            LoadGlyphs(nullptr, 0, mBaseFontPixelHeight, mDpiScale);
+            mBaseFontHash = HashFontData(ttfData, bytes);
+            LoadGlyphs(nullptr, 0, mBaseFontPixelHeight, mDpiScale, cachedAtlas);
         }
         else {
             mIsValid = false;
-            if (mTextureID) {
-                glDeleteTextures(1, &mTextureID);
-                mTextureID = 0;
-            }
         }
     }
 
     Font::~Font() {
-        if (mTextureID) {
-            glDeleteTextures(1, &mTextureID);
-            mTextureID = 0;
-        }
     }
 
     bool Font::IsValid() const {
         return mIsValid && mBaseFontLoaded;
     }
 
-    void Font::LoadGlyphs(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale) {
+    void Font::LoadGlyphs(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale,
+        const std::vector<unsigned char>* cachedAtlas) {
         if (ttfData && bytes > 0) {
             mBaseFontLoaded = LoadTTF(ttfData, bytes, mBaseFont);
+            mKerning.clear();
             if (mBaseFontLoaded) {
                 mBaseFontPixelHeight = pixelHeight;
                 mDpiScale = dpiScale;
+                mBaseFontHash = HashFontData(ttfData, bytes);
             }
             else {
                 mIsValid = false;
@@ -77,43 +108,53 @@ namespace TextEdit {
             mDpiScale = dpiScale;
         }
 
-        mGlyphMap.clear();
-        mAtlasPixels.assign(static_cast<size_t>(mAtlasWidth) * mAtlasHeight * 4, 0);
-        mNextX = 0;
-        mNextY = 0;
-        mRowHeight = 0;
+        if (cachedAtlas && LoadAtlas(*cachedAtlas)) {
+            mIsValid = true;
+            return;
+        }
+
+        mGlyphs.Clear();
+        mSubpixelVariants = 0;
+        mGlyphGeneration += 1;
+        ResetAtlas();
 
         for (char32_t c = 32; c <= 126; ++c) {
-            BakeGlyphToAtlas(c, mBaseFont, mBaseFontPixelHeight, mDpiScale);
+            BakeGlyphToAtlas(c, false);
         }
-        if (mGlyphMap.find(U' ') == mGlyphMap.end()) {
-            BakeGlyphToAtlas(U' ', mBaseFont, mBaseFontPixelHeight, mDpiScale);
+        if (!mGlyphs.Find(U' ')) {
+            BakeGlyphToAtlas(U' ', false);
         }
-        if (mGlyphMap.find(U'?') == mGlyphMap.end()) {
-            BakeGlyphToAtlas(U'?', mBaseFont, mBaseFontPixelHeight, mDpiScale);
+        if (!mGlyphs.Find(U'?')) {
+            BakeGlyphToAtlas(U'?', false);
         }
 
-        auto itSpace = mGlyphMap.find(U' ');
-        if (itSpace != mGlyphMap.end() && itSpace->second.isValid) {
-            mSpaceWidthPixels = static_cast<unsigned int>(std::round(itSpace->second.advance));
+        UpdateSpaceWidth();
+        MarkAtlasReset(0);
+        mIsValid = true;
+    }
+
+    void Font::SetPixelHeight(float pixelHeight, float dpiScale) {
+        if (pixelHeight <= 0.0f || dpiScale <= 0.0f) {
+            return;
         }
-        else {
-            mSpaceWidthPixels = static_cast<unsigned int>(std::round(mBaseFontPixelHeight / 2.0f));
-            GlyphInfo spaceGlyph;
-            spaceGlyph.advance = mBaseFontPixelHeight / 2.0f;
-            int spaceIdx = stbtt_FindGlyphIndex(&mBaseFont, ' ');
-            if (spaceIdx != 0) {
-                int adv, lsb;
-                stbtt_GetGlyphHMetrics(&mBaseFont, spaceIdx, &adv, &lsb);
-                spaceGlyph.advance = adv * GetScale(&mBaseFont, mBaseFontPixelHeight, mDpiScale) / mDpiScale;
-                mSpaceWidthPixels = static_cast<unsigned int>(std::round(spaceGlyph.advance));
-            }
+        mExtFontPixelHeight = pixelHeight;
+        mExtDpiScale = dpiScale;
+        if (!mDistanceField) {
+            LoadGlyphs(nullptr, 0, pixelHeight, dpiScale);
+            return;
         }
 
-        if (!mGlyphMap.empty()) {
-            UploadAtlasToGPU();
-        }
-        mIsValid = true;
+        mBaseFontPixelHeight = pixelHeight;
+        mDpiScale = dpiScale;
+        mGlyphs.ForEach([this](CachedGlyph& glyph) {
+            glyph.info = ScaleBakedGlyph(glyph);
+        });
+        UpdateSpaceWidth();
+        mGlyphGeneration += 1;
+    }
+
+    bool Font::IsDistanceField() const {
+        return mDistanceField;
     }
 
     void Font::LoadEmojis(const void* data, unsigned int bytes, float pixelHeight, float dpiScale) {
@@ -145,6 +186,47 @@ namespace TextEdit {
         return mSpaceWidthPixels * static_cast<unsigned int>(mTabSize);
     }
 
+    float Font::GetKerning(char32_t left, char32_t right) {
+        if (!mBaseFontLoaded) {
+            return 0.0f;
+        }
+
+        // stb_truetype searches the kern and GPOS tables on every call, most text is ASCII
+        int units = 0;
+        if (left < KERNING_TABLE_CHARS && right < KERNING_TABLE_CHARS) {
+            if (mKerning.empty()) {
+                mKerning.assign(static_cast<size_t>(KERNING_TABLE_CHARS) * KERNING_TABLE_CHARS, KERNING_UNKNOWN);
+            }
+            int16_t& cached = mKerning[static_cast<size_t>(left) * KERNING_TABLE_CHARS + right];
+            if (cached == KERNING_UNKNOWN) {
+                cached = static_cast<int16_t>(stbtt_GetCodepointKernAdvance(&mBaseFont, static_cast<int>(left), static_cast<int>(right)));
+            }
+            units = cached;
+        }
+        else {
+            units = stbtt_GetCodepointKernAdvance(&mBaseFont, static_cast<int>(left), static_cast<int>(right));
+        }
+        if (units == 0) {
+            return 0.0f;
+        }
+        return units * GetScale(&mBaseFont, mBaseFontPixelHeight, mDpiScale) / mDpiScale;
+    }
+
+    void Font::UpdateSpaceWidth() {
+        const CachedGlyph* space = mGlyphs.Find(U' ');
+        if (space && space->info.isValid) {
+            mSpaceWidthPixels = static_cast<unsigned int>(std::round(space->info.advance));
+            return;
+        }
+        mSpaceWidthPixels = static_cast<unsigned int>(std::round(mBaseFontPixelHeight / 2.0f));
+        int spaceIdx = stbtt_FindGlyphIndex(&mBaseFont, ' ');
+        if (spaceIdx != 0) {
+            int adv, lsb;
+            stbtt_GetGlyphHMetrics(&mBaseFont, spaceIdx, &adv, &lsb);
+            mSpaceWidthPixels = static_cast<unsigned int>(std::round(adv * GetScale(&mBaseFont, mBaseFontPixelHeight, mDpiScale) / mDpiScale));
+        }
+    }
+
     float Font::GetScale(const stbtt_fontinfo* font, float pixelHeight, float dpiScale) const {
         if (!font || pixelHeight <= 0.0f || dpiScale <= 0.0f) return 0.0f;
         return stbtt_ScaleForPixelHeight(font, pixelHeight * dpiScale);
@@ -177,55 +259,162 @@ namespace TextEdit {
     }
 
     bool Font::BakeGlyph(char32_t codepoint) {
-        if (mGlyphMap.count(codepoint)) {
-            return mGlyphMap[codepoint].isValid;
+        if (const CachedGlyph* cached = mGlyphs.Find(codepoint)) {
+            return cached->info.isValid;
+        }
+
+        if (BakeGlyphFromFonts(codepoint, mAsyncRasterization)) {
+            return true;
         }
 
+        // Only glyphs no font has are remembered as missing, running out of atlas space is retried
+        bool inBase = mBaseFontLoaded && stbtt_FindGlyphIndex(&mBaseFont, static_cast<int>(codepoint)) != 0;
+        bool inExt = mExtFontLoaded && stbtt_FindGlyphIndex(&mExtFont, static_cast<int>(codepoint)) != 0;
+        if (!inBase && !inExt) {
+            mGlyphs.Insert(codepoint).info.isValid = false;
+        }
+        return false;
+    }
+
+    bool Font::BakeGlyphFromFonts(char32_t codepoint, bool async) {
         bool baked = false;
         if (mBaseFontLoaded) {
             if (stbtt_FindGlyphIndex(&mBaseFont, static_cast<int>(codepoint)) != 0) {
-                baked = BakeGlyphToAtlas(codepoint, mBaseFont, mBaseFontPixelHeight, mDpiScale);
+                baked = BakeGlyphToAtlas(codepoint, false, async);
             }
         }
 
         if (!baked && mExtFontLoaded) {
             if (stbtt_FindGlyphIndex(&mExtFont, static_cast<int>(codepoint)) != 0) {
-                baked = BakeGlyphToAtlas(codepoint, mExtFont, mExtFontPixelHeight, mExtDpiScale);
+                baked = BakeGlyphToAtlas(codepoint, true, async);
             }
         }
+        return baked;
+    }
 
-        if (!baked) {
-            GlyphInfo dummy = {};
-            dummy.isValid = false;
-            mGlyphMap[codepoint] = dummy;
-            return false;
+    const GlyphInfo& Font::GetGlyph(char32_t codepoint) {
+        static const GlyphInfo failedGlyph;
+        CachedGlyph* cached = mGlyphs.Find(codepoint);
+        if (!cached) {
+            if (BakeGlyph(codepoint)) {
+                cached = mGlyphs.Find(codepoint);
+            }
+            else {
+                cached = mGlyphs.Find(U'?');
+                if (!cached && BakeGlyph(U'?')) {
+                    cached = mGlyphs.Find(U'?');
+                }
+            }
+            if (!cached) {
+                return failedGlyph;
+            }
         }
-        return true;
+        cached->lastUsedFrame = mFrame;
+        MarkAtlasPageUsed(cached->info.page);
+        return cached->info;
     }
 
-    GlyphInfo Font::GetGlyph(char32_t codepoint) {
-        auto it = mGlyphMap.find(codepoint);
-        if (it == mGlyphMap.end()) {
-            if (!BakeGlyph(codepoint)) {
-                it = mGlyphMap.find(U'?');
-                if (it == mGlyphMap.end()) {
-                    if (!BakeGlyph(U'?')) {
-                        GlyphInfo failedGlyph = {};
-                        failedGlyph.isValid = false;
-                        return failedGlyph;
-                    }
-                    it = mGlyphMap.find(U'?');
-                }
+    void Font::SetSubpixelPositioning(bool enabled) {
+        mSubpixelPositioning = enabled;
+    }
+
+    bool Font::HasSubpixelPositioning() const {
+        return mSubpixelPositioning && !mDistanceField;
+    }
+
+    void Font::SetSubpixelVariantBudget(unsigned int maxVariants) {
+        mSubpixelVariantBudget = maxVariants;
+        TrimSubpixelVariants();
+    }
+
+    char32_t Font::SubpixelKey(char32_t codepoint, int bin) {
+        return codepoint | (static_cast<char32_t>(bin) << SUBPIXEL_KEY_SHIFT);
+    }
+
+    bool Font::IsSubpixelVariant(char32_t key) {
+        return (key >> SUBPIXEL_KEY_SHIFT) != 0;
+    }
+
+    const GlyphInfo& Font::GetPositionedGlyph(char32_t codepoint, float& inoutPenX) {
+        // Distance fields are sampled smoothly at any offset, they don't need variants
+        if (!HasSubpixelPositioning()) {
+            return GetGlyph(codepoint);
+        }
+
+        // Bins are quarters of an atlas pixel, which is smaller than a screen pixel above 1x DPI
+        long quarters = std::lround(inoutPenX * mDpiScale * SUBPIXEL_BINS);
+        int bin = static_cast<int>(((quarters % SUBPIXEL_BINS) + SUBPIXEL_BINS) % SUBPIXEL_BINS);
+        float snappedPenX = static_cast<float>(quarters - bin) / (SUBPIXEL_BINS * mDpiScale);
+        if (bin == 0) {
+            inoutPenX = snappedPenX;
+            return GetGlyph(codepoint);
+        }
+
+        char32_t key = SubpixelKey(codepoint, bin);
+        CachedGlyph* variant = mGlyphs.Find(key);
+        if (!variant && mSubpixelVariants >= mSubpixelVariantBudget && mSubpixelTrimFrame != mFrame) {
+            // Once a frame at most, if the variants in use outnumber the budget it wouldn't free anything
+            mSubpixelTrimFrame = mFrame;
+            TrimSubpixelVariants();
+        }
+        if (!variant && mSubpixelVariants < mSubpixelVariantBudget) {
+            // Variants come from wherever the glyph itself did, blank and missing glyphs have none
+            GetGlyph(codepoint);
+            const CachedGlyph* base = mGlyphs.Find(codepoint);
+            if (base && base->info.isValid && base->info.width > 0.0f && base->info.height > 0.0f &&
+                BakeGlyphToAtlas(codepoint, base->fromExtFont, mAsyncRasterization, bin)) {
+                mSubpixelVariants += 1;
+                variant = mGlyphs.Find(key);
             }
-            else {
-                it = mGlyphMap.find(codepoint);
+        }
+
+        // Until the variant is rasterized the plain glyph stands in, where it was going to be drawn
+        if (!variant || variant->pendingJob != 0) {
+            return GetGlyph(codepoint);
+        }
+        variant->lastUsedFrame = mFrame;
+        MarkAtlasPageUsed(variant->info.page);
+        inoutPenX = snappedPenX;
+        return variant->info;
+    }
+
+    // Drops least recently used variants down to three quarters of the budget, so this doesn't run
+    // for every new variant. Those drawn this frame stay, their quads may not be drawn yet.
+    void Font::TrimSubpixelVariants() {
+        std::vector<std::pair<unsigned int, char32_t>> variants;
+        mGlyphs.ForEach([&](const CachedGlyph& glyph) {
+            if (IsSubpixelVariant(glyph.codepoint)) {
+                variants.push_back({ glyph.lastUsedFrame, glyph.codepoint });
             }
+        });
+        mSubpixelVariants = static_cast<unsigned int>(variants.size());
+        size_t keep = static_cast<size_t>(mSubpixelVariantBudget) * 3 / 4;
+        if (variants.size() <= keep) {
+            return;
         }
-        return (it != mGlyphMap.end()) ? it->second : GlyphInfo{};
+
+        // Their atlas space is only reclaimed when the page is evicted
+        size_t drop = variants.size() - keep;
+        std::nth_element(variants.begin(), variants.begin() + (drop - 1), variants.end());
+        for (size_t i = 0; i < drop; ++i) {
+            if (variants[i].first >= mFrame) {
+                continue;
+            }
+            mGlyphs.Erase(variants[i].second);
+            mSubpixelVariants -= 1;
+        }
+    }
+
+    unsigned int Font::GetAtlasPageCount() const {
+        return static_cast<unsigned int>(mAtlasPages.size());
     }
 
-    unsigned int Font::GetAtlasTextureHandle() const {
-        return mTextureID;
+    const std::vector<unsigned char>& Font::GetAtlasPixels(unsigned int page) const {
+        return mAtlasPages[page].pixels;
+    }
+
+    unsigned int Font::GetAtlasVersion(unsigned int page) const {
+        return mAtlasPages[page].version;
     }
 
     unsigned int Font::GetAtlasTextureWidth() const {
@@ -236,7 +425,166 @@ namespace TextEdit {
         return mAtlasHeight;
     }
 
-    bool Font::AllocateSpaceForGlyph(int glyphW_unpadded, int glyphH_unpadded, int& outX_padded_block, int& outY_padded_block) {
+    unsigned int Font::GetGlyphGeneration() const {
+        return mGlyphGeneration;
+    }
+
+    void Font::AdvanceFrame() {
+        mFrame += 1;
+    }
+
+    void Font::SetAsyncRasterization(bool enabled) {
+        mAsyncRasterization = enabled;
+    }
+
+    bool Font::HasPendingGlyphs() const {
+        return mPendingGlyphJobs > 0;
+    }
+
+    bool Font::CollectFinishedGlyphs() {
+        if (mPendingGlyphJobs == 0) {
+            return false;
+        }
+        PROFILE_SCOPE(GlyphBake);
+        mLandingGlyphs.clear();
+        mFinishedGlyphs->TakeFinished(mLandingGlyphs);
+
+        bool landed = false;
+        for (GlyphRasterizer::Job& job : mLandingGlyphs) {
+            mPendingGlyphJobs -= 1;
+
+            // Evicted, re-baked or reloaded since it was submitted
+            CachedGlyph* cached = mGlyphs.Find(job.codepoint);
+            if (!cached || cached->pendingJob != job.id || job.page >= mAtlasPages.size()) {
+                continue;
+            }
+            std::vector<unsigned char>& pixels = mAtlasPages[job.page].pixels;
+            for (int row = 0; row < job.height; ++row) {
+                memcpy(&pixels[static_cast<size_t>(job.y + row) * mAtlasWidth + job.x],
+                    &job.bitmap[static_cast<size_t>(row) * job.width], static_cast<size_t>(job.width));
+            }
+            MarkAtlasChanged(job.page, job.x - GLYPH_PADDING, job.y - GLYPH_PADDING,
+                job.width + 2 * GLYPH_PADDING, job.height + 2 * GLYPH_PADDING);
+            cached->pendingJob = 0;
+            landed = true;
+        }
+        mLandingGlyphs.clear();
+        return landed;
+    }
+
+    void Font::MarkAtlasPageUsed(unsigned int page) {
+        if (page < mAtlasPages.size()) {
+            mAtlasPages[page].lastUsedFrame = mFrame;
+        }
+    }
+
+    bool Font::GetAtlasChangesSince(unsigned int page, unsigned int version, std::vector<AtlasRect>& outRects) const {
+        outRects.clear();
+        if (page >= mAtlasPages.size()) {
+            return false;
+        }
+        const AtlasPage& atlas = mAtlasPages[page];
+        if (version < atlas.resetVersion || version > atlas.version) {
+            return false;
+        }
+        for (const AtlasChange& change : atlas.changes) {
+            if (change.version > version) {
+                outRects.push_back(change.rect);
+            }
+        }
+        return true;
+    }
+
+    void Font::ResetAtlas() {
+        mAtlasPages.resize(1);
+        ResetAtlasPage(mAtlasPages[0]);
+    }
+
+    void Font::ResetAtlasPage(AtlasPage& page) {
+        page.pixels.assign(static_cast<size_t>(mAtlasWidth) * mAtlasHeight, 0);
+        page.skyline.clear();
+        page.skyline.push_back({ 0, 0, static_cast<int>(mAtlasWidth) });
+        page.lastUsedFrame = mFrame;
+    }
+
+    void Font::MarkAtlasReset(unsigned int page) {
+        mAtlasVersion += 1;
+        mAtlasPages[page].version = mAtlasVersion;
+        mAtlasPages[page].resetVersion = mAtlasVersion;
+        mAtlasPages[page].changes.clear();
+    }
+
+    void Font::MarkAtlasChanged(unsigned int page, int x, int y, int width, int height) {
+        AtlasPage& atlas = mAtlasPages[page];
+        mAtlasVersion += 1;
+        atlas.version = mAtlasVersion;
+        atlas.changes.push_back({ mAtlasVersion, { x, y, width, height } });
+        if (atlas.changes.size() > MAX_ATLAS_CHANGES) {
+            // Whoever is older than the dropped change has to upload the whole page
+            atlas.resetVersion = atlas.changes.front().version;
+            atlas.changes.pop_front();
+        }
+    }
+
+    void Font::AddAtlasPage() {
+        mAtlasPages.emplace_back();
+        ResetAtlasPage(mAtlasPages.back());
+        MarkAtlasReset(static_cast<unsigned int>(mAtlasPages.size() - 1));
+    }
+
+    bool Font::EvictAtlasPage() {
+        // Pages used this frame may be sampled by quads that haven't been drawn yet
+        size_t victim = mAtlasPages.size();
+        for (size_t i = 0; i < mAtlasPages.size(); ++i) {
+            if (mAtlasPages[i].lastUsedFrame < mFrame &&
+                (victim == mAtlasPages.size() || mAtlasPages[i].lastUsedFrame < mAtlasPages[victim].lastUsedFrame)) {
+                victim = i;
+            }
+        }
+        if (victim == mAtlasPages.size()) {
+            return false;
+        }
+
+        // Cold glyphs are dropped and baked again if they ever come back, hot ones are repacked right away
+        std::vector<std::pair<unsigned int, char32_t>> hotGlyphs;
+        std::vector<char32_t> evicted;
+        mGlyphs.ForEach([&](const CachedGlyph& glyph) {
+            const GlyphInfo& info = glyph.info;
+            if (!info.isValid || info.page != victim || info.width <= 0.0f || info.height <= 0.0f) {
+                return;
+            }
+            // Subpixel variants are baked again the next time they are drawn
+            if (glyph.lastUsedFrame + HOT_GLYPH_FRAMES >= mFrame && !IsSubpixelVariant(glyph.codepoint)) {
+                hotGlyphs.push_back({ glyph.lastUsedFrame, glyph.codepoint });
+            }
+            evicted.push_back(glyph.codepoint);
+        });
+        for (char32_t codepoint : evicted) {
+            if (IsSubpixelVariant(codepoint) && mSubpixelVariants > 0) {
+                mSubpixelVariants -= 1;
+            }
+            mGlyphs.Erase(codepoint);
+        }
+
+        ResetAtlasPage(mAtlasPages[victim]);
+        MarkAtlasReset(static_cast<unsigned int>(victim));
+        mGlyphGeneration += 1;
+
+        // Most recently used first, in case they don't all fit
+        std::sort(hotGlyphs.begin(), hotGlyphs.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        mRepacking = true;
+        for (const auto& hot : hotGlyphs) {
+            if (BakeGlyphFromFonts(hot.second)) {
+                mGlyphs.Find(hot.second)->lastUsedFrame = hot.first;
+            }
+        }
+        mRepacking = false;
+        return true;
+    }
+
+    // Skyline bottom-left packing. Glyphs are placed on top of the skyline where their bottom edge
+    // ends up highest, ties go to the narrowest run so wide gaps stay free for wide glyphs.
+    bool Font::AllocateSpaceForGlyph(int glyphW_unpadded, int glyphH_unpadded, unsigned int& outPage, int& outX_padded_block, int& outY_padded_block) {
         if (glyphW_unpadded < 0 || glyphH_unpadded < 0) {
             return false;
         }
@@ -249,176 +597,417 @@ namespace TextEdit {
             return false;
         }
 
-        if (mNextX + actual_gw_to_allocate > static_cast<int>(mAtlasWidth)) {
-            mNextX = 0;
-            mNextY += mRowHeight;
-            mRowHeight = 0;
-        }
-
-        if (mNextY + actual_gh_to_allocate > static_cast<int>(mAtlasHeight)) {
-            if (!TryExpandAtlas(static_cast<unsigned int>(actual_gw_to_allocate),
-                static_cast<unsigned int>(actual_gh_to_allocate))) {
+        bool evicted = false;
+        while (true) {
+            for (size_t page = 0; page < mAtlasPages.size(); ++page) {
+                size_t node = 0;
+                int y = 0;
+                if (FindSkylineSpot(mAtlasPages[page], actual_gw_to_allocate, actual_gh_to_allocate, node, y)) {
+                    outPage = static_cast<unsigned int>(page);
+                    outX_padded_block = mAtlasPages[page].skyline[node].x;
+                    outY_padded_block = y;
+                    AddSkylineLevel(mAtlasPages[page], node, outX_padded_block, y + actual_gh_to_allocate, actual_gw_to_allocate);
+                    return true;
+                }
+            }
+            if (mRepacking) {
                 return false;
             }
-            if (mNextX + actual_gw_to_allocate > static_cast<int>(mAtlasWidth)) {
-                mNextX = 0;
-                mNextY += mRowHeight;
-                mRowHeight = 0;
+            // Growing re-bakes every glyph into a fresh skyline, so search that one again
+            if (mAtlasPages.size() == 1 && TryExpandAtlas(static_cast<unsigned int>(actual_gw_to_allocate),
+                static_cast<unsigned int>(actual_gh_to_allocate))) {
+                continue;
+            }
+            if (mAtlasPages.size() < mMaxAtlasPages) {
+                AddAtlasPage();
+                continue;
             }
-            if (mNextY + actual_gh_to_allocate > static_cast<int>(mAtlasHeight)) {
+            if (evicted || !EvictAtlasPage()) {
                 return false;
             }
+            evicted = true;
         }
+    }
 
-        outX_padded_block = mNextX;
-        outY_padded_block = mNextY;
+    bool Font::FindSkylineSpot(const AtlasPage& page, int width, int height, size_t& outNode, int& outY) const {
+        const std::vector<SkylineNode>& skyline = page.skyline;
+        size_t bestNode = skyline.size();
+        int bestBottom = 0;
+        int bestWidth = 0;
+        for (size_t i = 0; i < skyline.size(); ++i) {
+            int y = 0;
+            if (!FitSkyline(page, i, width, height, y)) {
+                continue;
+            }
+            int bottom = y + height;
+            if (bestNode == skyline.size() || bottom < bestBottom ||
+                (bottom == bestBottom && skyline[i].width < bestWidth)) {
+                bestNode = i;
+                outY = y;
+                bestBottom = bottom;
+                bestWidth = skyline[i].width;
+            }
+        }
+        outNode = bestNode;
+        return bestNode != skyline.size();
+    }
 
-        mNextX += actual_gw_to_allocate;
-        if (actual_gh_to_allocate > mRowHeight) {
-            mRowHeight = actual_gh_to_allocate;
+    // A block of width starting at node rests on the highest skyline it spans
+    bool Font::FitSkyline(const AtlasPage& page, size_t node, int width, int height, int& outY) const {
+        const std::vector<SkylineNode>& skyline = page.skyline;
+        if (skyline[node].x + width > static_cast<int>(mAtlasWidth)) {
+            return false;
         }
+        int y = 0;
+        int remaining = width;
+        for (size_t i = node; remaining > 0; ++i) {
+            if (i >= skyline.size()) {
+                return false;
+            }
+            y = std::max(y, skyline[i].y);
+            if (y + height > static_cast<int>(mAtlasHeight)) {
+                return false;
+            }
+            remaining -= skyline[i].width;
+        }
+        outY = y;
         return true;
     }
 
-    bool Font::TryExpandAtlas(unsigned int neededGlyphW_padded, unsigned int neededGlyphH_padded) {
-        unsigned int currentActualAtlasWidth = mAtlasWidth;
-        unsigned int currentActualAtlasHeight = mAtlasHeight;
+    void Font::AddSkylineLevel(AtlasPage& page, size_t node, int x, int y, int width) {
+        std::vector<SkylineNode>& skyline = page.skyline;
+        skyline.insert(skyline.begin() + node, { x, y, width });
 
-        unsigned int proposedWidth = mAtlasWidth;
-        unsigned int proposedHeight = mAtlasHeight;
+        // The new level covers the start of the nodes after it
+        for (size_t i = node + 1; i < skyline.size();) {
+            int coveredUntil = skyline[i - 1].x + skyline[i - 1].width;
+            if (skyline[i].x >= coveredUntil) {
+                break;
+            }
+            int shrink = coveredUntil - skyline[i].x;
+            skyline[i].x += shrink;
+            skyline[i].width -= shrink;
+            if (skyline[i].width > 0) {
+                break;
+            }
+            skyline.erase(skyline.begin() + i);
+        }
 
-        while (true) {
-            bool canFitInProposed = false;
-            if (neededGlyphW_padded <= proposedWidth && (static_cast<unsigned int>(mNextY + mRowHeight) + neededGlyphH_padded) <= proposedHeight) {
-                canFitInProposed = true;
+        for (size_t i = 0; i + 1 < skyline.size();) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
             }
-            else if ((static_cast<unsigned int>(mNextX) + neededGlyphW_padded) <= proposedWidth && (static_cast<unsigned int>(mNextY) + neededGlyphH_padded) <= proposedHeight) {
-                canFitInProposed = true;
+            else {
+                ++i;
             }
+        }
+    }
 
-            if (canFitInProposed) break;
+    bool Font::TryExpandAtlas(unsigned int neededGlyphW_padded, unsigned int neededGlyphH_padded) {
+        unsigned int proposedWidth = mAtlasWidth;
+        unsigned int proposedHeight = mAtlasHeight;
 
+        // Called when the skyline is full, so grow at least once
+        do {
             if (proposedWidth >= mMaxAtlasSize && proposedHeight >= mMaxAtlasSize) return false;
 
-            unsigned int prevProposedWidth = proposedWidth;
-            unsigned int prevProposedHeight = proposedHeight;
-
-            if (proposedWidth == proposedHeight && proposedWidth < mMaxAtlasSize) {
-                proposedWidth *= 2;
-                proposedHeight *= 2;
-            }
-            else if (proposedWidth < proposedHeight && proposedWidth < mMaxAtlasSize) {
+            if (proposedWidth == proposedHeight) {
                 proposedWidth *= 2;
-            }
-            else if (proposedHeight < proposedWidth && proposedHeight < mMaxAtlasSize) {
                 proposedHeight *= 2;
             }
-            else if (proposedWidth < mMaxAtlasSize) {
+            else if (proposedWidth < proposedHeight) {
                 proposedWidth *= 2;
             }
-            else if (proposedHeight < mMaxAtlasSize) {
-                proposedHeight *= 2;
-            }
             else {
-                return false;
+                proposedHeight *= 2;
             }
 
             proposedWidth = std::min(proposedWidth, mMaxAtlasSize);
             proposedHeight = std::min(proposedHeight, mMaxAtlasSize);
+        } while (neededGlyphW_padded > proposedWidth || neededGlyphH_padded > proposedHeight);
 
-            if (proposedWidth == prevProposedWidth && proposedHeight == prevProposedHeight) {
-                return false;
-            }
-        }
-
-        if (proposedWidth == currentActualAtlasWidth && proposedHeight == currentActualAtlasHeight) {
-            return true;
-        }
-
-        // Create a new atlas buffer
-        std::vector<unsigned char> newPixels(proposedWidth * proposedHeight * 4, 0);
-        mAtlasPixels = std::move(newPixels);
         mAtlasWidth = proposedWidth;
         mAtlasHeight = proposedHeight;
-
-        // Reset packing state
-        mNextX = 0;
-        mNextY = 0;
-        mRowHeight = 0;
-
-        // Store the current glyph map to re-bake
-        std::map<char32_t, GlyphInfo> oldGlyphMap = std::move(mGlyphMap);
-        mGlyphMap.clear();
+        ResetAtlas();
+
+        // Store the current glyphs to re-bake, only the valid ones
+        std::vector<char32_t> oldGlyphs;
+        oldGlyphs.reserve(mGlyphs.Size());
+        mGlyphs.ForEach([&](const CachedGlyph& glyph) {
+            if (glyph.info.isValid && !IsSubpixelVariant(glyph.codepoint)) {
+                oldGlyphs.push_back(glyph.codepoint);
+            }
+        });
+        std::sort(oldGlyphs.begin(), oldGlyphs.end());
+        mGlyphs.Clear();
+        mSubpixelVariants = 0;
+        mGlyphGeneration += 1;
 
         // Re-bake all glyphs from the base font
         if (mBaseFontLoaded) {
-            for (const auto& pair : oldGlyphMap) {
-                char32_t codepoint = pair.first;
-                // Only re-bake glyphs that were valid and came from the base font
-                if (pair.second.isValid && stbtt_FindGlyphIndex(&mBaseFont, static_cast<int>(codepoint)) != 0) {
-                    BakeGlyphToAtlas(codepoint, mBaseFont, mBaseFontPixelHeight, mDpiScale);
+            for (char32_t codepoint : oldGlyphs) {
+                // Only re-bake glyphs that came from the base font
+                if (stbtt_FindGlyphIndex(&mBaseFont, static_cast<int>(codepoint)) != 0) {
+                    BakeGlyphToAtlas(codepoint, false);
                 }
             }
             // Ensure space and '?' are baked
-            if (mGlyphMap.find(U' ') == mGlyphMap.end()) {
-                BakeGlyphToAtlas(U' ', mBaseFont, mBaseFontPixelHeight, mDpiScale);
-            }
-            if (mGlyphMap.find(U'?') == mGlyphMap.end()) {
-                BakeGlyphToAtlas(U'?', mBaseFont, mBaseFontPixelHeight, mDpiScale);
-            }
-            // Recalculate space width
-            auto itSpace = mGlyphMap.find(U' ');
-            if (itSpace != mGlyphMap.end() && itSpace->second.isValid) {
-                mSpaceWidthPixels = static_cast<unsigned int>(std::round(itSpace->second.advance));
+            if (!mGlyphs.Find(U' ')) {
+                BakeGlyphToAtlas(U' ', false);
             }
-            else {
-                mSpaceWidthPixels = static_cast<unsigned int>(std::round(mBaseFontPixelHeight / 2.0f));
-                GlyphInfo spaceGlyph;
-                spaceGlyph.advance = mBaseFontPixelHeight / 2.0f;
-                int spaceIdx = stbtt_FindGlyphIndex(&mBaseFont, ' ');
-                if (spaceIdx != 0) {
-                    int adv, lsb;
-                    stbtt_GetGlyphHMetrics(&mBaseFont, spaceIdx, &adv, &lsb);
-                    spaceGlyph.advance = adv * GetScale(&mBaseFont, mBaseFontPixelHeight, mDpiScale) / mDpiScale;
-                    mSpaceWidthPixels = static_cast<unsigned int>(std::round(spaceGlyph.advance));
-                }
+            if (!mGlyphs.Find(U'?')) {
+                BakeGlyphToAtlas(U'?', false);
             }
+            UpdateSpaceWidth();
         }
 
         // Re-bake emoji glyphs from the extension font
         if (mExtFontLoaded) {
-            for (const auto& pair : oldGlyphMap) {
-                char32_t codepoint = pair.first;
-                // Only re-bake glyphs that were valid and not in base font but in ext font
-                if (pair.second.isValid &&
-                    stbtt_FindGlyphIndex(&mBaseFont, static_cast<int>(codepoint)) == 0 &&
+            for (char32_t codepoint : oldGlyphs) {
+                // Only re-bake glyphs that are not in base font but in ext font
+                if (stbtt_FindGlyphIndex(&mBaseFont, static_cast<int>(codepoint)) == 0 &&
                     stbtt_FindGlyphIndex(&mExtFont, static_cast<int>(codepoint)) != 0) {
-                    BakeGlyphToAtlas(codepoint, mExtFont, mExtFontPixelHeight, mExtDpiScale);
+                    BakeGlyphToAtlas(codepoint, true);
                 }
             }
         }
 
-        if (!mGlyphMap.empty()) {
-            UploadAtlasToGPU();
+        MarkAtlasReset(0);
+
+        return true;
+    }
+
+    // FNV-1a, only has to tell fonts apart, not resist anyone
+    uint64_t Font::HashFontData(const void* data, unsigned int bytes) {
+        const unsigned char* bytesIn = static_cast<const unsigned char*>(data);
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (unsigned int i = 0; i < bytes; ++i) {
+            hash ^= bytesIn[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    static std::string FormatAtlasCacheKey(uint64_t fontHash, float pixelHeight, float dpiScale, bool distanceField) {
+        char key[96];
+        snprintf(key, sizeof(key), "atlas-%016llx-%d-%d%s.bin", static_cast<unsigned long long>(fontHash),
+            static_cast<int>(std::lround(pixelHeight * 100.0f)), static_cast<int>(std::lround(dpiScale * 100.0f)),
+            distanceField ? "-sdf" : "");
+        return key;
+    }
+
+    std::string Font::GetAtlasCacheKey(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale,
+        bool distanceField) {
+        if (distanceField) {
+            pixelHeight = SDF_PIXEL_HEIGHT;
+            dpiScale = 1.0f;
+        }
+        return FormatAtlasCacheKey(HashFontData(ttfData, bytes), pixelHeight, dpiScale, distanceField);
+    }
+
+    std::string Font::GetAtlasCacheKey() const {
+        return FormatAtlasCacheKey(mBaseFontHash, GetBakePixelHeight(false), GetBakeDpiScale(false), mDistanceField);
+    }
+
+    // Layout: header, glyphs, then per page its skyline and compressed pixels. Native byte order,
+    // the cache never leaves the machine that wrote it.
+    struct AtlasCacheHeader {
+        uint32_t magic;
+        uint32_t format;
+        uint64_t fontHash;
+        float pixelHeight;
+        float dpiScale;
+        uint32_t atlasWidth;
+        uint32_t atlasHeight;
+        uint32_t pageCount;
+        uint32_t glyphCount;
+        uint32_t distanceField;
+    };
+
+    struct AtlasCacheGlyph {
+        uint32_t codepoint;
+        uint32_t page;
+        float u0, v0, u1, v1;
+        float advance;
+        float leftBearing;
+        float topBearing;
+        float width;
+        float height;
+    };
+
+    template <typename T>
+    static void AtlasCacheWrite(std::vector<unsigned char>& out, const T& value) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    static bool AtlasCacheRead(const std::vector<unsigned char>& in, size_t& offset, T& outValue) {
+        if (offset + sizeof(T) > in.size()) {
+            return false;
+        }
+        memcpy(&outValue, &in[offset], sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool Font::SaveAtlas(std::vector<unsigned char>& outData) const {
+        outData.clear();
+        if (!mBaseFontLoaded) {
+            return false;
+        }
+
+        // Glyphs from the extension font, subpixel variants and glyphs still being rasterized are left out,
+        // they bake again on demand
+        std::vector<AtlasCacheGlyph> glyphs;
+        mGlyphs.ForEach([&](const CachedGlyph& cached) {
+            const GlyphInfo& info = cached.baked;
+            if (!info.isValid || cached.pendingJob != 0 || cached.fromExtFont || IsSubpixelVariant(cached.codepoint)) {
+                return;
+            }
+            glyphs.push_back({ static_cast<uint32_t>(cached.codepoint), info.page, info.u0, info.v0, info.u1, info.v1,
+                info.advance, info.leftBearing, info.topBearing, info.width, info.height });
+        });
+
+        AtlasCacheHeader header = {};
+        header.magic = ATLAS_CACHE_MAGIC;
+        header.format = ATLAS_CACHE_FORMAT;
+        header.fontHash = mBaseFontHash;
+        header.pixelHeight = GetBakePixelHeight(false);
+        header.dpiScale = GetBakeDpiScale(false);
+        header.atlasWidth = mAtlasWidth;
+        header.atlasHeight = mAtlasHeight;
+        header.pageCount = static_cast<uint32_t>(mAtlasPages.size());
+        header.glyphCount = static_cast<uint32_t>(glyphs.size());
+        header.distanceField = mDistanceField ? 1 : 0;
+        AtlasCacheWrite(outData, header);
+        for (const AtlasCacheGlyph& glyph : glyphs) {
+            AtlasCacheWrite(outData, glyph);
         }
 
+        for (const AtlasPage& page : mAtlasPages) {
+            AtlasCacheWrite(outData, static_cast<uint32_t>(page.skyline.size()));
+            for (const SkylineNode& node : page.skyline) {
+                AtlasCacheWrite(outData, node);
+            }
+
+            // Mostly empty space and glyph edges, compresses well
+            mz_ulong compressedBytes = mz_compressBound(static_cast<mz_ulong>(page.pixels.size()));
+            size_t sizeOffset = outData.size();
+            AtlasCacheWrite(outData, static_cast<uint32_t>(0));
+            size_t dataOffset = outData.size();
+            outData.resize(dataOffset + compressedBytes);
+            if (mz_compress(&outData[dataOffset], &compressedBytes, page.pixels.data(), static_cast<mz_ulong>(page.pixels.size())) != MZ_OK) {
+                printf("Font: Could not compress the atlas for caching.\n");
+                outData.clear();
+                return false;
+            }
+            outData.resize(dataOffset + compressedBytes);
+            uint32_t storedBytes = static_cast<uint32_t>(compressedBytes);
+            memcpy(&outData[sizeOffset], &storedBytes, sizeof(storedBytes));
+        }
         return true;
     }
 
-    void Font::UploadAtlasToGPU() {
-        if (mTextureID == 0 || mAtlasPixels.empty() || mAtlasWidth == 0 || mAtlasHeight == 0) {
-            if (mTextureID == 0 && mIsValid) glGenTextures(1, &mTextureID);
-            else return;
+    bool Font::LoadAtlas(const std::vector<unsigned char>& data) {
+        size_t offset = 0;
+        AtlasCacheHeader header;
+        if (!mBaseFontLoaded || !AtlasCacheRead(data, offset, header)) {
+            return false;
+        }
+        if (header.magic != ATLAS_CACHE_MAGIC || header.format != ATLAS_CACHE_FORMAT || header.fontHash != mBaseFontHash ||
+            header.distanceField != (mDistanceField ? 1u : 0u) ||
+            std::fabs(header.pixelHeight - GetBakePixelHeight(false)) > 0.001f ||
+            std::fabs(header.dpiScale - GetBakeDpiScale(false)) > 0.001f ||
+            header.atlasWidth == 0 || header.atlasHeight == 0 ||
+            header.atlasWidth > mMaxAtlasSize || header.atlasHeight > mMaxAtlasSize ||
+            header.pageCount == 0 || header.pageCount > mMaxAtlasPages) {
+            return false;
+        }
+
+        // Everything is read and checked before the font is touched, a bad cache changes nothing. Counts
+        // are checked against what is left of the file before anything is allocated for them.
+        if (header.glyphCount > (data.size() - offset) / sizeof(AtlasCacheGlyph)) {
+            return false;
+        }
+        std::vector<AtlasCacheGlyph> glyphs(header.glyphCount);
+        for (AtlasCacheGlyph& glyph : glyphs) {
+            if (!AtlasCacheRead(data, offset, glyph) || glyph.page >= header.pageCount) {
+                return false;
+            }
+            // Written the other way round, so NaN fails too
+            bool inside = glyph.u0 >= 0.0f && glyph.u0 <= glyph.u1 && glyph.u1 <= 1.0f &&
+                glyph.v0 >= 0.0f && glyph.v0 <= glyph.v1 && glyph.v1 <= 1.0f;
+            if (!inside) {
+                return false;
+            }
+        }
+
+        size_t pageBytes = static_cast<size_t>(header.atlasWidth) * header.atlasHeight;
+        std::vector<AtlasPage> pages(header.pageCount);
+        for (AtlasPage& page : pages) {
+            uint32_t nodeCount = 0;
+            if (!AtlasCacheRead(data, offset, nodeCount) || nodeCount == 0 || nodeCount > header.atlasWidth) {
+                return false;
+            }
+            // Glyphs are baked at the skyline's positions, it has to cover the page exactly once
+            page.skyline.resize(nodeCount);
+            int nextX = 0;
+            for (SkylineNode& node : page.skyline) {
+                if (!AtlasCacheRead(data, offset, node) || node.x != nextX || node.width <= 0 ||
+                    node.width > static_cast<int>(header.atlasWidth) - node.x ||
+                    node.y < 0 || node.y > static_cast<int>(header.atlasHeight)) {
+                    return false;
+                }
+                nextX += node.width;
+            }
+            if (nextX != static_cast<int>(header.atlasWidth)) {
+                return false;
+            }
+
+            uint32_t compressedBytes = 0;
+            if (!AtlasCacheRead(data, offset, compressedBytes) || offset + compressedBytes > data.size()) {
+                return false;
+            }
+            page.pixels.resize(pageBytes);
+            mz_ulong pixelBytes = static_cast<mz_ulong>(pageBytes);
+            if (mz_uncompress(page.pixels.data(), &pixelBytes, &data[offset], compressedBytes) != MZ_OK || pixelBytes != pageBytes) {
+                return false;
+            }
+            offset += compressedBytes;
+            page.lastUsedFrame = mFrame;
+        }
+
+        mAtlasWidth = header.atlasWidth;
+        mAtlasHeight = header.atlasHeight;
+        mAtlasPages = std::move(pages);
+        for (unsigned int page = 0; page < mAtlasPages.size(); ++page) {
+            MarkAtlasReset(page);
         }
 
-        glBindTexture(GL_TEXTURE_2D, mTextureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mAtlasWidth, mAtlasHeight, 0,
-            GL_RGBA, GL_UNSIGNED_BYTE, mAtlasPixels.data());
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        mGlyphs.Clear();
+        mSubpixelVariants = 0;
+        mGlyphGeneration += 1;
+        for (const AtlasCacheGlyph& glyph : glyphs) {
+            CachedGlyph& cached = mGlyphs.Insert(static_cast<char32_t>(glyph.codepoint));
+            cached.baked.u0 = glyph.u0;
+            cached.baked.v0 = glyph.v0;
+            cached.baked.u1 = glyph.u1;
+            cached.baked.v1 = glyph.v1;
+            cached.baked.advance = glyph.advance;
+            cached.baked.leftBearing = glyph.leftBearing;
+            cached.baked.topBearing = glyph.topBearing;
+            cached.baked.width = glyph.width;
+            cached.baked.height = glyph.height;
+            cached.baked.page = glyph.page;
+            cached.baked.isValid = true;
+            cached.fromExtFont = false;
+            cached.info = ScaleBakedGlyph(cached);
+            cached.lastUsedFrame = mFrame;
+        }
+        UpdateSpaceWidth();
+        return true;
     }
 
     bool Font::LoadTTF(const void* data, unsigned int bytes, stbtt_fontinfo& fontOut) {
@@ -433,18 +1022,62 @@ namespace TextEdit {
         return false;
     }
 
-    bool Font::BakeGlyphToAtlas(char32_t codepoint, stbtt_fontinfo& font, float pixelHeight, float dpiScale) {
-        float scale = GetScale(&font, pixelHeight, dpiScale);
+    float Font::GetBakePixelHeight(bool fromExtFont) const {
+        if (mDistanceField) {
+            return SDF_PIXEL_HEIGHT;
+        }
+        return fromExtFont ? mExtFontPixelHeight : mBaseFontPixelHeight;
+    }
+
+    float Font::GetBakeDpiScale(bool fromExtFont) const {
+        if (mDistanceField) {
+            return 1.0f;
+        }
+        return fromExtFont ? mExtDpiScale : mDpiScale;
+    }
+
+    GlyphInfo Font::ScaleBakedGlyph(const CachedGlyph& glyph) const {
+        GlyphInfo info = glyph.baked;
+        if (!mDistanceField) {
+            return info;
+        }
+        // Baked at SDF_PIXEL_HEIGHT with no DPI scale, the atlas texels stay where they are
+        float scale = (glyph.fromExtFont ? mExtFontPixelHeight : mBaseFontPixelHeight) / SDF_PIXEL_HEIGHT;
+        info.advance *= scale;
+        info.leftBearing *= scale;
+        info.topBearing *= scale;
+        info.width *= scale;
+        info.height *= scale;
+        return info;
+    }
+
+    bool Font::BakeGlyphToAtlas(char32_t codepoint, bool fromExtFont, bool async, int subpixelBin) {
+        PROFILE_SCOPE(GlyphBake);
+        stbtt_fontinfo& font = fromExtFont ? mExtFont : mBaseFont;
+        float dpiScale = GetBakeDpiScale(fromExtFont);
+        int spread = mDistanceField ? SDF_SPREAD : 0;
+        float shiftX = static_cast<float>(subpixelBin) / SUBPIXEL_BINS;
+        char32_t key = SubpixelKey(codepoint, subpixelBin);
+        float scale = GetScale(&font, GetBakePixelHeight(fromExtFont), dpiScale);
         if (scale == 0) return false;
 
         int glyphIndex = stbtt_FindGlyphIndex(&font, static_cast<int>(codepoint));
         if (glyphIndex == 0 && codepoint != 0) {
             return false;
         }
+        PROFILE_COUNT(GlyphBakes, 1);
 
         GlyphInfo g = {};
+        uint32_t pendingJob = 0;
         int x0, y0, x1, y1;
-        stbtt_GetGlyphBitmapBox(&font, glyphIndex, scale, scale, &x0, &y0, &x1, &y1);
+        stbtt_GetGlyphBitmapBoxSubpixel(&font, glyphIndex, scale, scale, shiftX, 0.0f, &x0, &y0, &x1, &y1);
+        if (spread > 0 && x1 > x0 && y1 > y0) {
+            // The field reaches past the outline on every side, the same box stbtt_GetGlyphSDF uses
+            x0 -= spread;
+            y0 -= spread;
+            x1 += spread;
+            y1 += spread;
+        }
 
         int gw_unpadded = x1 - x0;
         int gh_unpadded = y1 - y0;
@@ -459,31 +1092,44 @@ namespace TextEdit {
         g.height = static_cast<float>(gh_unpadded) / dpiScale;
 
         if (gw_unpadded > 0 && gh_unpadded > 0) {
+            unsigned int page = 0;
             int atlasX_padded_block, atlasY_padded_block;
-            if (!AllocateSpaceForGlyph(gw_unpadded, gh_unpadded, atlasX_padded_block, atlasY_padded_block)) {
-                g.isValid = false;
-                mGlyphMap[codepoint] = g;
+            if (!AllocateSpaceForGlyph(gw_unpadded, gh_unpadded, page, atlasX_padded_block, atlasY_padded_block)) {
                 return false;
             }
+            std::vector<unsigned char>& pixels = mAtlasPages[page].pixels;
+
+            // The padding has to be empty, or linear filtering bleeds neighbours into the glyph edges
+            int blockW = gw_unpadded + 2 * GLYPH_PADDING;
+            int blockH = gh_unpadded + 2 * GLYPH_PADDING;
+            for (int row = 0; row < blockH; ++row) {
+                size_t offset = static_cast<size_t>(atlasY_padded_block + row) * mAtlasWidth + atlasX_padded_block;
+                memset(&pixels[offset], 0, static_cast<size_t>(blockW));
+            }
 
-            std::vector<unsigned char> glyphBuffer(static_cast<size_t>(gw_unpadded) * gh_unpadded);
-            stbtt_MakeGlyphBitmap(&font, glyphBuffer.data(),
-                gw_unpadded, gh_unpadded, gw_unpadded,
-                scale, scale, glyphIndex);
-
-            for (int row = 0; row < gh_unpadded; ++row) {
-                for (int col = 0; col < gw_unpadded; ++col) {
-                    unsigned char val = glyphBuffer[static_cast<size_t>(row) * gw_unpadded + col];
-                    int destXInAtlas = atlasX_padded_block + GLYPH_PADDING + col;
-                    int destYInAtlas = atlasY_padded_block + GLYPH_PADDING + row;
-                    size_t offset = (static_cast<size_t>(destYInAtlas) * mAtlasWidth + destXInAtlas) * 4;
-                    if (offset + 3 < mAtlasPixels.size()) {
-                        mAtlasPixels[offset + 0] = 255;
-                        mAtlasPixels[offset + 1] = 255;
-                        mAtlasPixels[offset + 2] = 255;
-                        mAtlasPixels[offset + 3] = val;
-                    }
-                }
+            if (async) {
+                GlyphRasterizer::Job job;
+                job.id = mNextGlyphJob++;
+                job.codepoint = key;
+                job.font = font;
+                job.glyphIndex = glyphIndex;
+                job.scale = scale;
+                job.shiftX = shiftX;
+                job.distanceFieldSpread = spread;
+                job.width = gw_unpadded;
+                job.height = gh_unpadded;
+                job.page = page;
+                job.x = atlasX_padded_block + GLYPH_PADDING;
+                job.y = atlasY_padded_block + GLYPH_PADDING;
+                pendingJob = job.id;
+                mPendingGlyphJobs += 1;
+                GlyphRasterizer::Get().Submit(std::move(job), mFinishedGlyphs);
+            }
+            else {
+                // One channel is all the atlas holds, so the glyph can be rasterized straight into it
+                size_t glyphOffset = static_cast<size_t>(atlasY_padded_block + GLYPH_PADDING) * mAtlasWidth + atlasX_padded_block + GLYPH_PADDING;
+                GlyphRasterizer::RasterizeGlyph(font, glyphIndex, scale, shiftX, spread, &pixels[glyphOffset],
+                    gw_unpadded, gh_unpadded, static_cast<int>(mAtlasWidth));
             }
 
             g.u0 = static_cast<float>(atlasX_padded_block + GLYPH_PADDING) / mAtlasWidth;
@@ -491,14 +1137,168 @@ namespace TextEdit {
             g.u1 = static_cast<float>(atlasX_padded_block + GLYPH_PADDING + gw_unpadded) / mAtlasWidth;
             g.v1 = static_cast<float>(atlasY_padded_block + GLYPH_PADDING + gh_unpadded) / mAtlasHeight;
 
+            g.page = page;
             g.isValid = true;
-            UploadAtlasToGPU();
+            if (!async) {
+                MarkAtlasChanged(page, atlasX_padded_block, atlasY_padded_block, blockW, blockH);
+            }
         }
         else {
             g.isValid = true;
         }
 
-        mGlyphMap[codepoint] = g;
+        CachedGlyph& cached = mGlyphs.Insert(key);
+        cached.baked = g;
+        cached.fromExtFont = fromExtFont;
+        cached.info = ScaleBakedGlyph(cached);
+        cached.lastUsedFrame = mFrame;
+        cached.pendingJob = pendingJob;
         return g.isValid;
     }
+
+    Font::GlyphTable::GlyphTable() : mSparseCount(0), mSparseBits(0) {
+    }
+
+    // Fibonacci hashing, the top bits of the product spread neighbouring codepoints apart
+    size_t Font::GlyphTable::SparseHome(char32_t codepoint) const {
+        return static_cast<size_t>((static_cast<uint32_t>(codepoint) * 0x9E3779B1u) >> (32 - mSparseBits));
+    }
+
+    size_t Font::GlyphTable::FindSparseSlot(char32_t codepoint) const {
+        if (mSparse.empty()) {
+            return 0;
+        }
+        size_t mask = mSparse.size() - 1;
+        for (size_t slot = SparseHome(codepoint); mSparse[slot].glyph != NO_GLYPH; slot = (slot + 1) & mask) {
+            if (mSparse[slot].codepoint == codepoint) {
+                return slot;
+            }
+        }
+        return mSparse.size();
+    }
+
+    Font::CachedGlyph* Font::GlyphTable::Find(char32_t codepoint) {
+        uint32_t index = NO_GLYPH;
+        if (codepoint < DENSE_GLYPHS) {
+            if (!mDense.empty()) {
+                index = mDense[codepoint];
+            }
+        }
+        else {
+            size_t slot = FindSparseSlot(codepoint);
+            if (slot < mSparse.size()) {
+                index = mSparse[slot].glyph;
+            }
+        }
+        return index == NO_GLYPH ? nullptr : &mGlyphs[index];
+    }
+
+    Font::CachedGlyph& Font::GlyphTable::Insert(char32_t codepoint) {
+        if (CachedGlyph* existing = Find(codepoint)) {
+            return *existing;
+        }
+
+        uint32_t index;
+        if (!mFreeGlyphs.empty()) {
+            index = mFreeGlyphs.back();
+            mFreeGlyphs.pop_back();
+        }
+        else {
+            index = static_cast<uint32_t>(mGlyphs.size());
+            mGlyphs.emplace_back();
+        }
+        CachedGlyph& glyph = mGlyphs[index];
+        glyph = CachedGlyph();
+        glyph.codepoint = codepoint;
+        glyph.lastUsedFrame = 0;
+
+        if (codepoint < DENSE_GLYPHS) {
+            if (mDense.empty()) {
+                mDense.assign(DENSE_GLYPHS, NO_GLYPH);
+            }
+            mDense[codepoint] = index;
+        }
+        else {
+            if ((mSparseCount + 1) * 2 > mSparse.size()) {
+                GrowSparse();
+            }
+            size_t mask = mSparse.size() - 1;
+            size_t slot = SparseHome(codepoint);
+            while (mSparse[slot].glyph != NO_GLYPH) {
+                slot = (slot + 1) & mask;
+            }
+            mSparse[slot] = { codepoint, index };
+            mSparseCount += 1;
+        }
+        return glyph;
+    }
+
+    void Font::GlyphTable::GrowSparse() {
+        std::vector<SparseSlot> old = std::move(mSparse);
+        mSparseBits = std::max(MIN_SPARSE_GLYPH_BITS, mSparseBits + 1);
+        mSparse.assign(static_cast<size_t>(1) << mSparseBits, { 0, NO_GLYPH });
+        size_t mask = mSparse.size() - 1;
+        for (const SparseSlot& entry : old) {
+            if (entry.glyph == NO_GLYPH) {
+                continue;
+            }
+            size_t slot = SparseHome(entry.codepoint);
+            while (mSparse[slot].glyph != NO_GLYPH) {
+                slot = (slot + 1) & mask;
+            }
+            mSparse[slot] = entry;
+        }
+    }
+
+    void Font::GlyphTable::Erase(char32_t codepoint) {
+        uint32_t index = NO_GLYPH;
+        if (codepoint < DENSE_GLYPHS) {
+            if (mDense.empty()) {
+                return;
+            }
+            index = mDense[codepoint];
+            mDense[codepoint] = NO_GLYPH;
+        }
+        else {
+            size_t slot = FindSparseSlot(codepoint);
+            if (slot >= mSparse.size()) {
+                return;
+            }
+            index = mSparse[slot].glyph;
+
+            // Backward shift deletion, entries after the hole move up unless that puts them before their home slot
+            size_t mask = mSparse.size() - 1;
+            size_t hole = slot;
+            for (size_t next = (hole + 1) & mask; mSparse[next].glyph != NO_GLYPH; next = (next + 1) & mask) {
+                size_t home = SparseHome(mSparse[next].codepoint);
+                bool homeInRange = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+                if (!homeInRange) {
+                    mSparse[hole] = mSparse[next];
+                    hole = next;
+                }
+            }
+            mSparse[hole].glyph = NO_GLYPH;
+            mSparseCount -= 1;
+        }
+
+        if (index != NO_GLYPH) {
+            mGlyphs[index].codepoint = NO_CODEPOINT;
+            mFreeGlyphs.push_back(index);
+        }
+    }
+
+    void Font::GlyphTable::Clear() {
+        if (!mDense.empty()) {
+            std::fill(mDense.begin(), mDense.end(), NO_GLYPH);
+        }
+        mSparse.clear();
+        mSparseCount = 0;
+        mSparseBits = 0;
+        mGlyphs.clear();
+        mFreeGlyphs.clear();
+    }
+
+    size_t Font::GlyphTable::Size() const {
+        return mGlyphs.size() - mFreeGlyphs.size();
+    }
 }
\ No newline at end of file
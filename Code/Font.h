@@ -3,14 +3,15 @@
 #include <string>
 #include <memory>
 #include <vector>
-#include <map>
+#include <deque>
 #include <cstdint> // For char32_t and other integer types
 
-#ifdef _WIN32
+#ifndef __EMSCRIPTEN__
 #include "glad.h"
-#endif // _WIN32
+#endif // !__EMSCRIPTEN__
 
 #include "stb_truetype.h"
+#include "GlyphRasterizer.h"
 
 namespace TextEdit {
     struct Rect; // Forward declaration if used by Font, though not directly visible here
@@ -26,15 +27,24 @@ namespace TextEdit {
         float topBearing;    // Vertical offset from baseline to top of glyph bitmap (Y-positive upwards, font space). (Scaled y1 from stbtt_GetGlyphBitmapBox)
         float width;         // Pixel width of the glyph bitmap
         float height;        // Pixel height of the glyph bitmap
+        unsigned int page;   // Atlas page the bitmap is on
         bool isValid;
 
-        GlyphInfo() : u0(0), v0(0), u1(0), v1(0), advance(0), leftBearing(0), topBearing(0), width(0), height(0), isValid(false) {
+        GlyphInfo() : u0(0), v0(0), u1(0), v1(0), advance(0), leftBearing(0), topBearing(0), width(0), height(0), page(0), isValid(false) {
         }
     };
 
     class Font {
     public:
         friend class Renderer; // Renderer might need access to private members for optimization or specific details
+        friend class FontTest; // Tests/FontTests.cpp, for the glyph table and the packer
+
+        struct AtlasRect {
+            int x;
+            int y;
+            int width;
+            int height;
+        };
 
     protected:
         Font(const Font&) = delete;
@@ -43,32 +53,100 @@ namespace TextEdit {
         Font& operator=(Font&&) = delete;
 
     public:
-        static std::shared_ptr<Font> Create(const void* data, unsigned int bytes, float pixelHeight, float dpiScale);
+        // cachedAtlas is what SaveAtlas wrote for the same font, size and DPI, see LoadGlyphs.
+        // A distance field font bakes its atlas once at a fixed size and draws it at any size, see SetPixelHeight.
+        // data is not copied. It has to stay valid as long as the font, and as long as any glyph job the font
+        // handed to the GlyphRasterizer is still running, which can be after the font is gone.
+        static std::shared_ptr<Font> Create(const void* data, unsigned int bytes, float pixelHeight, float dpiScale,
+            const std::vector<unsigned char>* cachedAtlas = nullptr, bool distanceField = false);
 
-        Font(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale);
+        Font(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale,
+            const std::vector<unsigned char>* cachedAtlas = nullptr, bool distanceField = false);
         virtual ~Font();
 
         bool IsValid() const;
 
         // Load glyphs for the base font, replacing existing ones.
         // If ttfData is null, it re-bakes with current font data and new pixelHeight.
-        void LoadGlyphs(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale);
+        // A cached atlas that matches the font, size and DPI is used instead of baking anything.
+        // Like Create, ttfData is not copied and must outlive the font and its pending glyph jobs.
+        void LoadGlyphs(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale,
+            const std::vector<unsigned char>* cachedAtlas = nullptr);
+
+        // Changes the size text is laid out and drawn at, extension font included. A distance field
+        // atlas stays as it is and only the glyph metrics are scaled, anything else is baked again.
+        void SetPixelHeight(float pixelHeight, float dpiScale);
+
+        // Atlas pages hold signed distance fields rather than coverage, the renderer draws them with
+        // an outline threshold that stays sharp at any scale
+        bool IsDistanceField() const;
+
+        // Baked atlases can be kept between runs. SaveAtlas writes every page and the base font glyphs
+        // on them, LoadAtlas takes that back if it was saved for the font, size and DPI now loaded.
+        // Cache entries should be named by GetAtlasCacheKey, it changes with the font data. Distance
+        // field atlases are the same at every size, so they share one entry.
+        static std::string GetAtlasCacheKey(const void* ttfData, unsigned int bytes, float pixelHeight, float dpiScale,
+            bool distanceField = false);
+        std::string GetAtlasCacheKey() const; // For the font, size and DPI now loaded
+        bool SaveAtlas(std::vector<unsigned char>& outData) const;
+        bool LoadAtlas(const std::vector<unsigned char>& data);
 
         // Load an extension font (e.g., for emojis or additional character sets).
-        // Glyphs from this font are baked on demand if not found in the base font.
+        // Glyphs from this font are baked on demand if not found in the base font. The data has to live
+        // as long as ttfData does, see Create.
         void LoadEmojis(const void* data, unsigned int bytes, float pixelHeight, float dpiScale);
 
         void SetTabNumSpaces(int numSpaces);
         unsigned int GetTabNumSpaces() const;      // Added getter
         unsigned int GetTabWidthInPixels() const;  // Calculates based on space width and tab num spaces
         unsigned int GetSpaceWidthPixels() const;  // Added getter
+        // Pixels to move right by between left and right, usually negative. Only the base font is kerned.
+        float GetKerning(char32_t left, char32_t right);
 
         bool BakeGlyph(char32_t codepoint); // Ensures a glyph is baked into the atlas if possible
-        GlyphInfo GetGlyph(char32_t codepoint); // Returns glyph info, baking it if necessary
+        // Returns glyph info, baking it if necessary. The reference is only good until the next lookup
+        // that bakes something (which can evict), copy the glyph to hold on to it for longer.
+        const GlyphInfo& GetGlyph(char32_t codepoint);
+
+        // Subpixel positioning also bakes glyphs of coverage fonts at quarter pixel offsets, so text at
+        // fractional pen positions keeps its shape instead of being resampled. Variants are baked the
+        // first time they are drawn, past the budget the least recently used ones are dropped.
+        void SetSubpixelPositioning(bool enabled);
+        bool HasSubpixelPositioning() const;
+        void SetSubpixelVariantBudget(unsigned int maxVariants);
+        // The glyph to draw with its pen at inoutPenX, which is moved to where that glyph has to be drawn.
+        // Without subpixel positioning, or until the variant is rasterized, this is GetGlyph and the pen stays.
+        const GlyphInfo& GetPositionedGlyph(char32_t codepoint, float& inoutPenX);
 
-        unsigned int GetAtlasTextureHandle() const;
-        unsigned int GetAtlasTextureWidth() const;
+        // The atlas lives on the CPU. The renderer uploads it into its shared font texture array
+        // whenever the version changes, glyph texture coordinates are relative to this size.
+        // It grows up to the maximum size, then more pages of that size are added. Once there are
+        // as many pages as allowed, the least recently used page is emptied for new glyphs.
+        unsigned int GetAtlasPageCount() const;
+        const std::vector<unsigned char>& GetAtlasPixels(unsigned int page) const; // Coverage or distance, one byte per texel
+        unsigned int GetAtlasVersion(unsigned int page) const;
+        unsigned int GetAtlasTextureWidth() const;  // Same for every page
         unsigned int GetAtlasTextureHeight() const;
+        // The parts of a page that changed after version, in atlas pixels. Returns false when all
+        // of it has to be uploaded again, because it was reset, resized, or version is too old.
+        bool GetAtlasChangesSince(unsigned int page, unsigned int version, std::vector<AtlasRect>& outRects) const;
+
+        // Glyphs missing from the atlas are rasterized on worker threads by default. Until their bitmap
+        // lands the glyph is valid, with its real metrics, but draws nothing. CollectFinishedGlyphs
+        // copies finished bitmaps into the atlas, it returns true if any text has to be drawn again.
+        void SetAsyncRasterization(bool enabled);
+        bool CollectFinishedGlyphs();
+        bool HasPendingGlyphs() const;
+
+        // Pages with glyphs looked up or drawn since the last AdvanceFrame are never evicted, quads
+        // queued for the frame may still sample them. The renderer advances the fonts it draws with
+        // at the start of every frame, a font that is never advanced never evicts anything.
+        void AdvanceFrame();
+        void MarkAtlasPageUsed(unsigned int page); // For glyphs drawn without GetGlyph
+
+        // Bumped whenever existing glyphs are re-baked or evicted (resize, atlas growth, eviction). Anything
+        // that holds on to GlyphInfo copies compares against this to know when its texture coordinates went stale.
+        unsigned int GetGlyphGeneration() const;
 
         float GetScaledAscent() const;     // Pixel distance from baseline to top of Ascent line
         float GetScaledDescent() const;    // Pixel distance from baseline to bottom of Descent line (positive value)
@@ -80,35 +158,146 @@ namespace TextEdit {
         bool mBaseFontLoaded;
         float mBaseFontPixelHeight; // Pixel height the base font was initially scaled to or last re-scaled with LoadGlyphs
         float mDpiScale;            // DPI scale for oversampling
+        uint64_t mBaseFontHash;     // Of the TTF data, cached atlases are only good for the same font
+        bool mDistanceField;        // See IsDistanceField
 
         stbtt_fontinfo mExtFont;      // Extension font (e.g., for emojis)
         bool mExtFontLoaded;
         float mExtFontPixelHeight;    // Pixel height for the extension font
         float mExtDpiScale;           // DPI scale for the extension font
 
-        GLuint mTextureID;
+        unsigned int mAtlasVersion; // Bumped whenever a page changes, pages remember the value they changed at
         unsigned int mAtlasWidth;
         unsigned int mAtlasHeight;
         unsigned int mMaxAtlasSize; // Maximum dimensions for the atlas texture
-        std::vector<unsigned char> mAtlasPixels; // CPU-side copy of atlas pixels (RGBA)
+        unsigned int mMaxAtlasPages;
+
+        struct AtlasChange {
+            unsigned int version;
+            AtlasRect rect;
+        };
+
+        // Skyline packer, the lowest free y for each run of x across the atlas, left to right
+        struct SkylineNode {
+            int x;
+            int y;
+            int width;
+        };
 
-        // Atlas packing state
-        int mNextX;
-        int mNextY;
-        int mRowHeight; // Height of the current row being packed in the atlas
+        struct AtlasPage {
+            std::vector<unsigned char> pixels; // CPU-side copy of atlas pixels, one channel
+            std::vector<SkylineNode> skyline;
+            std::deque<AtlasChange> changes; // What changed at each version since resetVersion, oldest first
+            unsigned int version;
+            unsigned int resetVersion;
+            unsigned int lastUsedFrame;
+        };
+        std::vector<AtlasPage> mAtlasPages;
 
-        std::map<char32_t, GlyphInfo> mGlyphMap; // Cache for baked glyphs
+        struct CachedGlyph {
+            GlyphInfo info;  // What GetGlyph hands out, at the current pixel height
+            GlyphInfo baked; // At the size the atlas holds it, the same unless this is a distance field
+            bool fromExtFont;
+            char32_t codepoint;
+            unsigned int lastUsedFrame;
+            uint32_t pendingJob; // Rasterizer job that will fill in the bitmap, 0 once it is there
+        };
+
+        // Cache for baked glyphs. Codepoints of the common BMP blocks index a flat array, the rest go
+        // through an open addressing hash. Both point into a deque, so adding glyphs moves none.
+        class GlyphTable {
+        public:
+            static constexpr char32_t NO_CODEPOINT = 0xFFFFFFFF; // Marks free entries
+
+            GlyphTable();
+            CachedGlyph* Find(char32_t codepoint);
+            CachedGlyph& Insert(char32_t codepoint); // Returns the existing entry if there is one
+            void Erase(char32_t codepoint);
+            void Clear();
+            size_t Size() const;
+
+            template <typename Fn>
+            void ForEach(Fn fn) {
+                for (CachedGlyph& glyph : mGlyphs) {
+                    if (glyph.codepoint != NO_CODEPOINT) {
+                        fn(glyph);
+                    }
+                }
+            }
+
+            template <typename Fn>
+            void ForEach(Fn fn) const {
+                for (const CachedGlyph& glyph : mGlyphs) {
+                    if (glyph.codepoint != NO_CODEPOINT) {
+                        fn(glyph);
+                    }
+                }
+            }
+
+        private:
+            struct SparseSlot {
+                char32_t codepoint;
+                uint32_t glyph; // Index into mGlyphs, empty slot if there is none
+            };
+
+            std::vector<uint32_t> mDense; // Allocated on first use
+            std::vector<SparseSlot> mSparse; // Power of two sized, at most half full
+            size_t mSparseCount;
+            unsigned int mSparseBits;
+            std::deque<CachedGlyph> mGlyphs;
+            std::vector<uint32_t> mFreeGlyphs;
+
+            size_t SparseHome(char32_t codepoint) const;
+            size_t FindSparseSlot(char32_t codepoint) const; // mSparse.size() if not there
+            void GrowSparse();
+        };
+        GlyphTable mGlyphs;
+        unsigned int mGlyphGeneration; // See GetGlyphGeneration
+        unsigned int mFrame; // See AdvanceFrame
+        bool mRepacking; // Evicted glyphs are being baked again, they only go where there is room
+
+        bool mSubpixelPositioning;
+        unsigned int mSubpixelVariantBudget;
+        unsigned int mSubpixelVariants; // Resident variants, may count some that are gone until the next trim
+        unsigned int mSubpixelTrimFrame;
+
+        bool mAsyncRasterization;
+        std::shared_ptr<GlyphRasterizer::Queue> mFinishedGlyphs;
+        std::vector<GlyphRasterizer::Job> mLandingGlyphs; // Scratch for CollectFinishedGlyphs
+        uint32_t mNextGlyphJob;
+        unsigned int mPendingGlyphJobs; // Submitted and not collected yet, stale ones included
         bool mIsValid; // Overall validity of the Font object (e.g., base font loaded successfully)
 
+        std::vector<int16_t> mKerning; // Font units for pairs of ASCII characters, filled in as they are asked for
+
         int mTabSize; // Number of spaces for a tab character
         unsigned int mSpaceWidthPixels; // Cached width of a space character in pixels
 
         // Internal helper methods
-        bool AllocateSpaceForGlyph(int glyphW, int glyphH, int& outX, int& outY);
+        bool AllocateSpaceForGlyph(int glyphW, int glyphH, unsigned int& outPage, int& outX, int& outY);
+        bool FindSkylineSpot(const AtlasPage& page, int width, int height, size_t& outNode, int& outY) const;
+        bool FitSkyline(const AtlasPage& page, size_t node, int width, int height, int& outY) const;
+        void AddSkylineLevel(AtlasPage& page, size_t node, int x, int y, int width);
         bool TryExpandAtlas(unsigned int neededGlyphW, unsigned int neededGlyphH);
-        void UploadAtlasToGPU();
+        void AddAtlasPage();
+        bool EvictAtlasPage(); // Empties the least recently used page, false if every page is in use this frame
+        void ResetAtlas(); // Back to one empty page, all glyphs have to be baked again
+        void ResetAtlasPage(AtlasPage& page);
+        void MarkAtlasReset(unsigned int page); // Call once everything on the page is baked again
+        void MarkAtlasChanged(unsigned int page, int x, int y, int width, int height);
         float GetScale(const stbtt_fontinfo* font, float pixelHeight, float dpiScale) const;
         bool LoadTTF(const void* data, unsigned int bytes, stbtt_fontinfo& fontOut); // Helper to init stbtt_fontinfo
-        bool BakeGlyphToAtlas(char32_t codepoint, stbtt_fontinfo& font, float pixelHeight, float dpiScale); // Bakes using a specific font_info
+        static uint64_t HashFontData(const void* data, unsigned int bytes);
+        bool BakeGlyphFromFonts(char32_t codepoint, bool async = false); // From the base font if it has the glyph, the extension font otherwise
+        // Bakes from the base or extension font. When async the bitmap is left to a worker, the space for it is reserved.
+        // Bins other than 0 bake the subpixel variant shifted right by that many quarter pixels.
+        bool BakeGlyphToAtlas(char32_t codepoint, bool fromExtFont, bool async = false, int subpixelBin = 0);
+        static char32_t SubpixelKey(char32_t codepoint, int bin); // What variants are stored under in mGlyphs
+        static bool IsSubpixelVariant(char32_t key);
+        void TrimSubpixelVariants();
+        float GetBakePixelHeight(bool fromExtFont) const; // What the atlas is rasterized at
+        float GetBakeDpiScale(bool fromExtFont) const;
+        GlyphInfo ScaleBakedGlyph(const CachedGlyph& glyph) const; // Baked metrics at the current pixel height
+        void UpdateSpaceWidth();
     };
 }
\ No newline at end of file
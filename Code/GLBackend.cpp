@@ -0,0 +1,139 @@
+#include "GLBackend.h"
+#include <cstdio> // For printf
+
+namespace TextEdit {
+    // Straight through to the GL context that is current on the calling thread
+    class OpenGLBackend : public GLBackend {
+    public:
+        GLuint CreateProgram(const char* vertexSource, const char* fragmentSource) override {
+            GLuint vs = CompileShader(GL_VERTEX_SHADER, vertexSource);
+            if (!vs) return 0;
+            GLuint fs = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+            if (!fs) {
+                glDeleteShader(vs);
+                return 0;
+            }
+            GLuint prog = glCreateProgram();
+            glAttachShader(prog, vs);
+            glAttachShader(prog, fs);
+            glLinkProgram(prog);
+            glDeleteShader(vs); // Can delete after linking
+            glDeleteShader(fs); // Can delete after linking
+
+            GLint linked = 0;
+            glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+            if (!linked) {
+                char buffer[1024];
+                glGetProgramInfoLog(prog, 1024, nullptr, buffer);
+                printf("Program Link Error: %s\n", buffer);
+                glDeleteProgram(prog);
+                return 0;
+            }
+            return prog;
+        }
+        void DeleteProgram(GLuint program) override { glDeleteProgram(program); }
+        void UseProgram(GLuint program) override { glUseProgram(program); }
+        GLint GetUniformLocation(GLuint program, const char* name) override { return glGetUniformLocation(program, name); }
+        void Uniform1i(GLint location, GLint value) override { glUniform1i(location, value); }
+        void Uniform2f(GLint location, GLfloat x, GLfloat y) override { glUniform2f(location, x, y); }
+
+        void GenBuffers(GLsizei count, GLuint* buffers) override { glGenBuffers(count, buffers); }
+        void DeleteBuffers(GLsizei count, const GLuint* buffers) override { glDeleteBuffers(count, buffers); }
+        void BindBuffer(GLenum target, GLuint buffer) override { glBindBuffer(target, buffer); }
+        void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override { glBufferData(target, size, data, usage); }
+        void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override { glBufferSubData(target, offset, size, data); }
+        void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override {
+#ifdef __EMSCRIPTEN__
+            return nullptr; // WebGL2 can't map buffers
+#else
+            return glMapBufferRange(target, offset, length, access);
+#endif
+        }
+        GLboolean UnmapBuffer(GLenum target) override {
+#ifdef __EMSCRIPTEN__
+            return GL_FALSE;
+#else
+            return glUnmapBuffer(target);
+#endif
+        }
+        void GenVertexArrays(GLsizei count, GLuint* arrays) override { glGenVertexArrays(count, arrays); }
+        void DeleteVertexArrays(GLsizei count, const GLuint* arrays) override { glDeleteVertexArrays(count, arrays); }
+        void BindVertexArray(GLuint array) override { glBindVertexArray(array); }
+        void EnableVertexAttribArray(GLuint index) override { glEnableVertexAttribArray(index); }
+        void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override {
+            glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+        }
+        void VertexAttribDivisor(GLuint index, GLuint divisor) override { glVertexAttribDivisor(index, divisor); }
+
+        void GenTextures(GLsizei count, GLuint* textures) override { glGenTextures(count, textures); }
+        void DeleteTextures(GLsizei count, const GLuint* textures) override { glDeleteTextures(count, textures); }
+        void ActiveTexture(GLenum unit) override { glActiveTexture(unit); }
+        void BindTexture(GLenum target, GLuint texture) override { glBindTexture(target, texture); }
+        void TexParameteri(GLenum target, GLenum name, GLint value) override { glTexParameteri(target, name, value); }
+        void PixelStorei(GLenum name, GLint value) override { glPixelStorei(name, value); }
+        void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+            GLint border, GLenum format, GLenum type, const void* pixels) override {
+            glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+        }
+        void TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const void* pixels) override {
+            glTexSubImage2D(target, level, x, y, width, height, format, type, pixels);
+        }
+        void TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+            GLint border, GLenum format, GLenum type, const void* pixels) override {
+            glTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+        }
+        void TexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+            GLenum format, GLenum type, const void* pixels) override {
+            glTexSubImage3D(target, level, x, y, z, width, height, depth, format, type, pixels);
+        }
+
+        void GenFramebuffers(GLsizei count, GLuint* framebuffers) override { glGenFramebuffers(count, framebuffers); }
+        void DeleteFramebuffers(GLsizei count, const GLuint* framebuffers) override { glDeleteFramebuffers(count, framebuffers); }
+        void BindFramebuffer(GLenum target, GLuint framebuffer) override { glBindFramebuffer(target, framebuffer); }
+        void FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level) override {
+            glFramebufferTexture2D(target, attachment, textureTarget, texture, level);
+        }
+        GLenum CheckFramebufferStatus(GLenum target) override { return glCheckFramebufferStatus(target); }
+        void BlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+            GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) override {
+            glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+        }
+
+        void Enable(GLenum capability) override { glEnable(capability); }
+        void Disable(GLenum capability) override { glDisable(capability); }
+        void BlendFunc(GLenum source, GLenum destination) override { glBlendFunc(source, destination); }
+        void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) override { glViewport(x, y, width, height); }
+        void Scissor(GLint x, GLint y, GLsizei width, GLsizei height) override { glScissor(x, y, width, height); }
+        void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) override { glClearColor(r, g, b, a); }
+        void Clear(GLbitfield mask) override { glClear(mask); }
+        void DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) override {
+            glDrawArraysInstanced(mode, first, count, instanceCount);
+        }
+
+        GLsync FenceSync(GLenum condition, GLbitfield flags) override { return glFenceSync(condition, flags); }
+        GLenum ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) override { return glClientWaitSync(sync, flags, timeout); }
+        void DeleteSync(GLsync sync) override { glDeleteSync(sync); }
+
+    private:
+        static GLuint CompileShader(GLenum type, const char* src) {
+            GLuint shader = glCreateShader(type);
+            glShaderSource(shader, 1, &src, nullptr);
+            glCompileShader(shader);
+            GLint status = 0;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+            if (status == 0) {
+                char buffer[1024];
+                glGetShaderInfoLog(shader, 1024, nullptr, buffer);
+                printf("Shader Compile Error (%s): %s\n", (type == GL_VERTEX_SHADER ? "VS" : "FS"), buffer);
+                glDeleteShader(shader);
+                return 0;
+            }
+            return shader;
+        }
+    };
+
+    std::shared_ptr<GLBackend> GLBackend::CreateOpenGL() {
+        return std::make_shared<OpenGLBackend>();
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <cstddef>
+
+#ifndef __EMSCRIPTEN__
+#include "glad.h"
+#endif // !__EMSCRIPTEN__
+
+#ifdef __EMSCRIPTEN__
+#define GL_GLEXT_PROTOTYPES 1
+
+#include <GLES3/gl3.h>
+#endif
+
+namespace TextEdit {
+    // Every OpenGL call the editor makes goes through one of these, so the renderer and everything
+    // drawing through it can run against something other than a GL context. Methods are the GL entry
+    // points they stand for without the gl prefix, and take the same arguments. The one exception is
+    // CreateProgram, which compiles and links a vertex and fragment shader in one go.
+    class GLBackend {
+    public:
+        virtual ~GLBackend() = default;
+
+        // The backend that talks to the current OpenGL context
+        static std::shared_ptr<GLBackend> CreateOpenGL();
+
+        // Shaders
+        virtual GLuint CreateProgram(const char* vertexSource, const char* fragmentSource) = 0; // 0 on failure, errors are printed
+        virtual void DeleteProgram(GLuint program) = 0;
+        virtual void UseProgram(GLuint program) = 0;
+        virtual GLint GetUniformLocation(GLuint program, const char* name) = 0;
+        virtual void Uniform1i(GLint location, GLint value) = 0;
+        virtual void Uniform2f(GLint location, GLfloat x, GLfloat y) = 0;
+
+        // Buffers and vertex arrays
+        virtual void GenBuffers(GLsizei count, GLuint* buffers) = 0;
+        virtual void DeleteBuffers(GLsizei count, const GLuint* buffers) = 0;
+        virtual void BindBuffer(GLenum target, GLuint buffer) = 0;
+        virtual void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) = 0;
+        virtual void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) = 0;
+        virtual void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) = 0; // Null if mapping isn't available
+        virtual GLboolean UnmapBuffer(GLenum target) = 0;
+        virtual void GenVertexArrays(GLsizei count, GLuint* arrays) = 0;
+        virtual void DeleteVertexArrays(GLsizei count, const GLuint* arrays) = 0;
+        virtual void BindVertexArray(GLuint array) = 0;
+        virtual void EnableVertexAttribArray(GLuint index) = 0;
+        virtual void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) = 0;
+        virtual void VertexAttribDivisor(GLuint index, GLuint divisor) = 0;
+
+        // Textures
+        virtual void GenTextures(GLsizei count, GLuint* textures) = 0;
+        virtual void DeleteTextures(GLsizei count, const GLuint* textures) = 0;
+        virtual void ActiveTexture(GLenum unit) = 0;
+        virtual void BindTexture(GLenum target, GLuint texture) = 0;
+        virtual void TexParameteri(GLenum target, GLenum name, GLint value) = 0;
+        virtual void PixelStorei(GLenum name, GLint value) = 0;
+        virtual void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+            GLint border, GLenum format, GLenum type, const void* pixels) = 0;
+        virtual void TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const void* pixels) = 0;
+        virtual void TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+            GLint border, GLenum format, GLenum type, const void* pixels) = 0;
+        virtual void TexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+            GLenum format, GLenum type, const void* pixels) = 0;
+
+        // Framebuffers
+        virtual void GenFramebuffers(GLsizei count, GLuint* framebuffers) = 0;
+        virtual void DeleteFramebuffers(GLsizei count, const GLuint* framebuffers) = 0;
+        virtual void BindFramebuffer(GLenum target, GLuint framebuffer) = 0;
+        virtual void FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level) = 0;
+        virtual GLenum CheckFramebufferStatus(GLenum target) = 0;
+        virtual void BlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+            GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) = 0;
+
+        // Fixed function state and drawing
+        virtual void Enable(GLenum capability) = 0;
+        virtual void Disable(GLenum capability) = 0;
+        virtual void BlendFunc(GLenum source, GLenum destination) = 0;
+        virtual void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+        virtual void Scissor(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+        virtual void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) = 0;
+        virtual void Clear(GLbitfield mask) = 0;
+        virtual void DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) = 0;
+
+        // Sync
+        virtual GLsync FenceSync(GLenum condition, GLbitfield flags) = 0;
+        virtual GLenum ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) = 0;
+        virtual void DeleteSync(GLsync sync) = 0;
+    };
+}
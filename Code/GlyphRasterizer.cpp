@@ -0,0 +1,115 @@
+#include "GlyphRasterizer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define GLYPH_RASTERIZER_THREADS 0
+#else
+#define GLYPH_RASTERIZER_THREADS 1
+#endif
+
+namespace TextEdit {
+    static constexpr unsigned int MAX_GLYPH_WORKERS = 4;
+
+    void GlyphRasterizer::Queue::Push(Job&& job) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFinished.push_back(std::move(job));
+    }
+
+    void GlyphRasterizer::Queue::TakeFinished(std::vector<Job>& outJobs) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (Job& job : mFinished) {
+            outJobs.push_back(std::move(job));
+        }
+        mFinished.clear();
+    }
+
+    GlyphRasterizer& GlyphRasterizer::Get() {
+        static GlyphRasterizer rasterizer;
+        return rasterizer;
+    }
+
+    GlyphRasterizer::GlyphRasterizer() : mStopping(false) {
+#if GLYPH_RASTERIZER_THREADS
+        // Leave a core for the main thread
+        unsigned int cores = std::thread::hardware_concurrency();
+        unsigned int workers = std::max(1u, std::min(MAX_GLYPH_WORKERS, cores > 1 ? cores - 1 : 1u));
+        for (unsigned int i = 0; i < workers; ++i) {
+            mWorkers.emplace_back(&GlyphRasterizer::WorkerMain, this);
+        }
+#endif
+    }
+
+    GlyphRasterizer::~GlyphRasterizer() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mWake.notify_all();
+        for (std::thread& worker : mWorkers) {
+            worker.join();
+        }
+    }
+
+    void GlyphRasterizer::Submit(Job&& job, const std::shared_ptr<Queue>& queue) {
+        if (mWorkers.empty()) {
+            Rasterize(job);
+            queue->Push(std::move(job));
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPending.push_back({ std::move(job), queue });
+        }
+        mWake.notify_one();
+    }
+
+    void GlyphRasterizer::Rasterize(Job& job) {
+        PROFILE_SCOPE(GlyphRasterize);
+        job.bitmap.assign(static_cast<size_t>(job.width) * job.height, 0);
+        RasterizeGlyph(job.font, job.glyphIndex, job.scale, job.shiftX, job.distanceFieldSpread,
+            job.bitmap.data(), job.width, job.height, job.width);
+    }
+
+    void GlyphRasterizer::RasterizeGlyph(stbtt_fontinfo& font, int glyphIndex, float scale, float shiftX, int distanceFieldSpread,
+        unsigned char* out, int width, int height, int stride) {
+        if (width <= 0 || height <= 0) {
+            return;
+        }
+        if (distanceFieldSpread <= 0) {
+            stbtt_MakeGlyphBitmapSubpixel(&font, out, width, height, stride, scale, scale, shiftX, 0.0f, glyphIndex);
+            return;
+        }
+
+        int sdfWidth = 0, sdfHeight = 0, xOffset = 0, yOffset = 0;
+        unsigned char* sdf = stbtt_GetGlyphSDF(&font, scale, glyphIndex, distanceFieldSpread, 128,
+            128.0f / distanceFieldSpread, &sdfWidth, &sdfHeight, &xOffset, &yOffset);
+        if (sdf == nullptr) {
+            return;
+        }
+        int copyWidth = std::min(width, sdfWidth);
+        int copyHeight = std::min(height, sdfHeight);
+        for (int row = 0; row < copyHeight; ++row) {
+            memcpy(out + static_cast<size_t>(row) * stride, sdf + static_cast<size_t>(row) * sdfWidth, static_cast<size_t>(copyWidth));
+        }
+        stbtt_FreeSDF(sdf, nullptr);
+    }
+
+    void GlyphRasterizer::WorkerMain() {
+        while (true) {
+            PendingJob pending;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWake.wait(lock, [this] { return mStopping || !mPending.empty(); });
+                if (mStopping) {
+                    return;
+                }
+                pending = std::move(mPending.front());
+                mPending.pop_front();
+            }
+            Rasterize(pending.job);
+            pending.queue->Push(std::move(pending.job));
+        }
+    }
+}
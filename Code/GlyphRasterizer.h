@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include "stb_truetype.h"
+
+namespace TextEdit {
+    // Rasterizes glyph bitmaps on worker threads, so the first frame that shows a new script doesn't
+    // stall on stb_truetype. Fonts submit jobs and collect them from their own queue on the main thread.
+    // Where there are no threads (WebAssembly without pthreads) jobs are done inside Submit.
+    class GlyphRasterizer {
+    public:
+        struct Job {
+            uint32_t id;          // Chosen by the font, to tell stale results apart
+            char32_t codepoint;   // Or subpixel variant key, whatever the font looks the glyph up by
+            // A copy of the font's info, so the font can switch to other TTF data while the job runs. It still
+            // points into the TTF bytes the font was loaded from, those have to outlive the job.
+            stbtt_fontinfo font;
+            int glyphIndex;
+            float scale;
+            float shiftX;         // See RasterizeGlyph
+            int distanceFieldSpread; // 0 for coverage, see RasterizeGlyph
+            int width;
+            int height;
+            unsigned int page;    // Where the bitmap goes in the font's atlas
+            int x;
+            int y;
+            std::vector<unsigned char> bitmap; // width * height, filled in by the worker
+        };
+
+        // Finished jobs of one font. The workers hold on to it too, so the font can go away first.
+        class Queue {
+        public:
+            void Push(Job&& job);
+            void TakeFinished(std::vector<Job>& outJobs); // Appends to outJobs
+        private:
+            std::mutex mMutex;
+            std::vector<Job> mFinished;
+        };
+
+        static GlyphRasterizer& Get(); // Shared by all fonts, workers start on first use
+        ~GlyphRasterizer();
+
+        void Submit(Job&& job, const std::shared_ptr<Queue>& queue);
+
+        // Rasterizes one glyph into a width by height block of out, stride bytes apart. Coverage is moved
+        // right by shiftX pixels, the block has to match stbtt_GetGlyphBitmapBoxSubpixel for that shift.
+        // With a spread the block holds a signed distance field instead: 128 on the outline, changing by
+        // 128 / spread per pixel, and spread pixels wider than the glyph's bitmap box on every side.
+        static void RasterizeGlyph(stbtt_fontinfo& font, int glyphIndex, float scale, float shiftX, int distanceFieldSpread,
+            unsigned char* out, int width, int height, int stride);
+
+    private:
+        GlyphRasterizer();
+        GlyphRasterizer(const GlyphRasterizer&) = delete;
+        GlyphRasterizer& operator=(const GlyphRasterizer&) = delete;
+
+        static void Rasterize(Job& job);
+        void WorkerMain();
+
+        struct PendingJob {
+            Job job;
+            std::shared_ptr<Queue> queue;
+        };
+
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::deque<PendingJob> mPending;
+        std::vector<std::thread> mWorkers;
+        bool mStopping;
+    };
+}
@@ -0,0 +1,225 @@
+#include "InputRecording.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace TextEdit {
+    static constexpr uint32_t INPUT_RECORDING_MAGIC = 0x52494343; // "CCIR"
+    static constexpr uint32_t INPUT_RECORDING_FORMAT = 1; // Bump whenever what Save writes changes
+    static constexpr unsigned int DEFAULT_RECORDING_WIDTH = 1280;
+    static constexpr unsigned int DEFAULT_RECORDING_HEIGHT = 720;
+    static constexpr unsigned int VK_RETURN_KEY = 0x0D;
+
+    static constexpr uint32_t RECORDED_CTRL = 1;
+    static constexpr uint32_t RECORDED_SHIFT = 2;
+    static constexpr uint32_t RECORDED_REPEAT = 4;
+    static constexpr uint32_t RECORDED_ALT = 8;
+
+    struct InputRecordingHeader {
+        uint32_t magic;
+        uint32_t format;
+        uint32_t screenWidth;
+        uint32_t screenHeight;
+        uint32_t eventCount;
+    };
+
+    // One event with the union spelled out, so the file doesn't depend on how InputEvent is laid out
+    struct RecordedInputEvent {
+        double time;
+        uint32_t type;
+        uint32_t eventTime;
+        uint32_t code;    // Key code, mouse button or touch id
+        uint32_t unicode;
+        int32_t delta;
+        int32_t x;
+        int32_t y;
+        uint32_t flags;   // RECORDED_*
+    };
+
+    InputRecording::InputRecording() : mScreenWidth(DEFAULT_RECORDING_WIDTH), mScreenHeight(DEFAULT_RECORDING_HEIGHT) {
+    }
+
+    void InputRecording::Clear() {
+        mEntries.clear();
+    }
+
+    void InputRecording::Add(double time, const InputEvent& event) {
+        mEntries.push_back({ time, event });
+    }
+
+    const std::vector<InputRecording::Entry>& InputRecording::GetEntries() const {
+        return mEntries;
+    }
+
+    void InputRecording::SetScreenSize(unsigned int width, unsigned int height) {
+        mScreenWidth = width;
+        mScreenHeight = height;
+    }
+
+    unsigned int InputRecording::GetScreenWidth() const {
+        return mScreenWidth;
+    }
+
+    unsigned int InputRecording::GetScreenHeight() const {
+        return mScreenHeight;
+    }
+
+    void InputRecording::AddTyping(const std::u32string& text, double startTime, double interval) {
+        double time = startTime;
+        for (char32_t c : text) {
+            InputEvent event;
+            memset(&event, 0, sizeof(event));
+            event.type = InputEvent::Type::KEY_DOWN;
+            event.time = static_cast<unsigned long>(time * 1000.0);
+            if (c == U'\n') {
+                event.key.keyCode = VK_RETURN_KEY;
+                Add(time, event);
+                event.type = InputEvent::Type::KEY_UP;
+            }
+            else {
+                event.key.unicode = c;
+            }
+            Add(time, event);
+            time += interval;
+        }
+    }
+
+    void InputRecording::Save(std::vector<unsigned char>& outData) const {
+        InputRecordingHeader header = { INPUT_RECORDING_MAGIC, INPUT_RECORDING_FORMAT, mScreenWidth, mScreenHeight,
+            static_cast<uint32_t>(mEntries.size()) };
+        outData.resize(sizeof(header) + mEntries.size() * sizeof(RecordedInputEvent));
+        memcpy(outData.data(), &header, sizeof(header));
+
+        unsigned char* cursor = outData.data() + sizeof(header);
+        for (const Entry& entry : mEntries) {
+            const InputEvent& e = entry.event;
+            RecordedInputEvent recorded = {};
+            recorded.time = entry.time;
+            recorded.type = static_cast<uint32_t>(e.type);
+            recorded.eventTime = static_cast<uint32_t>(e.time);
+            if (e.type == InputEvent::Type::KEY_DOWN || e.type == InputEvent::Type::KEY_UP) {
+                recorded.code = e.key.keyCode;
+                recorded.unicode = static_cast<uint32_t>(e.key.unicode);
+                recorded.flags = (e.key.ctrl ? RECORDED_CTRL : 0) | (e.key.shift ? RECORDED_SHIFT : 0) |
+                    (e.key.isRepeat ? RECORDED_REPEAT : 0) | (e.key.alt ? RECORDED_ALT : 0);
+            }
+            else if (e.type == InputEvent::Type::TOUCH_DOWN || e.type == InputEvent::Type::TOUCH_UP || e.type == InputEvent::Type::TOUCH_MOVE) {
+                recorded.code = static_cast<uint32_t>(e.touch.id);
+                recorded.x = e.touch.x;
+                recorded.y = e.touch.y;
+            }
+            else {
+                recorded.code = e.mouse.button;
+                recorded.delta = e.mouse.delta;
+                recorded.x = e.mouse.x;
+                recorded.y = e.mouse.y;
+                recorded.flags = (e.mouse.ctrl ? RECORDED_CTRL : 0) | (e.mouse.shift ? RECORDED_SHIFT : 0);
+            }
+            memcpy(cursor, &recorded, sizeof(recorded));
+            cursor += sizeof(recorded);
+        }
+    }
+
+    bool InputRecording::Load(const std::vector<unsigned char>& data) {
+        mEntries.clear();
+        InputRecordingHeader header;
+        if (data.size() < sizeof(header)) {
+            printf("Input recording is too short\n");
+            return false;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != INPUT_RECORDING_MAGIC || header.format != INPUT_RECORDING_FORMAT) {
+            printf("Not an input recording, or one from another version\n");
+            return false;
+        }
+        if (data.size() != sizeof(header) + static_cast<size_t>(header.eventCount) * sizeof(RecordedInputEvent)) {
+            printf("Input recording is truncated\n");
+            return false;
+        }
+
+        const unsigned char* cursor = data.data() + sizeof(header);
+        mEntries.reserve(header.eventCount);
+        for (uint32_t i = 0; i < header.eventCount; ++i) {
+            RecordedInputEvent recorded;
+            memcpy(&recorded, cursor, sizeof(recorded));
+            cursor += sizeof(recorded);
+            if (recorded.type > static_cast<uint32_t>(InputEvent::Type::TOUCH_MOVE)) {
+                printf("Input recording has an unknown event type %u\n", recorded.type);
+                mEntries.clear();
+                return false;
+            }
+
+            InputEvent e;
+            memset(&e, 0, sizeof(e));
+            e.type = static_cast<InputEvent::Type>(recorded.type);
+            e.time = recorded.eventTime;
+            if (e.type == InputEvent::Type::KEY_DOWN || e.type == InputEvent::Type::KEY_UP) {
+                e.key.keyCode = recorded.code;
+                e.key.unicode = static_cast<char32_t>(recorded.unicode);
+                e.key.ctrl = (recorded.flags & RECORDED_CTRL) != 0;
+                e.key.shift = (recorded.flags & RECORDED_SHIFT) != 0;
+                e.key.isRepeat = (recorded.flags & RECORDED_REPEAT) != 0;
+                e.key.alt = (recorded.flags & RECORDED_ALT) != 0;
+            }
+            else if (e.type == InputEvent::Type::TOUCH_DOWN || e.type == InputEvent::Type::TOUCH_UP || e.type == InputEvent::Type::TOUCH_MOVE) {
+                e.touch.id = static_cast<int>(recorded.code);
+                e.touch.x = recorded.x;
+                e.touch.y = recorded.y;
+            }
+            else {
+                e.mouse.button = recorded.code;
+                e.mouse.delta = recorded.delta;
+                e.mouse.x = recorded.x;
+                e.mouse.y = recorded.y;
+                e.mouse.ctrl = (recorded.flags & RECORDED_CTRL) != 0;
+                e.mouse.shift = (recorded.flags & RECORDED_SHIFT) != 0;
+            }
+            mEntries.push_back({ recorded.time, e });
+        }
+        mScreenWidth = header.screenWidth;
+        mScreenHeight = header.screenHeight;
+        return true;
+    }
+
+    void InputReplay::Run(const InputRecording& recording, Result& outResult) {
+        typedef std::chrono::steady_clock Clock;
+        const std::vector<InputRecording::Entry>& entries = recording.GetEntries();
+        unsigned int width = recording.GetScreenWidth();
+        unsigned int height = recording.GetScreenHeight();
+
+        outResult.latencies.clear();
+        outResult.latencies.reserve(entries.size());
+        Clock::time_point replayStart = Clock::now();
+
+        // Settle the first frame so the first event isn't charged for drawing the whole window
+        Tick(width, height, 0.0f);
+        double lastTime = entries.empty() ? 0.0 : entries.front().time;
+        for (const InputRecording::Entry& entry : entries) {
+            float deltaTime = static_cast<float>(std::max(0.0, entry.time - lastTime));
+            lastTime = entry.time;
+
+            Clock::time_point start = Clock::now();
+            OnInput(entry.event);
+            Tick(width, height, deltaTime);
+            outResult.latencies.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+        }
+        outResult.totalSeconds = std::chrono::duration<double>(Clock::now() - replayStart).count();
+    }
+
+    void InputReplay::PrintReport(const char* name, const Result& result) {
+        if (result.latencies.empty()) {
+            printf("%s: no events\n", name);
+            return;
+        }
+        std::vector<double> sorted = result.latencies;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) {
+            size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+            return sorted[std::min(index, sorted.size() - 1)] * 1000.0;
+        };
+        printf("%s: %zu events in %.2f s, latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            name, sorted.size(), result.totalSeconds, percentile(0.5), percentile(0.9), percentile(0.99), sorted.back() * 1000.0);
+    }
+}
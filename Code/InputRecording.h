@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "application.h"
+
+namespace TextEdit {
+    // The input events given to OnInput, each with the application time it arrived at, so a session
+    // can be played back frame for frame. Ctrl+F9 records one in profiling builds, benchmarks can
+    // also make them up (AddTyping).
+    class InputRecording {
+    public:
+        struct Entry {
+            double time; // Seconds, only the differences between entries matter
+            InputEvent event;
+        };
+
+        InputRecording();
+
+        void Clear();
+        void Add(double time, const InputEvent& event);
+        const std::vector<Entry>& GetEntries() const;
+
+        // Mouse positions only mean the same thing in a window of the same size
+        void SetScreenSize(unsigned int width, unsigned int height);
+        unsigned int GetScreenWidth() const;
+        unsigned int GetScreenHeight() const;
+
+        // Text input events interval seconds apart, the way platforms deliver typed characters.
+        // Newlines become return key presses.
+        void AddTyping(const std::u32string& text, double startTime, double interval);
+
+        void Save(std::vector<unsigned char>& outData) const;
+        bool Load(const std::vector<unsigned char>& data); // Leaves the recording empty if the data isn't one
+
+    protected:
+        std::vector<Entry> mEntries;
+        unsigned int mScreenWidth;
+        unsigned int mScreenHeight;
+    };
+
+    // Plays a recording into the application. Time only moves when the recording says it does, the
+    // ticks in between run with the recorded gaps, so every replay draws the same frames.
+    class InputReplay {
+    public:
+        struct Result {
+            std::vector<double> latencies; // Seconds from handing an event to OnInput until the frame after it is drawn
+            double totalSeconds = 0.0;
+        };
+
+        // The application must be initialized with a backend at least the recording's screen size,
+        // each event is followed by a Tick
+        static void Run(const InputRecording& recording, Result& outResult);
+
+        // Latency percentiles (p50, p90, p99, max) in milliseconds, on one line after name
+        static void PrintReport(const char* name, const Result& result);
+    };
+}
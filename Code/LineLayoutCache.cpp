@@ -0,0 +1,242 @@
+#include "LineLayoutCache.h"
+#include "Document.h"
+#include "Font.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace TextEdit {
+    // Enough for every visible line and whatever was hit tested lately
+    static constexpr size_t MAX_CACHED_LINES = 4096;
+
+    LineLayoutCache::LineLayoutCache() : mUseCounter(0), mMaxWidth(0.0f), mMaxWidthValid(false),
+        mDocument(nullptr), mFont(nullptr), mEditVersion(0), mFontGeneration(0), mTabSpaces(0) {
+    }
+
+    void LineLayoutCache::Clear() {
+        InvalidateAll();
+        mDocument = nullptr;
+        mFont = nullptr;
+    }
+
+    const std::vector<float>& LineLayoutCache::GetPositions(const Document& document, Font& font, unsigned int line) {
+        return Layout(document, font, line, true).positions;
+    }
+
+    float LineLayoutCache::GetWidth(const Document& document, Font& font, unsigned int line) {
+        return Layout(document, font, line, false).width;
+    }
+
+    float LineLayoutCache::GetMaxWidth(const Document& document, Font& font) {
+        Sync(document, font);
+        unsigned int lineCount = document.GetLineCount();
+        if (!mMaxWidthValid) {
+            mMaxWidth = 0.0f;
+            for (unsigned int line = 0; line < lineCount; ++line) {
+                mMaxWidth = std::max(mMaxWidth, Measure(document, font, line, nullptr));
+            }
+            mMaxWidthValid = true;
+        }
+        else {
+            for (const LineRange& range : mEditedRanges) {
+                for (unsigned int line = range.first; line <= range.last && line < lineCount; ++line) {
+                    mMaxWidth = std::max(mMaxWidth, Measure(document, font, line, nullptr));
+                }
+            }
+        }
+        mEditedRanges.clear();
+        return mMaxWidth;
+    }
+
+    unsigned int LineLayoutCache::GetColumnAt(const std::vector<float>& positions, float x) {
+        if (positions.size() < 2) {
+            return 0;
+        }
+        // Past the middle of a character is the boundary after it
+        size_t low = 0, high = positions.size() - 1;
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (x < (positions[mid] + positions[mid + 1]) * 0.5f) {
+                high = mid;
+            }
+            else {
+                low = mid + 1;
+            }
+        }
+        return static_cast<unsigned int>(low);
+    }
+
+    void LineLayoutCache::Sync(const Document& document, Font& font) {
+        if (&document != mDocument || &font != mFont) {
+            Clear();
+            mDocument = &document;
+            mFont = &font;
+            mEditVersion = document.GetEditVersion();
+            mFontGeneration = font.GetGlyphGeneration();
+            mTabSpaces = font.GetTabNumSpaces();
+        }
+
+        unsigned int version = document.GetEditVersion();
+        if (version != mEditVersion) {
+            const std::deque<Document::LineEdit>& edits = document.GetRecentEdits();
+            if (edits.empty() || edits.front().version > mEditVersion + 1) {
+                InvalidateAll(); // Too far behind to know where the lines went
+            }
+            else {
+                for (const Document::LineEdit& edit : edits) {
+                    if (edit.version <= mEditVersion) {
+                        continue;
+                    }
+                    if (edit.reset) {
+                        InvalidateAll();
+                    }
+                    else {
+                        ApplyEdit(edit.line, edit.lineDelta);
+                    }
+                }
+            }
+            mEditVersion = version;
+        }
+
+        // Re-baked or rescaled glyphs may have new advances
+        if (font.GetGlyphGeneration() != mFontGeneration || font.GetTabNumSpaces() != mTabSpaces) {
+            InvalidateAll();
+            mFontGeneration = font.GetGlyphGeneration();
+            mTabSpaces = font.GetTabNumSpaces();
+        }
+    }
+
+    void LineLayoutCache::ApplyEdit(unsigned int line, int lineDelta) {
+        unsigned int removed = static_cast<unsigned int>(lineDelta < 0 ? -lineDelta : 0);
+
+        // Only the cached lines move, not the document's
+        if (lineDelta == 0) {
+            mLines.erase(line);
+        }
+        else {
+            std::unordered_map<unsigned int, Line> moved;
+            moved.reserve(mLines.size());
+            for (auto& entry : mLines) {
+                unsigned int key = entry.first;
+                if (key < line) {
+                    moved.emplace(key, std::move(entry.second));
+                }
+                else if (key == line || key <= line + removed) {
+                    continue; // Edited or removed
+                }
+                else {
+                    moved.emplace(key + static_cast<unsigned int>(lineDelta), std::move(entry.second));
+                }
+            }
+            mLines.swap(moved);
+        }
+
+        if (!mMaxWidthValid) {
+            return; // Everything gets measured anyway
+        }
+        // Ranges below the edit move with it, removed lines are cut out of them
+        for (LineRange& range : mEditedRanges) {
+            if (lineDelta > 0) {
+                if (range.first > line) range.first += static_cast<unsigned int>(lineDelta);
+                if (range.last > line) range.last += static_cast<unsigned int>(lineDelta);
+            }
+            else if (lineDelta < 0) {
+                if (range.first > line) range.first = range.first > line + removed ? range.first - removed : line;
+                if (range.last > line) range.last = range.last > line + removed ? range.last - removed : line;
+            }
+        }
+        mEditedRanges.push_back({ line, line + static_cast<unsigned int>(std::max(lineDelta, 0)) });
+    }
+
+    void LineLayoutCache::InvalidateAll() {
+        mLines.clear();
+        mEditedRanges.clear();
+        mMaxWidthValid = false;
+    }
+
+    void LineLayoutCache::EvictLeastRecentlyUsed() {
+        std::vector<unsigned int> uses;
+        uses.reserve(mLines.size());
+        for (const auto& entry : mLines) {
+            uses.push_back(entry.second.lastUsed);
+        }
+        std::nth_element(uses.begin(), uses.begin() + uses.size() / 2, uses.end());
+        unsigned int oldestKept = uses[uses.size() / 2];
+        for (auto it = mLines.begin(); it != mLines.end();) {
+            if (it->second.lastUsed < oldestKept) {
+                it = mLines.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    LineLayoutCache::Line& LineLayoutCache::Layout(const Document& document, Font& font, unsigned int line, bool keepPositions) {
+        Sync(document, font);
+
+        static Line emptyLine;
+        if (line >= document.GetLineCount()) {
+            emptyLine = Line();
+            emptyLine.positions.push_back(0.0f);
+            return emptyLine;
+        }
+
+        size_t length = document.GetLine(line).text.length();
+        auto found = mLines.find(line);
+        if (found != mLines.end() && found->second.length == length && (!keepPositions || !found->second.positions.empty())) {
+            found->second.lastUsed = ++mUseCounter;
+            return found->second;
+        }
+
+        if (found == mLines.end() && mLines.size() >= MAX_CACHED_LINES) {
+            EvictLeastRecentlyUsed();
+        }
+        Line& entry = mLines[line];
+        entry.width = Measure(document, font, line, keepPositions ? &entry.positions : nullptr);
+        if (!keepPositions) {
+            entry.positions.clear();
+        }
+        entry.length = length;
+        entry.lastUsed = ++mUseCounter;
+        return entry;
+    }
+
+    float LineLayoutCache::Measure(const Document& document, Font& font, unsigned int line, std::vector<float>* outPositions) {
+        PROFILE_SCOPE(LineLayout);
+        const std::u32string& text = document.GetLine(line).text;
+
+        float spaceWidth = static_cast<float>(font.GetSpaceWidthPixels());
+        if (spaceWidth == 0.0f) spaceWidth = font.GetGlyph(U' ').advance;
+        if (spaceWidth == 0.0f) spaceWidth = 10.0f;
+        float tabWidth = spaceWidth * static_cast<float>(font.GetTabNumSpaces()); // Fixed width tabs, same as the renderer
+
+        if (outPositions) {
+            outPositions->clear();
+            outPositions->reserve(text.length() + 1);
+        }
+
+        float penX = 0.0f;
+        char32_t previous = 0;
+        for (char32_t c : text) {
+            if (c == U'\t') {
+                if (outPositions) outPositions->push_back(penX);
+                penX += tabWidth;
+                previous = 0;
+                continue;
+            }
+            if (previous != 0) {
+                penX += font.GetKerning(previous, c);
+            }
+            if (outPositions) outPositions->push_back(penX);
+            const GlyphInfo& glyph = font.GetGlyph(c);
+            if (glyph.isValid) {
+                penX += glyph.advance;
+            }
+            previous = c;
+        }
+        if (outPositions) {
+            outPositions->push_back(penX);
+        }
+        return penX;
+    }
+}
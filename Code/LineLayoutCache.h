@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+namespace TextEdit {
+    class Document;
+    class Font;
+
+    // Where every character of a document line goes, with kerning and tabs applied, so drawing and
+    // hit testing agree and neither measures text every frame. Only lines used lately are kept, the
+    // least recently used half is dropped when there are too many, so the cache is sized by what is
+    // on screen rather than by the document. Edits are replayed like the folds do, so lines keep
+    // their layouts when other lines are inserted or removed above them.
+    class LineLayoutCache {
+    public:
+        LineLayoutCache();
+
+        void Clear();
+
+        // Left edge of every column relative to the line start, one more than the line has characters,
+        // the last being where the line ends. Good until the next call.
+        const std::vector<float>& GetPositions(const Document& document, Font& font, unsigned int line);
+        float GetWidth(const Document& document, Font& font, unsigned int line); // Lays the line out without keeping positions
+
+        // Width of the widest line. Measuring every line only happens after a load or when the glyphs
+        // change, edits measure the lines they touched. Lines that got shorter or went away don't make
+        // it smaller until then.
+        float GetMaxWidth(const Document& document, Font& font);
+
+        // The column boundary closest to x
+        static unsigned int GetColumnAt(const std::vector<float>& positions, float x);
+
+    protected:
+        struct Line {
+            std::vector<float> positions; // Empty until asked for, see GetPositions
+            float width = 0.0f;
+            size_t length = 0; // Of the text it was laid out for, a cheap check that the line is the same
+            unsigned int lastUsed = 0;
+        };
+
+        // Lines an edit touched whose widths haven't been measured yet, moved along with later edits
+        struct LineRange {
+            unsigned int first;
+            unsigned int last;
+        };
+
+        std::unordered_map<unsigned int, Line> mLines; // By document line
+        unsigned int mUseCounter;
+        float mMaxWidth;
+        bool mMaxWidthValid;
+        std::vector<LineRange> mEditedRanges;
+
+        const Document* mDocument;
+        const Font* mFont;
+        unsigned int mEditVersion;     // Last document edit the lines were moved for
+        unsigned int mFontGeneration;  // Glyph metrics the layouts were made with
+        unsigned int mTabSpaces;
+
+        void Sync(const Document& document, Font& font);
+        void ApplyEdit(unsigned int line, int lineDelta);
+        void InvalidateAll();
+        void EvictLeastRecentlyUsed();
+        Line& Layout(const Document& document, Font& font, unsigned int line, bool keepPositions);
+        static float Measure(const Document& document, Font& font, unsigned int line, std::vector<float>* outPositions);
+    };
+}
@@ -0,0 +1,142 @@
+// MainBenchmarks.cpp
+// Headless benchmarks of the document core, no fonts and no drawing. Each one runs --repeat times and
+// reports the fastest and the median run.
+//
+//   carrot_bench [--lines N] [--edits N] [--repeat N] [--document path]
+//
+//   load      Splitting the document into lines
+//   tokenize  Highlighting every line, the way the incremental highlighter catches up after a load
+//   type      Typing --edits characters into the middle of the document, highlighting as the editor does per frame
+//   undo      Undoing all of that typing
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Document.h"
+#include "BenchmarkDocument.h"
+
+std::u32string Utf8ToUtf32(const char* utf8_string, unsigned int bytes);
+
+static const unsigned int DEFAULT_BENCH_LINES = 1000000;
+static const unsigned int DEFAULT_BENCH_EDITS = 10000;
+static const unsigned int DEFAULT_BENCH_REPEAT = 5;
+static const int BENCH_HIGHLIGHT_LINES_PER_FRAME = 5; // What DocumentView asks for each update
+
+static bool ReadDocument(const char* path, std::u32string& outText) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("Can't open %s\n", path);
+        return false;
+    }
+    std::vector<char> data;
+    char buffer[65536];
+    size_t bytes;
+    while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + bytes);
+    }
+    fclose(file);
+    outText = Utf8ToUtf32(data.data(), static_cast<unsigned int>(data.size()));
+    return true;
+}
+
+// setup isn't timed, run is
+static void Benchmark(const char* name, unsigned int repeat, unsigned int operations,
+    const std::function<void()>& setup, const std::function<void()>& run) {
+    typedef std::chrono::steady_clock Clock;
+    std::vector<double> seconds;
+    for (unsigned int i = 0; i < repeat; ++i) {
+        setup();
+        Clock::time_point start = Clock::now();
+        run();
+        seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    double median = seconds[seconds.size() / 2];
+    printf("%-9s min %9.3f ms, median %9.3f ms, %8.3f us per %s\n", name, seconds.front() * 1000.0, median * 1000.0,
+        median * 1000000.0 / std::max(operations, 1u), operations > 1 ? "operation" : "run");
+}
+
+int main(int argc, char** argv) {
+    unsigned int lines = DEFAULT_BENCH_LINES;
+    unsigned int edits = DEFAULT_BENCH_EDITS;
+    unsigned int repeat = DEFAULT_BENCH_REPEAT;
+    const char* documentPath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+            lines = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--edits") == 0 && i + 1 < argc) {
+            edits = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1u, static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10)));
+        }
+        else if (strcmp(argv[i], "--document") == 0 && i + 1 < argc) {
+            documentPath = argv[++i];
+        }
+        else {
+            printf("Usage: %s [--lines N] [--edits N] [--repeat N] [--document path]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::u32string text;
+    if (documentPath) {
+        if (!ReadDocument(documentPath, text)) {
+            return 1;
+        }
+    }
+    else {
+        std::string generated;
+        MakeBenchmarkDocument(lines, generated);
+        text = Utf8ToUtf32(generated.data(), static_cast<unsigned int>(generated.size()));
+    }
+
+    std::shared_ptr<TextEdit::Document> document = TextEdit::Document::Create();
+    document->Load(text);
+    printf("%u lines, %zu characters\n", document->GetLineCount(), text.length());
+
+    auto nothing = []() {};
+    Benchmark("load", repeat, 1, nothing, [&]() {
+        document->Load(text);
+    });
+
+    Benchmark("tokenize", repeat, document->GetLineCount(), [&]() {
+        document->Load(text);
+        document->SetHighlighter(TextEdit::Highlighter::Code);
+    }, [&]() {
+        document->UpdateIncrementalHighlight(static_cast<int>(document->GetLineCount()));
+    });
+
+    const TextEdit::Document::Cursor middle(document->GetLineCount() / 2, 0);
+    auto loadHighlighted = [&]() {
+        document->Load(text);
+        document->SetHighlighter(TextEdit::Highlighter::Code);
+        document->UpdateIncrementalHighlight(static_cast<int>(document->GetLineCount()));
+        document->PlaceCursor(middle);
+    };
+    auto type = [&]() {
+        const std::u32string sample = U"value = value * 31 + 7; // typed\n";
+        for (unsigned int i = 0; i < edits; ++i) {
+            document->Insert(sample.substr(i % sample.length(), 1));
+            document->UpdateIncrementalHighlight(BENCH_HIGHLIGHT_LINES_PER_FRAME);
+        }
+    };
+    Benchmark("type", repeat, edits, loadHighlighted, type);
+
+    Benchmark("undo", repeat, edits, [&]() {
+        loadHighlighted();
+        type();
+    }, [&]() {
+        while (document->CanUndo()) {
+            document->Undo();
+        }
+    });
+    return 0;
+}
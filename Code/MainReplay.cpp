@@ -0,0 +1,151 @@
+// MainReplay.cpp
+// Headless benchmark, plays input into the editor without a window and reports how long each event took.
+//
+//   carrot_replay [--lines N] [--type N | --scroll N] [--document path] [--size WxH] [recording.ccir]
+//
+// A recording (Ctrl+F9 in profiling builds) is replayed as recorded. Without one, --type characters are
+// typed at 50 per second, or --scroll wheel notches are scrolled down at 60 per second. The document is
+// loaded from --document, or made up with --lines lines of code.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Renderer.h"
+#include "SoftwareGLBackend.h"
+#include "InputRecording.h"
+#include "application.h"
+#include "BenchmarkDocument.h"
+
+static const unsigned int DEFAULT_REPLAY_LINES = 1000000;
+static const unsigned int DEFAULT_REPLAY_CHARACTERS = 10000;
+static const double REPLAY_TYPING_INTERVAL = 1.0 / 50.0;
+static const double REPLAY_SCROLL_INTERVAL = 1.0 / 60.0;
+static const int REPLAY_WHEEL_DELTA = -120; // One notch towards the end of the document
+
+static bool ReadWholeFile(const char* path, std::vector<unsigned char>& outData) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("Can't open %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    outData.resize(size > 0 ? static_cast<size_t>(size) : 0);
+    bool ok = outData.empty() || fread(outData.data(), 1, outData.size(), file) == outData.size();
+    fclose(file);
+    if (!ok) {
+        printf("Can't read %s\n", path);
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    unsigned int lines = DEFAULT_REPLAY_LINES;
+    unsigned int characters = DEFAULT_REPLAY_CHARACTERS;
+    unsigned int notches = 0;
+    unsigned int width = 0, height = 0;
+    const char* documentPath = nullptr;
+    const char* recordingPath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+            lines = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
+            characters = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--scroll") == 0 && i + 1 < argc) {
+            notches = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--document") == 0 && i + 1 < argc) {
+            documentPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &width, &height) != 2) {
+                printf("--size takes WIDTHxHEIGHT\n");
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-') {
+            recordingPath = argv[i];
+        }
+        else {
+            printf("Usage: %s [--lines N] [--type N | --scroll N] [--document path] [--size WxH] [recording.ccir]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    TextEdit::InputRecording recording;
+    std::string workload;
+    if (recordingPath) {
+        std::vector<unsigned char> data;
+        if (!ReadWholeFile(recordingPath, data) || !recording.Load(data)) {
+            return 1;
+        }
+        workload = recordingPath;
+    }
+    else if (notches != 0) {
+        if (width != 0 && height != 0) {
+            recording.SetScreenSize(width, height);
+        }
+        InputEvent wheel;
+        memset(&wheel, 0, sizeof(wheel));
+        wheel.type = InputEvent::Type::MOUSE_WHEEL;
+        wheel.mouse.delta = REPLAY_WHEEL_DELTA;
+        wheel.mouse.x = static_cast<int>(recording.GetScreenWidth() / 2); // Over the document
+        wheel.mouse.y = static_cast<int>(recording.GetScreenHeight() / 2);
+        for (unsigned int i = 0; i < notches; ++i) {
+            wheel.time = static_cast<unsigned long>(i * REPLAY_SCROLL_INTERVAL * 1000.0);
+            recording.Add(i * REPLAY_SCROLL_INTERVAL, wheel);
+        }
+        workload = "scroll " + std::to_string(notches) + " notches";
+    }
+    else {
+        std::u32string text;
+        const std::u32string sample = U"value = value * 31 + 7; // typed\n";
+        for (unsigned int i = 0; i < characters; ++i) {
+            text += sample[i % sample.length()];
+        }
+        recording.AddTyping(text, 0.0, REPLAY_TYPING_INTERVAL);
+        workload = "type " + std::to_string(characters) + " characters";
+    }
+    if (width != 0 && height != 0) {
+        recording.SetScreenSize(width, height);
+    }
+
+    std::string documentName, documentLabel;
+    std::vector<unsigned char> documentData;
+    if (documentPath) {
+        if (!ReadWholeFile(documentPath, documentData)) {
+            return 1;
+        }
+        documentName = documentPath;
+        documentLabel = documentPath;
+    }
+    else {
+        std::string text;
+        MakeBenchmarkDocument(lines, text);
+        documentData.assign(text.begin(), text.end());
+        documentName = "replay.cpp";
+        documentLabel = std::to_string(lines) + " generated lines";
+    }
+
+    std::shared_ptr<TextEdit::SoftwareGLBackend> gl = TextEdit::SoftwareGLBackend::Create(recording.GetScreenWidth(), recording.GetScreenHeight());
+    SetAsyncGlyphRasterization(false);
+    if (!Initialize(1.0f, gl)) {
+        printf("Failed to initialize\n");
+        return 1;
+    }
+    OnFileDropped(documentName.c_str(), documentData.data(), static_cast<unsigned int>(documentData.size()));
+
+    TextEdit::InputReplay::Result result;
+    TextEdit::InputReplay::Run(recording, result);
+    std::string name = workload + " into " + documentLabel;
+    TextEdit::InputReplay::PrintReport(name.c_str(), result);
+
+    Shutdown();
+    return 0;
+}
@@ -9,6 +9,7 @@
 #include <chrono>
 #include <thread>
 #include <cstring>
+#include <algorithm>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -17,6 +18,9 @@
 #endif
 
 #include "Renderer.h"
+#ifndef __EMSCRIPTEN__
+#include "SoftwareGLBackend.h" // The web build always draws with WebGL
+#endif
 
 #ifdef _WIN32
 #include "glad.h"
@@ -32,6 +36,10 @@
 // Global variables
 SDL_Window* g_window = nullptr;
 SDL_GLContext g_glContext = nullptr;
+bool g_softwareRendering = false; // --software-renderer, draws on the CPU and presents through the window surface
+#ifndef __EMSCRIPTEN__
+std::shared_ptr<TextEdit::SoftwareGLBackend> g_softwareGL;
+#endif
 bool g_running = true;
 bool g_isMaximized = false;
 bool g_isDragging = false;
@@ -50,6 +58,9 @@ float GetWindowScaleFactor(SDL_Window* window);
 void ProcessSDLEvent(const SDL_Event& e);
 void EnableFileDrops(SDL_Window* window);
 void MainLoop();
+void GetDrawableSize(int* width, int* height);
+void PrepareFrame(int width, int height);
+void PresentFrame();
 
 // Platform-specific functions
 void OnApplicationCloseButtonClicked() {
@@ -164,6 +175,8 @@ unsigned int SDLKeyToVK(SDL_Keycode key) {
     case SDLK_END: return 0x23; // VK_END
     case SDLK_PAGEUP: return 0x21; // VK_PRIOR
     case SDLK_PAGEDOWN: return 0x22; // VK_NEXT
+    case SDLK_LEFTBRACKET: return 0xDB; // VK_OEM_4
+    case SDLK_RIGHTBRACKET: return 0xDD; // VK_OEM_6
     case SDLK_LSHIFT:
     case SDLK_RSHIFT: return 0x10; // VK_SHIFT
     case SDLK_LCTRL:
@@ -325,6 +338,7 @@ void ProcessSDLEvent(const SDL_Event& e) {
 
     case SDL_WINDOWEVENT:
         if (e.window.windowID == g_windowID) {
+            RequestRedraw(); // Exposed, resized, restored, etc. all need a fresh frame
             switch (e.window.event) {
             case SDL_WINDOWEVENT_CLOSE:
                 g_running = false;
@@ -333,15 +347,18 @@ void ProcessSDLEvent(const SDL_Event& e) {
             {
                 // Get the drawable size for proper HDPI rendering
                 int drawableW, drawableH;
-                SDL_GL_GetDrawableSize(g_window, &drawableW, &drawableH);
+                GetDrawableSize(&drawableW, &drawableH);
                 static Uint64 lastResizeTime = 0;
                 Uint64 currentTime = SDL_GetPerformanceCounter();
                 Uint64 freq = SDL_GetPerformanceFrequency();
 
                 // Only tick if 16ms have passed since last resize
                 if ((currentTime - lastResizeTime) > (freq / 60)) {
+                    PrepareFrame(drawableW, drawableH);
                     Tick(drawableW, drawableH, 0.0f);
-                    SDL_GL_SwapWindow(g_window);
+                    if (FrameWasDrawn()) {
+                        PresentFrame();
+                    }
                     lastResizeTime = currentTime;
                 }
             }
@@ -558,6 +575,9 @@ void CreateSDL2Window(int width, int height, const char* title) {
 
     // Create window with HDPI support
     Uint32 windowFlags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI;
+    if (g_softwareRendering) {
+        windowFlags = SDL_WINDOW_RESIZABLE; // Presented through the window surface, which is never high DPI
+    }
 
 #ifdef __EMSCRIPTEN__
     // For Emscripten, let the canvas size determine the window size
@@ -588,17 +608,27 @@ void CreateSDL2Window(int width, int height, const char* title) {
 
     g_windowID = SDL_GetWindowID(g_window);
 
-    // Create OpenGL context
-    g_glContext = SDL_GL_CreateContext(g_window);
-    if (!g_glContext) {
-        SDL_DestroyWindow(g_window);
-        FatalError("SDL_GL_CreateContext failed: " + std::string(SDL_GetError()));
+#ifndef __EMSCRIPTEN__
+    if (g_softwareRendering) {
+        int windowW, windowH;
+        SDL_GetWindowSize(g_window, &windowW, &windowH);
+        g_softwareGL = TextEdit::SoftwareGLBackend::Create(windowW, windowH);
     }
+    else
+#endif
+    {
+        // Create OpenGL context
+        g_glContext = SDL_GL_CreateContext(g_window);
+        if (!g_glContext) {
+            SDL_DestroyWindow(g_window);
+            FatalError("SDL_GL_CreateContext failed: " + std::string(SDL_GetError()));
+        }
 
-    if (SDL_GL_MakeCurrent(g_window, g_glContext) < 0) {
-        SDL_GL_DeleteContext(g_glContext);
-        SDL_DestroyWindow(g_window);
-        FatalError("SDL_GL_MakeCurrent failed: " + std::string(SDL_GetError()));
+        if (SDL_GL_MakeCurrent(g_window, g_glContext) < 0) {
+            SDL_GL_DeleteContext(g_glContext);
+            SDL_DestroyWindow(g_window);
+            FatalError("SDL_GL_MakeCurrent failed: " + std::string(SDL_GetError()));
+        }
     }
 
     // Enable file drops
@@ -617,6 +647,9 @@ void CreateSDL2Window(int width, int height, const char* title) {
 }
 
 void CleanupSDL2Window() {
+#ifndef __EMSCRIPTEN__
+    g_softwareGL = nullptr;
+#endif
     if (g_glContext) {
         SDL_GL_DeleteContext(g_glContext);
         g_glContext = nullptr;
@@ -630,6 +663,9 @@ void CleanupSDL2Window() {
 
 void InitGlad() {
 #ifndef __EMSCRIPTEN__
+    if (g_softwareRendering) {
+        return; // No GL context to load functions from
+    }
     int version = gladLoadGL();
     if (version == 0) {
         FatalError("Failed to initialize GLAD (gladLoadGL returned 0).\n"
@@ -664,6 +700,17 @@ void PreciseSleep(double milliseconds) {
 
 void MainLoop() {
     SDL_Event event;
+#ifndef __EMSCRIPTEN__
+    // Sleep until there is input, or until the application has timed work (cursor blink,
+    // incremental highlighting). The browser drives the emscripten loop, so it can't block.
+    if (!HasPendingRedraw()) {
+        int timeout = GetIdleTimeoutMs();
+        int hasEvent = (timeout < 0) ? SDL_WaitEvent(&event) : SDL_WaitEventTimeout(&event, timeout);
+        if (hasEvent) {
+            ProcessSDLEvent(event);
+        }
+    }
+#endif
     while (SDL_PollEvent(&event)) {
         ProcessSDLEvent(event);
     }
@@ -679,9 +726,10 @@ void MainLoop() {
 
     // Get the actual drawable size for rendering
     int drawableWidth, drawableHeight;
-    SDL_GL_GetDrawableSize(g_window, &drawableWidth, &drawableHeight);
+    GetDrawableSize(&drawableWidth, &drawableHeight);
 
     if (drawableWidth > 0 && drawableHeight > 0) {
+        PrepareFrame(drawableWidth, drawableHeight);
         if (!Tick(drawableWidth, drawableHeight, g_deltaTime)) {
             g_running = false;
 #ifdef __EMSCRIPTEN__
@@ -690,10 +738,65 @@ void MainLoop() {
         }
     }
 
-    SDL_GL_SwapWindow(g_window);
+    // Tick skips drawing when nothing changed, presenting then would show a stale back buffer
+    if (FrameWasDrawn()) {
+        PresentFrame();
+#ifndef __EMSCRIPTEN__
+        SDL_Delay(1);
+#endif
+    }
+}
 
+void GetDrawableSize(int* width, int* height) {
+    if (g_softwareRendering) {
+        SDL_GetWindowSize(g_window, width, height);
+    }
+    else {
+        SDL_GL_GetDrawableSize(g_window, width, height);
+    }
+}
+
+void PrepareFrame(int width, int height) {
 #ifndef __EMSCRIPTEN__
-    SDL_Delay(1);
+    if (g_softwareGL && (g_softwareGL->GetWidth() != static_cast<unsigned int>(width) ||
+        g_softwareGL->GetHeight() != static_cast<unsigned int>(height))) {
+        g_softwareGL->Resize(width, height);
+        RequestRedraw();
+    }
+#else
+    (void)width; // The canvas is the drawable
+    (void)height;
+#endif
+}
+
+void PresentFrame() {
+#ifdef __EMSCRIPTEN__
+    SDL_GL_SwapWindow(g_window);
+#else
+    if (!g_softwareGL) {
+        SDL_GL_SwapWindow(g_window);
+        return;
+    }
+
+    SDL_Surface* surface = SDL_GetWindowSurface(g_window);
+    if (!surface) {
+        return;
+    }
+    int width = std::min(surface->w, static_cast<int>(g_softwareGL->GetWidth()));
+    int height = std::min(surface->h, static_cast<int>(g_softwareGL->GetHeight()));
+    int sourcePitch = static_cast<int>(g_softwareGL->GetWidth()) * 4;
+    const unsigned char* pixels = g_softwareGL->GetPixels();
+
+    // The backend's rows are bottom up, like glReadPixels
+    SDL_LockSurface(surface);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* sourceRow = pixels + static_cast<size_t>(g_softwareGL->GetHeight() - 1 - y) * sourcePitch;
+        unsigned char* destRow = static_cast<unsigned char*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch;
+        SDL_ConvertPixels(width, 1, SDL_PIXELFORMAT_ABGR8888, sourceRow, sourcePitch,
+            surface->format->format, destRow, surface->pitch);
+    }
+    SDL_UnlockSurface(surface);
+    SDL_UpdateWindowSurface(g_window);
 #endif
 }
 
@@ -723,15 +826,31 @@ int main(int argc, char* argv[]) {
     unsigned int windowWidth = 1280;
     unsigned int windowHeight = 720;
 
+#if defined(_WIN32)
+    g_softwareRendering = (strstr(lpCmdLine, "--software-renderer") != nullptr);
+#elif !defined(__EMSCRIPTEN__)
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--software-renderer") == 0) {
+            g_softwareRendering = true;
+        }
+    }
+#endif
+
     CreateSDL2Window(windowWidth, windowHeight, "Carrot.Code");
     InitGlad();
 
     // Get actual drawable size for OpenGL viewport
     int drawableWidth, drawableHeight;
-    SDL_GL_GetDrawableSize(g_window, &drawableWidth, &drawableHeight);
+    GetDrawableSize(&drawableWidth, &drawableHeight);
 
-    glViewport(0, 0, drawableWidth, drawableHeight);
+    if (!g_softwareRendering) {
+        glViewport(0, 0, drawableWidth, drawableHeight);
+    }
+#ifdef __EMSCRIPTEN__
     if (!Initialize(GetWindowScaleFactor(g_window))) {
+#else
+    if (!Initialize(GetWindowScaleFactor(g_window), g_softwareGL)) {
+#endif
         g_running = false;
     }
 
@@ -176,6 +176,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
 	MSG msg = { 0 };
 	while (g_running) {
+		// Sleep until there is input, or until the application has timed work (cursor blink,
+		// incremental highlighting). An idle editor shouldn't keep a core busy.
+		if (!HasPendingRedraw()) {
+			int timeout = GetIdleTimeoutMs();
+			MsgWaitForMultipleObjectsEx(0, NULL, (timeout < 0) ? INFINITE : (DWORD)timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		}
+
 		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
 			if (msg.message == WM_QUIT) {
 				g_running = false;
@@ -203,9 +210,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 			}
 		}
 
-		SwapBuffers(g_hDC);
-		Sleep(1);
-		//PreciseSleep(5);
+		// Tick skips drawing when nothing changed, presenting then would show a stale back buffer
+		if (FrameWasDrawn()) {
+			SwapBuffers(g_hDC);
+			Sleep(1);
+			//PreciseSleep(5);
+		}
 	}
 
 	Shutdown();
@@ -243,10 +253,18 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 		//}
 		if (created) {
 			// TODO: ONLY TICK IF 16 ms passed
+			RequestRedraw();
 			Tick(LOWORD(lParam), HIWORD(lParam), 0.0f);
-			SwapBuffers(g_hDC);
+			if (FrameWasDrawn()) {
+				SwapBuffers(g_hDC);
+			}
 		}
 		break;
+	case WM_PAINT:
+		// Window was uncovered or restored, the next loop iteration re-draws it.
+		// DefWindowProc validates the update region.
+		RequestRedraw();
+		break;
 	case WM_ERASEBKGND:
 		//SwapBuffers(g_hDC);
 		return 1; // Indicate we "handled" background erase (by doing nothing)
@@ -0,0 +1,271 @@
+#include "Minimap.h"
+#include "Styles.h"
+#include <cmath>
+
+namespace TextEdit {
+    static constexpr unsigned int MINIMAP_TILE_LINES = 128;
+    static constexpr unsigned int MINIMAP_LINE_PIXELS = 2;
+    static constexpr size_t MINIMAP_MAX_RESIDENT_TILES = 24; // A screenful is a handful of tiles, keep some around for scrolling back
+    static constexpr unsigned char MINIMAP_ALPHA = 190;
+
+    std::shared_ptr<Minimap> Minimap::Create(std::shared_ptr<Renderer> renderer, std::shared_ptr<Document> doc, std::shared_ptr<Font> font) {
+        return std::make_shared<Minimap>(renderer, doc, font);
+    }
+
+    Minimap::Minimap(std::shared_ptr<Renderer> renderer, std::shared_ptr<Document> doc, std::shared_ptr<Font> font)
+        : mRenderer(renderer), mDocument(doc), mFont(font),
+        mTextureWidth(0), mFrame(0),
+        mFirstLine(0.0f), mSliderRange(0.0f), mMaxScrollY(0.0f), mVisibleHeight(0.0f), mLineHeight(0.0f) {
+    }
+
+    Minimap::~Minimap() {
+        for (Tile& tile : mTiles) {
+            ReleaseTile(tile);
+        }
+    }
+
+    void Minimap::InvalidateLines(unsigned int firstLine, unsigned int lastLine) {
+        if (mTiles.empty() || firstLine > lastLine) {
+            return;
+        }
+
+        unsigned int firstTile = firstLine / MINIMAP_TILE_LINES;
+        unsigned int lastTile = std::min(lastLine / MINIMAP_TILE_LINES, static_cast<unsigned int>(mTiles.size() - 1));
+        for (unsigned int i = firstTile; i <= lastTile; ++i) {
+            mTiles[i].dirty = true;
+        }
+
+        // Damage only the rows of the lines that are on screen
+        if (mArea.width > 0.0f && mArea.height > 0.0f) {
+            float top = mArea.y + (static_cast<float>(firstLine) - mFirstLine) * MINIMAP_LINE_PIXELS;
+            float bottom = mArea.y + (static_cast<float>(lastLine) + 1.0f - mFirstLine) * MINIMAP_LINE_PIXELS;
+            top = std::max(top, mArea.y);
+            bottom = std::min(bottom, mArea.y + mArea.height);
+            if (bottom > top) {
+                mRenderer->Invalidate(mArea.x, top, mArea.width, bottom - top);
+            }
+        }
+    }
+
+    void Minimap::InvalidateAll() {
+        for (Tile& tile : mTiles) {
+            tile.dirty = true;
+        }
+        if (mArea.width > 0.0f && mArea.height > 0.0f) {
+            mRenderer->Invalidate(mArea);
+        }
+    }
+
+    void Minimap::Display(const Rect& area, float scrollY, float visibleHeight, float lineHeight, bool highlightSlider) {
+        mFrame += 1;
+        mArea = area;
+        mVisibleHeight = visibleHeight;
+        mLineHeight = lineHeight;
+
+        unsigned int lineCount = mDocument->GetLineCount();
+        if (area.width <= 0.0f || area.height <= 0.0f || lineHeight <= 0.0f || lineCount == 0) {
+            return;
+        }
+
+        // A new width changes the texture size, start over
+        unsigned int textureWidth = static_cast<unsigned int>(std::ceil(area.width));
+        if (textureWidth != mTextureWidth) {
+            for (Tile& tile : mTiles) {
+                ReleaseTile(tile);
+            }
+            mResidentTiles.clear();
+            mTextureWidth = textureWidth;
+        }
+
+        unsigned int tileCount = (lineCount + MINIMAP_TILE_LINES - 1) / MINIMAP_TILE_LINES;
+        if (mTiles.size() > tileCount) {
+            for (size_t i = tileCount; i < mTiles.size(); ++i) {
+                ReleaseTile(mTiles[i]);
+            }
+            mResidentTiles.erase(std::remove_if(mResidentTiles.begin(), mResidentTiles.end(),
+                [tileCount](unsigned int index) { return index >= tileCount; }), mResidentTiles.end());
+        }
+        mTiles.resize(tileCount, Tile{ 0, true, 0 });
+
+        // Place the slider. When the document is taller than the minimap, the minimap scrolls too,
+        // so that the slider reaches the bottom of the minimap when the view reaches the bottom of the document.
+        float contentHeight = static_cast<float>(lineCount) * MINIMAP_LINE_PIXELS;
+        float sliderHeight = std::min(visibleHeight / lineHeight * MINIMAP_LINE_PIXELS, area.height);
+        mMaxScrollY = std::max(0.0f, static_cast<float>(lineCount) * lineHeight - visibleHeight);
+        mSliderRange = std::max(0.0f, std::min(contentHeight, area.height) - sliderHeight);
+
+        float scrollRatio = mMaxScrollY > 0.0f ? std::max(0.0f, std::min(scrollY / mMaxScrollY, 1.0f)) : 0.0f;
+        if (contentHeight <= area.height) {
+            mFirstLine = 0.0f;
+        }
+        else {
+            mFirstLine = scrollRatio * (static_cast<float>(lineCount) - area.height / MINIMAP_LINE_PIXELS);
+        }
+        mSliderRect = Rect(area.x, area.y + scrollRatio * mSliderRange, area.width, sliderHeight);
+
+        mRenderer->SetClip(area.x, area.y, area.width, area.height);
+
+        const Styles::Color& sliderColor = highlightSlider ? Styles::ScrollbarNibColor : Styles::ScrollbarTrackColor;
+        mRenderer->DrawRect(mSliderRect.x, mSliderRect.y, mSliderRect.width, mSliderRect.height, sliderColor.r, sliderColor.g, sliderColor.b);
+
+        unsigned int firstTile = static_cast<unsigned int>(mFirstLine) / MINIMAP_TILE_LINES;
+        unsigned int lastLine = std::min(lineCount - 1, static_cast<unsigned int>(mFirstLine + area.height / MINIMAP_LINE_PIXELS));
+        unsigned int lastTile = lastLine / MINIMAP_TILE_LINES;
+
+        for (unsigned int i = firstTile; i <= lastTile && i < mTiles.size(); ++i) {
+            Tile& tile = mTiles[i];
+            if (tile.dirty || tile.texture == 0) {
+                RasterizeTile(i);
+            }
+            tile.lastUsedFrame = mFrame;
+
+            // Whole pixels, so the nearest filtered texture doesn't shimmer while scrolling
+            float tileY = std::floor(area.y + (static_cast<float>(i * MINIMAP_TILE_LINES) - mFirstLine) * MINIMAP_LINE_PIXELS + 0.5f);
+            mRenderer->DrawImage(tile.texture, area.x, tileY,
+                static_cast<float>(mTextureWidth), static_cast<float>(MINIMAP_TILE_LINES * MINIMAP_LINE_PIXELS));
+        }
+
+        mRenderer->ClearClip();
+
+        EvictTiles();
+    }
+
+    bool Minimap::Contains(float x, float y) const {
+        return mArea.width > 0.0f && mArea.Contains(x, y);
+    }
+
+    const Rect& Minimap::GetSliderRect() const {
+        return mSliderRect;
+    }
+
+    float Minimap::GetScrollForSlider(float sliderY) const {
+        if (mSliderRange <= 0.0f) {
+            return 0.0f;
+        }
+        float ratio = std::max(0.0f, std::min((sliderY - mArea.y) / mSliderRange, 1.0f));
+        return ratio * mMaxScrollY;
+    }
+
+    float Minimap::GetScrollForClick(float y) const {
+        float line = mFirstLine + (y - mArea.y) / MINIMAP_LINE_PIXELS;
+        float scroll = line * mLineHeight - mVisibleHeight / 2.0f;
+        return std::max(0.0f, std::min(scroll, mMaxScrollY));
+    }
+
+    void Minimap::SummarizeLine(unsigned int line) {
+        mRuns.clear();
+
+        const Document::Line& lineObj = mDocument->GetLine(line);
+        const std::u32string& text = lineObj.text;
+        bool useTokens = mDocument->GetHighlighter() == Highlighter::Code && !lineObj.tokens.empty();
+        unsigned int tabColumns = mFont ? mFont->GetTabNumSpaces() : 4;
+
+        size_t tokenIndex = 0;
+        unsigned int column = 0;
+        for (size_t i = 0; i < text.size() && column < mTextureWidth; ++i) {
+            char32_t c = text[i];
+            if (c == U'\t') {
+                column += tabColumns; // Matches the fixed width tabs of Renderer::DrawText
+                continue;
+            }
+            if (c == U' ') {
+                column += 1;
+                continue;
+            }
+
+            TokenType type = TokenType::Normal;
+            if (useTokens) {
+                while (tokenIndex + 1 < lineObj.tokens.size() && lineObj.tokens[tokenIndex + 1].second <= static_cast<int>(i)) {
+                    tokenIndex += 1;
+                }
+                if (lineObj.tokens[tokenIndex].second <= static_cast<int>(i)) {
+                    type = lineObj.tokens[tokenIndex].first;
+                }
+            }
+
+            if (!mRuns.empty() && mRuns.back().end == column && mRuns.back().type == type) {
+                mRuns.back().end = column + 1;
+            }
+            else {
+                mRuns.push_back({ column, column + 1, type });
+            }
+            column += 1;
+        }
+    }
+
+    void Minimap::RasterizeTile(unsigned int tileIndex) {
+        Tile& tile = mTiles[tileIndex];
+        const unsigned int tileHeight = MINIMAP_TILE_LINES * MINIMAP_LINE_PIXELS;
+        mPixels.assign(static_cast<size_t>(mTextureWidth) * tileHeight * 4, 0);
+
+        unsigned int firstLine = tileIndex * MINIMAP_TILE_LINES;
+        unsigned int endLine = std::min(firstLine + MINIMAP_TILE_LINES, mDocument->GetLineCount());
+        for (unsigned int line = firstLine; line < endLine; ++line) {
+            SummarizeLine(line);
+
+            unsigned int row = (line - firstLine) * MINIMAP_LINE_PIXELS;
+            for (const Run& run : mRuns) {
+                auto style = Styles::style_map.find(run.type);
+                const Styles::Color& color = style != Styles::style_map.end() ? style->second : Styles::TextColor;
+                unsigned char r = static_cast<unsigned char>(color.r * 255.0f);
+                unsigned char g = static_cast<unsigned char>(color.g * 255.0f);
+                unsigned char b = static_cast<unsigned char>(color.b * 255.0f);
+
+                unsigned int end = std::min(run.end, mTextureWidth);
+                for (unsigned int y = row; y < row + MINIMAP_LINE_PIXELS; ++y) {
+                    unsigned char* pixel = &mPixels[(static_cast<size_t>(y) * mTextureWidth + run.start) * 4];
+                    for (unsigned int x = run.start; x < end; ++x) {
+                        pixel[0] = r;
+                        pixel[1] = g;
+                        pixel[2] = b;
+                        pixel[3] = MINIMAP_ALPHA;
+                        pixel += 4;
+                    }
+                }
+            }
+        }
+
+        GLBackend& gl = mRenderer->GetGL();
+        if (tile.texture == 0) {
+            gl.GenTextures(1, &tile.texture);
+            gl.BindTexture(GL_TEXTURE_2D, tile.texture);
+            gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            gl.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mTextureWidth, tileHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, mPixels.data());
+            mResidentTiles.push_back(tileIndex);
+        }
+        else {
+            gl.BindTexture(GL_TEXTURE_2D, tile.texture);
+            gl.TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mTextureWidth, tileHeight, GL_RGBA, GL_UNSIGNED_BYTE, mPixels.data());
+        }
+        gl.BindTexture(GL_TEXTURE_2D, 0);
+
+        tile.dirty = false;
+    }
+
+    void Minimap::EvictTiles() {
+        while (mResidentTiles.size() > MINIMAP_MAX_RESIDENT_TILES) {
+            size_t oldest = 0;
+            for (size_t i = 1; i < mResidentTiles.size(); ++i) {
+                if (mTiles[mResidentTiles[i]].lastUsedFrame < mTiles[mResidentTiles[oldest]].lastUsedFrame) {
+                    oldest = i;
+                }
+            }
+            if (mTiles[mResidentTiles[oldest]].lastUsedFrame == mFrame) {
+                break; // Everything left is on screen
+            }
+            ReleaseTile(mTiles[mResidentTiles[oldest]]);
+            mResidentTiles.erase(mResidentTiles.begin() + oldest);
+        }
+    }
+
+    void Minimap::ReleaseTile(Tile& tile) {
+        if (tile.texture != 0) {
+            mRenderer->GetGL().DeleteTextures(1, &tile.texture);
+            tile.texture = 0;
+        }
+        tile.dirty = true;
+    }
+}
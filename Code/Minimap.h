@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Renderer.h"
+#include "Document.h"
+#include "Font.h"
+
+namespace TextEdit {
+    // Zoomed out overview of a document, drawn next to the vertical scrollbar.
+    // Every line is a couple of pixels tall and every character a pixel wide, colored by its token.
+    // Lines are rasterized into tile textures that are only rebuilt when one of their lines changes,
+    // so drawing and scrolling cost the same no matter how long the document is.
+    class Minimap {
+    protected:
+        struct Tile {
+            GLuint texture;
+            bool dirty;
+            unsigned int lastUsedFrame;
+        };
+
+        // One pixel run of a line, in minimap pixels
+        struct Run {
+            unsigned int start;
+            unsigned int end;
+            TokenType type;
+        };
+
+        std::shared_ptr<Renderer> mRenderer;
+        std::shared_ptr<Document> mDocument;
+        std::shared_ptr<Font> mFont;
+
+        std::vector<Tile> mTiles;
+        std::vector<unsigned int> mResidentTiles; // Tiles that own a texture, capped so long files don't fill VRAM
+        unsigned int mTextureWidth;
+        unsigned int mFrame;
+
+        // Layout from the last Display, used for hit testing and drag
+        Rect mArea;
+        Rect mSliderRect;
+        float mFirstLine; // Document line at the top of the minimap, fractional
+        float mSliderRange; // How far the slider can travel
+        float mMaxScrollY;
+        float mVisibleHeight;
+        float mLineHeight;
+
+        std::vector<unsigned char> mPixels; // Scratch RGBA buffer for rasterizing one tile
+        std::vector<Run> mRuns;        // Scratch buffer for one line's summary
+
+        Minimap(const Minimap&) = delete;
+        Minimap& operator=(const Minimap&) = delete;
+    public:
+        Minimap(std::shared_ptr<Renderer> renderer, std::shared_ptr<Document> doc, std::shared_ptr<Font> font);
+        static std::shared_ptr<Minimap> Create(std::shared_ptr<Renderer> renderer, std::shared_ptr<Document> doc, std::shared_ptr<Font> font);
+        virtual ~Minimap();
+
+        // Lines that changed since they were last drawn, their tiles are rebuilt the next time they are on screen.
+        // If any of them are on screen right now, the minimap area is damaged.
+        void InvalidateLines(unsigned int firstLine, unsigned int lastLine);
+        void InvalidateAll();
+
+        // scrollY, visibleHeight and lineHeight describe the text view, they place the slider
+        void Display(const Rect& area, float scrollY, float visibleHeight, float lineHeight, bool highlightSlider);
+
+        bool Contains(float x, float y) const;
+        const Rect& GetSliderRect() const;
+
+        // Scroll position for the text view that puts the top of the slider at sliderY
+        float GetScrollForSlider(float sliderY) const;
+        // Scroll position for the text view that centers the line under y in the minimap
+        float GetScrollForClick(float y) const;
+    protected:
+        void SummarizeLine(unsigned int line);
+        void RasterizeTile(unsigned int tileIndex);
+        void EvictTiles();
+        void ReleaseTile(Tile& tile);
+    };
+}
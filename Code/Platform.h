@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 typedef void(*PlatformSaveAsResult)(const char* path);
 extern "C" void PlatformSaveAs(const unsigned char* data, unsigned int size, PlatformSaveAsResult result);
@@ -15,6 +16,11 @@ void PlatformWriteClipboardU16(const std::wstring& text);
 std::wstring PlatformReadClipboardU16();
 extern "C" void PlatformSetNextSaveAsName(const char* filename);
 
+// Data the editor can rebuild but would rather not, like baked font atlases. Entries may vanish at
+// any time, keys are plain file names. Both return false when there is no cache to use.
+bool PlatformReadCache(const char* key, std::vector<unsigned char>& outData);
+bool PlatformWriteCache(const char* key, const unsigned char* data, unsigned int size);
+
 #ifndef __EMSCRIPTEN__
 typedef void PlatofrmHasFileResult(const char* url, bool result);
 extern "C" void PlatformHasFile(const char* url, PlatofrmHasFileResult callback);
@@ -0,0 +1,230 @@
+// Linux and other POSIX systems, without a window system. Dialogs can't be shown, so Save As writes
+// into the working directory, file selection is cancelled and questions are answered with no. The
+// clipboard only lives as long as the process. This is what the headless library and the benchmarks
+// are built with.
+#include "Platform.h"
+#include "Profiler.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static std::string gNextSaveAsName;
+static std::wstring gClipboard;
+
+// Writes all of data, pwrite may write less than asked for and may be interrupted
+static bool WriteAll(int fd, const unsigned char* data, unsigned int size) {
+    off_t offset = 0;
+    while (offset < static_cast<off_t>(size)) {
+        ssize_t written = pwrite(fd, data + offset, static_cast<size_t>(size - offset), offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += written;
+    }
+    return true;
+}
+
+static bool WriteWholeFile(const char* path, const unsigned char* data, unsigned int size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = WriteAll(fd, data, size);
+    if (close(fd) != 0) {
+        ok = false;
+    }
+    return ok;
+}
+
+extern "C" void PlatformSetNextSaveAsName(const char* filename) {
+    gNextSaveAsName = filename != 0 ? filename : "";
+}
+
+extern "C" void PlatformSaveAs(const unsigned char* data, unsigned int size, PlatformSaveAsResult result) {
+    PROFILE_SCOPE(FileWrite);
+    std::string path = gNextSaveAsName.empty() ? "untitled.txt" : gNextSaveAsName;
+    gNextSaveAsName.clear();
+
+    bool ok = WriteWholeFile(path.c_str(), data, size);
+    if (ok) {
+        printf("Saved %s\n", path.c_str());
+    }
+    else {
+        printf("Can't save %s: %s\n", path.c_str(), strerror(errno));
+    }
+    if (result != 0) {
+        result(ok ? path.c_str() : 0);
+    }
+}
+
+extern "C" void PlatformSelectFile(const char* /*filter*/, PlatformSelectFileResult result) {
+    if (result != 0) {
+        result(0, 0, 0);
+    }
+}
+
+extern "C" void PlatformYesNoAlert(const char* message, PlatformYesNoResult callback) {
+    printf("%s (answered no)\n", message);
+    if (callback != 0) {
+        callback(false);
+    }
+}
+
+void PlatformWriteClipboardU16(const std::wstring& text) {
+    gClipboard = text;
+}
+
+std::wstring PlatformReadClipboardU16() {
+    return gClipboard;
+}
+
+// $XDG_CACHE_HOME/CarrotCode, or ~/.cache/CarrotCode, created on first use
+static std::string GetCacheDirectory() {
+    std::string directory;
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (cacheHome != 0 && cacheHome[0] == '/') {
+        directory = cacheHome;
+    }
+    else if (home != 0 && home[0] != 0) {
+        directory = std::string(home) + "/.cache";
+        mkdir(directory.c_str(), 0755);
+    }
+    else {
+        return "";
+    }
+    directory += "/CarrotCode";
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        return "";
+    }
+    return directory + "/";
+}
+
+bool PlatformReadCache(const char* key, std::vector<unsigned char>& outData) {
+    PROFILE_SCOPE(FileRead);
+    std::string directory = GetCacheDirectory();
+    if (directory.empty()) {
+        return false;
+    }
+    int fd = open((directory + key).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    bool read = fstat(fd, &info) == 0 && info.st_size > 0;
+    if (read) {
+        outData.resize(static_cast<size_t>(info.st_size));
+        size_t offset = 0;
+        while (read && offset < outData.size()) {
+            ssize_t bytes = pread(fd, outData.data() + offset, outData.size() - offset, static_cast<off_t>(offset));
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            read = bytes > 0;
+            offset += read ? static_cast<size_t>(bytes) : 0;
+        }
+    }
+    close(fd);
+    if (!read) {
+        outData.clear();
+    }
+    return read;
+}
+
+bool PlatformWriteCache(const char* key, const unsigned char* data, unsigned int size) {
+    PROFILE_SCOPE(FileWrite);
+    std::string directory = GetCacheDirectory();
+    if (directory.empty()) {
+        return false;
+    }
+    std::string path = directory + key;
+    bool ok = WriteWholeFile(path.c_str(), data, size);
+    if (!ok) {
+        unlink(path.c_str()); // Half a cache entry is worse than none
+    }
+    return ok;
+}
+
+#ifndef __EMSCRIPTEN__
+extern "C" void PlatformHasFile(const char* url, PlatofrmHasFileResult callback) {
+    if (callback != 0) {
+        struct stat info;
+        callback(url, stat(url, &info) == 0);
+    }
+}
+
+extern "C" void PlatformWriteFile(const char* path, unsigned char* buffer, unsigned int size, PlatformWriteFileResult callback, void* userData, unsigned int /*userDataSize*/) {
+    PROFILE_SCOPE(FileWrite);
+    bool ok = WriteWholeFile(path, buffer, size);
+    if (callback != 0) {
+        callback(path, ok, userData);
+    }
+}
+
+// The file is mapped rather than read, only the pages the callback touches are faulted in. The
+// mapping is private and writable, callbacks get a void* and may scribble on it.
+extern "C" void PlatformReadFile(const char* path, PlatformReadFileResult callback) {
+    PROFILE_SCOPE(FileRead);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size > 0xFFFFFFFFll) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (callback) {
+            callback(path, 0, 0);
+        }
+        return;
+    }
+
+    if (info.st_size == 0) { // mmap can't map nothing
+        static unsigned char empty = 0;
+        close(fd);
+        if (callback) {
+            callback(path, &empty, 0);
+        }
+        return;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void* data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (data == MAP_FAILED) {
+        if (callback) {
+            callback(path, 0, 0);
+        }
+        return;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    if (callback) {
+        callback(path, data, static_cast<unsigned int>(size));
+    }
+    munmap(data, size);
+}
+
+// Nothing to close without a window
+void PlatformExit() {
+    exit(0);
+}
+#endif
+
+// The title bar buttons the application draws, there is no window for them to act on
+void OnApplicationCloseButtonClicked() {
+}
+
+void OnApplicationMaximizeButtonClicked() {
+}
+
+void OnApplicationRestoreButtonClicked() {
+}
+
+void OnApplicationMinimizeButtonClicked() {
+}
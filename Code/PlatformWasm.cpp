@@ -250,6 +250,53 @@ void PlatformWriteClipboardU16(const std::wstring& text) {
     }, utf8Text.c_str());
 }
 
+// IndexedDB would only answer after startup, localStorage is synchronous. Entries are base64.
+bool PlatformReadCache(const char* key, std::vector<unsigned char>& outData) {
+    int size = 0;
+    unsigned char* data = (unsigned char*)EM_ASM_PTR({
+        let encoded = null;
+        try {
+            encoded = window.localStorage.getItem("CarrotCode.cache." + UTF8ToString($0));
+        } catch (err) {
+            return 0;
+        }
+        if (!encoded) {
+            return 0;
+        }
+
+        const binary = atob(encoded);
+        const ptr = Module._AllocateMemory(binary.length);
+        for (let i = 0; i < binary.length; ++i) {
+            HEAPU8[ptr + i] = binary.charCodeAt(i);
+        }
+        HEAP32[$1 >> 2] = binary.length;
+        return ptr;
+    }, key, &size);
+
+    if (!data) {
+        return false;
+    }
+    outData.assign(data, data + size);
+    free(data);
+    return true;
+}
+
+bool PlatformWriteCache(const char* key, const unsigned char* data, unsigned int size) {
+    return EM_ASM_INT({
+        const bytes = HEAPU8.subarray($1, $1 + $2);
+        let binary = "";
+        for (let i = 0; i < bytes.length; i += 0x8000) {
+            binary += String.fromCharCode.apply(null, bytes.subarray(i, i + 0x8000));
+        }
+        try {
+            window.localStorage.setItem("CarrotCode.cache." + UTF8ToString($0), btoa(binary));
+            return 1;
+        } catch (err) {
+            return 0; // Over quota or storage is disabled
+        }
+    }, key, data, size) != 0;
+}
+
 std::wstring PlatformReadClipboardU16() {
     // Use native prompt dialog which blocks
     char* clipboardText = (char*)EM_ASM_PTR({
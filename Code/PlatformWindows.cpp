@@ -1,5 +1,6 @@
 #include <Windows.h>
 #include "Platform.h"
+#include "Profiler.h"
 #include <cstring>
 #include <iostream>
 #include <algorithm>
@@ -204,6 +205,7 @@ extern "C" void PlatformSelectFile(const char* filter, PlatformSelectFileResult
 }
 
 extern "C" void PlatformWriteFile(const char* path, unsigned char* buffer, unsigned int size, PlatformWriteFileResult callback, void* userData, unsigned int userDataSize) {
+    PROFILE_SCOPE(FileWrite);
     DWORD written = 0;
     bool called = false;
 
@@ -237,6 +239,7 @@ extern "C" void PlatformWriteFile(const char* path, unsigned char* buffer, unsig
 }
 
 extern "C" void PlatformReadFile(const char* path, PlatformReadFileResult callback) {
+    PROFILE_SCOPE(FileRead);
     HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
     if (hFile == INVALID_HANDLE_VALUE) {
         if (callback) {
@@ -267,6 +270,64 @@ void PlatformExit() {
     SendMessageA(GetActiveWindow(), WM_CLOSE, 0, 0);
 }
 
+// %LOCALAPPDATA%\CarrotCode\Cache, created on first use
+static std::string GetCacheDirectory() {
+    char localAppData[MAX_PATH];
+    DWORD length = GetEnvironmentVariableA("LOCALAPPDATA", localAppData, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return "";
+    }
+    std::string directory = std::string(localAppData) + "\\CarrotCode";
+    CreateDirectoryA(directory.c_str(), NULL);
+    directory += "\\Cache";
+    CreateDirectoryA(directory.c_str(), NULL);
+    return directory + "\\";
+}
+
+bool PlatformReadCache(const char* key, std::vector<unsigned char>& outData) {
+    PROFILE_SCOPE(FileRead);
+    std::string directory = GetCacheDirectory();
+    if (directory.empty()) {
+        return false;
+    }
+    HANDLE hFile = CreateFileA((directory + key).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD bytesInFile = GetFileSize(hFile, 0);
+    DWORD bytesRead = 0;
+    bool read = bytesInFile != INVALID_FILE_SIZE && bytesInFile > 0;
+    if (read) {
+        outData.resize(bytesInFile);
+        read = ReadFile(hFile, outData.data(), bytesInFile, &bytesRead, NULL) != 0 && bytesRead == bytesInFile;
+    }
+    CloseHandle(hFile);
+    if (!read) {
+        outData.clear();
+    }
+    return read;
+}
+
+bool PlatformWriteCache(const char* key, const unsigned char* data, unsigned int size) {
+    PROFILE_SCOPE(FileWrite);
+    std::string directory = GetCacheDirectory();
+    if (directory.empty()) {
+        return false;
+    }
+    std::string path = directory + key;
+    HANDLE hFile = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD written = 0;
+    bool ok = WriteFile(hFile, data, (DWORD)size, &written, NULL) != 0 && written == size;
+    CloseHandle(hFile);
+    if (!ok) {
+        DeleteFileA(path.c_str()); // Half a cache entry is worse than none
+    }
+    return ok;
+}
+
 extern "C" void PlatformHasFile(const char* url, PlatofrmHasFileResult callback) {
     if (callback != 0) {
         DWORD attributes = GetFileAttributesA(url);
@@ -0,0 +1,327 @@
+#include "Profiler.h"
+#include "Renderer.h"
+#include "Font.h"
+#include "Styles.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+namespace TextEdit {
+    static constexpr unsigned int PROFILER_AVERAGE_FRAMES = 60; // The numbers are averaged over this many frames
+    static constexpr float PROFILER_GRAPH_SECONDS = 1.0f / 30.0f; // Graph height
+    static constexpr float PROFILER_TARGET_SECONDS = 1.0f / 60.0f; // Drawn as a line across the graph
+    static constexpr float PROFILER_GRAPH_HEIGHT = 64.0f;
+    static constexpr float PROFILER_PADDING = 6.0f;
+
+    // A debugging aid, so these are not part of the themes in Styles
+    static const Styles::Color PROFILER_BACKGROUND_COLOR = { 0.08f, 0.08f, 0.1f };
+    static const Styles::Color PROFILER_TEXT_COLOR = { 0.85f, 0.85f, 0.85f };
+    static const Styles::Color PROFILER_OTHER_COLOR = { 0.35f, 0.35f, 0.4f }; // Frame time outside of every scope
+    static const Styles::Color PROFILER_TARGET_COLOR = { 0.8f, 0.25f, 0.25f };
+    static const Styles::Color PROFILER_SCOPE_COLORS[Profiler::SCOPE_COUNT] = {
+        { 0.3f, 0.6f, 0.9f },   // ContainerUpdate
+        { 0.4f, 0.8f, 0.4f },   // ContainerDisplay
+        { 0.9f, 0.75f, 0.3f },  // DocumentViewDisplay
+        { 0.8f, 0.45f, 0.8f },  // Tokenize
+        { 0.6f, 0.5f, 0.95f },  // LineLayout
+        { 0.95f, 0.5f, 0.3f },  // GlyphBake
+        { 0.3f, 0.85f, 0.85f }, // RendererFlush
+        { 0.95f, 0.95f, 0.5f }, // InputDispatch
+        { 0.55f, 0.75f, 0.55f },// FileRead
+        { 0.75f, 0.55f, 0.55f },// FileWrite
+        { 0.9f, 0.4f, 0.55f },  // Script
+        { 0.85f, 0.65f, 0.45f } // GlyphRasterize
+    };
+
+    Profiler& Profiler::Get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    const char* Profiler::GetScopeName(Scope scope) {
+        switch (scope) {
+        case Scope::ContainerUpdate: return "Update";
+        case Scope::ContainerDisplay: return "Layout";
+        case Scope::DocumentViewDisplay: return "Document";
+        case Scope::Tokenize: return "Tokenize";
+        case Scope::LineLayout: return "Line layout";
+        case Scope::GlyphBake: return "Glyph bake";
+        case Scope::RendererFlush: return "GL flush";
+        case Scope::InputDispatch: return "Input";
+        case Scope::FileRead: return "File read";
+        case Scope::FileWrite: return "File write";
+        case Scope::Script: return "Script";
+        case Scope::GlyphRasterize: return "Glyph raster";
+        default: return "";
+        }
+    }
+
+    Profiler::Profiler() : mNextFrame(0), mFrameCount(0), mDepth(0), mUntimedDepth(0), mOverlayVisible(false),
+        mMainThread(std::this_thread::get_id()), mTracing(false), mTraceGeneration(0) {
+        mFrameStart = Clock::now();
+        mTraceStartNs.store(0, std::memory_order_relaxed);
+    }
+
+    void Profiler::BeginFrame() {
+        mFrameStart = Clock::now();
+    }
+
+    void Profiler::EndFrame(bool drawn) {
+        mCurrent.seconds = std::chrono::duration<float>(Clock::now() - mFrameStart).count();
+        mCurrent.drawn = drawn;
+        mHistory[mNextFrame] = mCurrent;
+        mNextFrame = (mNextFrame + 1) % HISTORY_FRAMES;
+        mFrameCount = std::min(mFrameCount + 1, HISTORY_FRAMES);
+        mCurrent = Frame();
+    }
+
+    void Profiler::BeginScope(Scope scope) {
+        if (std::this_thread::get_id() != mMainThread) {
+            return;
+        }
+        if (mDepth == MAX_SCOPE_DEPTH) {
+            mUntimedDepth += 1;
+            return;
+        }
+        OpenScope& open = mStack[mDepth++];
+        open.scope = scope;
+        open.childSeconds = 0.0f;
+    }
+
+    void Profiler::EndScope(Scope scope, Clock::time_point start) {
+        Clock::time_point end = Clock::now();
+        if (mTracing.load(std::memory_order_acquire)) {
+            AddTraceEvent(scope, start, end);
+        }
+
+        if (std::this_thread::get_id() != mMainThread) {
+            return;
+        }
+        if (mUntimedDepth > 0) {
+            mUntimedDepth -= 1;
+            return;
+        }
+        if (mDepth == 0) {
+            return;
+        }
+        const OpenScope& open = mStack[--mDepth];
+        float seconds = std::chrono::duration<float>(end - start).count();
+        mCurrent.scopeSeconds[static_cast<unsigned int>(open.scope)] += std::max(0.0f, seconds - open.childSeconds);
+        if (mDepth > 0) {
+            mStack[mDepth - 1].childSeconds += seconds;
+        }
+    }
+
+    void Profiler::Count(Counter counter, unsigned int amount) {
+        mCurrent.counters[static_cast<unsigned int>(counter)] += amount;
+    }
+
+    void Profiler::StartTrace() {
+        mTraceStartNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+        // Threads see the new generation on their next event and reset their own buffer
+        mTraceGeneration.fetch_add(1, std::memory_order_relaxed);
+        mTracing.store(true, std::memory_order_release);
+    }
+
+    void Profiler::StopTrace() {
+        mTracing.store(false, std::memory_order_release);
+    }
+
+    bool Profiler::IsTracing() const {
+        return mTracing.load(std::memory_order_relaxed);
+    }
+
+    Profiler::TraceBuffer* Profiler::GetThreadTraceBuffer() {
+        thread_local TraceBuffer* buffer = nullptr;
+        if (!buffer) {
+            std::unique_ptr<TraceBuffer> created(new TraceBuffer());
+            created->events.resize(TRACE_BUFFER_EVENTS);
+            created->count.store(0, std::memory_order_relaxed);
+            created->dropped.store(0, std::memory_order_relaxed);
+            created->generation.store(mTraceGeneration.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            created->thread = std::this_thread::get_id();
+
+            std::lock_guard<std::mutex> lock(mTraceBuffersMutex);
+            created->index = static_cast<unsigned int>(mTraceBuffers.size());
+            buffer = created.get();
+            mTraceBuffers.push_back(std::move(created));
+        }
+        return buffer;
+    }
+
+    void Profiler::AddTraceEvent(Scope scope, Clock::time_point start, Clock::time_point end) {
+        TraceBuffer* buffer = GetThreadTraceBuffer();
+        unsigned int generation = mTraceGeneration.load(std::memory_order_relaxed);
+        if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+            buffer->count.store(0, std::memory_order_relaxed);
+            buffer->dropped.store(0, std::memory_order_relaxed);
+            buffer->generation.store(generation, std::memory_order_release);
+        }
+        long long startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+        long long traceStartNs = mTraceStartNs.load(std::memory_order_relaxed);
+        if (startNs < traceStartNs) {
+            return; // Began before the trace did
+        }
+
+        unsigned int count = buffer->count.load(std::memory_order_relaxed);
+        if (count == TRACE_BUFFER_EVENTS) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        TraceEvent& event = buffer->events[count];
+        event.startNs = static_cast<uint64_t>(startNs - traceStartNs);
+        event.durationNs = static_cast<uint32_t>(std::min<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), UINT32_MAX));
+        event.scope = scope;
+        buffer->count.store(count + 1, std::memory_order_release); // Publishes the event to WriteTrace
+    }
+
+    void Profiler::WriteTrace(std::string& outJson) const {
+        unsigned int generation = mTraceGeneration.load(std::memory_order_relaxed);
+        char text[256];
+        outJson = "{\"traceEvents\":[\n";
+        bool first = true;
+        unsigned int dropped = 0;
+
+        std::lock_guard<std::mutex> lock(mTraceBuffersMutex);
+        for (const std::unique_ptr<TraceBuffer>& buffer : mTraceBuffers) {
+            if (buffer->generation.load(std::memory_order_acquire) != generation) {
+                continue; // Nothing recorded in this trace
+            }
+            unsigned int count = buffer->count.load(std::memory_order_acquire);
+            if (count == 0) {
+                continue;
+            }
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+
+            bool main = buffer->thread == mMainThread;
+            snprintf(text, sizeof(text), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                first ? "" : ",\n", buffer->index, main ? "Main" : "Thread", buffer->index);
+            outJson += text;
+            first = false;
+
+            for (unsigned int i = 0; i < count; ++i) {
+                const TraceEvent& event = buffer->events[i];
+                snprintf(text, sizeof(text), ",\n{\"name\":\"%s\",\"cat\":\"editor\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    GetScopeName(event.scope), static_cast<double>(event.startNs) / 1000.0, static_cast<double>(event.durationNs) / 1000.0, buffer->index);
+                outJson += text;
+            }
+        }
+        snprintf(text, sizeof(text), "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%u}}\n", dropped);
+        outJson += text;
+    }
+
+    unsigned int Profiler::GetFrameCount() const {
+        return mFrameCount;
+    }
+
+    const Profiler::Frame& Profiler::GetFrame(unsigned int framesAgo) const {
+        return mHistory[(mNextFrame + HISTORY_FRAMES - 1 - (framesAgo % HISTORY_FRAMES)) % HISTORY_FRAMES];
+    }
+
+    bool Profiler::IsOverlayVisible() const {
+        return mOverlayVisible;
+    }
+
+    void Profiler::SetOverlayVisible(bool visible) {
+        mOverlayVisible = visible;
+    }
+
+    Rect Profiler::GetOverlayRect(Font& font, float screenWidth, float top) const {
+        float dpi = Styles::DPI;
+        float width = (static_cast<float>(HISTORY_FRAMES) + PROFILER_PADDING * 2.0f) * dpi;
+        // The graph, a frame time row, a row per scope and a counter row
+        float height = (PROFILER_GRAPH_HEIGHT + PROFILER_PADDING * 3.0f) * dpi + font.GetLineHeight() * static_cast<float>(SCOPE_COUNT + 2);
+        return Rect(screenWidth - width, top, width, height);
+    }
+
+    static void DrawProfilerLine(Renderer& renderer, const char* text, float x, float y, const Styles::Color& color) {
+        std::u32string line;
+        for (const char* c = text; *c; ++c) {
+            line.push_back(static_cast<char32_t>(static_cast<unsigned char>(*c)));
+        }
+        renderer.DrawText(line, x, y, color.r, color.g, color.b);
+    }
+
+    void Profiler::DisplayOverlay(Renderer& renderer, const std::shared_ptr<Font>& font, float screenWidth, float top) const {
+        if (!mOverlayVisible || !font) {
+            return;
+        }
+        float dpi = Styles::DPI;
+        Rect area = GetOverlayRect(*font, screenWidth, top);
+        renderer.DrawRect(area.x, area.y, area.width, area.height,
+            PROFILER_BACKGROUND_COLOR.r, PROFILER_BACKGROUND_COLOR.g, PROFILER_BACKGROUND_COLOR.b);
+
+        // Stacked scope times per frame, newest on the right, whatever no scope covers on top
+        float graphX = area.x + PROFILER_PADDING * dpi;
+        float graphBottom = area.y + (PROFILER_PADDING + PROFILER_GRAPH_HEIGHT) * dpi;
+        float pixelsPerSecond = PROFILER_GRAPH_HEIGHT * dpi / PROFILER_GRAPH_SECONDS;
+        for (unsigned int i = 0; i < mFrameCount; ++i) {
+            const Frame& frame = GetFrame(i);
+            float x = graphX + static_cast<float>(HISTORY_FRAMES - 1 - i) * dpi;
+            float y = graphBottom;
+            float scopesSeconds = 0.0f;
+            for (unsigned int s = 0; s < SCOPE_COUNT; ++s) {
+                float h = std::min(frame.scopeSeconds[s] * pixelsPerSecond, y - (graphBottom - PROFILER_GRAPH_HEIGHT * dpi));
+                if (h > 0.0f) {
+                    y -= h;
+                    renderer.DrawRect(x, y, dpi, h, PROFILER_SCOPE_COLORS[s].r, PROFILER_SCOPE_COLORS[s].g, PROFILER_SCOPE_COLORS[s].b);
+                }
+                scopesSeconds += frame.scopeSeconds[s];
+            }
+            float other = std::min((frame.seconds - scopesSeconds) * pixelsPerSecond, y - (graphBottom - PROFILER_GRAPH_HEIGHT * dpi));
+            if (other > 0.0f) {
+                renderer.DrawRect(x, y - other, dpi, other, PROFILER_OTHER_COLOR.r, PROFILER_OTHER_COLOR.g, PROFILER_OTHER_COLOR.b);
+            }
+        }
+        float targetY = graphBottom - PROFILER_TARGET_SECONDS * pixelsPerSecond;
+        renderer.DrawRect(graphX, targetY, static_cast<float>(HISTORY_FRAMES) * dpi, dpi,
+            PROFILER_TARGET_COLOR.r, PROFILER_TARGET_COLOR.g, PROFILER_TARGET_COLOR.b);
+
+        // Averages of the recent drawn frames, ticks that drew nothing would only dilute them
+        float frameSeconds = 0.0f, worstSeconds = 0.0f;
+        float scopeSeconds[SCOPE_COUNT] = {};
+        unsigned int counters[COUNTER_COUNT] = {};
+        unsigned int drawnFrames = 0;
+        for (unsigned int i = 0; i < mFrameCount && drawnFrames < PROFILER_AVERAGE_FRAMES; ++i) {
+            const Frame& frame = GetFrame(i);
+            if (!frame.drawn) {
+                continue;
+            }
+            drawnFrames += 1;
+            frameSeconds += frame.seconds;
+            worstSeconds = std::max(worstSeconds, frame.seconds);
+            for (unsigned int s = 0; s < SCOPE_COUNT; ++s) {
+                scopeSeconds[s] += frame.scopeSeconds[s];
+            }
+            for (unsigned int c = 0; c < COUNTER_COUNT; ++c) {
+                counters[c] += frame.counters[c];
+            }
+        }
+        float average = drawnFrames > 0 ? 1.0f / static_cast<float>(drawnFrames) : 0.0f;
+
+        renderer.SetFont(font);
+        char text[128];
+        float textX = graphX;
+        float swatch = font->GetLineHeight() * 0.5f;
+        float y = graphBottom + PROFILER_PADDING * dpi;
+        float lineHeight = font->GetLineHeight();
+
+        snprintf(text, sizeof(text), "Frame %.2f ms avg, %.2f ms worst of %u", frameSeconds * average * 1000.0f, worstSeconds * 1000.0f, drawnFrames);
+        DrawProfilerLine(renderer, text, textX, y, PROFILER_TEXT_COLOR);
+        y += lineHeight;
+
+        for (unsigned int s = 0; s < SCOPE_COUNT; ++s) {
+            const Styles::Color& color = PROFILER_SCOPE_COLORS[s];
+            renderer.DrawRect(textX, y + (lineHeight - swatch) * 0.5f, swatch, swatch, color.r, color.g, color.b);
+            snprintf(text, sizeof(text), "%s %.3f ms", GetScopeName(static_cast<Scope>(s)), scopeSeconds[s] * average * 1000.0f);
+            DrawProfilerLine(renderer, text, textX + swatch * 2.0f, y, PROFILER_TEXT_COLOR);
+            y += lineHeight;
+        }
+
+        snprintf(text, sizeof(text), "Draws %.0f  Quads %.0f  Bakes %u",
+            static_cast<float>(counters[static_cast<unsigned int>(Counter::DrawCalls)]) * average,
+            static_cast<float>(counters[static_cast<unsigned int>(Counter::Quads)]) * average,
+            counters[static_cast<unsigned int>(Counter::GlyphBakes)]);
+        DrawProfilerLine(renderer, text, textX, y, PROFILER_TEXT_COLOR);
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Scoped timers cost two clock reads each. They are compiled into debug builds, release builds
+// only get them when CARROT_PROFILER is defined, otherwise the macros below expand to nothing.
+#if defined(_DEBUG) || defined(CARROT_PROFILER)
+#define PROFILER_ENABLED 1
+#else
+#define PROFILER_ENABLED 0
+#endif
+
+namespace TextEdit {
+    class Renderer;
+    class Font;
+    struct Rect;
+
+    // Where the main thread spends its frames. PROFILE_SCOPE times the rest of the enclosing block,
+    // time spent in nested scopes is taken out of their parent, so the scopes of a frame never add
+    // up to more than the frame. Counters are summed per frame. The last HISTORY_FRAMES frames are
+    // kept for the overlay (F9 toggles it). Frame statistics only cover the main thread.
+    //
+    // While a trace is running every scope, on any thread, is also written to a buffer owned by that
+    // thread, without locks, and WriteTrace turns them into Chrome trace event JSON (Shift+F9 starts
+    // a trace and saves it, open it in chrome://tracing or Perfetto).
+    class Profiler {
+    public:
+        enum class Scope : unsigned int {
+            ContainerUpdate,
+            ContainerDisplay,
+            DocumentViewDisplay,
+            Tokenize,
+            LineLayout,
+            GlyphBake,
+            RendererFlush,
+            InputDispatch,
+            FileRead,
+            FileWrite,
+            Script,
+            GlyphRasterize, // Background rasterizer jobs, on worker threads only shows up in traces
+            Count
+        };
+
+        enum class Counter : unsigned int {
+            DrawCalls,
+            Quads, // Instanced, four vertices each
+            GlyphBakes,
+            Count
+        };
+
+        static constexpr unsigned int SCOPE_COUNT = static_cast<unsigned int>(Scope::Count);
+        static constexpr unsigned int COUNTER_COUNT = static_cast<unsigned int>(Counter::Count);
+        static constexpr unsigned int HISTORY_FRAMES = 240;
+        static constexpr unsigned int MAX_SCOPE_DEPTH = 16; // Deeper scopes are not timed
+        static constexpr unsigned int TRACE_BUFFER_EVENTS = 65536; // Per thread, later events are dropped
+
+        struct Frame {
+            float scopeSeconds[SCOPE_COUNT] = {}; // Exclusive of nested scopes
+            unsigned int counters[COUNTER_COUNT] = {};
+            float seconds = 0.0f; // BeginFrame to EndFrame
+            bool drawn = false;   // False for ticks that only updated
+        };
+
+        static Profiler& Get();
+        static const char* GetScopeName(Scope scope);
+
+        // Around everything one Tick does, scopes and counts outside of a frame go to the next one.
+        // The main thread is the one that used the profiler first.
+        void BeginFrame();
+        void EndFrame(bool drawn);
+
+        // See ProfileScope, start is when the scope was entered
+        void BeginScope(Scope scope);
+        void EndScope(Scope scope, std::chrono::steady_clock::time_point start);
+        void Count(Counter counter, unsigned int amount); // Main thread only
+
+        // Starting a trace drops the events of the last one. Events stay until the next start, so
+        // WriteTrace can be called any number of times after StopTrace.
+        void StartTrace();
+        void StopTrace();
+        bool IsTracing() const;
+        void WriteTrace(std::string& outJson) const;
+
+        unsigned int GetFrameCount() const; // Finished frames kept, up to HISTORY_FRAMES
+        const Frame& GetFrame(unsigned int framesAgo) const; // 0 is the last finished frame
+
+        bool IsOverlayVisible() const;
+        void SetOverlayVisible(bool visible);
+        Rect GetOverlayRect(Font& font, float screenWidth, float top) const; // Top right corner, below top
+        void DisplayOverlay(Renderer& renderer, const std::shared_ptr<Font>& font, float screenWidth, float top) const;
+
+    protected:
+        typedef std::chrono::steady_clock Clock;
+
+        struct OpenScope {
+            Scope scope;
+            float childSeconds; // Spent in scopes nested in this one
+        };
+
+        struct TraceEvent {
+            uint64_t startNs; // Since the trace started
+            uint32_t durationNs;
+            Scope scope;
+        };
+
+        // Only the owning thread writes events and publishes them through count, readers only look
+        // below count. Buffers are never freed, threads that exit leave theirs for the next export.
+        struct TraceBuffer {
+            std::vector<TraceEvent> events;
+            std::atomic<unsigned int> count;
+            std::atomic<unsigned int> dropped;
+            std::atomic<unsigned int> generation; // Trace the events belong to, stale buffers are reset by their thread
+            std::thread::id thread;
+            unsigned int index;
+        };
+
+        Frame mHistory[HISTORY_FRAMES];
+        unsigned int mNextFrame; // Ring buffer slot of the frame being recorded
+        unsigned int mFrameCount;
+        Frame mCurrent;
+        Clock::time_point mFrameStart;
+
+        OpenScope mStack[MAX_SCOPE_DEPTH];
+        unsigned int mDepth;
+        unsigned int mUntimedDepth; // Scopes opened past MAX_SCOPE_DEPTH
+
+        bool mOverlayVisible;
+        std::thread::id mMainThread;
+
+        std::atomic<bool> mTracing;
+        std::atomic<unsigned int> mTraceGeneration;
+        std::atomic<long long> mTraceStartNs; // Clock time the trace started, read by every tracing thread
+        mutable std::mutex mTraceBuffersMutex; // Only taken when a thread traces for the first time, and to export
+        std::vector<std::unique_ptr<TraceBuffer>> mTraceBuffers;
+
+        Profiler();
+        TraceBuffer* GetThreadTraceBuffer();
+        void AddTraceEvent(Scope scope, Clock::time_point start, Clock::time_point end);
+    };
+
+    class ProfileScope {
+    public:
+        inline explicit ProfileScope(Profiler::Scope scope) : mScope(scope) {
+            Profiler::Get().BeginScope(scope);
+            mStart = std::chrono::steady_clock::now(); // Last, so the bookkeeping isn't timed
+        }
+        inline ~ProfileScope() {
+            Profiler::Get().EndScope(mScope, mStart);
+        }
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+    private:
+        Profiler::Scope mScope;
+        std::chrono::steady_clock::time_point mStart;
+    };
+}
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE_CONCAT2(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT2(a, b)
+#define PROFILE_SCOPE(scope) TextEdit::ProfileScope PROFILE_SCOPE_CONCAT(profileScope, __LINE__)(TextEdit::Profiler::Scope::scope)
+#define PROFILE_COUNT(counter, amount) TextEdit::Profiler::Get().Count(TextEdit::Profiler::Counter::counter, (amount))
+#define PROFILE_BEGIN_FRAME() TextEdit::Profiler::Get().BeginFrame()
+#define PROFILE_END_FRAME(drawn) TextEdit::Profiler::Get().EndFrame(drawn)
+#else
+#define PROFILE_SCOPE(scope) ((void)0)
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_BEGIN_FRAME() ((void)0)
+#define PROFILE_END_FRAME(drawn) ((void)0)
+#endif
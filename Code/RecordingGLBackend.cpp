@@ -0,0 +1,373 @@
+#include "RecordingGLBackend.h"
+#include <cstring> // for memcpy
+#include <cstdint>
+
+namespace TextEdit {
+    std::shared_ptr<RecordingGLBackend> RecordingGLBackend::Create(bool keepLog) {
+        return std::make_shared<RecordingGLBackend>(keepLog);
+    }
+
+    RecordingGLBackend::RecordingGLBackend(bool keepLog)
+        : mKeepLog(keepLog),
+        mNextName(1),
+        mBoundArrayBuffer(0),
+        mAttributeBuffer(0),
+        mAttributeOffset(0) {
+    }
+
+    const std::vector<RecordingGLBackend::Command>& RecordingGLBackend::GetLog() const {
+        return mLog;
+    }
+
+    const RecordingGLBackend::Stats& RecordingGLBackend::GetStats() const {
+        return mStats;
+    }
+
+    void RecordingGLBackend::Reset() {
+        mLog.clear();
+        mDrawSources.clear();
+        mStats = Stats();
+    }
+
+    const std::vector<unsigned char>* RecordingGLBackend::GetBufferData(GLuint buffer) const {
+        auto it = mBuffers.find(buffer);
+        return (it != mBuffers.end()) ? &it->second : nullptr;
+    }
+
+    const std::vector<RecordingGLBackend::DrawSource>& RecordingGLBackend::GetDrawSources() const {
+        return mDrawSources;
+    }
+
+    void RecordingGLBackend::Record(const char* name, GLenum target, GLuint object,
+        long long a0, long long a1, long long a2, long long a3, size_t bytes) {
+        mStats.calls += 1;
+        if (mKeepLog) {
+            Command command;
+            command.name = name;
+            command.target = target;
+            command.object = object;
+            command.args[0] = a0;
+            command.args[1] = a1;
+            command.args[2] = a2;
+            command.args[3] = a3;
+            command.bytes = bytes;
+            mLog.push_back(command);
+        }
+    }
+
+    void RecordingGLBackend::GenNames(GLsizei count, GLuint* names) {
+        for (GLsizei i = 0; i < count; ++i) {
+            names[i] = mNextName++;
+        }
+    }
+
+    size_t RecordingGLBackend::TextureBytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type) const {
+        size_t channels = (format == GL_RGBA) ? 4 : (format == GL_RGB) ? 3 : (format == GL_RG) ? 2 : 1;
+        size_t channelBytes = (type == GL_UNSIGNED_BYTE) ? 1 : 4;
+        return static_cast<size_t>(width) * height * depth * channels * channelBytes;
+    }
+
+    // Shaders
+
+    GLuint RecordingGLBackend::CreateProgram(const char* vertexSource, const char* fragmentSource) {
+        GLuint program = 0;
+        GenNames(1, &program);
+        Record("CreateProgram", 0, program);
+        return program;
+    }
+
+    void RecordingGLBackend::DeleteProgram(GLuint program) {
+        Record("DeleteProgram", 0, program);
+    }
+
+    void RecordingGLBackend::UseProgram(GLuint program) {
+        mStats.stateChanges += 1;
+        Record("UseProgram", 0, program);
+    }
+
+    GLint RecordingGLBackend::GetUniformLocation(GLuint program, const char* name) {
+        // Locations are per program in GL, one shared table is enough to tell uniforms apart here
+        auto it = mUniformLocations.find(name);
+        GLint location = 0;
+        if (it != mUniformLocations.end()) {
+            location = it->second;
+        }
+        else {
+            location = static_cast<GLint>(mUniformLocations.size());
+            mUniformLocations[name] = location;
+        }
+        Record("GetUniformLocation", 0, program, location);
+        return location;
+    }
+
+    void RecordingGLBackend::Uniform1i(GLint location, GLint value) {
+        mStats.stateChanges += 1;
+        Record("Uniform1i", 0, 0, location, value);
+    }
+
+    void RecordingGLBackend::Uniform2f(GLint location, GLfloat x, GLfloat y) {
+        mStats.stateChanges += 1;
+        Record("Uniform2f", 0, 0, location, static_cast<long long>(x), static_cast<long long>(y));
+    }
+
+    // Buffers and vertex arrays
+
+    void RecordingGLBackend::GenBuffers(GLsizei count, GLuint* buffers) {
+        GenNames(count, buffers);
+        for (GLsizei i = 0; i < count; ++i) {
+            mBuffers[buffers[i]];
+            Record("GenBuffers", 0, buffers[i]);
+        }
+    }
+
+    void RecordingGLBackend::DeleteBuffers(GLsizei count, const GLuint* buffers) {
+        for (GLsizei i = 0; i < count; ++i) {
+            mBuffers.erase(buffers[i]);
+            Record("DeleteBuffers", 0, buffers[i]);
+        }
+    }
+
+    void RecordingGLBackend::BindBuffer(GLenum target, GLuint buffer) {
+        if (target == GL_ARRAY_BUFFER) {
+            mBoundArrayBuffer = buffer;
+        }
+        mStats.stateChanges += 1;
+        Record("BindBuffer", target, buffer);
+    }
+
+    void RecordingGLBackend::BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+        GLuint buffer = (target == GL_ARRAY_BUFFER) ? mBoundArrayBuffer : 0;
+        if (buffer != 0) {
+            std::vector<unsigned char>& storage = mBuffers[buffer];
+            storage.assign(static_cast<size_t>(size), 0);
+            if (data) {
+                memcpy(storage.data(), data, static_cast<size_t>(size));
+            }
+        }
+        if (data) {
+            mStats.bufferUploads += 1;
+            mStats.bufferUploadBytes += static_cast<unsigned long long>(size);
+        }
+        Record("BufferData", target, buffer, size, usage, 0, 0, data ? static_cast<size_t>(size) : 0);
+    }
+
+    void RecordingGLBackend::BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+        GLuint buffer = (target == GL_ARRAY_BUFFER) ? mBoundArrayBuffer : 0;
+        auto it = mBuffers.find(buffer);
+        if (it != mBuffers.end() && data && static_cast<size_t>(offset + size) <= it->second.size()) {
+            memcpy(it->second.data() + offset, data, static_cast<size_t>(size));
+        }
+        mStats.bufferUploads += 1;
+        mStats.bufferUploadBytes += static_cast<unsigned long long>(size);
+        Record("BufferSubData", target, buffer, offset, size, 0, 0, static_cast<size_t>(size));
+    }
+
+    void* RecordingGLBackend::MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+        GLuint buffer = (target == GL_ARRAY_BUFFER) ? mBoundArrayBuffer : 0;
+        auto it = mBuffers.find(buffer);
+        Record("MapBufferRange", target, buffer, offset, length, access);
+        if (it == mBuffers.end() || static_cast<size_t>(offset + length) > it->second.size()) {
+            return nullptr;
+        }
+        // Whatever is written through the pointer counts as uploaded
+        mStats.bufferUploads += 1;
+        mStats.bufferUploadBytes += static_cast<unsigned long long>(length);
+        return it->second.data() + offset;
+    }
+
+    GLboolean RecordingGLBackend::UnmapBuffer(GLenum target) {
+        Record("UnmapBuffer", target, (target == GL_ARRAY_BUFFER) ? mBoundArrayBuffer : 0);
+        return GL_TRUE;
+    }
+
+    void RecordingGLBackend::GenVertexArrays(GLsizei count, GLuint* arrays) {
+        GenNames(count, arrays);
+        Record("GenVertexArrays", 0, count > 0 ? arrays[0] : 0, count);
+    }
+
+    void RecordingGLBackend::DeleteVertexArrays(GLsizei count, const GLuint* arrays) {
+        Record("DeleteVertexArrays", 0, count > 0 ? arrays[0] : 0, count);
+    }
+
+    void RecordingGLBackend::BindVertexArray(GLuint array) {
+        mStats.stateChanges += 1;
+        Record("BindVertexArray", 0, array);
+    }
+
+    void RecordingGLBackend::EnableVertexAttribArray(GLuint index) {
+        Record("EnableVertexAttribArray", 0, 0, index);
+    }
+
+    void RecordingGLBackend::VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+        size_t offset = static_cast<size_t>(reinterpret_cast<uintptr_t>(pointer));
+        if (index == 0) {
+            mAttributeBuffer = mBoundArrayBuffer;
+            mAttributeOffset = offset;
+        }
+        mStats.stateChanges += 1;
+        Record("VertexAttribPointer", type, mBoundArrayBuffer, index, size, stride, static_cast<long long>(offset));
+    }
+
+    void RecordingGLBackend::VertexAttribDivisor(GLuint index, GLuint divisor) {
+        Record("VertexAttribDivisor", 0, 0, index, divisor);
+    }
+
+    // Textures
+
+    void RecordingGLBackend::GenTextures(GLsizei count, GLuint* textures) {
+        GenNames(count, textures);
+        Record("GenTextures", 0, count > 0 ? textures[0] : 0, count);
+    }
+
+    void RecordingGLBackend::DeleteTextures(GLsizei count, const GLuint* textures) {
+        Record("DeleteTextures", 0, count > 0 ? textures[0] : 0, count);
+    }
+
+    void RecordingGLBackend::ActiveTexture(GLenum unit) {
+        mStats.stateChanges += 1;
+        Record("ActiveTexture", unit);
+    }
+
+    void RecordingGLBackend::BindTexture(GLenum target, GLuint texture) {
+        mStats.stateChanges += 1;
+        Record("BindTexture", target, texture);
+    }
+
+    void RecordingGLBackend::TexParameteri(GLenum target, GLenum name, GLint value) {
+        Record("TexParameteri", target, 0, name, value);
+    }
+
+    void RecordingGLBackend::PixelStorei(GLenum name, GLint value) {
+        Record("PixelStorei", name, 0, value);
+    }
+
+    void RecordingGLBackend::TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+        GLint border, GLenum format, GLenum type, const void* pixels) {
+        size_t bytes = pixels ? TextureBytes(width, height, 1, format, type) : 0;
+        if (pixels) {
+            mStats.textureUploads += 1;
+            mStats.textureUploadBytes += bytes;
+        }
+        Record("TexImage2D", target, 0, width, height, 1, internalFormat, bytes);
+    }
+
+    void RecordingGLBackend::TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+        GLenum format, GLenum type, const void* pixels) {
+        size_t bytes = TextureBytes(width, height, 1, format, type);
+        mStats.textureUploads += 1;
+        mStats.textureUploadBytes += bytes;
+        Record("TexSubImage2D", target, 0, x, y, width, height, bytes);
+    }
+
+    void RecordingGLBackend::TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+        GLint border, GLenum format, GLenum type, const void* pixels) {
+        size_t bytes = pixels ? TextureBytes(width, height, depth, format, type) : 0;
+        if (pixels) {
+            mStats.textureUploads += 1;
+            mStats.textureUploadBytes += bytes;
+        }
+        Record("TexImage3D", target, 0, width, height, depth, internalFormat, bytes);
+    }
+
+    void RecordingGLBackend::TexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+        GLenum format, GLenum type, const void* pixels) {
+        size_t bytes = TextureBytes(width, height, depth, format, type);
+        mStats.textureUploads += 1;
+        mStats.textureUploadBytes += bytes;
+        Record("TexSubImage3D", target, 0, x, y, z, static_cast<long long>(width) * height, bytes);
+    }
+
+    // Framebuffers
+
+    void RecordingGLBackend::GenFramebuffers(GLsizei count, GLuint* framebuffers) {
+        GenNames(count, framebuffers);
+        Record("GenFramebuffers", 0, count > 0 ? framebuffers[0] : 0, count);
+    }
+
+    void RecordingGLBackend::DeleteFramebuffers(GLsizei count, const GLuint* framebuffers) {
+        Record("DeleteFramebuffers", 0, count > 0 ? framebuffers[0] : 0, count);
+    }
+
+    void RecordingGLBackend::BindFramebuffer(GLenum target, GLuint framebuffer) {
+        mStats.stateChanges += 1;
+        Record("BindFramebuffer", target, framebuffer);
+    }
+
+    void RecordingGLBackend::FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level) {
+        Record("FramebufferTexture2D", target, texture, attachment);
+    }
+
+    GLenum RecordingGLBackend::CheckFramebufferStatus(GLenum target) {
+        Record("CheckFramebufferStatus", target);
+        return GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    void RecordingGLBackend::BlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+        GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) {
+        Record("BlitFramebuffer", filter, 0, dstX0, dstY0, dstX1 - dstX0, dstY1 - dstY0);
+    }
+
+    // Fixed function state and drawing
+
+    void RecordingGLBackend::Enable(GLenum capability) {
+        mStats.stateChanges += 1;
+        Record("Enable", capability);
+    }
+
+    void RecordingGLBackend::Disable(GLenum capability) {
+        mStats.stateChanges += 1;
+        Record("Disable", capability);
+    }
+
+    void RecordingGLBackend::BlendFunc(GLenum source, GLenum destination) {
+        mStats.stateChanges += 1;
+        Record("BlendFunc", 0, 0, source, destination);
+    }
+
+    void RecordingGLBackend::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        mStats.stateChanges += 1;
+        Record("Viewport", 0, 0, x, y, width, height);
+    }
+
+    void RecordingGLBackend::Scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+        mStats.stateChanges += 1;
+        Record("Scissor", 0, 0, x, y, width, height);
+    }
+
+    void RecordingGLBackend::ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+        mStats.stateChanges += 1;
+        Record("ClearColor");
+    }
+
+    void RecordingGLBackend::Clear(GLbitfield mask) {
+        Record("Clear", 0, 0, mask);
+    }
+
+    void RecordingGLBackend::DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) {
+        mStats.drawCalls += 1;
+        mStats.instances += static_cast<unsigned long long>(instanceCount);
+        mStats.vertices += static_cast<unsigned long long>(count) * instanceCount;
+        if (mKeepLog) {
+            mDrawSources.push_back({ mAttributeBuffer, mAttributeOffset });
+        }
+        Record("DrawArraysInstanced", mode, mAttributeBuffer, first, count, instanceCount, static_cast<long long>(mAttributeOffset));
+    }
+
+    // Sync, nothing is ever in flight
+
+    GLsync RecordingGLBackend::FenceSync(GLenum condition, GLbitfield flags) {
+        GLuint name = 0;
+        GenNames(1, &name);
+        Record("FenceSync", condition, name);
+        return reinterpret_cast<GLsync>(static_cast<uintptr_t>(name));
+    }
+
+    GLenum RecordingGLBackend::ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+        Record("ClientWaitSync", 0, static_cast<GLuint>(reinterpret_cast<uintptr_t>(sync)));
+        return GL_ALREADY_SIGNALED;
+    }
+
+    void RecordingGLBackend::DeleteSync(GLsync sync) {
+        Record("DeleteSync", 0, static_cast<GLuint>(reinterpret_cast<uintptr_t>(sync)));
+    }
+}
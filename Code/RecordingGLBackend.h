@@ -0,0 +1,125 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "GLBackend.h"
+
+namespace TextEdit {
+    // Stands in for OpenGL where there is no GPU, for benchmarks and for checking what a frame drew.
+    // Object names are made up, nothing is rendered. Buffer contents are kept, so the instances behind
+    // every draw can be read back, and every call is counted and (optionally) logged.
+    class RecordingGLBackend : public GLBackend {
+    public:
+        struct Command {
+            const char* name;   // Entry point without the gl prefix, "DrawArraysInstanced"
+            GLenum target;      // Target, capability or mode of the call, 0 if it has none
+            GLuint object;      // Object bound, created or written to, 0 if none
+            long long args[4];  // Call specific, see Record calls in RecordingGLBackend.cpp
+            size_t bytes;       // Bytes uploaded by the call
+        };
+
+        struct Stats {
+            unsigned int calls = 0;
+            unsigned int drawCalls = 0;
+            unsigned long long instances = 0;
+            unsigned long long vertices = 0;      // Vertices times instances
+            unsigned int stateChanges = 0;        // Binds, enables, uniforms, viewport and scissor
+            unsigned int textureUploads = 0;
+            unsigned long long textureUploadBytes = 0;
+            unsigned int bufferUploads = 0;
+            unsigned long long bufferUploadBytes = 0;
+        };
+
+        // A draw's instances start at this offset of this buffer, as set by VertexAttribPointer(0)
+        struct DrawSource {
+            GLuint buffer;
+            size_t offset;
+        };
+
+        RecordingGLBackend(bool keepLog);
+        static std::shared_ptr<RecordingGLBackend> Create(bool keepLog = true); // Without a log only the stats are kept
+
+        const std::vector<Command>& GetLog() const;
+        const Stats& GetStats() const;
+        void Reset(); // Clears the log and stats, objects stay alive
+
+        const std::vector<unsigned char>* GetBufferData(GLuint buffer) const; // Null for unknown buffers
+        const std::vector<DrawSource>& GetDrawSources() const; // One per logged draw, cleared by Reset
+
+        GLuint CreateProgram(const char* vertexSource, const char* fragmentSource) override;
+        void DeleteProgram(GLuint program) override;
+        void UseProgram(GLuint program) override;
+        GLint GetUniformLocation(GLuint program, const char* name) override;
+        void Uniform1i(GLint location, GLint value) override;
+        void Uniform2f(GLint location, GLfloat x, GLfloat y) override;
+
+        void GenBuffers(GLsizei count, GLuint* buffers) override;
+        void DeleteBuffers(GLsizei count, const GLuint* buffers) override;
+        void BindBuffer(GLenum target, GLuint buffer) override;
+        void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+        void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override;
+        void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+        GLboolean UnmapBuffer(GLenum target) override;
+        void GenVertexArrays(GLsizei count, GLuint* arrays) override;
+        void DeleteVertexArrays(GLsizei count, const GLuint* arrays) override;
+        void BindVertexArray(GLuint array) override;
+        void EnableVertexAttribArray(GLuint index) override;
+        void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override;
+        void VertexAttribDivisor(GLuint index, GLuint divisor) override;
+
+        void GenTextures(GLsizei count, GLuint* textures) override;
+        void DeleteTextures(GLsizei count, const GLuint* textures) override;
+        void ActiveTexture(GLenum unit) override;
+        void BindTexture(GLenum target, GLuint texture) override;
+        void TexParameteri(GLenum target, GLenum name, GLint value) override;
+        void PixelStorei(GLenum name, GLint value) override;
+        void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+            GLint border, GLenum format, GLenum type, const void* pixels) override;
+        void TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const void* pixels) override;
+        void TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+            GLint border, GLenum format, GLenum type, const void* pixels) override;
+        void TexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+            GLenum format, GLenum type, const void* pixels) override;
+
+        void GenFramebuffers(GLsizei count, GLuint* framebuffers) override;
+        void DeleteFramebuffers(GLsizei count, const GLuint* framebuffers) override;
+        void BindFramebuffer(GLenum target, GLuint framebuffer) override;
+        void FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level) override;
+        GLenum CheckFramebufferStatus(GLenum target) override;
+        void BlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+            GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) override;
+
+        void Enable(GLenum capability) override;
+        void Disable(GLenum capability) override;
+        void BlendFunc(GLenum source, GLenum destination) override;
+        void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+        void Scissor(GLint x, GLint y, GLsizei width, GLsizei height) override;
+        void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) override;
+        void Clear(GLbitfield mask) override;
+        void DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) override;
+
+        GLsync FenceSync(GLenum condition, GLbitfield flags) override;
+        GLenum ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) override;
+        void DeleteSync(GLsync sync) override;
+
+    private:
+        bool mKeepLog;
+        std::vector<Command> mLog;
+        std::vector<DrawSource> mDrawSources;
+        Stats mStats;
+
+        GLuint mNextName;
+        std::map<GLuint, std::vector<unsigned char>> mBuffers;
+        std::map<std::string, GLint> mUniformLocations;
+        GLuint mBoundArrayBuffer;
+        GLuint mAttributeBuffer; // Buffer and offset behind attribute 0, where draws read instances from
+        size_t mAttributeOffset;
+
+        void Record(const char* name, GLenum target = 0, GLuint object = 0,
+            long long a0 = 0, long long a1 = 0, long long a2 = 0, long long a3 = 0, size_t bytes = 0);
+        void GenNames(GLsizei count, GLuint* names);
+        size_t TextureBytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type) const;
+    };
+}
@@ -1,6 +1,7 @@
 ﻿#include "Renderer.h"
 #include "Font.h" // Make sure Font.h is included
 #include "Styles.h"
+#include "Profiler.h"
 #include <cmath>
 #include <cstdio> // For printf
 #include <cstring> // For offsetof if not using C++11 std::offsetof
@@ -16,22 +17,48 @@
 
 
 namespace TextEdit {
+    // More damage rects than this collapse into a single bounding rect, every rect is a full pass over the UI
+    static constexpr size_t MAX_DAMAGE_RECTS = 4;
+
+    // Quad positions are stored in 1/8ths of a pixel, which is plenty for glyph placement and
+    // still covers an 8K wide window in 16 bits. Has to match the scale in the vertex shader.
+    static constexpr float QUAD_SUBPIXELS = 8.0f;
+    // Lives in the alpha channel of the color. Glyphs store their font layer + 1 there instead, in the
+    // low seven bits, with the top bit set when the layer holds a distance field rather than coverage.
+    static constexpr uint8_t QUAD_FLAG_IMAGE = 255;
+    static constexpr uint8_t QUAD_FLAG_DISTANCE_FIELD = 128;
+    static constexpr unsigned int MAX_FONT_LAYERS = QUAD_FLAG_DISTANCE_FIELD - 2; // Layer 126 as a distance field would read as an image
+    static constexpr unsigned int NO_FONT_LAYER = ~0u;
+    // Past this many changed glyphs only their bounds are uploaded, one call beats dozens of tiny ones
+    static constexpr size_t MAX_ATLAS_RECT_UPLOADS = 32;
+
+    // Enough for a 4K window full of text in a single frame, bigger frames grow the buffer
+    static constexpr size_t RING_BUFFER_INITIAL_REGION_BYTES = 1024 * 1024;
+    static constexpr GLuint64 RING_BUFFER_FENCE_TIMEOUT_NS = 1000000000ull;
+
+    static constexpr GLuint GL_STATE_UNKNOWN = 0xFFFFFFFF; // Never a valid object name or enum
+
     static const char* gVertexShader = R"GLSL(#version 300 es
-        layout(location = 0) in vec2 inPosition;
-        layout(location = 1) in vec3 inColor;
-        layout(location = 2) in float inTexFlag;
-        layout(location = 3) in vec2 inUV;
+        layout(location = 0) in vec4 inRect;  // x, y, width, height in 1/8 pixels
+        layout(location = 1) in vec4 inUV;    // u0, v0, u1, v1, atlas texels in 1/8ths or 16 bit normalized
+        layout(location = 2) in vec4 inColor; // rgb, alpha is the quad flags
 
         uniform vec2 uViewportSize;
+        uniform vec2 uFontArraySize;
         
         out vec3 fragColor;
-        out float texFlag;
+        flat out int quadFlags;
         out vec2 uvCoord;
 
         void main() {
-            fragColor = inColor;
-            texFlag = inTexFlag;
-            uvCoord = inUV;
+            // Triangle strip corners in order: top-left, bottom-left, top-right, bottom-right
+            vec2 corner = vec2(float(gl_VertexID / 2), float(gl_VertexID % 2));
+            vec2 inPosition = (inRect.xy + inRect.zw * corner) * 0.125;
+
+            fragColor = inColor.rgb;
+            quadFlags = int(inColor.a * 255.0 + 0.5);
+            vec2 uv = mix(inUV.xy, inUV.zw, corner);
+            uvCoord = (quadFlags == 255) ? uv / 65535.0 : uv * 0.125 / uFontArraySize;
             vec2 ndcPos = vec2(
                 (inPosition.x / uViewportSize.x) * 2.0 - 1.0,
                 1.0 - (inPosition.y / uViewportSize.y) * 2.0 // Y flipped to correspond to top-left origin
@@ -42,73 +69,37 @@ namespace TextEdit {
 
     static const char* gFragmentShader = R"GLSL(#version 300 es
 		precision mediump float;
+		precision mediump sampler2DArray;
         in vec3 fragColor;
-        in float texFlag;
+        flat in int quadFlags;
         in vec2 uvCoord;
         out vec4 outColor;
 
-        uniform sampler2D uTexture;
+        uniform sampler2D uTexture;          // DrawImage
+        uniform sampler2DArray uFontArray;   // One layer per font
 
         void main()
         {
-            if(texFlag > 0.5) { // Using a threshold for texFlag
+            if (quadFlags == 0) {
+                outColor = vec4(fragColor, 1.0); // For solid rects, alpha is 1.0
+            } else if (quadFlags == 255) {
                 vec4 sampleColor = texture(uTexture, uvCoord);
-                // Font atlas stores white characters with alpha.
-                // Modulate fragColor (desired text color) with sampleColor.rgb (should be white, effectively 1.0)
-                // and use sampleColor.a as the final alpha.
                 outColor = vec4(fragColor.rgb * sampleColor.rgb, sampleColor.a);
             } else {
-                outColor = vec4(fragColor, 1.0); // For solid rects, alpha is 1.0
+                // Font atlases are single channel, the text color comes from the quad
+                float value = texture(uFontArray, vec3(uvCoord, float((quadFlags & 127) - 1))).r;
+                if (quadFlags >= 128) {
+                    // Signed distance, the outline is at 0.5. The edge ramps over one screen pixel at any scale.
+                    value = clamp((value - 0.5) / max(fwidth(value), 0.0001) + 0.5, 0.0, 1.0);
+                }
+                outColor = vec4(fragColor, value);
             }
         }
     )GLSL";
 
-    static GLuint CompileShader(GLenum type, const char* src) {
-        GLuint shader = glCreateShader(type);
-        glShaderSource(shader, 1, &src, nullptr);
-        glCompileShader(shader);
-        GLint status = 0;
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-        if (status == 0) {
-            char buffer[1024];
-            glGetShaderInfoLog(shader, 1024, nullptr, buffer);
-            printf("Shader Compile Error (%s): %s\n", (type == GL_VERTEX_SHADER ? "VS" : "FS"), buffer);
-            glDeleteShader(shader);
-            return 0;
-        }
-        return shader;
-    }
-
-    static GLuint CreateProgram(const char* vsSrc, const char* fsSrc) {
-        GLuint vs = CompileShader(GL_VERTEX_SHADER, vsSrc);
-        if (!vs) return 0;
-        GLuint fs = CompileShader(GL_FRAGMENT_SHADER, fsSrc);
-        if (!fs) {
-            glDeleteShader(vs);
-            return 0;
-        }
-        GLuint prog = glCreateProgram();
-        glAttachShader(prog, vs);
-        glAttachShader(prog, fs);
-        glLinkProgram(prog);
-        glDeleteShader(vs); // Can delete after linking
-        glDeleteShader(fs); // Can delete after linking
-
-        GLint linked = 0;
-        glGetProgramiv(prog, GL_LINK_STATUS, &linked);
-        if (!linked) {
-            char buffer[1024];
-            glGetProgramInfoLog(prog, 1024, nullptr, buffer);
-            printf("Program Link Error: %s\n", buffer);
-            glDeleteProgram(prog);
-            return 0;
-        }
-        return prog;
-    }
-
-
-    std::shared_ptr<Renderer> Renderer::Create(float dpi, std::shared_ptr<Font> defaultFont) {
+    std::shared_ptr<Renderer> Renderer::Create(float dpi, std::shared_ptr<Font> defaultFont, std::shared_ptr<GLBackend> backend) {
         auto r = std::make_shared<Renderer>();
+        r->mGL = (backend != nullptr) ? backend : GLBackend::CreateOpenGL();
         if (!r->InitGLResources()) { // Check if InitGLResources failed
             // Handle initialization failure, perhaps by returning nullptr or logging
             printf("Renderer: Failed to initialize GL resources.\n");
@@ -120,9 +111,14 @@ namespace TextEdit {
         }
         else {
             std::shared_ptr<Font> defaultBase = Font::Create(Roboto, Roboto_Size, 18.0f, dpi);
+            if (!defaultBase) {
+                printf("Renderer: Failed to create the default font.\n");
+                return nullptr;
+            }
             defaultBase->LoadEmojis(NotoEmoji, NotoEmoji_Size, 18.0f, dpi);
             r->mDefaultFont = defaultBase;
         }
+        r->SetFont(nullptr); // Binds the default font, so there is always a font layer to draw with
         return r;
     }
 
@@ -133,11 +129,34 @@ namespace TextEdit {
         mProgram(0),
         mVBO(0),
         mVAO(0),
+        mRingRegionBytes(RING_BUFFER_INITIAL_REGION_BYTES),
+        mRingRegion(0),
+        mRingOffset(0),
+        mRingRegionSynced(true),
         mViewportX(0),
         mViewportY(0),
         mViewportWidth(0),
         mViewportHeight(0),
-        mLayoutScale(1.0f) {
+        mLayoutScale(1.0f),
+        mFullDamage(true),
+        mDamagePass(0, 0, 0, 0),
+        mEffectiveClip(0, 0, 0, 0),
+        mBackBufferFBO(0),
+        mBackBufferTexture(0),
+        mBackBufferWidth(0),
+        mBackBufferHeight(0),
+        mImageTexture(0),
+        mFontArrayTexture(0),
+        mFontArrayWidth(0),
+        mFontArrayHeight(0),
+        mFontArrayLayers(0),
+        mViewportSizeLocation(-1),
+        mFontArraySizeLocation(-1),
+        mGL(nullptr) {
+        ResetGLStateCache();
+        for (unsigned int i = 0; i < RING_BUFFER_FRAMES; ++i) {
+            mRingFences[i] = 0;
+        }
     }
 
     Renderer::~Renderer() {
@@ -154,30 +173,322 @@ namespace TextEdit {
         mClipRect = Rect(static_cast<float>(viewport_x), static_cast<float>(viewport_y),
             static_cast<float>(viewport_width), static_cast<float>(viewport_height));
         mDrawBuffer.clear();
+        mFrameStats = FrameStats();
+        ResetGLStateCache();
+
+        // Atlas pages drawn from last frame are free to be evicted again
+        CollectFinishedGlyphs();
+        for (FontLayer& layer : mFontLayers) {
+            std::shared_ptr<Font> font = layer.font.lock();
+            if (font && layer.page == 0) {
+                font->AdvanceFrame();
+                layer.frameGlyphGeneration = font->GetGlyphGeneration();
+            }
+        }
+        AdvanceRingBuffer();
+
+        // Without a back buffer nothing survives between frames, so everything is damaged
+        if (!ResizeBackBuffer(viewport_width, viewport_height)) {
+            mFullDamage = true;
+        }
+        if (mFullDamage || mDamageRects.empty()) {
+            mDamageRects.clear();
+            mDamageRects.push_back(mClipRect);
+        }
+
+        if (mBackBufferFBO != 0) {
+            mGL->BindFramebuffer(GL_FRAMEBUFFER, mBackBufferFBO);
+            mFrameStats.glCalls += 1;
+        }
 
         // It's common to set GL viewport here too
-        glViewport(mViewportX, mViewportY, mViewportWidth, mViewportHeight);
+        mGL->Viewport(mViewportX, mViewportY, mViewportWidth, mViewportHeight);
+        mGL->Enable(GL_SCISSOR_TEST);
+        mFrameStats.glCalls += 2;
+        StartDamagePass(0);
     }
 
     void Renderer::EndFrame() {
         FlushAndDraw();
+        FenceRingBuffer();
+        mGL->Disable(GL_SCISSOR_TEST);
+        mFrameStats.glCalls += 1;
         // mBoundFont is reset per frame by SetFont being called or not.
         // If SetFont is not called, previous mBoundFont persists.
         // Clearing it here might be too aggressive if SetFont is not called every frame.
         // Let's assume mBoundFont persists unless explicitly changed.
+
+        if (mBackBufferFBO != 0) {
+            // The default framebuffer is undefined after a swap, so present all of the back buffer
+            mGL->BindFramebuffer(GL_READ_FRAMEBUFFER, mBackBufferFBO);
+            mGL->BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            mGL->BlitFramebuffer(0, 0, mBackBufferWidth, mBackBufferHeight,
+                mViewportX, mViewportY, mViewportX + mBackBufferWidth, mViewportY + mBackBufferHeight,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            mGL->BindFramebuffer(GL_FRAMEBUFFER, 0);
+            mFrameStats.glCalls += 4;
+        }
+
+        mDamageRects.clear();
+        mFullDamage = false;
+        mLastFrameStats = mFrameStats;
+
+        // A font that re-baked its glyphs during the frame (atlas growth) moved them after quads using
+        // the old texture coordinates were queued. Those quads drew the wrong glyphs into the back buffer,
+        // where they would stay until the area is damaged again. Damage left over after EndFrame is a
+        // pending redraw, see HasDamage.
+        bool rebaked = false;
+        for (FontLayer& layer : mFontLayers) {
+            std::shared_ptr<Font> font = layer.font.lock();
+            if (font && layer.page == 0 && layer.frameGlyphGeneration != font->GetGlyphGeneration()) {
+                layer.frameGlyphGeneration = font->GetGlyphGeneration();
+                rebaked = true;
+            }
+        }
+        if (rebaked) {
+            InvalidateAll();
+        }
+    }
+
+    void Renderer::Invalidate(const Rect& area) {
+        if (mFullDamage) {
+            return;
+        }
+
+        // Scissor rects are whole pixels, snap outwards so nothing is left half drawn
+        float x1 = std::floor(area.x);
+        float y1 = std::floor(area.y);
+        float x2 = std::ceil(area.x + area.width);
+        float y2 = std::ceil(area.y + area.height);
+        if (mViewportWidth > 0 && mViewportHeight > 0) {
+            x1 = std::max(x1, static_cast<float>(mViewportX));
+            y1 = std::max(y1, static_cast<float>(mViewportY));
+            x2 = std::min(x2, static_cast<float>(mViewportX + mViewportWidth));
+            y2 = std::min(y2, static_cast<float>(mViewportY + mViewportHeight));
+        }
+        if (x2 <= x1 || y2 <= y1) {
+            return;
+        }
+
+        // Merge with anything overlapping or touching, merging can make the rect touch others
+        Rect damage(x1, y1, x2 - x1, y2 - y1);
+        for (size_t i = 0; i < mDamageRects.size();) {
+            Rect grown(mDamageRects[i].x - 1.0f, mDamageRects[i].y - 1.0f, mDamageRects[i].width + 2.0f, mDamageRects[i].height + 2.0f);
+            if (grown.Intersects(damage)) {
+                damage = damage.Union(mDamageRects[i]);
+                mDamageRects.erase(mDamageRects.begin() + i);
+                i = 0;
+            }
+            else {
+                ++i;
+            }
+        }
+        mDamageRects.push_back(damage);
+
+        if (mDamageRects.size() > MAX_DAMAGE_RECTS) {
+            Rect bounds = mDamageRects[0];
+            for (size_t i = 1; i < mDamageRects.size(); ++i) {
+                bounds = bounds.Union(mDamageRects[i]);
+            }
+            mDamageRects.clear();
+            mDamageRects.push_back(bounds);
+        }
+    }
+
+    void Renderer::InvalidateAll() {
+        mFullDamage = true;
+    }
+
+    bool Renderer::HasDamage() const {
+        return mFullDamage || !mDamageRects.empty();
+    }
+
+    unsigned int Renderer::GetDamagePassCount() const {
+        return static_cast<unsigned int>(mDamageRects.size());
+    }
+
+    void Renderer::StartDamagePass(unsigned int pass) {
+        FlushAndDraw(); // Anything pending belongs to the previous pass
+
+        mDamagePass = mDamageRects[pass];
+        mClipRect = Rect(static_cast<float>(mViewportX), static_cast<float>(mViewportY),
+            static_cast<float>(mViewportWidth), static_cast<float>(mViewportHeight));
+        UpdateEffectiveClip();
+
+        // GL scissor has a bottom-left origin
+        GLint scissorX = static_cast<GLint>(mDamagePass.x) - static_cast<GLint>(mViewportX);
+        GLint scissorY = static_cast<GLint>(mViewportHeight) - static_cast<GLint>(mDamagePass.y + mDamagePass.height) + static_cast<GLint>(mViewportY);
+        mGL->Scissor(scissorX, scissorY, static_cast<GLsizei>(mDamagePass.width), static_cast<GLsizei>(mDamagePass.height));
+        mFrameStats.glCalls += 1;
+    }
+
+    void Renderer::UpdateEffectiveClip() {
+        mEffectiveClip = mClipRect.ClipAgainst(mDamagePass);
     }
 
     void Renderer::SetFont(std::shared_ptr<Font> font) {
         std::shared_ptr<Font> newFont = font ? font : mDefaultFont;
         if (mBoundFont != newFont) {
-            FlushAndDraw(); // Flush with old font's texture (if any)
+            // No flush, glyphs from every font sample the same texture array
             mBoundFont = newFont;
+            mBoundFontLayers.clear();
+            GetBoundFontLayer(newFont, 0);
+        }
+    }
+
+    void Renderer::CollectFinishedGlyphs() {
+        bool landed = false;
+        for (const FontLayer& layer : mFontLayers) {
+            std::shared_ptr<Font> font = layer.font.lock();
+            if (font && layer.page == 0 && font->CollectFinishedGlyphs()) {
+                landed = true;
+            }
+        }
+        // Text with the new glyphs drew nothing for them, and could be anywhere
+        if (landed) {
+            InvalidateAll();
+        }
+    }
+
+    bool Renderer::HasPendingGlyphs() const {
+        for (const FontLayer& layer : mFontLayers) {
+            std::shared_ptr<Font> font = layer.font.lock();
+            if (font && layer.page == 0 && font->HasPendingGlyphs()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned int Renderer::GetBoundFontLayer(const std::shared_ptr<Font>& font, unsigned int page) {
+        if (page < mBoundFontLayers.size() && mBoundFontLayers[page] != NO_FONT_LAYER) {
+            return mBoundFontLayers[page];
+        }
+        unsigned int layer = GetFontLayer(font, page);
+        if (page >= mBoundFontLayers.size()) {
+            mBoundFontLayers.resize(page + 1, NO_FONT_LAYER);
+        }
+        mBoundFontLayers[page] = layer;
+        return layer;
+    }
+
+    unsigned int Renderer::GetFontLayer(const std::shared_ptr<Font>& font, unsigned int page) {
+        if (!font) {
+            return 0;
+        }
+        int freeLayer = -1;
+        for (size_t i = 0; i < mFontLayers.size(); ++i) {
+            std::shared_ptr<Font> layerFont = mFontLayers[i].font.lock();
+            if (layerFont == font && mFontLayers[i].page == page) {
+                return static_cast<unsigned int>(i);
+            }
+            if (!layerFont && freeLayer < 0) {
+                freeLayer = static_cast<int>(i);
+            }
+        }
+
+        if (freeLayer < 0 && mFontLayers.size() < MAX_FONT_LAYERS) {
+            freeLayer = static_cast<int>(mFontLayers.size());
+            mFontLayers.emplace_back();
+        }
+        if (freeLayer < 0) {
+            // Out of layers, take over the first one. Nothing queued may still sample it.
+            printf("Renderer: More than %u font atlas pages in use, reusing a font layer.\n", MAX_FONT_LAYERS);
+            FlushAndDraw();
+            freeLayer = 0;
+            std::fill(mBoundFontLayers.begin(), mBoundFontLayers.end(), NO_FONT_LAYER);
+        }
+        mFontLayers[freeLayer].font = font;
+        mFontLayers[freeLayer].page = page;
+        mFontLayers[freeLayer].uploadedVersion = 0;
+        mFontLayers[freeLayer].frameGlyphGeneration = font->GetGlyphGeneration();
+        return static_cast<unsigned int>(freeLayer);
+    }
+
+    void Renderer::SyncFontArray() {
+        unsigned int width = mFontArrayWidth;
+        unsigned int height = mFontArrayHeight;
+        for (const FontLayer& layer : mFontLayers) {
+            if (std::shared_ptr<Font> font = layer.font.lock()) {
+                width = std::max(width, font->GetAtlasTextureWidth());
+                height = std::max(height, font->GetAtlasTextureHeight());
+            }
+        }
+        unsigned int layers = std::max<unsigned int>(1, static_cast<unsigned int>(mFontLayers.size()));
+
+        if (mFontArrayTexture == 0) {
+            mGL->GenTextures(1, &mFontArrayTexture);
+            mFrameStats.glCalls += 1;
+        }
+        BindTexture(1, GL_TEXTURE_2D_ARRAY, mFontArrayTexture);
+
+        // Growing drops the contents, every layer is uploaded again below
+        if (width != mFontArrayWidth || height != mFontArrayHeight || layers > mFontArrayLayers) {
+            mFontArrayWidth = width;
+            mFontArrayHeight = height;
+            mFontArrayLayers = std::max(layers, mFontArrayLayers);
+            mGL->TexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, mFontArrayWidth, mFontArrayHeight, mFontArrayLayers, 0,
+                GL_RED, GL_UNSIGNED_BYTE, nullptr);
+            mGL->TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            mGL->TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            mGL->TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            mGL->TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            mFrameStats.glCalls += 5;
+            for (FontLayer& layer : mFontLayers) {
+                layer.uploadedVersion = 0;
+            }
+        }
+
+        std::vector<Font::AtlasRect> changes;
+        for (size_t i = 0; i < mFontLayers.size(); ++i) {
+            std::shared_ptr<Font> font = mFontLayers[i].font.lock();
+            unsigned int page = mFontLayers[i].page;
+            if (!font || page >= font->GetAtlasPageCount() || font->GetAtlasVersion(page) == mFontLayers[i].uploadedVersion) {
+                continue;
+            }
+
+            // Only the glyphs baked since the last upload, when the font can tell which those are
+            const std::vector<unsigned char>& pixels = font->GetAtlasPixels(page);
+            unsigned int atlasWidth = font->GetAtlasTextureWidth();
+            if (mFontLayers[i].uploadedVersion != 0 && font->GetAtlasChangesSince(page, mFontLayers[i].uploadedVersion, changes)) {
+                if (changes.size() > MAX_ATLAS_RECT_UPLOADS) {
+                    Font::AtlasRect bounds = changes[0];
+                    for (const Font::AtlasRect& rect : changes) {
+                        int right = std::max(bounds.x + bounds.width, rect.x + rect.width);
+                        int bottom = std::max(bounds.y + bounds.height, rect.y + rect.height);
+                        bounds.x = std::min(bounds.x, rect.x);
+                        bounds.y = std::min(bounds.y, rect.y);
+                        bounds.width = right - bounds.x;
+                        bounds.height = bottom - bounds.y;
+                    }
+                    changes.assign(1, bounds);
+                }
+                for (const Font::AtlasRect& rect : changes) {
+                    size_t rowBytes = static_cast<size_t>(rect.width);
+                    mAtlasUploadScratch.resize(rowBytes * rect.height);
+                    for (int row = 0; row < rect.height; ++row) {
+                        memcpy(&mAtlasUploadScratch[rowBytes * row],
+                            &pixels[static_cast<size_t>(rect.y + row) * atlasWidth + rect.x], rowBytes);
+                    }
+                    mGL->TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, rect.x, rect.y, static_cast<GLint>(i),
+                        rect.width, rect.height, 1, GL_RED, GL_UNSIGNED_BYTE, mAtlasUploadScratch.data());
+                    mFrameStats.glCalls += 1;
+                }
+            }
+            else {
+                mGL->TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(i),
+                    atlasWidth, font->GetAtlasTextureHeight(), 1,
+                    GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+                mFrameStats.glCalls += 1;
+            }
+            mFontLayers[i].uploadedVersion = font->GetAtlasVersion(page);
         }
     }
 
     void Renderer::SetClip(float x, float y, float w, float h) {
-        FlushAndDraw(); // Apply current draw calls with old clip
+        // Quads are clipped as they are added, so the batch can keep going across clip changes
         mClipRect = Rect(x, y, w, h);
+        UpdateEffectiveClip();
     }
 
     const Rect& Renderer::GetClip() const {
@@ -186,9 +497,9 @@ namespace TextEdit {
 
 
     void Renderer::ClearClip() {
-        FlushAndDraw(); // Apply current draw calls with old clip
         mClipRect = Rect(static_cast<float>(mViewportX), static_cast<float>(mViewportY),
             static_cast<float>(mViewportWidth), static_cast<float>(mViewportHeight));
+        UpdateEffectiveClip();
     }
 
 
@@ -204,37 +515,28 @@ namespace TextEdit {
             return;
         }
 
-        Vertex v;
-        v.r = r; v.g = g; v.b = b;
-        v.texFlag = 0.0f;
-        v.u = 0.0f; v.v = 0.0f;
-
-        // Top-left
-        v.x = clippedX; v.y = clippedY; mDrawBuffer.push_back(v);
-        // Bottom-left
-        v.x = clippedX; v.y = clippedY + clippedH; mDrawBuffer.push_back(v);
-        // Bottom-right
-        v.x = clippedX + clippedW; v.y = clippedY + clippedH; mDrawBuffer.push_back(v);
-
-        // Top-left
-        v.x = clippedX; v.y = clippedY; mDrawBuffer.push_back(v);
-        // Bottom-right
-        v.x = clippedX + clippedW; v.y = clippedY + clippedH; mDrawBuffer.push_back(v);
-        // Top-right
-        v.x = clippedX + clippedW; v.y = clippedY; mDrawBuffer.push_back(v);
+        PushQuad(clippedX, clippedY, clippedW, clippedH, 0.0f, 0.0f, 0.0f, 0.0f, r, g, b, 0);
     }
 
     void Renderer::DrawChar(char32_t character, float penX_baseline, float penY_baseline, float r, float g, float b) {
-        r = std::min(1.0f, std::max(0.0f, r * Styles::GlobalTint.r));
-        g = std::min(1.0f, std::max(0.0f, g * Styles::GlobalTint.g));
-        b = std::min(1.0f, std::max(0.0f, b * Styles::GlobalTint.b));
-
         std::shared_ptr<Font> currentFont = mBoundFont ? mBoundFont : mDefaultFont;
         if (!currentFont || !currentFont->IsValid()) {
             return;
         }
 
-        GlyphInfo glyph = currentFont->GetGlyph(character);
+        const GlyphInfo& glyph = currentFont->GetPositionedGlyph(character, penX_baseline);
+        DrawGlyph(glyph, penX_baseline, penY_baseline, r, g, b);
+    }
+
+    void Renderer::DrawGlyph(const GlyphInfo& glyph, float penX_baseline, float penY_baseline, float r, float g, float b) {
+        std::shared_ptr<Font> currentFont = mBoundFont ? mBoundFont : mDefaultFont;
+        if (!currentFont) {
+            return;
+        }
+
+        r = std::min(1.0f, std::max(0.0f, r * Styles::GlobalTint.r));
+        g = std::min(1.0f, std::max(0.0f, g * Styles::GlobalTint.g));
+        b = std::min(1.0f, std::max(0.0f, b * Styles::GlobalTint.b));
 
         if (!glyph.isValid || glyph.width <= 0 || glyph.height <= 0) {
             return;
@@ -267,19 +569,46 @@ namespace TextEdit {
             return;
         }
 
-        Vertex v;
-        v.r = r; v.g = g; v.b = b;
-        v.texFlag = 1.0f;
+        // Keeps the page from being evicted while this frame's quads may still sample it
+        currentFont->MarkAtlasPageUsed(glyph.page);
+        unsigned int layer = GetBoundFontLayer(currentFont, glyph.page);
+
+        // Texels of the font's own atlas, which sits in the corner of its (maybe bigger) layer
+        float atlasWidth = static_cast<float>(currentFont->GetAtlasTextureWidth());
+        float atlasHeight = static_cast<float>(currentFont->GetAtlasTextureHeight());
+        uint8_t flags = static_cast<uint8_t>(layer + 1);
+        if (currentFont->IsDistanceField()) {
+            flags |= QUAD_FLAG_DISTANCE_FIELD;
+        }
+        PushQuad(finalScreenX, finalScreenY, finalWidth, finalHeight,
+            u1_glyph * atlasWidth, v1_glyph * atlasHeight, u2_glyph * atlasWidth, v2_glyph * atlasHeight,
+            r, g, b, flags);
+    }
+
+    void Renderer::DrawImage(GLuint texture, float x, float y, float w, float h,
+        float u0, float v0, float u1, float v1, float r, float g, float b) {
+        if (texture == 0) {
+            return;
+        }
 
-        // Triangle 1
-        v.x = finalScreenX; v.y = finalScreenY; v.u = u1_glyph; v.v = v1_glyph; mDrawBuffer.push_back(v); // Top-Left
-        v.x = finalScreenX; v.y = finalScreenY + finalHeight; v.u = u1_glyph; v.v = v2_glyph; mDrawBuffer.push_back(v); // Bottom-Left
-        v.x = finalScreenX + finalWidth; v.y = finalScreenY + finalHeight; v.u = u2_glyph; v.v = v2_glyph; mDrawBuffer.push_back(v); // Bottom-Right
+        r = std::min(1.0f, std::max(0.0f, r * Styles::GlobalTint.r));
+        g = std::min(1.0f, std::max(0.0f, g * Styles::GlobalTint.g));
+        b = std::min(1.0f, std::max(0.0f, b * Styles::GlobalTint.b));
+        w *= mLayoutScale;
+        h *= mLayoutScale;
 
-        // Triangle 2
-        v.x = finalScreenX; v.y = finalScreenY; v.u = u1_glyph; v.v = v1_glyph; mDrawBuffer.push_back(v); // Top-Left
-        v.x = finalScreenX + finalWidth; v.y = finalScreenY + finalHeight; v.u = u2_glyph; v.v = v2_glyph; mDrawBuffer.push_back(v); // Bottom-Right
-        v.x = finalScreenX + finalWidth; v.y = finalScreenY; v.u = u2_glyph; v.v = v1_glyph; mDrawBuffer.push_back(v); // Top-Right
+        if (!ClipRectAgainstCurrent(x, y, w, h, &u0, &v0, &u1, &v1)) {
+            return;
+        }
+
+        // Images don't share a texture with the text, so they always go out in their own batch
+        FlushAndDraw();
+
+        PushQuad(x, y, w, h, u0, v0, u1, v1, r, g, b, QUAD_FLAG_IMAGE);
+
+        mImageTexture = texture;
+        FlushAndDraw();
+        mImageTexture = 0;
     }
 
     float Renderer::DrawText(const std::u32string& text, int startChar, int endChar,
@@ -321,9 +650,11 @@ namespace TextEdit {
                 continue;
             }
 
-            DrawChar(character, currentPenX, currentBaselineY, r, g, b);
-
-            GlyphInfo glyph = currentFont->GetGlyph(character);
+            // One lookup for both drawing and advancing, nothing bakes in between. The glyph may
+            // be a subpixel variant that is drawn from a snapped pen, the advance is the same.
+            float glyphPenX = currentPenX;
+            const GlyphInfo& glyph = currentFont->GetPositionedGlyph(character, glyphPenX);
+            DrawGlyph(glyph, glyphPenX, currentBaselineY, r, g, b);
             if (glyph.isValid) {
                 currentPenX += glyph.advance;
             }
@@ -332,75 +663,302 @@ namespace TextEdit {
         return (currentPenX - x_start) * mLayoutScale;
     }
 
+    void Renderer::DrawPositionedText(const std::u32string& text, const std::vector<float>& positions,
+        int startChar, int endChar, float x, float y_topLeft, float r, float g, float b) {
+        std::shared_ptr<Font> currentFont = mBoundFont ? mBoundFont : mDefaultFont;
+        if (!currentFont || !currentFont->IsValid()) {
+            return;
+        }
+
+        float baselineY = y_topLeft + currentFont->GetScaledAscent();
+        startChar = std::max(startChar, 0);
+        endChar = std::min(endChar, static_cast<int>(std::min(text.length(), positions.size())));
+        for (int i = startChar; i < endChar; ++i) {
+            char32_t character = text[i];
+            if (character == U'\t' || character == U'\n') {
+                continue;
+            }
+            float penX = x + positions[i];
+            const GlyphInfo& glyph = currentFont->GetPositionedGlyph(character, penX);
+            DrawGlyph(glyph, penX, baselineY, r, g, b);
+        }
+    }
+
+    void Renderer::PushQuad(float x, float y, float w, float h, float u0, float v0, float u1, float v1,
+        float r, float g, float b, uint8_t flags) {
+        // Round both edges rather than the size, so quads that touch keep touching
+        auto toFixed = [](float pixels) -> int {
+            return static_cast<int>(std::lround(pixels * QUAD_SUBPIXELS));
+        };
+        auto toUnorm16 = [](float value) -> uint16_t {
+            return static_cast<uint16_t>(std::lround(std::min(1.0f, std::max(0.0f, value)) * 65535.0f));
+        };
+        auto toUnorm8 = [](float value) -> uint8_t {
+            return static_cast<uint8_t>(std::lround(std::min(1.0f, std::max(0.0f, value)) * 255.0f));
+        };
+
+        int left = std::max(0, std::min(toFixed(x), 0xFFFF));
+        int top = std::max(0, std::min(toFixed(y), 0xFFFF));
+        int right = std::max(left, std::min(toFixed(x + w), 0xFFFF));
+        int bottom = std::max(top, std::min(toFixed(y + h), 0xFFFF));
+        if (right == left || bottom == top) {
+            return;
+        }
+
+        QuadInstance quad;
+        quad.x = static_cast<uint16_t>(left);
+        quad.y = static_cast<uint16_t>(top);
+        quad.width = static_cast<uint16_t>(right - left);
+        quad.height = static_cast<uint16_t>(bottom - top);
+        if (flags == QUAD_FLAG_IMAGE) {
+            quad.u0 = toUnorm16(u0);
+            quad.v0 = toUnorm16(v0);
+            quad.u1 = toUnorm16(u1);
+            quad.v1 = toUnorm16(v1);
+        }
+        else {
+            auto toTexel = [&](float texels) -> uint16_t {
+                return static_cast<uint16_t>(std::max(0, std::min(toFixed(texels), 0xFFFF)));
+            };
+            quad.u0 = toTexel(u0);
+            quad.v0 = toTexel(v0);
+            quad.u1 = toTexel(u1);
+            quad.v1 = toTexel(v1);
+        }
+        quad.r = toUnorm8(r);
+        quad.g = toUnorm8(g);
+        quad.b = toUnorm8(b);
+        quad.flags = flags;
+        mDrawBuffer.push_back(quad);
+    }
+
     void Renderer::FlushAndDraw() {
         if (mDrawBuffer.empty()) {
             return;
         }
+        PROFILE_SCOPE(RendererFlush);
+        PROFILE_COUNT(DrawCalls, 1);
+        PROFILE_COUNT(Quads, static_cast<unsigned int>(mDrawBuffer.size()));
+
+        // State stays bound until the end of the frame, these only reach GL on the first flush
+        SetBlend(true);
+        UseProgram(mProgram);
+        BindVertexArray(mVAO);
+        BindArrayBuffer(mVBO);
+        SetInstanceAttributes(UploadInstances());
+
+        // Texture binding, images on unit 0 and the font array on unit 1
+        SyncFontArray();
+        BindTexture(0, GL_TEXTURE_2D, mImageTexture);
+        SetUniform2f(mFontArraySizeLocation, mGLState.fontArraySize, static_cast<float>(mFontArrayWidth), static_cast<float>(mFontArrayHeight));
+        SetUniform2f(mViewportSizeLocation, mGLState.viewportSize, static_cast<float>(mViewportWidth), static_cast<float>(mViewportHeight));
+
+        mGL->DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(mDrawBuffer.size()));
+        mFrameStats.glCalls += 1;
+        mFrameStats.drawCalls += 1;
+        mFrameStats.quads += static_cast<unsigned int>(mDrawBuffer.size());
+
+        if (mImageTexture != 0) {
+            // Owners of images upload to them on whatever unit is active, don't leave one bound
+            BindTexture(0, GL_TEXTURE_2D, 0);
+        }
 
-        std::shared_ptr<Font> fontToUse = mBoundFont ? mBoundFont : mDefaultFont;
-        bool hasTexturedGlyphs = false;
-        for (const auto& vertex : mDrawBuffer) {
-            if (vertex.texFlag > 0.5f) {
-                hasTexturedGlyphs = true;
-                break;
-            }
+        mDrawBuffer.clear();
+    }
+
+    const Renderer::FrameStats& Renderer::GetLastFrameStats() const {
+        return mLastFrameStats;
+    }
+
+    GLBackend& Renderer::GetGL() {
+        return *mGL;
+    }
+
+    void Renderer::ResetGLStateCache() {
+        mGLState.program = GL_STATE_UNKNOWN;
+        mGLState.vertexArray = GL_STATE_UNKNOWN;
+        mGLState.arrayBuffer = GL_STATE_UNKNOWN;
+        mGLState.activeTexture = GL_STATE_UNKNOWN;
+        mGLState.textures[0] = GL_STATE_UNKNOWN;
+        mGLState.textures[1] = GL_STATE_UNKNOWN;
+        mGLState.blend = -1;
+        mGLState.viewportSize[0] = mGLState.viewportSize[1] = -1.0f;
+        mGLState.fontArraySize[0] = mGLState.fontArraySize[1] = -1.0f;
+    }
+
+    void Renderer::UseProgram(GLuint program) {
+        if (mGLState.program == program) {
+            mFrameStats.skippedCalls += 1;
+            return;
         }
+        mGL->UseProgram(program);
+        mGLState.program = program;
+        mFrameStats.glCalls += 1;
+    }
 
-        // If there are textured glyphs but no valid font/texture, we might have an issue.
-        if (hasTexturedGlyphs && (!fontToUse || !fontToUse->IsValid() || fontToUse->GetAtlasTextureHandle() == 0)) {
-            // Option 1: Clear only textured parts (complex)
-            // Option 2: Draw rects anyway, text won't show (current shader might show black for text)
-            // Option 3: Clear entire buffer (simplest, but loses rects)
-            // For now, let it try to draw. The shader will sample texture; if no texture bound, result is undefined (often black or white).
-            // A better check: if fontToUse or its texture is null, don't even try to bind/use it for text.
-            // printf("Warning: Flushing draw buffer with textured glyphs, but font/texture is not fully available.\n");
+    void Renderer::BindVertexArray(GLuint vertexArray) {
+        if (mGLState.vertexArray == vertexArray) {
+            mFrameStats.skippedCalls += 1;
+            return;
         }
+        mGL->BindVertexArray(vertexArray);
+        mGLState.vertexArray = vertexArray;
+        mFrameStats.glCalls += 1;
+    }
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        // glViewport already set in StartFrame
+    void Renderer::BindArrayBuffer(GLuint buffer) {
+        if (mGLState.arrayBuffer == buffer) {
+            mFrameStats.skippedCalls += 1;
+            return;
+        }
+        mGL->BindBuffer(GL_ARRAY_BUFFER, buffer);
+        mGLState.arrayBuffer = buffer;
+        mFrameStats.glCalls += 1;
+    }
 
-        glUseProgram(mProgram);
-        glBindVertexArray(mVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    void Renderer::BindTexture(unsigned int unit, GLenum target, GLuint texture) {
+        if (mGLState.textures[unit] == texture) {
+            mFrameStats.skippedCalls += 1;
+            return;
+        }
+        if (mGLState.activeTexture != GL_TEXTURE0 + unit) {
+            mGL->ActiveTexture(GL_TEXTURE0 + unit);
+            mGLState.activeTexture = GL_TEXTURE0 + unit;
+            mFrameStats.glCalls += 1;
+        }
+        mGL->BindTexture(target, texture);
+        mGLState.textures[unit] = texture;
+        mFrameStats.glCalls += 1;
+    }
 
-        // Texture binding
-        if (hasTexturedGlyphs && fontToUse && fontToUse->IsValid() && fontToUse->GetAtlasTextureHandle() != 0) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, fontToUse->GetAtlasTextureHandle());
-            GLint texLoc = glGetUniformLocation(mProgram, "uTexture");
-            if (texLoc != -1) glUniform1i(texLoc, 0);
+    void Renderer::SetBlend(bool enabled) {
+        if (mGLState.blend == (enabled ? 1 : 0)) {
+            mFrameStats.skippedCalls += 1;
+            return;
+        }
+        if (enabled) {
+            mGL->Enable(GL_BLEND);
+            mGL->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            mFrameStats.glCalls += 2;
         }
-        else if (hasTexturedGlyphs) {
-            // This case means we expected a texture but couldn't bind one.
-            // Drawing will likely be incorrect for textured parts.
+        else {
+            mGL->Disable(GL_BLEND);
+            mFrameStats.glCalls += 1;
         }
+        mGLState.blend = enabled ? 1 : 0;
+    }
 
+    void Renderer::SetUniform2f(GLint location, float cached[2], float x, float y) {
+        if (location == -1) {
+            return;
+        }
+        if (cached[0] == x && cached[1] == y) {
+            mFrameStats.skippedCalls += 1;
+            return;
+        }
+        mGL->Uniform2f(location, x, y); // Program must be in use
+        cached[0] = x;
+        cached[1] = y;
+        mFrameStats.glCalls += 1;
+    }
 
-        glBufferData(GL_ARRAY_BUFFER, mDrawBuffer.size() * sizeof(Vertex),
-            mDrawBuffer.data(), GL_STREAM_DRAW); // Use STREAM_DRAW for buffer that changes every frame
+    size_t Renderer::UploadInstances() {
+        size_t bytes = mDrawBuffer.size() * sizeof(QuadInstance);
+        if (mRingOffset + bytes > mRingRegionBytes) {
+            // Outgrew the region. Fresh storage has nothing in flight, so the fences can go, and
+            // draws already issued this frame keep reading from the orphaned old storage.
+            size_t frameBytes = mRingOffset + bytes; // Sized for all of this frame, so the next one fits
+            while (mRingRegionBytes < frameBytes) {
+                mRingRegionBytes *= 2;
+            }
+            mGL->BufferData(GL_ARRAY_BUFFER, mRingRegionBytes * RING_BUFFER_FRAMES, nullptr, GL_DYNAMIC_DRAW);
+            mFrameStats.glCalls += 1;
+            for (unsigned int i = 0; i < RING_BUFFER_FRAMES; ++i) {
+                if (mRingFences[i]) {
+                    mGL->DeleteSync(mRingFences[i]);
+                    mFrameStats.glCalls += 1;
+                    mRingFences[i] = 0;
+                }
+            }
+            mRingOffset = 0;
+            mRingRegionSynced = true;
+        }
 
-        GLint viewportSizeLoc = glGetUniformLocation(mProgram, "uViewportSize");
-        if (viewportSizeLoc != -1) glUniform2f(viewportSizeLoc, static_cast<float>(mViewportWidth), static_cast<float>(mViewportHeight));
+        size_t offset = mRingRegion * mRingRegionBytes + mRingOffset;
+#ifdef __EMSCRIPTEN__
+        // WebGL2 has no buffer mapping, and the browser already keeps sub data uploads in order
+        mGL->BufferSubData(GL_ARRAY_BUFFER, offset, bytes, mDrawBuffer.data());
+        mFrameStats.glCalls += 1;
+#else
+        // The fence in AdvanceRingBuffer made sure the GPU is done with this range. If it couldn't,
+        // the sub data upload below lets the driver wait for whatever still reads it.
+        void* mapped = nullptr;
+        if (mRingRegionSynced) {
+            mapped = mGL->MapBufferRange(GL_ARRAY_BUFFER, offset, bytes,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        }
+        if (mapped) {
+            memcpy(mapped, mDrawBuffer.data(), bytes);
+            mGL->UnmapBuffer(GL_ARRAY_BUFFER);
+            mFrameStats.glCalls += 2;
+        }
+        else {
+            mGL->BufferSubData(GL_ARRAY_BUFFER, offset, bytes, mDrawBuffer.data());
+            mFrameStats.glCalls += 2;
+        }
+#endif
+        mRingOffset += bytes;
+        return offset;
+    }
 
-        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(mDrawBuffer.size()));
+    void Renderer::SetInstanceAttributes(size_t byteOffset) {
+        GLsizei stride = sizeof(QuadInstance);
+        const char* base = reinterpret_cast<const char*>(byteOffset);
+        // Rect (vec4, fixed point)
+        mGL->VertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_FALSE, stride, base + offsetof(QuadInstance, x));
+        // UV (vec4, texels or normalized depending on the flags)
+        mGL->VertexAttribPointer(1, 4, GL_UNSIGNED_SHORT, GL_FALSE, stride, base + offsetof(QuadInstance, u0));
+        // Color and flags (vec4, normalized)
+        mGL->VertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, base + offsetof(QuadInstance, r));
+        mFrameStats.glCalls += 3;
+    }
 
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glUseProgram(0);
-        glDisable(GL_BLEND);
+    void Renderer::AdvanceRingBuffer() {
+        mRingRegion = (mRingRegion + 1) % RING_BUFFER_FRAMES;
+        mRingOffset = 0;
+        mRingRegionSynced = true;
+        if (mRingFences[mRingRegion]) {
+            // Normally signaled long ago, this only waits if the GPU is several frames behind
+            GLenum waited = mGL->ClientWaitSync(mRingFences[mRingRegion], GL_SYNC_FLUSH_COMMANDS_BIT, RING_BUFFER_FENCE_TIMEOUT_NS);
+            if (waited != GL_ALREADY_SIGNALED && waited != GL_CONDITION_SATISFIED) {
+                // Timed out or failed, the GPU may still read the region, so this frame can't write it unsynchronized
+                printf("Renderer: Waiting for a frame in flight failed (0x%X), uploading synchronized.\n", waited);
+                mRingRegionSynced = false;
+            }
+            mGL->DeleteSync(mRingFences[mRingRegion]);
+            mRingFences[mRingRegion] = 0;
+            mFrameStats.glCalls += 2;
+        }
+    }
 
-        mDrawBuffer.clear();
+    void Renderer::FenceRingBuffer() {
+#ifndef __EMSCRIPTEN__
+        if (mRingFences[mRingRegion]) {
+            mGL->DeleteSync(mRingFences[mRingRegion]);
+            mFrameStats.glCalls += 1;
+        }
+        mRingFences[mRingRegion] = mGL->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        mFrameStats.glCalls += 1;
+#endif
     }
 
     bool Renderer::ClipRectAgainstCurrent(float& inoutX, float& inoutY, float& inoutW, float& inoutH,
         float* u1, float* v1, float* u2, float* v2) {
 
-        // mClipRect is the master clipping rectangle for the current state.
+        // mEffectiveClip is the master clipping rectangle for the current state (clip and damage pass).
         // itemRect is the rectangle of the item we want to draw.
         Rect itemRect(inoutX, inoutY, inoutW, inoutH);
-        Rect clippedRect = itemRect.ClipAgainst(mClipRect);
+        Rect clippedRect = itemRect.ClipAgainst(mEffectiveClip);
 
         if (clippedRect.width <= 0.0f || clippedRect.height <= 0.0f) {
             return false; // Fully clipped
@@ -446,55 +1004,130 @@ namespace TextEdit {
 
 
     bool Renderer::InitGLResources() {
-        mProgram = CreateProgram(gVertexShader, gFragmentShader);
+        mProgram = mGL->CreateProgram(gVertexShader, gFragmentShader);
         if (mProgram == 0) return false;
 
-        glGenVertexArrays(1, &mVAO);
+        mGL->GenVertexArrays(1, &mVAO);
         if (mVAO == 0) {
-            glDeleteProgram(mProgram); mProgram = 0; return false;
+            mGL->DeleteProgram(mProgram); mProgram = 0; return false;
         }
 
-        glGenBuffers(1, &mVBO);
+        mGL->GenBuffers(1, &mVBO);
         if (mVBO == 0) {
-            glDeleteVertexArrays(1, &mVAO); mVAO = 0;
-            glDeleteProgram(mProgram); mProgram = 0;
+            mGL->DeleteVertexArrays(1, &mVAO); mVAO = 0;
+            mGL->DeleteProgram(mProgram); mProgram = 0;
             return false;
         }
 
-        glBindVertexArray(mVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+        mGL->BindVertexArray(mVAO);
+        mGL->BindBuffer(GL_ARRAY_BUFFER, mVBO);
+        mGL->BufferData(GL_ARRAY_BUFFER, mRingRegionBytes * RING_BUFFER_FRAMES, nullptr, GL_DYNAMIC_DRAW);
+
+        static_assert(sizeof(QuadInstance) == 20, "QuadInstance should be tightly packed");
+
+        // All attributes advance once per quad, not per vertex. Pointers are re-set per
+        // flush, since every flush lands at a different offset of the ring buffer.
+        for (GLuint attribute = 0; attribute < 3; ++attribute) {
+            mGL->EnableVertexAttribArray(attribute);
+            mGL->VertexAttribDivisor(attribute, 1);
+        }
+        SetInstanceAttributes(0);
+
+        mGL->BindVertexArray(0);
+        mGL->BindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Font atlas rows are single bytes, the default 4 byte row alignment would skew odd widths
+        mGL->PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        // Samplers never change units, and the rest of the uniforms are only looked up once
+        mGL->UseProgram(mProgram);
+        GLint textureLocation = mGL->GetUniformLocation(mProgram, "uTexture");
+        if (textureLocation != -1) mGL->Uniform1i(textureLocation, 0);
+        GLint fontArrayLocation = mGL->GetUniformLocation(mProgram, "uFontArray");
+        if (fontArrayLocation != -1) mGL->Uniform1i(fontArrayLocation, 1);
+        mViewportSizeLocation = mGL->GetUniformLocation(mProgram, "uViewportSize");
+        mFontArraySizeLocation = mGL->GetUniformLocation(mProgram, "uFontArraySize");
+        mGL->UseProgram(0);
+
+        ResetGLStateCache();
+        return true;
+    }
+
+    bool Renderer::ResizeBackBuffer(unsigned int width, unsigned int height) {
+        if (width == mBackBufferWidth && height == mBackBufferHeight) {
+            return mBackBufferFBO != 0; // Don't retry a size that failed before
+        }
+        mBackBufferWidth = width;
+        mBackBufferHeight = height;
+        mFullDamage = true; // Resized back buffer contents are undefined
 
-        GLsizei stride = sizeof(Vertex);
+        if (width == 0 || height == 0) {
+            return false;
+        }
 
-        // Position (vec2)
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, x));
-        // Color (vec3)
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, r));
-        // TexFlag (float)
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, texFlag));
-        // UV (vec2)
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(Vertex, u));
+        if (mBackBufferTexture == 0) {
+            mGL->GenTextures(1, &mBackBufferTexture);
+        }
+        if (mBackBufferFBO == 0) {
+            mGL->GenFramebuffers(1, &mBackBufferFBO);
+        }
 
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mGL->BindTexture(GL_TEXTURE_2D, mBackBufferTexture);
+        mGL->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        mGL->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        mGL->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        mGL->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        mGL->TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        mGL->BindTexture(GL_TEXTURE_2D, 0);
+
+        mGL->BindFramebuffer(GL_FRAMEBUFFER, mBackBufferFBO);
+        mGL->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mBackBufferTexture, 0);
+        GLenum status = mGL->CheckFramebufferStatus(GL_FRAMEBUFFER);
+        mGL->BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Renderer: Back buffer incomplete (0x%x), drawing every frame in full.\n", status);
+            mGL->DeleteFramebuffers(1, &mBackBufferFBO);
+            mGL->DeleteTextures(1, &mBackBufferTexture);
+            mBackBufferFBO = 0;
+            mBackBufferTexture = 0;
+            return false;
+        }
         return true;
     }
 
     void Renderer::CleanGLResources() {
+        if (mGL == nullptr) {
+            return; // Never created through Create, so nothing was allocated
+        }
+        if (mBackBufferFBO) {
+            mGL->DeleteFramebuffers(1, &mBackBufferFBO);
+            mBackBufferFBO = 0;
+        }
+        if (mBackBufferTexture) {
+            mGL->DeleteTextures(1, &mBackBufferTexture);
+            mBackBufferTexture = 0;
+        }
+        for (unsigned int i = 0; i < RING_BUFFER_FRAMES; ++i) {
+            if (mRingFences[i]) {
+                mGL->DeleteSync(mRingFences[i]);
+                mRingFences[i] = 0;
+            }
+        }
+        if (mFontArrayTexture) {
+            mGL->DeleteTextures(1, &mFontArrayTexture);
+            mFontArrayTexture = 0;
+        }
         if (mVBO) {
-            glDeleteBuffers(1, &mVBO);
+            mGL->DeleteBuffers(1, &mVBO);
             mVBO = 0;
         }
         if (mVAO) {
-            glDeleteVertexArrays(1, &mVAO);
+            mGL->DeleteVertexArrays(1, &mVAO);
             mVAO = 0;
         }
         if (mProgram) {
-            glDeleteProgram(mProgram);
+            mGL->DeleteProgram(mProgram);
             mProgram = 0;
         }
         // mDefaultFont is a shared_ptr, will be managed automatically.
@@ -7,9 +7,9 @@
 #include <cstddef>
 #include <cstdint>
 
-#ifdef _WIN32
+#ifndef __EMSCRIPTEN__
 #include "glad.h"
-#endif // _WIN32
+#endif // !__EMSCRIPTEN__
 
 #ifdef __EMSCRIPTEN__
 #define GL_GLEXT_PROTOTYPES 1
@@ -20,6 +20,8 @@
 #include <SDL_syswm.h>
 #endif
 
+#include "GLBackend.h"
+
 extern unsigned int Roboto_Size;
 extern unsigned char Roboto[];
 extern unsigned int NotoEmoji_Size;
@@ -62,19 +64,34 @@ namespace TextEdit {
             }
             return Rect(x1, y1, x2 - x1, y2 - y1);
         }
+
+        inline Rect Union(const Rect& other) const {
+            float x1 = std::min(x, other.x);
+            float y1 = std::min(y, other.y);
+            float x2 = std::max(x + width, other.x + other.width);
+            float y2 = std::max(y + height, other.y + other.height);
+            return Rect(x1, y1, x2 - x1, y2 - y1);
+        }
     };
 
     class Font;
+    struct GlyphInfo;
 
-    struct Vertex {
-        float x;
-        float y;
-        float r;
-        float g;
-        float b;
-        float texFlag;  // 0.0 = no texture, 1.0 = use texture
-        float u;
-        float v;
+    // One rect, glyph or image. The vertex shader expands it into the four corners of a
+    // triangle strip, so a glyph costs 20 bytes instead of six full vertices.
+    struct QuadInstance {
+        uint16_t x;      // Position and size are fixed point, see QUAD_SUBPIXELS in Renderer.cpp
+        uint16_t y;
+        uint16_t width;
+        uint16_t height;
+        uint16_t u0;     // Font atlas texels in the same fixed point for glyphs, normalized for images
+        uint16_t v0;
+        uint16_t u1;
+        uint16_t v1;
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t flags;   // 0 for a solid rect, QUAD_FLAG_IMAGE, or the glyph's font layer + 1 (+ 128 for distance fields)
     };
 
     class Renderer {
@@ -88,8 +105,18 @@ namespace TextEdit {
         GLuint mVBO;
         GLuint mVAO;
 
-        // draw buffer
-        std::vector<Vertex> mDrawBuffer;
+        // Instances stream through mVBO, which is split into one region per frame in flight. A region
+        // is only written again once the fence from the frame that last used it has passed, so uploads
+        // are plain sub-allocations. The storage is only reallocated if a frame outgrows its region.
+        static constexpr unsigned int RING_BUFFER_FRAMES = 3;
+        size_t mRingRegionBytes;
+        unsigned int mRingRegion; // Region the current frame writes to
+        size_t mRingOffset;       // Next free byte in the current region
+        GLsync mRingFences[RING_BUFFER_FRAMES];
+        bool mRingRegionSynced;   // The GPU is done with the current region, false if waiting for its fence failed
+
+        // draw buffer, one instance per quad
+        std::vector<QuadInstance> mDrawBuffer;
 
         // viewport
         unsigned int mViewportX;
@@ -99,25 +126,98 @@ namespace TextEdit {
 
         float mLayoutScale; // User scale, applied after DPI adjustments
 
+        // Damage tracking. The frame is rendered into a persistent back buffer, only the
+        // damaged regions of it are cleared and re-drawn. Each damage rect is one pass.
+        std::vector<Rect> mDamageRects;
+        bool mFullDamage;
+        Rect mDamagePass;     // Damage rect of the current pass
+        Rect mEffectiveClip;  // mClipRect intersected with mDamagePass, what draw calls are clipped against
+
+        GLuint mBackBufferFBO;
+        GLuint mBackBufferTexture;
+        unsigned int mBackBufferWidth;
+        unsigned int mBackBufferHeight;
+
+        GLuint mImageTexture; // Bound next to the font atlases while DrawImage flushes
+
+        // Every page of every font's atlas is a layer of one texture array, so text in different fonts
+        // can share a batch. The array is as big as the biggest atlas, glyphs carry the layer they sample.
+        struct FontLayer {
+            std::weak_ptr<Font> font;
+            unsigned int page = 0;
+            unsigned int uploadedVersion = 0;
+            unsigned int frameGlyphGeneration = 0; // Page 0 only, the font's glyph generation when the frame started
+        };
+        std::vector<FontLayer> mFontLayers;
+        std::vector<unsigned char> mAtlasUploadScratch; // Changed atlas rects are copied here to upload them tightly packed
+        std::vector<unsigned int> mBoundFontLayers; // Layer of each page of the bound font, looked up as glyphs from it are drawn
+        GLuint mFontArrayTexture;
+        unsigned int mFontArrayWidth;
+        unsigned int mFontArrayHeight;
+        unsigned int mFontArrayLayers;
+
+        // Shadow of the GL state the renderer sets, so binding what is already bound costs nothing.
+        // Reset at the start of every frame, other code is free to change GL state between frames.
+        struct GLStateCache {
+            GLuint program;
+            GLuint vertexArray;
+            GLuint arrayBuffer;
+            GLenum activeTexture;
+            GLuint textures[2]; // Unit 0 holds GL_TEXTURE_2D images, unit 1 the GL_TEXTURE_2D_ARRAY of fonts
+            int blend;          // -1 when unknown
+            float viewportSize[2];
+            float fontArraySize[2];
+        };
+        GLStateCache mGLState;
+        GLint mViewportSizeLocation; // Looked up once in InitGLResources
+        GLint mFontArraySizeLocation;
+
+        std::shared_ptr<GLBackend> mGL; // Every GL call goes through here
+
         Renderer(const Renderer&) = delete;
         Renderer& operator=(const Renderer&) = delete;
     public:
         Renderer();
-        static std::shared_ptr<Renderer> Create(float dpi, std::shared_ptr<Font> defaultFont = nullptr);
+        // Without a backend the renderer draws with the current OpenGL context
+        static std::shared_ptr<Renderer> Create(float dpi, std::shared_ptr<Font> defaultFont = nullptr,
+            std::shared_ptr<GLBackend> backend = nullptr);
         virtual ~Renderer();
 
         void StartFrame(unsigned int viewport_x, unsigned int viewport_y,
             unsigned int viewport_width, unsigned int viewport_height);
         void EndFrame();
 
+        // Mark a region of the screen as changed. Regions close to each other are merged, if
+        // there are too many they collapse into their bounding rect.
+        void Invalidate(const Rect& area);
+        inline void Invalidate(float x, float y, float w, float h) {
+            Invalidate(Rect(x, y, w, h));
+        }
+        void InvalidateAll();
+        bool HasDamage() const;
+
+        // Between StartFrame and EndFrame the frame is drawn once per damage rect. Each
+        // pass clears nothing by itself, but clips (and scissors) all drawing to its rect.
+        unsigned int GetDamagePassCount() const;
+        void StartDamagePass(unsigned int pass);
+
         void SetFont(std::shared_ptr<Font> font);
 
+        // Glyphs rasterized in the background since the last call go into their atlases, and the
+        // whole frame is invalidated if any did. StartFrame does this too, call it earlier to find
+        // out whether there is anything to draw. HasPendingGlyphs is true while workers are busy.
+        void CollectFinishedGlyphs();
+        bool HasPendingGlyphs() const;
+
         void SetClip(float x, float y, float w, float h);
         const Rect& GetClip() const;
         void ClearClip();
 
         void DrawRect(float x, float y, float w, float h, float r, float g, float b);
         void DrawChar(char32_t character, float x, float y, float r, float g, float b);
+        // Same as DrawChar, for callers that looked the glyph up once and keep drawing it.
+        // The glyph must come from the bound font, and be refreshed when its generation changes.
+        void DrawGlyph(const GlyphInfo& glyph, float x, float y, float r, float g, float b);
         
         float DrawText(const std::u32string& text, int startChar, int onePastEndChar,
             float x, float y, float r, float g, float b,
@@ -128,15 +228,59 @@ namespace TextEdit {
             return DrawText(text, 0, (int)text.length(), x, y, r, g, b, lineStartX);
         }
 
+        // Draws text[startChar, onePastEndChar) with every character at x plus its entry in positions,
+        // which already has kerning and tabs applied (see LineLayoutCache). Nothing is measured here.
+        void DrawPositionedText(const std::u32string& text, const std::vector<float>& positions,
+            int startChar, int onePastEndChar, float x, float y, float r, float g, float b);
+
+        // Draws part of a caller owned RGBA texture. Color is multiplied with the texture, and alpha comes from it.
+        void DrawImage(GLuint texture, float x, float y, float w, float h,
+            float u0 = 0.0f, float v0 = 0.0f, float u1 = 1.0f, float v1 = 1.0f,
+            float r = 1.0f, float g = 1.0f, float b = 1.0f);
+
         inline void SetLayoutScale(float scl) {
             mLayoutScale = scl;
         }
+
+        // What the renderer sent to GL during the last drawn frame
+        struct FrameStats {
+            unsigned int glCalls = 0;      // Everything, including state changes and uploads
+            unsigned int skippedCalls = 0; // State changes dropped because GL already had that state
+            unsigned int drawCalls = 0;
+            unsigned int quads = 0;
+        };
+        const FrameStats& GetLastFrameStats() const;
+
+        // For code outside the renderer that owns GL objects, like the minimap's tiles
+        GLBackend& GetGL();
     private:
+        FrameStats mFrameStats;
+        FrameStats mLastFrameStats;
+
+        void ResetGLStateCache();
+        void UseProgram(GLuint program);
+        void BindVertexArray(GLuint vertexArray);
+        void BindArrayBuffer(GLuint buffer);
+        void BindTexture(unsigned int unit, GLenum target, GLuint texture);
+        void SetBlend(bool enabled);
+        void SetUniform2f(GLint location, float cached[2], float x, float y);
+
         void FlushAndDraw();
+        size_t UploadInstances(); // Copies mDrawBuffer into the ring buffer, returns its byte offset
+        void SetInstanceAttributes(size_t byteOffset);
+        void AdvanceRingBuffer();
+        void FenceRingBuffer();
+        void PushQuad(float x, float y, float w, float h, float u0, float v0, float u1, float v1,
+            float r, float g, float b, uint8_t flags); // Expects clipped, tinted input
+        unsigned int GetFontLayer(const std::shared_ptr<Font>& font, unsigned int page);
+        unsigned int GetBoundFontLayer(const std::shared_ptr<Font>& font, unsigned int page);
+        void SyncFontArray(); // Uploads atlases that changed since the last flush
         bool ClipRectAgainstCurrent(float& inoutX, float& inoutY, float& inoutW, float& inoutH,
             float* u1 = nullptr, float* v1 = nullptr,
             float* u2 = nullptr, float* v2 = nullptr);
         bool InitGLResources();
         void CleanGLResources();
+        bool ResizeBackBuffer(unsigned int width, unsigned int height);
+        void UpdateEffectiveClip();
     };
 }
\ No newline at end of file
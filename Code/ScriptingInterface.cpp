@@ -1,5 +1,6 @@
 #include "ScriptingInterface.h"
 #include "srell.hpp"
+#include "Profiler.h"
 #include <iostream>
 #include <sstream>
 #include <cstdarg>
@@ -108,6 +109,7 @@ namespace TextEdit {
 
     bool ScriptingInterface::ExecuteScript(const std::string& script) {
         if (!L) return false;
+        PROFILE_SCOPE(Script);
 
         if (luaL_loadstring(L, script.c_str()) != LUA_OK) {
             // Get the error message
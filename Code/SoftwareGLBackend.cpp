@@ -0,0 +1,774 @@
+#include "SoftwareGLBackend.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring> // for memcpy
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_GL_SSE2 1
+#endif
+
+namespace TextEdit {
+    // dst = src * srcAlpha + dst * (1 - srcAlpha) for all four channels, which is what
+    // glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) does. (t + 128 + ((t + 128) >> 8)) >> 8 is
+    // t / 255 rounded for everything the blend can produce, the scalar tail uses the same math so
+    // both paths give identical pixels.
+    static void SoftwareBlendSpan(unsigned char* dst, const unsigned char* src, size_t pixels) {
+        size_t i = 0;
+#ifdef SOFTWARE_GL_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i full = _mm_set1_epi16(255);
+        const __m128i half = _mm_set1_epi16(128);
+        for (; i + 4 <= pixels; i += 4) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i * 4));
+
+            // Two pixels per register, 16 bits per channel
+            __m128i sLo = _mm_unpacklo_epi8(s, zero);
+            __m128i sHi = _mm_unpackhi_epi8(s, zero);
+            __m128i dLo = _mm_unpacklo_epi8(d, zero);
+            __m128i dHi = _mm_unpackhi_epi8(d, zero);
+            __m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+            // At most 255 * 255 + 128 + 254, fits 16 unsigned bits
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(sLo, aLo), _mm_mullo_epi16(dLo, _mm_sub_epi16(full, aLo))), half);
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(sHi, aHi), _mm_mullo_epi16(dHi, _mm_sub_epi16(full, aHi))), half);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; i < pixels; ++i) {
+            unsigned int alpha = src[i * 4 + 3];
+            for (unsigned int c = 0; c < 4; ++c) {
+                unsigned int t = src[i * 4 + c] * alpha + dst[i * 4 + c] * (255 - alpha) + 128;
+                dst[i * 4 + c] = static_cast<unsigned char>((t + (t >> 8)) >> 8);
+            }
+        }
+    }
+
+    static inline unsigned char SoftwareToByte(float value) {
+        value = std::min(std::max(value, 0.0f), 1.0f);
+        return static_cast<unsigned char>(value * 255.0f + 0.5f);
+    }
+
+    // u and v are in texels, clamped to the edge like GL_CLAMP_TO_EDGE. Output is 0 to 1, one channel
+    // textures give (r, 0, 0, 1).
+    static void SoftwareSample(const unsigned char* pixels, GLsizei width, GLsizei height, unsigned int channels,
+        bool linear, float u, float v, float out[4]) {
+        out[1] = out[2] = 0.0f;
+        out[3] = 1.0f;
+        if (!linear) {
+            GLsizei x = std::min(std::max(static_cast<GLsizei>(std::floor(u)), 0), width - 1);
+            GLsizei y = std::min(std::max(static_cast<GLsizei>(std::floor(v)), 0), height - 1);
+            const unsigned char* texel = pixels + (static_cast<size_t>(y) * width + x) * channels;
+            for (unsigned int c = 0; c < channels; ++c) {
+                out[c] = texel[c] / 255.0f;
+            }
+            return;
+        }
+
+        u -= 0.5f;
+        v -= 0.5f;
+        float fx = std::floor(u);
+        float fy = std::floor(v);
+        float wx = u - fx;
+        float wy = v - fy;
+        GLsizei x0 = std::min(std::max(static_cast<GLsizei>(fx), 0), width - 1);
+        GLsizei y0 = std::min(std::max(static_cast<GLsizei>(fy), 0), height - 1);
+        GLsizei x1 = std::min(std::max(static_cast<GLsizei>(fx) + 1, 0), width - 1);
+        GLsizei y1 = std::min(std::max(static_cast<GLsizei>(fy) + 1, 0), height - 1);
+        const unsigned char* t00 = pixels + (static_cast<size_t>(y0) * width + x0) * channels;
+        const unsigned char* t10 = pixels + (static_cast<size_t>(y0) * width + x1) * channels;
+        const unsigned char* t01 = pixels + (static_cast<size_t>(y1) * width + x0) * channels;
+        const unsigned char* t11 = pixels + (static_cast<size_t>(y1) * width + x1) * channels;
+        for (unsigned int c = 0; c < channels; ++c) {
+            float top = t00[c] + (t10[c] - t00[c]) * wx;
+            float bottom = t01[c] + (t11[c] - t01[c]) * wx;
+            out[c] = (top + (bottom - top) * wy) / 255.0f;
+        }
+    }
+
+    std::shared_ptr<SoftwareGLBackend> SoftwareGLBackend::Create(unsigned int width, unsigned int height) {
+        return std::make_shared<SoftwareGLBackend>(width, height);
+    }
+
+    SoftwareGLBackend::SoftwareGLBackend(unsigned int width, unsigned int height)
+        : mWidth(0),
+        mHeight(0),
+        mNextName(1),
+        mBoundArrayBuffer(0),
+        mReadFramebuffer(0),
+        mDrawFramebuffer(0),
+        mActiveTexture(0),
+        mUnpackAlignment(4),
+        mBlend(false),
+        mScissorTest(false) {
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; ++i) {
+            mBoundTextures[i] = 0;
+            mBoundTextureArrays[i] = 0;
+        }
+        for (unsigned int i = 0; i < 4; ++i) {
+            mClearColor[i] = 0.0f;
+        }
+        Resize(width, height);
+    }
+
+    void SoftwareGLBackend::Resize(unsigned int width, unsigned int height) {
+        mWidth = width;
+        mHeight = height;
+        mPixels.assign(static_cast<size_t>(width) * height * 4, 0);
+        mViewport[0] = mViewport[1] = 0;
+        mViewport[2] = static_cast<GLint>(width);
+        mViewport[3] = static_cast<GLint>(height);
+        mScissor[0] = mScissor[1] = 0;
+        mScissor[2] = static_cast<GLint>(width);
+        mScissor[3] = static_cast<GLint>(height);
+    }
+
+    unsigned int SoftwareGLBackend::GetWidth() const {
+        return mWidth;
+    }
+
+    unsigned int SoftwareGLBackend::GetHeight() const {
+        return mHeight;
+    }
+
+    const unsigned char* SoftwareGLBackend::GetPixels() const {
+        return mPixels.data();
+    }
+
+    SoftwareGLBackend::Texture* SoftwareGLBackend::GetUnitTexture(GLenum target, int unit) {
+        if (unit < 0 || unit >= static_cast<int>(MAX_TEXTURE_UNITS)) {
+            return nullptr;
+        }
+        GLuint name = (target == GL_TEXTURE_2D_ARRAY) ? mBoundTextureArrays[unit] : mBoundTextures[unit];
+        auto it = mTextures.find(name);
+        return (it != mTextures.end()) ? &it->second : nullptr;
+    }
+
+    SoftwareGLBackend::Texture* SoftwareGLBackend::GetBoundTexture(GLenum target) {
+        return GetUnitTexture(target, static_cast<int>(mActiveTexture));
+    }
+
+    SoftwareGLBackend::Target SoftwareGLBackend::GetTarget(GLuint framebuffer) {
+        if (framebuffer != 0) {
+            auto fbo = mFramebuffers.find(framebuffer);
+            if (fbo != mFramebuffers.end()) {
+                auto texture = mTextures.find(fbo->second);
+                if (texture != mTextures.end() && texture->second.channels == 4 && !texture->second.pixels.empty()) {
+                    return { texture->second.pixels.data(), texture->second.width, texture->second.height };
+                }
+            }
+            return { nullptr, 0, 0 };
+        }
+        return { mPixels.data(), static_cast<GLint>(mWidth), static_cast<GLint>(mHeight) };
+    }
+
+    float SoftwareGLBackend::GetUniform(const char* name, unsigned int component) const {
+        auto it = mUniformLocations.find(name);
+        if (it == mUniformLocations.end()) {
+            return 0.0f;
+        }
+        return mUniforms[static_cast<size_t>(it->second) * 2 + component];
+    }
+
+    void SoftwareGLBackend::ReadAttribute(const DrawState& state, unsigned int index, GLsizei instance, float out[4]) const {
+        out[0] = out[1] = out[2] = 0.0f;
+        out[3] = 1.0f;
+        const std::vector<unsigned char>* buffer = state.buffers[index];
+        if (buffer == nullptr) {
+            return;
+        }
+        const Attribute& attribute = mAttributes[index];
+        size_t componentBytes = (attribute.type == GL_UNSIGNED_BYTE) ? 1 : (attribute.type == GL_UNSIGNED_SHORT) ? 2 : 4;
+        size_t start = attribute.offset + static_cast<size_t>(attribute.stride) * instance;
+        if (start + componentBytes * attribute.size > buffer->size()) {
+            return;
+        }
+        const unsigned char* data = buffer->data() + start;
+        for (GLint c = 0; c < attribute.size && c < 4; ++c) {
+            float value = 0.0f;
+            if (attribute.type == GL_UNSIGNED_BYTE) {
+                value = data[c];
+                if (attribute.normalized) value /= 255.0f;
+            }
+            else if (attribute.type == GL_UNSIGNED_SHORT) {
+                uint16_t v;
+                memcpy(&v, data + c * 2, 2);
+                value = v;
+                if (attribute.normalized) value /= 65535.0f;
+            }
+            else {
+                memcpy(&value, data + c * 4, 4);
+            }
+            out[c] = value;
+        }
+    }
+
+    void SoftwareGLBackend::Upload(Texture& texture, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+        GLenum format, const void* pixels) {
+        if (pixels == nullptr) {
+            return;
+        }
+        const unsigned char* source = static_cast<const unsigned char*>(pixels);
+        size_t channels = (format == GL_RED) ? 1 : 4;
+        size_t texelBytes = texture.channels;
+        size_t alignment = static_cast<size_t>(std::max(mUnpackAlignment, 1));
+        size_t rowPadding = (alignment - (static_cast<size_t>(width) * channels) % alignment) % alignment;
+        for (GLsizei layer = 0; layer < depth; ++layer) {
+            for (GLsizei row = 0; row < height; ++row) {
+                GLint ty = y + row;
+                GLint tz = z + layer;
+                if (ty < 0 || ty >= texture.height || tz < 0 || tz >= texture.depth) {
+                    source += static_cast<size_t>(width) * channels + rowPadding;
+                    continue;
+                }
+                unsigned char* dest = texture.pixels.data() +
+                    ((static_cast<size_t>(tz) * texture.height + ty) * texture.width) * texelBytes;
+                GLint first = std::max(x, 0);
+                GLint last = std::min(x + width, texture.width);
+                if (channels == texelBytes && last > first) {
+                    memcpy(dest + static_cast<size_t>(first) * texelBytes, source + static_cast<size_t>(first - x) * channels,
+                        static_cast<size_t>(last - first) * texelBytes);
+                    source += static_cast<size_t>(width) * channels;
+                }
+                else {
+                    // GL_RED into RGBA is (r, 0, 0, 255), RGBA into one channel keeps red
+                    for (GLsizei column = 0; column < width; ++column, source += channels) {
+                        GLint tx = x + column;
+                        if (tx < 0 || tx >= texture.width) {
+                            continue;
+                        }
+                        unsigned char* texel = dest + static_cast<size_t>(tx) * texelBytes;
+                        texel[0] = source[0];
+                        if (texelBytes == 4) {
+                            texel[1] = 0;
+                            texel[2] = 0;
+                            texel[3] = 255;
+                        }
+                    }
+                }
+                source += rowPadding;
+            }
+        }
+    }
+
+    // Shaders, there is only the one quad program so any source links
+
+    GLuint SoftwareGLBackend::CreateProgram(const char* vertexSource, const char* fragmentSource) {
+        return mNextName++;
+    }
+
+    void SoftwareGLBackend::DeleteProgram(GLuint program) {
+    }
+
+    void SoftwareGLBackend::UseProgram(GLuint program) {
+    }
+
+    GLint SoftwareGLBackend::GetUniformLocation(GLuint program, const char* name) {
+        auto it = mUniformLocations.find(name);
+        if (it != mUniformLocations.end()) {
+            return it->second;
+        }
+        GLint location = static_cast<GLint>(mUniformLocations.size());
+        mUniformLocations[name] = location;
+        mUniforms.resize(mUniforms.size() + 2, 0.0f);
+        return location;
+    }
+
+    void SoftwareGLBackend::Uniform1i(GLint location, GLint value) {
+        if (location >= 0 && static_cast<size_t>(location) * 2 < mUniforms.size()) {
+            mUniforms[static_cast<size_t>(location) * 2] = static_cast<float>(value);
+        }
+    }
+
+    void SoftwareGLBackend::Uniform2f(GLint location, GLfloat x, GLfloat y) {
+        if (location >= 0 && static_cast<size_t>(location) * 2 < mUniforms.size()) {
+            mUniforms[static_cast<size_t>(location) * 2] = x;
+            mUniforms[static_cast<size_t>(location) * 2 + 1] = y;
+        }
+    }
+
+    // Buffers and vertex arrays, there is a single vertex array so its state lives in mAttributes
+
+    void SoftwareGLBackend::GenBuffers(GLsizei count, GLuint* buffers) {
+        for (GLsizei i = 0; i < count; ++i) {
+            buffers[i] = mNextName++;
+            mBuffers[buffers[i]];
+        }
+    }
+
+    void SoftwareGLBackend::DeleteBuffers(GLsizei count, const GLuint* buffers) {
+        for (GLsizei i = 0; i < count; ++i) {
+            mBuffers.erase(buffers[i]);
+        }
+    }
+
+    void SoftwareGLBackend::BindBuffer(GLenum target, GLuint buffer) {
+        if (target == GL_ARRAY_BUFFER) {
+            mBoundArrayBuffer = buffer;
+        }
+    }
+
+    void SoftwareGLBackend::BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+        auto it = mBuffers.find((target == GL_ARRAY_BUFFER) ? mBoundArrayBuffer : 0);
+        if (it == mBuffers.end()) {
+            return;
+        }
+        it->second.assign(static_cast<size_t>(size), 0);
+        if (data) {
+            memcpy(it->second.data(), data, static_cast<size_t>(size));
+        }
+    }
+
+    void SoftwareGLBackend::BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+        auto it = mBuffers.find((target == GL_ARRAY_BUFFER) ? mBoundArrayBuffer : 0);
+        if (it != mBuffers.end() && static_cast<size_t>(offset + size) <= it->second.size()) {
+            memcpy(it->second.data() + offset, data, static_cast<size_t>(size));
+        }
+    }
+
+    void* SoftwareGLBackend::MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+        auto it = mBuffers.find((target == GL_ARRAY_BUFFER) ? mBoundArrayBuffer : 0);
+        if (it == mBuffers.end() || static_cast<size_t>(offset + length) > it->second.size()) {
+            return nullptr;
+        }
+        return it->second.data() + offset;
+    }
+
+    GLboolean SoftwareGLBackend::UnmapBuffer(GLenum target) {
+        return GL_TRUE;
+    }
+
+    void SoftwareGLBackend::GenVertexArrays(GLsizei count, GLuint* arrays) {
+        for (GLsizei i = 0; i < count; ++i) {
+            arrays[i] = mNextName++;
+        }
+    }
+
+    void SoftwareGLBackend::DeleteVertexArrays(GLsizei count, const GLuint* arrays) {
+    }
+
+    void SoftwareGLBackend::BindVertexArray(GLuint array) {
+    }
+
+    void SoftwareGLBackend::EnableVertexAttribArray(GLuint index) {
+    }
+
+    void SoftwareGLBackend::VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+        if (index >= MAX_ATTRIBUTES) {
+            return;
+        }
+        Attribute& attribute = mAttributes[index];
+        attribute.buffer = mBoundArrayBuffer;
+        attribute.offset = static_cast<size_t>(reinterpret_cast<uintptr_t>(pointer));
+        attribute.stride = stride;
+        attribute.size = size;
+        attribute.type = type;
+        attribute.normalized = (normalized == GL_TRUE);
+    }
+
+    void SoftwareGLBackend::VertexAttribDivisor(GLuint index, GLuint divisor) {
+    }
+
+    // Textures
+
+    void SoftwareGLBackend::GenTextures(GLsizei count, GLuint* textures) {
+        for (GLsizei i = 0; i < count; ++i) {
+            textures[i] = mNextName++;
+            mTextures[textures[i]];
+        }
+    }
+
+    void SoftwareGLBackend::DeleteTextures(GLsizei count, const GLuint* textures) {
+        for (GLsizei i = 0; i < count; ++i) {
+            mTextures.erase(textures[i]);
+        }
+    }
+
+    void SoftwareGLBackend::ActiveTexture(GLenum unit) {
+        mActiveTexture = unit - GL_TEXTURE0;
+    }
+
+    void SoftwareGLBackend::BindTexture(GLenum target, GLuint texture) {
+        if (mActiveTexture >= MAX_TEXTURE_UNITS) {
+            return;
+        }
+        if (target == GL_TEXTURE_2D_ARRAY) {
+            mBoundTextureArrays[mActiveTexture] = texture;
+        }
+        else {
+            mBoundTextures[mActiveTexture] = texture;
+        }
+    }
+
+    void SoftwareGLBackend::TexParameteri(GLenum target, GLenum name, GLint value) {
+        Texture* texture = GetBoundTexture(target);
+        if (texture && name == GL_TEXTURE_MAG_FILTER) {
+            texture->linear = (value == GL_LINEAR);
+        }
+    }
+
+    void SoftwareGLBackend::PixelStorei(GLenum name, GLint value) {
+        if (name == GL_UNPACK_ALIGNMENT) {
+            mUnpackAlignment = value;
+        }
+    }
+
+    void SoftwareGLBackend::TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+        GLint border, GLenum format, GLenum type, const void* pixels) {
+        TexImage3D(target, level, internalFormat, width, height, 1, border, format, type, pixels);
+    }
+
+    void SoftwareGLBackend::TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+        GLenum format, GLenum type, const void* pixels) {
+        TexSubImage3D(target, level, x, y, 0, width, height, 1, format, type, pixels);
+    }
+
+    void SoftwareGLBackend::TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+        GLint border, GLenum format, GLenum type, const void* pixels) {
+        Texture* texture = GetBoundTexture(target);
+        if (texture == nullptr || level != 0) {
+            return;
+        }
+        texture->width = width;
+        texture->height = height;
+        texture->depth = depth;
+        texture->channels = (internalFormat == GL_R8 || internalFormat == GL_RED) ? 1 : 4;
+        texture->pixels.assign(static_cast<size_t>(width) * height * depth * texture->channels, 0);
+        Upload(*texture, 0, 0, 0, width, height, depth, format, pixels);
+    }
+
+    void SoftwareGLBackend::TexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+        GLenum format, GLenum type, const void* pixels) {
+        Texture* texture = GetBoundTexture(target);
+        if (texture == nullptr || level != 0) {
+            return;
+        }
+        Upload(*texture, x, y, z, width, height, depth, format, pixels);
+    }
+
+    // Framebuffers
+
+    void SoftwareGLBackend::GenFramebuffers(GLsizei count, GLuint* framebuffers) {
+        for (GLsizei i = 0; i < count; ++i) {
+            framebuffers[i] = mNextName++;
+            mFramebuffers[framebuffers[i]] = 0;
+        }
+    }
+
+    void SoftwareGLBackend::DeleteFramebuffers(GLsizei count, const GLuint* framebuffers) {
+        for (GLsizei i = 0; i < count; ++i) {
+            mFramebuffers.erase(framebuffers[i]);
+        }
+    }
+
+    void SoftwareGLBackend::BindFramebuffer(GLenum target, GLuint framebuffer) {
+        if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER) {
+            mReadFramebuffer = framebuffer;
+        }
+        if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER) {
+            mDrawFramebuffer = framebuffer;
+        }
+    }
+
+    void SoftwareGLBackend::FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level) {
+        GLuint framebuffer = (target == GL_READ_FRAMEBUFFER) ? mReadFramebuffer : mDrawFramebuffer;
+        auto it = mFramebuffers.find(framebuffer);
+        if (it != mFramebuffers.end() && attachment == GL_COLOR_ATTACHMENT0) {
+            it->second = texture;
+        }
+    }
+
+    GLenum SoftwareGLBackend::CheckFramebufferStatus(GLenum target) {
+        GLuint framebuffer = (target == GL_READ_FRAMEBUFFER) ? mReadFramebuffer : mDrawFramebuffer;
+        return (GetTarget(framebuffer).pixels != nullptr) ? GL_FRAMEBUFFER_COMPLETE : GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT;
+    }
+
+    void SoftwareGLBackend::BlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+        GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) {
+        Target source = GetTarget(mReadFramebuffer);
+        Target dest = GetTarget(mDrawFramebuffer);
+        if (source.pixels == nullptr || dest.pixels == nullptr || !(mask & GL_COLOR_BUFFER_BIT) ||
+            srcX1 == srcX0 || srcY1 == srcY0 || dstX1 == dstX0 || dstY1 == dstY0) {
+            return;
+        }
+
+        // Nearest sampling for any scale, a straight row copy when the sizes match
+        bool sameSize = (srcX1 - srcX0 == dstX1 - dstX0) && (srcY1 - srcY0 == dstY1 - dstY0) &&
+            srcX1 > srcX0 && srcY1 > srcY0;
+        float scaleX = static_cast<float>(srcX1 - srcX0) / (dstX1 - dstX0);
+        float scaleY = static_cast<float>(srcY1 - srcY0) / (dstY1 - dstY0);
+        GLint xStart = std::max(std::min(dstX0, dstX1), 0);
+        GLint xEnd = std::min(std::max(dstX0, dstX1), dest.width);
+        GLint yStart = std::max(std::min(dstY0, dstY1), 0);
+        GLint yEnd = std::min(std::max(dstY0, dstY1), dest.height);
+        if (mScissorTest) {
+            xStart = std::max(xStart, mScissor[0]);
+            xEnd = std::min(xEnd, mScissor[0] + mScissor[2]);
+            yStart = std::max(yStart, mScissor[1]);
+            yEnd = std::min(yEnd, mScissor[1] + mScissor[3]);
+        }
+
+        for (GLint y = yStart; y < yEnd; ++y) {
+            GLint sy = srcY0 + static_cast<GLint>(std::floor((y - dstY0 + 0.5f) * scaleY));
+            if (sy < 0 || sy >= source.height) {
+                continue;
+            }
+            unsigned char* destRow = dest.pixels + static_cast<size_t>(y) * dest.width * 4;
+            const unsigned char* sourceRow = source.pixels + static_cast<size_t>(sy) * source.width * 4;
+            if (sameSize) {
+                GLint first = std::max(xStart, dstX0 - srcX0);
+                GLint last = std::min(xEnd, dstX0 - srcX0 + source.width);
+                if (last > first) {
+                    memcpy(destRow + static_cast<size_t>(first) * 4, sourceRow + static_cast<size_t>(srcX0 + (first - dstX0)) * 4,
+                        static_cast<size_t>(last - first) * 4);
+                }
+                continue;
+            }
+            for (GLint x = xStart; x < xEnd; ++x) {
+                GLint sx = srcX0 + static_cast<GLint>(std::floor((x - dstX0 + 0.5f) * scaleX));
+                if (sx >= 0 && sx < source.width) {
+                    memcpy(destRow + static_cast<size_t>(x) * 4, sourceRow + static_cast<size_t>(sx) * 4, 4);
+                }
+            }
+        }
+    }
+
+    // Fixed function state and drawing
+
+    void SoftwareGLBackend::Enable(GLenum capability) {
+        if (capability == GL_BLEND) mBlend = true;
+        if (capability == GL_SCISSOR_TEST) mScissorTest = true;
+    }
+
+    void SoftwareGLBackend::Disable(GLenum capability) {
+        if (capability == GL_BLEND) mBlend = false;
+        if (capability == GL_SCISSOR_TEST) mScissorTest = false;
+    }
+
+    void SoftwareGLBackend::BlendFunc(GLenum source, GLenum destination) {
+        // Always GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, the only blend the renderer uses
+    }
+
+    void SoftwareGLBackend::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        mViewport[0] = x;
+        mViewport[1] = y;
+        mViewport[2] = width;
+        mViewport[3] = height;
+    }
+
+    void SoftwareGLBackend::Scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+        mScissor[0] = x;
+        mScissor[1] = y;
+        mScissor[2] = width;
+        mScissor[3] = height;
+    }
+
+    void SoftwareGLBackend::ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+        mClearColor[0] = r;
+        mClearColor[1] = g;
+        mClearColor[2] = b;
+        mClearColor[3] = a;
+    }
+
+    void SoftwareGLBackend::Clear(GLbitfield mask) {
+        Target target = GetTarget(mDrawFramebuffer);
+        if (target.pixels == nullptr || !(mask & GL_COLOR_BUFFER_BIT)) {
+            return;
+        }
+        GLint x0 = 0, y0 = 0, x1 = target.width, y1 = target.height;
+        if (mScissorTest) {
+            x0 = std::max(x0, mScissor[0]);
+            y0 = std::max(y0, mScissor[1]);
+            x1 = std::min(x1, mScissor[0] + mScissor[2]);
+            y1 = std::min(y1, mScissor[1] + mScissor[3]);
+        }
+        unsigned char color[4];
+        for (unsigned int c = 0; c < 4; ++c) {
+            color[c] = SoftwareToByte(mClearColor[c]);
+        }
+        for (GLint y = y0; y < y1; ++y) {
+            unsigned char* pixel = target.pixels + (static_cast<size_t>(y) * target.width + x0) * 4;
+            for (GLint x = x0; x < x1; ++x, pixel += 4) {
+                memcpy(pixel, color, 4);
+            }
+        }
+    }
+
+    void SoftwareGLBackend::DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) {
+        Target target = GetTarget(mDrawFramebuffer);
+        if (target.pixels == nullptr || mode != GL_TRIANGLE_STRIP || count != 4) {
+            return; // Only the renderer's instanced quads are supported
+        }
+
+        DrawState state;
+        for (unsigned int i = 0; i < MAX_ATTRIBUTES; ++i) {
+            auto it = mBuffers.find(mAttributes[i].buffer);
+            state.buffers[i] = (it != mBuffers.end()) ? &it->second : nullptr;
+        }
+        state.viewportWidth = GetUniform("uViewportSize", 0);
+        state.viewportHeight = GetUniform("uViewportSize", 1);
+        if (state.viewportWidth <= 0.0f || state.viewportHeight <= 0.0f) {
+            return;
+        }
+        state.image = GetUnitTexture(GL_TEXTURE_2D, static_cast<int>(GetUniform("uTexture", 0)));
+        state.fontArray = GetUnitTexture(GL_TEXTURE_2D_ARRAY, static_cast<int>(GetUniform("uFontArray", 0)));
+        state.fontArrayWidth = GetUniform("uFontArraySize", 0);
+        state.fontArrayHeight = GetUniform("uFontArraySize", 1);
+
+        for (GLsizei instance = 0; instance < instanceCount; ++instance) {
+            DrawQuad(target, state, instance);
+        }
+    }
+
+    // Does what the renderer's vertex and fragment shader do for one quad instance
+    void SoftwareGLBackend::DrawQuad(const Target& target, const DrawState& state, GLsizei instance) {
+        float rect[4], uv[4], color[4];
+        ReadAttribute(state, 0, instance, rect);
+        ReadAttribute(state, 1, instance, uv);
+        ReadAttribute(state, 2, instance, color);
+
+        // Quad corners in window coordinates, y up
+        float scaleX = mViewport[2] / state.viewportWidth;
+        float scaleY = mViewport[3] / state.viewportHeight;
+        float left = mViewport[0] + rect[0] * 0.125f * scaleX;
+        float right = mViewport[0] + (rect[0] + rect[2]) * 0.125f * scaleX;
+        float top = mViewport[1] + mViewport[3] - rect[1] * 0.125f * scaleY;
+        float bottom = mViewport[1] + mViewport[3] - (rect[1] + rect[3]) * 0.125f * scaleY;
+        if (right <= left || top <= bottom) {
+            return;
+        }
+
+        // Pixels whose centers are inside, clipped to the target, viewport and scissor
+        GLint x0 = static_cast<GLint>(std::ceil(left - 0.5f));
+        GLint x1 = static_cast<GLint>(std::ceil(right - 0.5f));
+        GLint y0 = static_cast<GLint>(std::ceil(bottom - 0.5f));
+        GLint y1 = static_cast<GLint>(std::ceil(top - 0.5f));
+        x0 = std::max(x0, std::max(0, mViewport[0]));
+        y0 = std::max(y0, std::max(0, mViewport[1]));
+        x1 = std::min(x1, std::min(target.width, mViewport[0] + mViewport[2]));
+        y1 = std::min(y1, std::min(target.height, mViewport[1] + mViewport[3]));
+        if (mScissorTest) {
+            x0 = std::max(x0, mScissor[0]);
+            y0 = std::max(y0, mScissor[1]);
+            x1 = std::min(x1, mScissor[0] + mScissor[2]);
+            y1 = std::min(y1, mScissor[1] + mScissor[3]);
+        }
+        if (x1 <= x0 || y1 <= y0) {
+            return;
+        }
+
+        unsigned char tint[3] = { SoftwareToByte(color[0]), SoftwareToByte(color[1]), SoftwareToByte(color[2]) };
+        int flags = static_cast<int>(color[3] * 255.0f + 0.5f);
+        size_t spanPixels = static_cast<size_t>(x1 - x0);
+
+        if (flags == 0) {
+            // Solid quads are opaque, blending or not
+            for (GLint y = y0; y < y1; ++y) {
+                unsigned char* pixel = target.pixels + (static_cast<size_t>(y) * target.width + x0) * 4;
+                for (size_t x = 0; x < spanPixels; ++x, pixel += 4) {
+                    pixel[0] = tint[0];
+                    pixel[1] = tint[1];
+                    pixel[2] = tint[2];
+                    pixel[3] = 255;
+                }
+            }
+            return;
+        }
+
+        // Texture coordinates are taken to texels of the sampled texture
+        const Texture* texture = nullptr;
+        size_t layerOffset = 0;
+        float toTexelsU = 0.0f, toTexelsV = 0.0f;
+        bool distanceField = false;
+        if (flags == 255) {
+            texture = state.image;
+            if (texture) {
+                toTexelsU = texture->width / 65535.0f;
+                toTexelsV = texture->height / 65535.0f;
+            }
+        }
+        else {
+            texture = state.fontArray;
+            float arrayWidth = state.fontArrayWidth;
+            float arrayHeight = state.fontArrayHeight;
+            distanceField = (flags & 128) != 0;
+            int layer = (flags & 127) - 1;
+            if (texture && layer < texture->depth && arrayWidth > 0.0f && arrayHeight > 0.0f) {
+                layerOffset = static_cast<size_t>(layer) * texture->width * texture->height * texture->channels;
+                toTexelsU = 0.125f * texture->width / arrayWidth;
+                toTexelsV = 0.125f * texture->height / arrayHeight;
+            }
+            else {
+                texture = nullptr;
+            }
+        }
+        if (texture == nullptr || texture->pixels.empty()) {
+            return;
+        }
+        const unsigned char* texels = texture->pixels.data() + layerOffset;
+
+        float u0 = uv[0] * toTexelsU, v0 = uv[1] * toTexelsV;
+        float uStep = (uv[2] - uv[0]) * toTexelsU / (right - left);
+        float vStep = (uv[3] - uv[1]) * toTexelsV / (top - bottom);
+
+        mSpan.resize(spanPixels * 4);
+        for (GLint y = y0; y < y1; ++y) {
+            float v = v0 + (top - (y + 0.5f)) * vStep;
+            float u = u0 + (x0 + 0.5f - left) * uStep;
+            unsigned char* span = mSpan.data();
+            for (size_t x = 0; x < spanPixels; ++x, u += uStep, span += 4) {
+                float sample[4];
+                SoftwareSample(texels, texture->width, texture->height, texture->channels, texture->linear, u, v, sample);
+                if (flags == 255) {
+                    span[0] = SoftwareToByte(tint[0] / 255.0f * sample[0]);
+                    span[1] = SoftwareToByte(tint[1] / 255.0f * sample[1]);
+                    span[2] = SoftwareToByte(tint[2] / 255.0f * sample[2]);
+                    span[3] = SoftwareToByte(sample[3]);
+                }
+                else {
+                    // Font atlases are coverage or distance in the red channel
+                    float value = sample[0];
+                    if (distanceField) {
+                        // Same edge as the shader, fwidth from the neighbouring pixels' samples
+                        float nextX[4], nextY[4];
+                        SoftwareSample(texels, texture->width, texture->height, texture->channels, texture->linear, u + uStep, v, nextX);
+                        SoftwareSample(texels, texture->width, texture->height, texture->channels, texture->linear, u, v - vStep, nextY);
+                        float width = std::fabs(nextX[0] - value) + std::fabs(nextY[0] - value);
+                        value = std::min(1.0f, std::max(0.0f, (value - 0.5f) / std::max(width, 0.0001f) + 0.5f));
+                    }
+                    span[0] = tint[0];
+                    span[1] = tint[1];
+                    span[2] = tint[2];
+                    span[3] = SoftwareToByte(value);
+                }
+            }
+
+            unsigned char* row = target.pixels + (static_cast<size_t>(y) * target.width + x0) * 4;
+            if (mBlend) {
+                SoftwareBlendSpan(row, mSpan.data(), spanPixels);
+            }
+            else {
+                memcpy(row, mSpan.data(), spanPixels * 4);
+            }
+        }
+    }
+
+    // Sync, drawing is done by the time a call returns
+
+    GLsync SoftwareGLBackend::FenceSync(GLenum condition, GLbitfield flags) {
+        return reinterpret_cast<GLsync>(static_cast<uintptr_t>(mNextName++));
+    }
+
+    GLenum SoftwareGLBackend::ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+        return GL_ALREADY_SIGNALED;
+    }
+
+    void SoftwareGLBackend::DeleteSync(GLsync sync) {
+    }
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "GLBackend.h"
+
+namespace TextEdit {
+    // Draws on the CPU into an RGBA framebuffer, for screenshot tests without a GPU and for machines
+    // where the only OpenGL is a slow software one. It is not a general GL implementation, draws run
+    // the renderer's quad shader (solid, image and font array quads) and everything else the renderer
+    // needs is emulated: textures, framebuffer objects with blits, scissor and alpha blending.
+    // GL_R8 and GL_RED textures keep one byte per texel, everything else is RGBA8. Uploads must be GL_RGBA or
+    // GL_RED bytes, GL_RED is sampled as (r, 0, 0, 1) and only RGBA textures can be drawn to.
+    class SoftwareGLBackend : public GLBackend {
+    public:
+        SoftwareGLBackend(unsigned int width, unsigned int height);
+        static std::shared_ptr<SoftwareGLBackend> Create(unsigned int width, unsigned int height);
+
+        void Resize(unsigned int width, unsigned int height); // Of the default framebuffer, contents are lost
+        unsigned int GetWidth() const;
+        unsigned int GetHeight() const;
+        const unsigned char* GetPixels() const; // Default framebuffer as RGBA, bottom row first like glReadPixels
+
+        GLuint CreateProgram(const char* vertexSource, const char* fragmentSource) override;
+        void DeleteProgram(GLuint program) override;
+        void UseProgram(GLuint program) override;
+        GLint GetUniformLocation(GLuint program, const char* name) override;
+        void Uniform1i(GLint location, GLint value) override;
+        void Uniform2f(GLint location, GLfloat x, GLfloat y) override;
+
+        void GenBuffers(GLsizei count, GLuint* buffers) override;
+        void DeleteBuffers(GLsizei count, const GLuint* buffers) override;
+        void BindBuffer(GLenum target, GLuint buffer) override;
+        void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+        void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override;
+        void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+        GLboolean UnmapBuffer(GLenum target) override;
+        void GenVertexArrays(GLsizei count, GLuint* arrays) override;
+        void DeleteVertexArrays(GLsizei count, const GLuint* arrays) override;
+        void BindVertexArray(GLuint array) override;
+        void EnableVertexAttribArray(GLuint index) override;
+        void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override;
+        void VertexAttribDivisor(GLuint index, GLuint divisor) override;
+
+        void GenTextures(GLsizei count, GLuint* textures) override;
+        void DeleteTextures(GLsizei count, const GLuint* textures) override;
+        void ActiveTexture(GLenum unit) override;
+        void BindTexture(GLenum target, GLuint texture) override;
+        void TexParameteri(GLenum target, GLenum name, GLint value) override;
+        void PixelStorei(GLenum name, GLint value) override;
+        void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+            GLint border, GLenum format, GLenum type, const void* pixels) override;
+        void TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const void* pixels) override;
+        void TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+            GLint border, GLenum format, GLenum type, const void* pixels) override;
+        void TexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+            GLenum format, GLenum type, const void* pixels) override;
+
+        void GenFramebuffers(GLsizei count, GLuint* framebuffers) override;
+        void DeleteFramebuffers(GLsizei count, const GLuint* framebuffers) override;
+        void BindFramebuffer(GLenum target, GLuint framebuffer) override;
+        void FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level) override;
+        GLenum CheckFramebufferStatus(GLenum target) override;
+        void BlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+            GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) override;
+
+        void Enable(GLenum capability) override;
+        void Disable(GLenum capability) override;
+        void BlendFunc(GLenum source, GLenum destination) override;
+        void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+        void Scissor(GLint x, GLint y, GLsizei width, GLsizei height) override;
+        void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) override;
+        void Clear(GLbitfield mask) override;
+        void DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) override;
+
+        GLsync FenceSync(GLenum condition, GLbitfield flags) override;
+        GLenum ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) override;
+        void DeleteSync(GLsync sync) override;
+
+    private:
+        static constexpr unsigned int MAX_TEXTURE_UNITS = 4;
+        static constexpr unsigned int MAX_ATTRIBUTES = 4;
+
+        struct Texture {
+            GLsizei width = 0;
+            GLsizei height = 0;
+            GLsizei depth = 0; // Layers, 1 for GL_TEXTURE_2D
+            bool linear = true;
+            unsigned int channels = 4; // 1 for GL_R8 textures, 4 for RGBA8
+            std::vector<unsigned char> pixels; // channels bytes per texel, layer after layer, bottom row first
+        };
+
+        struct Attribute {
+            GLuint buffer = 0;
+            size_t offset = 0;
+            GLsizei stride = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            bool normalized = false;
+        };
+
+        // Where pixels go, or come from for blits
+        struct Target {
+            unsigned char* pixels;
+            GLint width;
+            GLint height;
+        };
+
+        // What every quad of a draw call reads, looked up once per call
+        struct DrawState {
+            const std::vector<unsigned char>* buffers[MAX_ATTRIBUTES]; // Behind each attribute, null if there is none
+            float viewportWidth;
+            float viewportHeight;
+            const Texture* image;     // Bound to uTexture's unit
+            const Texture* fontArray; // Bound to uFontArray's unit
+            float fontArrayWidth;
+            float fontArrayHeight;
+        };
+
+        unsigned int mWidth;
+        unsigned int mHeight;
+        std::vector<unsigned char> mPixels;
+
+        GLuint mNextName;
+        std::map<GLuint, std::vector<unsigned char>> mBuffers;
+        std::map<GLuint, Texture> mTextures;
+        std::map<GLuint, GLuint> mFramebuffers; // Framebuffer to the texture attached to it
+        std::map<std::string, GLint> mUniformLocations;
+        std::vector<float> mUniforms; // Two per location
+
+        GLuint mBoundArrayBuffer;
+        GLuint mReadFramebuffer;
+        GLuint mDrawFramebuffer;
+        unsigned int mActiveTexture;
+        GLint mUnpackAlignment;
+        GLuint mBoundTextures[MAX_TEXTURE_UNITS];      // GL_TEXTURE_2D
+        GLuint mBoundTextureArrays[MAX_TEXTURE_UNITS]; // GL_TEXTURE_2D_ARRAY
+        Attribute mAttributes[MAX_ATTRIBUTES];
+
+        bool mBlend;
+        bool mScissorTest;
+        GLint mViewport[4];
+        GLint mScissor[4];
+        float mClearColor[4];
+
+        std::vector<unsigned char> mSpan; // Shaded colors of the row being drawn, blended into the target in one go
+
+        Texture* GetBoundTexture(GLenum target);
+        Texture* GetUnitTexture(GLenum target, int unit);
+        Target GetTarget(GLuint framebuffer);
+        float GetUniform(const char* name, unsigned int component) const;
+        void ReadAttribute(const DrawState& state, unsigned int index, GLsizei instance, float out[4]) const;
+        void Upload(Texture& texture, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+            GLenum format, const void* pixels);
+        void DrawQuad(const Target& target, const DrawState& state, GLsizei instance);
+    };
+}
@@ -61,6 +61,8 @@ namespace TextEdit {
     float TextEdit::Styles::SMALL_FONT_SIZE = 18;
     float TextEdit::Styles::HIGHLIGHTER_BUTTON_WIDTH = 53;
     float TextEdit::Styles::CONTEXT_MENU_WIDTH = 80;
+    float TextEdit::Styles::MINIMAP_WIDTH = 90;
+    float TextEdit::Styles::FOLD_MARKER_WIDTH = 14;
     float TextEdit::Styles::FILE_MENU_HEIGHT = 28;
     float TextEdit::Styles::FILE_MENU_PADDING = 10;
     float TextEdit::Styles::FILE_MENU_DROPDOWN_HEIGHT = 24;
@@ -180,6 +182,8 @@ void TextEdit::Styles::ApplyDPI(float dpi) {
     GUTTER_RIGHT_PAD *= dpi;
     HIGHLIGHTER_BUTTON_WIDTH *= dpi;
     CONTEXT_MENU_WIDTH *= dpi;
+    MINIMAP_WIDTH *= dpi;
+    FOLD_MARKER_WIDTH *= dpi;
     FILE_MENU_HEIGHT *= dpi;
     FILE_MENU_PADDING *= dpi;
     MEDIUM_FONT_SIZE *= dpi;
@@ -64,6 +64,8 @@ namespace TextEdit {
 		static float GUTTER_RIGHT_PAD;
 		static float HIGHLIGHTER_BUTTON_WIDTH;
 		static float CONTEXT_MENU_WIDTH;
+		static float MINIMAP_WIDTH;
+		static float FOLD_MARKER_WIDTH;
 		static float FILE_MENU_HEIGHT;
 		static float FILE_MENU_PADDING;
 		static float FILE_MENU_DROPDOWN_HEIGHT;
@@ -1,6 +1,6 @@
-﻿#ifdef _WIN32
+﻿#ifndef __EMSCRIPTEN__
 #include "glad.h"
-#endif // _WIN32
+#endif // !__EMSCRIPTEN__
 #include "application.h"
 #include "Renderer.h"
 #include "Font.h"
@@ -11,6 +11,8 @@
 #include "ScriptingInterface.h"
 #include "miniz.h"
 #include "IncludedDocuments.h"
+#include "Profiler.h"
+#include "InputRecording.h"
 
 #include <string>     
 #include <fstream>    
@@ -57,6 +59,27 @@ int gClickedButton = -1; // -1: none, 0: minimize, 1: maximize, 2: close
 float gLastMouseX = 0;
 float gLastMouseY = 0;
 
+// Damage tracking, see RequestRedraw in application.h
+bool gRedrawPending = true;
+bool gFrameWasDrawn = false;
+double gAppTime = 0.0; // Sum of all Tick delta times
+double gNextRedrawTime = -1.0; // Absolute app time of the next timed redraw, negative if none is scheduled
+unsigned int gLastScreenWidth = 0;
+unsigned int gLastScreenHeight = 0;
+const float GLYPH_POLL_SECONDS = 0.008f; // How often to check on glyphs being rasterized in the background
+
+// The document font is a distance field, zooming it rescales one atlas instead of baking a new one
+const bool DOCUMENT_FONT_DISTANCE_FIELD = true;
+const float DOCUMENT_FONT_SCALE_STEP = 0.1f; // Per Ctrl+wheel notch
+const float MIN_DOCUMENT_FONT_SCALE = 0.5f;
+const float MAX_DOCUMENT_FONT_SCALE = 3.0f;
+float gDocumentFontScale = 1.0f;
+const bool SUBPIXEL_GLYPH_POSITIONING = true; // Coverage fonts bake quarter pixel glyph variants as they are drawn
+const unsigned int PROFILER_OVERLAY_KEY = 0x70 + 8; // VK_F9 toggles the overlay, Shift+F9 starts and saves a trace, Ctrl+F9 records input
+bool gAsyncGlyphRasterization = true;
+TextEdit::InputRecording gInputRecording;
+bool gRecordingInput = false;
+
 void OnApplicationCloseButtonClicked();
 void OnApplicationMaximizeButtonClicked();
 void OnApplicationRestoreButtonClicked();
@@ -64,6 +87,12 @@ void OnApplicationMinimizeButtonClicked();
 
 void CopyPrompt();
 void BundleFiles();
+void DrawFrame(unsigned int screenWidth, unsigned int screenHeight);
+std::shared_ptr<TextEdit::Font> CreateCachedFont(float pixelHeight, float dpi, bool distanceField = false);
+void SetDocumentFontScale(float scale);
+void SaveFontAtlas(const std::shared_ptr<TextEdit::Font>& font);
+int GetWindowButtonAt(float x, float y);
+void InvalidateWindowButtons();
 
 std::u32string Utf8ToUtf32(const char* utf8_string, unsigned int bytes);
 std::string Utf32ToUtf8(const std::u32string& utf32_string);
@@ -85,24 +114,84 @@ void GetTitleBarInteractiveRect(unsigned int* outX, unsigned int* outY, unsigned
 	}
 }
 
+void RequestRedraw() {
+	gRedrawPending = true;
+}
+
+void RequestRedrawIn(float seconds) {
+	double when = gAppTime + (double)std::max(seconds, 0.0f);
+	if (gNextRedrawTime < 0.0 || when < gNextRedrawTime) {
+		gNextRedrawTime = when;
+	}
+}
+
+bool HasPendingRedraw() {
+	return gRedrawPending || (gRenderer != nullptr && gRenderer->HasDamage());
+}
+
+bool FrameWasDrawn() {
+	return gFrameWasDrawn;
+}
+
+int GetIdleTimeoutMs() {
+	if (HasPendingRedraw()) {
+		return 0;
+	}
+	if (gNextRedrawTime < 0.0) {
+		return -1; // Nothing scheduled, sleep until there is input
+	}
+
+	double ms = (gNextRedrawTime - gAppTime) * 1000.0;
+	if (ms <= 0.0) {
+		return 0;
+	}
+	return (int)ms + 1; // Round up so we don't wake just before the deadline
+}
+
+int GetWindowButtonAt(float x, float y) {
+	float buttonWidth = TextEdit::Styles::WINDOW_BUTTON_WIDTH;
+	float buttonHeight = TextEdit::Styles::FILE_MENU_HEIGHT;
+
+	if (y >= 0 && y <= buttonHeight) {
+		float closeX = (float)gLastScreenWidth - buttonWidth;
+		float maxX = closeX - buttonWidth;
+		float minX = maxX - buttonWidth;
+
+		if (x >= closeX && x <= closeX + buttonWidth) {
+			return 2; // Close button
+		}
+		else if (x >= maxX && x <= maxX + buttonWidth) {
+			return 1; // Maximize button
+		}
+		else if (x >= minX && x <= minX + buttonWidth) {
+			return 0; // Minimize button
+		}
+	}
+	return -1;
+}
+
+void InvalidateWindowButtons() {
+	float buttonsWidth = TextEdit::Styles::WINDOW_BUTTON_WIDTH * 3.0f;
+	gRenderer->Invalidate((float)gLastScreenWidth - buttonsWidth, 0.0f, buttonsWidth, TextEdit::Styles::FILE_MENU_HEIGHT);
+}
+
 void ExternalCreateNewDocument() {
 	std::shared_ptr<TextEdit::Document> document = TextEdit::Document::Create();
 	gDocContainer->AddDocument(document);
 }
 
-bool Initialize(float dpi) {
+bool Initialize(float dpi, std::shared_ptr<TextEdit::GLBackend> glBackend) {
 	TextEdit::Styles::ApplyDPI(dpi);
 
-	gLargeFont = TextEdit::Font::Create(Roboto, Roboto_Size, TextEdit::Styles::REGULAR_FONT_SIZE, dpi);
-	gLargeFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::REGULAR_FONT_SIZE, dpi);
-
-	gRenderer = TextEdit::Renderer::Create(dpi, gLargeFont);
+	gLargeFont = CreateCachedFont(TextEdit::Styles::REGULAR_FONT_SIZE, dpi, DOCUMENT_FONT_DISTANCE_FIELD);
 
-	gSmallFont = TextEdit::Font::Create(Roboto, Roboto_Size, TextEdit::Styles::SMALL_FONT_SIZE, dpi);
-	gSmallFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::SMALL_FONT_SIZE, dpi);
+	gRenderer = TextEdit::Renderer::Create(dpi, gLargeFont, glBackend);
 
-	gMediumFont = TextEdit::Font::Create(Roboto, Roboto_Size, TextEdit::Styles::MEDIUM_FONT_SIZE, dpi);
-	gMediumFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::MEDIUM_FONT_SIZE, dpi);
+	gSmallFont = CreateCachedFont(TextEdit::Styles::SMALL_FONT_SIZE, dpi);
+	gMediumFont = CreateCachedFont(TextEdit::Styles::MEDIUM_FONT_SIZE, dpi);
+	if (!gLargeFont || !gRenderer || !gSmallFont || !gMediumFont) {
+		return false;
+	}
 
 	gDocContainer = std::make_shared<TextEdit::DocumentContainer>(gRenderer, gLargeFont, gSmallFont);
 #if 0
@@ -124,6 +213,7 @@ bool Initialize(float dpi) {
 				document->ClearHistory();
 				document->MarkClean();
 				gDocContainer->AddDocument(document);
+				RequestRedraw(); // The file dialog may complete outside of OnInput
 			});
 		}, true },
 		{ U"Close", []() {
@@ -273,28 +363,22 @@ bool Initialize(float dpi) {
 
 	std::vector<TextEdit::FileMenu::MenuItem> fontMenu = {
 		{ U"50%", []() {
-			gLargeFont->LoadGlyphs(Roboto, Roboto_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 0.5f, TextEdit::Styles::DPI);
-			gLargeFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 0.5f, TextEdit::Styles::DPI);
+			SetDocumentFontScale(0.5f);
 		}, true },
 		{ U"75%", []() {
-			gLargeFont->LoadGlyphs(Roboto, Roboto_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 0.75f, TextEdit::Styles::DPI);
-			gLargeFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 0.75f, TextEdit::Styles::DPI);
+			SetDocumentFontScale(0.75f);
 		}, true },
 		{ U"100%", []() {
-			gLargeFont->LoadGlyphs(Roboto, Roboto_Size, TextEdit::Styles::REGULAR_FONT_SIZE			       , TextEdit::Styles::DPI);
-			gLargeFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::REGULAR_FONT_SIZE	       , TextEdit::Styles::DPI);
+			SetDocumentFontScale(1.0f);
 		}, true },
 		{ U"125%", []() {
-			gLargeFont->LoadGlyphs(Roboto, Roboto_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 1.25f, TextEdit::Styles::DPI);
-			gLargeFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 1.25f, TextEdit::Styles::DPI);
+			SetDocumentFontScale(1.25f);
 		}, true },
 		{ U"150%", []() {
-			gLargeFont->LoadGlyphs(Roboto, Roboto_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 1.5f, TextEdit::Styles::DPI);
-			gLargeFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 1.5f, TextEdit::Styles::DPI);
+			SetDocumentFontScale(1.5f);
 		}, true },
 		{ U"200%", []() {
-			gLargeFont->LoadGlyphs(Roboto, Roboto_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 2.0f, TextEdit::Styles::DPI);
-			gLargeFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, TextEdit::Styles::REGULAR_FONT_SIZE * 2.0f, TextEdit::Styles::DPI);
+			SetDocumentFontScale(2.0f);
 		}, true },
 	};
 	gMenu->AddMenuOption(U"FONT", fontMenu, 0.8f);
@@ -322,14 +406,68 @@ bool Initialize(float dpi) {
 }
 
 bool Tick(unsigned int screenWidth, unsigned int screenHeight, float deltaTime) {
-	glClearColor(TextEdit::Styles::BGColor.r, TextEdit::Styles::BGColor.g, TextEdit::Styles::BGColor.b, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
+	PROFILE_BEGIN_FRAME();
+	gAppTime += (double)deltaTime;
+	gFrameWasDrawn = false;
+
+	if (gNextRedrawTime >= 0.0 && gAppTime >= gNextRedrawTime) {
+		gNextRedrawTime = -1.0; // Just a wake up, Update decides what actually changed
+	}
+	if (screenWidth != gLastScreenWidth || screenHeight != gLastScreenHeight) {
+		gLastScreenWidth = screenWidth;
+		gLastScreenHeight = screenHeight;
+		gRedrawPending = true;
+	}
 
 	contentArea = TextEdit::Rect(0.0f, TextEdit::Styles::FILE_MENU_HEIGHT, (float)screenWidth, (float)screenHeight - TextEdit::Styles::FILE_MENU_HEIGHT);
 
+	// Views advance their timers (cursor blink, highlighting, auto scroll) even if nothing
+	// gets drawn this frame, and invalidate whatever changed since they were last displayed.
+	gDocContainer->Update(deltaTime);
+
+	if (gRedrawPending) {
+		gRenderer->InvalidateAll();
+		gRedrawPending = false;
+	}
+
+	// Glyphs rasterized in the background since the last frame damage everything once they land
+	gRenderer->CollectFinishedGlyphs();
+	if (!gRenderer->HasDamage()) {
+		if (gRenderer->HasPendingGlyphs()) {
+			RequestRedrawIn(GLYPH_POLL_SECONDS);
+		}
+		PROFILE_END_FRAME(false);
+		return true; // Nothing changed, the last presented frame is still valid
+	}
+	gFrameWasDrawn = true;
+
+	// The overlay shows the frames before this one, it only needs to keep up with frames that draw anyway
+	if (TextEdit::Profiler::Get().IsOverlayVisible()) {
+		gRenderer->Invalidate(TextEdit::Profiler::Get().GetOverlayRect(*gSmallFont, (float)screenWidth, TextEdit::Styles::FILE_MENU_HEIGHT));
+	}
+
 	gRenderer->StartFrame(0, 0, screenWidth, screenHeight);
+	for (unsigned int pass = 0, passes = gRenderer->GetDamagePassCount(); pass < passes; ++pass) {
+		gRenderer->StartDamagePass(pass);
 
-	gDocContainer->Update(deltaTime);
+		// Scissored to the damage rect, everything outside of it is kept from the last frame
+		gRenderer->GetGL().ClearColor(TextEdit::Styles::BGColor.r, TextEdit::Styles::BGColor.g, TextEdit::Styles::BGColor.b, 1.0f);
+		gRenderer->GetGL().Clear(GL_COLOR_BUFFER_BIT);
+
+		DrawFrame(screenWidth, screenHeight);
+	}
+	gRenderer->EndFrame();
+
+	// The frame drew glyphs that aren't rasterized yet, come back for them
+	if (gRenderer->HasPendingGlyphs()) {
+		RequestRedrawIn(GLYPH_POLL_SECONDS);
+	}
+
+	PROFILE_END_FRAME(true);
+	return true;
+}
+
+void DrawFrame(unsigned int screenWidth, unsigned int screenHeight) {
 	gDocContainer->Display(contentArea.x, contentArea.y, contentArea.width, contentArea.height);
 
 	gRenderer->ClearClip();
@@ -372,22 +510,7 @@ bool Tick(unsigned int screenWidth, unsigned int screenHeight, float deltaTime)
 	float buttonY = 0;
 
 	// Determine which button is hovered based on current mouse position
-	gHoveredButton = -1;
-	if (gLastMouseY >= 0 && gLastMouseY <= buttonHeight) {
-		float closeX = (float)screenWidth - buttonWidth;
-		float maxX = closeX - buttonWidth;
-		float minX = maxX - buttonWidth;
-
-		if (gLastMouseX >= closeX && gLastMouseX <= closeX + buttonWidth) {
-			gHoveredButton = 2; // Close button
-		}
-		else if (gLastMouseX >= maxX && gLastMouseX <= maxX + buttonWidth) {
-			gHoveredButton = 1; // Maximize button
-		}
-		else if (gLastMouseX >= minX && gLastMouseX <= minX + buttonWidth) {
-			gHoveredButton = 0; // Minimize button
-		}
-	}
+	gHoveredButton = GetWindowButtonAt(gLastMouseX, gLastMouseY);
 
 	// Close button
 	float closeX = (float)screenWidth - buttonWidth;
@@ -470,13 +593,72 @@ bool Tick(unsigned int screenWidth, unsigned int screenHeight, float deltaTime)
 		TextEdit::Styles::WindowButtonIconColor.b);
 #endif // !__EMSCRIPTEN__
 
+	gRenderer->ClearClip();
+	TextEdit::Profiler::Get().DisplayOverlay(*gRenderer, gSmallFont, (float)screenWidth, TextEdit::Styles::FILE_MENU_HEIGHT);
+}
 
-	gRenderer->EndFrame();
+// Fonts start from the atlas they had at the same size last time, if the platform keeps a cache
+std::shared_ptr<TextEdit::Font> CreateCachedFont(float pixelHeight, float dpi, bool distanceField) {
+	std::vector<unsigned char> cachedAtlas;
+	bool cached = PlatformReadCache(TextEdit::Font::GetAtlasCacheKey(Roboto, Roboto_Size, pixelHeight, dpi, distanceField).c_str(), cachedAtlas);
 
-	return true;
+	std::shared_ptr<TextEdit::Font> font = TextEdit::Font::Create(Roboto, Roboto_Size, pixelHeight, dpi,
+		cached ? &cachedAtlas : nullptr, distanceField);
+	if (!font) {
+		printf("Failed to create a %.1f pixel font\n", pixelHeight);
+		return nullptr;
+	}
+	font->LoadEmojis(NotoEmoji, NotoEmoji_Size, pixelHeight, dpi);
+	font->SetSubpixelPositioning(SUBPIXEL_GLYPH_POSITIONING); // Only does anything without a distance field
+	font->SetAsyncRasterization(gAsyncGlyphRasterization);
+	if (!cached) {
+		SaveFontAtlas(font);
+	}
+	return font;
+}
+
+void SetDocumentFontScale(float scale) {
+	gDocumentFontScale = std::min(MAX_DOCUMENT_FONT_SCALE, std::max(MIN_DOCUMENT_FONT_SCALE, scale));
+	float pixelHeight = TextEdit::Styles::REGULAR_FONT_SIZE * gDocumentFontScale;
+	float dpi = TextEdit::Styles::DPI;
+	RequestRedraw();
+
+	if (gLargeFont->IsDistanceField()) {
+		gLargeFont->SetPixelHeight(pixelHeight, dpi); // Nothing is baked, the glyphs are drawn bigger or smaller
+		return;
+	}
+
+	SaveFontAtlas(gLargeFont); // Going back to the current size is a cache hit then
+
+	std::vector<unsigned char> cachedAtlas;
+	bool cached = PlatformReadCache(TextEdit::Font::GetAtlasCacheKey(Roboto, Roboto_Size, pixelHeight, dpi).c_str(), cachedAtlas);
+	gLargeFont->LoadGlyphs(Roboto, Roboto_Size, pixelHeight, dpi, cached ? &cachedAtlas : nullptr);
+	gLargeFont->LoadEmojis(NotoEmoji, NotoEmoji_Size, pixelHeight, dpi);
+	if (!cached) {
+		SaveFontAtlas(gLargeFont);
+	}
+}
+
+void SetAsyncGlyphRasterization(bool enabled) {
+	gAsyncGlyphRasterization = enabled;
+	if (gLargeFont) gLargeFont->SetAsyncRasterization(enabled);
+	if (gSmallFont) gSmallFont->SetAsyncRasterization(enabled);
+	if (gMediumFont) gMediumFont->SetAsyncRasterization(enabled);
+}
+
+void SaveFontAtlas(const std::shared_ptr<TextEdit::Font>& font) {
+	std::vector<unsigned char> atlas;
+	if (font && font->SaveAtlas(atlas)) {
+		PlatformWriteCache(font->GetAtlasCacheKey().c_str(), atlas.data(), (unsigned int)atlas.size());
+	}
 }
 
 void Shutdown() {
+	// Whatever got baked this session is there right away next time
+	SaveFontAtlas(gLargeFont);
+	SaveFontAtlas(gSmallFont);
+	SaveFontAtlas(gMediumFont);
+
 	gRenderer = nullptr;
 	gDocContainer = nullptr;
 	gMenu = nullptr;
@@ -485,12 +667,62 @@ void Shutdown() {
 }
 
 void OnInput(const InputEvent& e) {
+	PROFILE_SCOPE(InputDispatch);
 	bool skipInput = false;
 
 	// Update mouse position for hover state
 	if (e.type == InputEvent::Type::MOUSE_MOVE) {
 		gLastMouseX = (float)e.mouse.x;
 		gLastMouseY = (float)e.mouse.y;
+
+		// The menu, tab bars and views report their own damage, only the window buttons are drawn here
+		if (GetWindowButtonAt(gLastMouseX, gLastMouseY) != gHoveredButton) {
+			InvalidateWindowButtons();
+		}
+	}
+
+#if PROFILER_ENABLED
+	if (gRecordingInput && !((e.type == InputEvent::Type::KEY_DOWN || e.type == InputEvent::Type::KEY_UP) && e.key.keyCode == PROFILER_OVERLAY_KEY)) {
+		gInputRecording.Add(gAppTime, e);
+	}
+	if (e.type == InputEvent::Type::KEY_DOWN && e.key.keyCode == PROFILER_OVERLAY_KEY && !e.key.isRepeat) {
+		TextEdit::Profiler& profiler = TextEdit::Profiler::Get();
+		if (e.key.ctrl) {
+			// Replays start from an empty editor, so record right after opening the documents to test with
+			if (!gRecordingInput) {
+				gInputRecording.Clear();
+				gInputRecording.SetScreenSize(gLastScreenWidth, gLastScreenHeight);
+			}
+			else {
+				std::vector<unsigned char> data;
+				gInputRecording.Save(data);
+				PlatformSetNextSaveAsName("carrot_input.ccir");
+				PlatformSaveAs(data.data(), (unsigned int)data.size(), 0);
+			}
+			gRecordingInput = !gRecordingInput;
+		}
+		else if (!e.key.shift) {
+			profiler.SetOverlayVisible(!profiler.IsOverlayVisible());
+			RequestRedraw();
+		}
+		else if (!profiler.IsTracing()) {
+			profiler.StartTrace();
+		}
+		else {
+			profiler.StopTrace();
+			std::string json;
+			profiler.WriteTrace(json);
+			PlatformSetNextSaveAsName("carrot_trace.json");
+			PlatformSaveAs((const unsigned char*)json.c_str(), (unsigned int)json.size(), 0);
+		}
+		return;
+	}
+#endif
+
+	// Ctrl+wheel zooms the document font
+	if (e.type == InputEvent::Type::MOUSE_WHEEL && e.mouse.ctrl) {
+		SetDocumentFontScale(gDocumentFontScale + (float)e.mouse.delta / 120.0f * DOCUMENT_FONT_SCALE_STEP);
+		return;
 	}
 
 	// Handle window control buttons
@@ -542,6 +774,9 @@ void OnInput(const InputEvent& e) {
 
 	// Clear clicked state on mouse up
 	if (e.type == InputEvent::Type::MOUSE_UP) {
+		if (gClickedButton != -1) {
+			InvalidateWindowButtons();
+		}
 		gClickedButton = -1;
 	}
 
@@ -583,9 +818,10 @@ void OnFileDropped(const char* path, const void* data, unsigned int bytes) {
 	newDoc->ClearHistory();
 	newDoc->MarkClean();
 	gDocContainer->AddDocument(newDoc);
+	RequestRedraw();
 }
 
-#ifdef __EMSCRIPTEN__
+#if defined(__EMSCRIPTEN__) || !defined(_WIN32) // Windows converts through the OS
 std::string Utf32ToUtf8(const std::u32string& utf32_string) {
 	if (utf32_string.empty()) {
 		return "";
@@ -839,7 +1075,7 @@ std::u32string Utf8ToUtf32(const char* utf8_string, unsigned int bytes) {
 	return utf32_string;
 }
 
-#endif // __EMSCRIPTEN__ 
+#endif // __EMSCRIPTEN__ || !_WIN32
 
 void BundleFiles() {
 	auto allDocs = gDocContainer->GetAllOpenDocuments();
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <memory>
+
+namespace TextEdit {
+	class GLBackend;
+}
+
 struct InputEvent {
 	enum class Type {
 		KEY_DOWN, KEY_UP,
@@ -35,10 +41,24 @@ struct InputEvent {
 	};
 };
 
-bool Initialize(float dpi);
+bool Initialize(float dpi, std::shared_ptr<TextEdit::GLBackend> glBackend = nullptr); // Null draws with the current OpenGL context
+void SetAsyncGlyphRasterization(bool enabled); // Replays turn it off, so every run bakes the same glyphs in the same frames
 bool Tick(unsigned int screenWidth, unsigned int screenHeight, float deltaTime);
 void Shutdown();
 void OnInput(const InputEvent& event);
 void OnFileDropped(const char* path, const void* data, unsigned int bytes);
 
-void GetTitleBarInteractiveRect(unsigned int* outX, unsigned int* outY, unsigned int* outW, unsigned int* outH); 
\ No newline at end of file
+void GetTitleBarInteractiveRect(unsigned int* outX, unsigned int* outY, unsigned int* outW, unsigned int* outH);
+
+// Damage driven rendering. RequestRedraw invalidates the whole window, smaller changes are
+// reported to the renderer with Renderer::Invalidate. Anything that will change on its own
+// (cursor blink, animations) calls RequestRedrawIn to get another Tick within that many
+// seconds, its Update then invalidates what actually changed. Tick only draws when there
+// is damage, the platform layer should only swap buffers when FrameWasDrawn() returns true,
+// and can block on input for up to GetIdleTimeoutMs() milliseconds (-1 means there is no
+// deadline, wait for input).
+void RequestRedraw();
+void RequestRedrawIn(float seconds);
+bool HasPendingRedraw();
+bool FrameWasDrawn();
+int GetIdleTimeoutMs();
@@ -0,0 +1,177 @@
+// FoldIndex against a brute force model of which lines are hidden, and edits replayed onto folds
+#include <algorithm>
+#include <vector>
+
+#include "FoldIndex.h"
+#include "Test.h"
+
+using namespace TextEdit;
+
+namespace {
+    // One flag per line, hidden by any fold
+    struct Model {
+        std::vector<FoldIndex::Fold> folds;
+
+        void Add(unsigned int first, unsigned int last) {
+            if (last <= first) {
+                return;
+            }
+            for (FoldIndex::Fold& fold : folds) {
+                if (fold.first == first) {
+                    fold.last = last;
+                    return;
+                }
+            }
+            folds.push_back({ first, last });
+        }
+
+        bool IsHidden(unsigned int line) const {
+            for (const FoldIndex::Fold& fold : folds) {
+                if (fold.first < line && line <= fold.last) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    void CheckAgainstModel(const FoldIndex& index, const Model& model, unsigned int lineCount) {
+        unsigned int row = 0;
+        unsigned int lastVisible = 0;
+        for (unsigned int line = 0; line < lineCount; ++line) {
+            bool hidden = model.IsHidden(line);
+            CHECK(index.IsHidden(line) == hidden);
+            if (hidden) {
+                CHECK(index.LineToRow(line) == index.LineToRow(lastVisible));
+                continue;
+            }
+            CHECK(index.LineToRow(line) == row);
+            CHECK(index.RowToLine(row) == line);
+            if (row > 0) {
+                CHECK(index.NextVisibleLine(lastVisible) == line);
+            }
+            lastVisible = line;
+            row += 1;
+        }
+        CHECK(index.GetRowCount(lineCount) == row);
+    }
+
+    void NoFolds() {
+        FoldIndex index;
+        CHECK(!index.HasFolds());
+        CHECK(index.GetRowCount(100) == 100);
+        CHECK(index.LineToRow(42) == 42);
+        CHECK(index.RowToLine(42) == 42);
+        CHECK(index.NextVisibleLine(42) == 43);
+        CHECK(!index.RemoveFold(3));
+    }
+
+    void NestedFolds() {
+        FoldIndex index;
+        index.AddFold(10, 40);
+        index.AddFold(20, 30);
+        CHECK(index.IsFolded(10) && index.IsFolded(20));
+        CHECK(index.GetRowCount(100) == 70);
+        CHECK(index.NextVisibleLine(10) == 41);
+
+        // Opening the outer fold leaves the inner one closed
+        CHECK(index.RemoveFold(10));
+        CHECK(!index.IsHidden(15));
+        CHECK(index.IsHidden(25));
+        CHECK(index.GetRowCount(100) == 90);
+
+        index.AddFold(10, 40);
+        index.RevealLine(25);
+        CHECK(!index.HasFolds());
+    }
+
+    void MatchesModel() {
+        const unsigned int lineCount = 300;
+        Test::Random random(1);
+        for (unsigned int round = 0; round < 50; ++round) {
+            FoldIndex index;
+            Model model;
+            unsigned int folds = 1 + random.Next(12);
+            for (unsigned int i = 0; i < folds; ++i) {
+                unsigned int first = random.Next(lineCount);
+                unsigned int last = std::min(lineCount - 1, first + random.Next(60));
+                index.AddFold(first, last);
+                model.Add(first, last);
+            }
+            CheckAgainstModel(index, model, lineCount);
+        }
+    }
+
+    void EditsAboveMoveFolds() {
+        FoldIndex index;
+        index.AddFold(10, 20);
+        unsigned int version = index.GetVersion();
+
+        index.ApplyEdit(5, 3); // Three lines inserted after line 5
+        CHECK(index.IsFolded(13));
+        CHECK(!index.IsHidden(13) && index.IsHidden(14) && index.IsHidden(23) && !index.IsHidden(24));
+        CHECK(index.GetVersion() != version);
+
+        index.ApplyEdit(2, -3); // Lines 3 to 5 removed
+        CHECK(index.IsFolded(10));
+        CHECK(index.IsHidden(20) && !index.IsHidden(21));
+
+        index.ApplyEdit(30, 5); // Below the fold, nothing moves
+        CHECK(index.IsFolded(10));
+        CHECK(index.GetRowCount(100) == 90);
+    }
+
+    void EditsInsideOpenFolds() {
+        FoldIndex index;
+        index.AddFold(10, 20);
+        index.ApplyEdit(15, 0);
+        CHECK(!index.HasFolds());
+
+        // Lines added on the header line belong to its fold
+        index.AddFold(10, 20);
+        index.ApplyEdit(10, 2);
+        CHECK(index.IsFolded(10));
+        CHECK(index.IsHidden(22) && !index.IsHidden(23));
+
+        // Joining the header with the line after it opens the fold
+        index.ApplyEdit(10, -1);
+        CHECK(!index.HasFolds());
+
+        // So does removing the header
+        index.AddFold(10, 20);
+        index.ApplyEdit(8, -3);
+        CHECK(!index.HasFolds());
+    }
+
+    void DeleteAndReinsert() {
+        FoldIndex index;
+        index.AddFold(50, 60);
+        index.AddFold(70, 90);
+        index.AddFold(75, 80);
+
+        // What undoing a deletion replays
+        index.ApplyEdit(10, -5);
+        CHECK(index.IsFolded(45) && index.IsFolded(65) && index.IsFolded(70));
+        index.ApplyEdit(10, 5);
+        CHECK(index.IsFolded(50) && index.IsFolded(70) && index.IsFolded(75));
+        CHECK(!index.IsFolded(45) && !index.IsFolded(65));
+
+        Model model;
+        model.Add(50, 60);
+        model.Add(70, 90);
+        model.Add(75, 80);
+        CheckAgainstModel(index, model, 120);
+    }
+}
+
+int main() {
+    static const Test::Case cases[] = {
+        { "FoldIndex no folds", NoFolds },
+        { "FoldIndex nested folds", NestedFolds },
+        { "FoldIndex matches model", MatchesModel },
+        { "FoldIndex edits above move folds", EditsAboveMoveFolds },
+        { "FoldIndex edits inside open folds", EditsInsideOpenFolds },
+        { "FoldIndex delete and reinsert", DeleteAndReinsert },
+    };
+    return Test::RunTests(cases);
+}
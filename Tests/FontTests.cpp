@@ -0,0 +1,232 @@
+// The glyph table against std::map, the skyline packer's invariants and the atlas cache round trip
+#include <map>
+#include <vector>
+
+#include "Font.h"
+#include "Test.h"
+
+extern unsigned int Roboto_Size;
+extern unsigned char Roboto[];
+
+namespace TextEdit {
+    // Friend of Font, reaches what the tests need
+    class FontTest {
+    public:
+        typedef Font::GlyphTable GlyphTable;
+        typedef Font::CachedGlyph CachedGlyph;
+        typedef Font::AtlasPage AtlasPage;
+        typedef Font::SkylineNode SkylineNode;
+
+        static bool FindSkylineSpot(const Font& font, const AtlasPage& page, int width, int height, size_t& outNode, int& outY) {
+            return font.FindSkylineSpot(page, width, height, outNode, outY);
+        }
+
+        static void AddSkylineLevel(Font& font, AtlasPage& page, size_t node, int x, int y, int width) {
+            font.AddSkylineLevel(page, node, x, y, width);
+        }
+    };
+}
+
+using namespace TextEdit;
+
+namespace {
+    typedef std::map<char32_t, unsigned int> GlyphModel; // Codepoint to a tag kept in lastUsedFrame
+
+    void CheckGlyphTable(FontTest::GlyphTable& table, const GlyphModel& model) {
+        CHECK(table.Size() == model.size());
+        for (const auto& entry : model) {
+            FontTest::CachedGlyph* glyph = table.Find(entry.first);
+            CHECK(glyph != nullptr && glyph->codepoint == entry.first && glyph->lastUsedFrame == entry.second);
+        }
+        size_t visited = 0;
+        table.ForEach([&](FontTest::CachedGlyph& glyph) {
+            visited += 1;
+            CHECK(model.count(glyph.codepoint) == 1);
+        });
+        CHECK(visited == model.size());
+    }
+
+    void GlyphTableInsertFind() {
+        FontTest::GlyphTable table;
+        GlyphModel model;
+        CHECK(table.Find(U'a') == nullptr);
+        CHECK(table.Find(0x1F600) == nullptr);
+
+        for (unsigned int i = 0; i < 2000; ++i) {
+            char32_t codepoint = i % 3 == 0 ? static_cast<char32_t>(0x20 + i) : static_cast<char32_t>(0x10000 + i * 7);
+            table.Insert(codepoint).lastUsedFrame = i + 1;
+            model[codepoint] = i + 1;
+        }
+        CheckGlyphTable(table, model);
+
+        // Inserting again finds what is there
+        CHECK(table.Insert(0x10000 + 7).lastUsedFrame == model[0x10000 + 7]);
+        CHECK(table.Size() == model.size());
+
+        table.Clear();
+        model.clear();
+        CheckGlyphTable(table, model);
+        CHECK(table.Find(0x10000 + 7) == nullptr);
+    }
+
+    // Every erase moves the entries after it in the probe sequence, each of them has to stay reachable
+    void GlyphTableBackwardShiftErase() {
+        FontTest::GlyphTable table;
+        GlyphModel model;
+        std::vector<char32_t> codepoints;
+        for (unsigned int i = 0; i < 1500; ++i) {
+            char32_t codepoint = static_cast<char32_t>(0x20000 + i);
+            codepoints.push_back(codepoint);
+            table.Insert(codepoint).lastUsedFrame = i + 1;
+            model[codepoint] = i + 1;
+        }
+
+        Test::Random random(2);
+        for (size_t i = codepoints.size(); i > 1; --i) {
+            std::swap(codepoints[i - 1], codepoints[random.Next(static_cast<unsigned int>(i))]);
+        }
+        for (size_t i = 0; i < codepoints.size(); ++i) {
+            table.Erase(codepoints[i]);
+            model.erase(codepoints[i]);
+            CHECK(table.Find(codepoints[i]) == nullptr);
+            if (i % 50 == 0) {
+                CheckGlyphTable(table, model);
+            }
+        }
+        CheckGlyphTable(table, model);
+        table.Erase(0x20000); // Not there any more
+        CHECK(table.Size() == 0);
+    }
+
+    void GlyphTableRandomOperations() {
+        FontTest::GlyphTable table;
+        GlyphModel model;
+        Test::Random random(3);
+        for (unsigned int i = 0; i < 40000; ++i) {
+            // Dense and sparse codepoints, few enough that they get erased and inserted again
+            char32_t codepoint = random.Next(4) == 0 ? static_cast<char32_t>(random.Next(0x3000))
+                : static_cast<char32_t>(0x1F000 + random.Next(3000));
+            if (random.Next(3) == 0) {
+                table.Erase(codepoint);
+                model.erase(codepoint);
+                CHECK(table.Find(codepoint) == nullptr);
+            }
+            else {
+                table.Insert(codepoint).lastUsedFrame = i + 1;
+                model[codepoint] = i + 1;
+            }
+            if (i % 2000 == 0) {
+                CheckGlyphTable(table, model);
+            }
+        }
+        CheckGlyphTable(table, model);
+    }
+
+    void CheckSkyline(const std::vector<FontTest::SkylineNode>& skyline, int atlasWidth, int atlasHeight) {
+        int x = 0;
+        for (size_t i = 0; i < skyline.size(); ++i) {
+            CHECK(skyline[i].x == x);
+            CHECK(skyline[i].width > 0);
+            CHECK(skyline[i].y >= 0 && skyline[i].y <= atlasHeight);
+            if (i > 0) {
+                CHECK(skyline[i].y != skyline[i - 1].y); // Neighbours at the same height are merged
+            }
+            x += skyline[i].width;
+        }
+        CHECK(x == atlasWidth);
+    }
+
+    void SkylinePacking() {
+        std::shared_ptr<Font> font = Font::Create(Roboto, Roboto_Size, 16.0f, 1.0f);
+        CHECK(font != nullptr);
+        if (!font) {
+            return;
+        }
+        const int atlasWidth = static_cast<int>(font->GetAtlasTextureWidth());
+        const int atlasHeight = static_cast<int>(font->GetAtlasTextureHeight());
+
+        FontTest::AtlasPage page;
+        page.skyline.push_back({ 0, 0, atlasWidth });
+        Font::AtlasRect full = { 0, 0, atlasWidth, atlasHeight };
+        std::vector<Font::AtlasRect> placed;
+        Test::Random random(4);
+        int area = 0;
+        unsigned int misses = 0;
+        while (misses < 50) {
+            int width = 2 + static_cast<int>(random.Next(24));
+            int height = 6 + static_cast<int>(random.Next(20)); // Roughly glyph shaped
+            size_t node = 0;
+            int y = 0;
+            if (!FontTest::FindSkylineSpot(*font, page, width, height, node, y)) {
+                misses += 1;
+                continue;
+            }
+            Font::AtlasRect rect = { page.skyline[node].x, y, width, height };
+            FontTest::AddSkylineLevel(*font, page, node, rect.x, y + height, width);
+            CheckSkyline(page.skyline, atlasWidth, atlasHeight);
+            placed.push_back(rect);
+            area += width * height;
+        }
+
+        for (size_t i = 0; i < placed.size(); ++i) {
+            const Font::AtlasRect& a = placed[i];
+            CHECK(a.x >= full.x && a.y >= full.y && a.x + a.width <= full.width && a.y + a.height <= full.height);
+            for (size_t j = i + 1; j < placed.size(); ++j) {
+                const Font::AtlasRect& b = placed[j];
+                bool apart = a.x + a.width <= b.x || b.x + b.width <= a.x || a.y + a.height <= b.y || b.y + b.height <= a.y;
+                CHECK(apart);
+            }
+            // Everything placed is under the skyline
+            for (const FontTest::SkylineNode& node : page.skyline) {
+                if (node.x < a.x + a.width && a.x < node.x + node.width) {
+                    CHECK(a.y + a.height <= node.y);
+                }
+            }
+        }
+        CHECK(area * 10 > atlasWidth * atlasHeight * 7); // Bottom-left packing of similar sized boxes wastes little
+    }
+
+    void AtlasCacheRoundTrip() {
+        std::shared_ptr<Font> font = Font::Create(Roboto, Roboto_Size, 16.0f, 1.0f);
+        CHECK(font != nullptr);
+        if (!font) {
+            return;
+        }
+        font->SetAsyncRasterization(false);
+        while (font->HasPendingGlyphs()) {
+            font->CollectFinishedGlyphs();
+        }
+        const GlyphInfo glyph = font->GetGlyph(U'g');
+
+        std::vector<unsigned char> data;
+        CHECK(font->SaveAtlas(data));
+        std::shared_ptr<Font> cached = Font::Create(Roboto, Roboto_Size, 16.0f, 1.0f, &data);
+        CHECK(cached != nullptr);
+        if (!cached) {
+            return;
+        }
+        CHECK(cached->GetAtlasPixels(0) == font->GetAtlasPixels(0));
+        const GlyphInfo& loaded = cached->GetGlyph(U'g');
+        CHECK(loaded.isValid && loaded.u0 == glyph.u0 && loaded.v1 == glyph.v1 && loaded.advance == glyph.advance);
+
+        // Anything cut short is turned down, the font keeps what it has
+        for (size_t size = 0; size < data.size(); size += 1 + size / 4) {
+            std::vector<unsigned char> truncated(data.begin(), data.begin() + size);
+            CHECK(!cached->LoadAtlas(truncated));
+        }
+        // So is a cache made at another size
+        std::shared_ptr<Font> larger = Font::Create(Roboto, Roboto_Size, 24.0f, 1.0f);
+        CHECK(larger != nullptr && !larger->LoadAtlas(data));
+    }
+}
+
+int main() {
+    static const Test::Case cases[] = {
+        { "GlyphTable insert and find", GlyphTableInsertFind },
+        { "GlyphTable backward shift erase", GlyphTableBackwardShiftErase },
+        { "GlyphTable random operations", GlyphTableRandomOperations },
+        { "Skyline packing", SkylinePacking },
+        { "Atlas cache round trip", AtlasCacheRoundTrip },
+    };
+    return Test::RunTests(cases);
+}
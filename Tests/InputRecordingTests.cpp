@@ -0,0 +1,142 @@
+// InputRecording Save and Load: every kind of event comes back as it was, broken files are turned down
+#include <cstring>
+#include <vector>
+
+#include "InputRecording.h"
+#include "Test.h"
+
+using namespace TextEdit;
+
+namespace {
+    InputEvent MakeEvent(InputEvent::Type type, unsigned long time) {
+        InputEvent event;
+        memset(&event, 0, sizeof(event));
+        event.type = type;
+        event.time = time;
+        return event;
+    }
+
+    bool SameEvent(const InputEvent& a, const InputEvent& b) {
+        if (a.type != b.type || a.time != b.time) {
+            return false;
+        }
+        switch (a.type) {
+        case InputEvent::Type::KEY_DOWN:
+        case InputEvent::Type::KEY_UP:
+            return a.key.keyCode == b.key.keyCode && a.key.unicode == b.key.unicode && a.key.ctrl == b.key.ctrl &&
+                a.key.shift == b.key.shift && a.key.isRepeat == b.key.isRepeat && a.key.alt == b.key.alt;
+        case InputEvent::Type::TOUCH_DOWN:
+        case InputEvent::Type::TOUCH_UP:
+        case InputEvent::Type::TOUCH_MOVE:
+            return a.touch.id == b.touch.id && a.touch.x == b.touch.x && a.touch.y == b.touch.y;
+        default:
+            return a.mouse.button == b.mouse.button && a.mouse.ctrl == b.mouse.ctrl && a.mouse.shift == b.mouse.shift &&
+                a.mouse.delta == b.mouse.delta && a.mouse.x == b.mouse.x && a.mouse.y == b.mouse.y;
+        }
+    }
+
+    InputRecording MakeRecording() {
+        InputRecording recording;
+        recording.SetScreenSize(1920, 1080);
+        recording.AddTyping(U"int a;\n\U0001F600", 0.0, 0.02);
+
+        InputEvent key = MakeEvent(InputEvent::Type::KEY_DOWN, 500);
+        key.key.keyCode = 0x5A; // Ctrl+Shift+Z, held
+        key.key.ctrl = true;
+        key.key.shift = true;
+        key.key.isRepeat = true;
+        recording.Add(0.5, key);
+        key.type = InputEvent::Type::KEY_UP;
+        key.key.isRepeat = false;
+        key.key.alt = true;
+        recording.Add(0.52, key);
+
+        InputEvent mouse = MakeEvent(InputEvent::Type::MOUSE_WHEEL, 600);
+        mouse.mouse.delta = -120;
+        mouse.mouse.x = 300;
+        mouse.mouse.y = -4; // Dragged out of the window
+        mouse.mouse.ctrl = true;
+        recording.Add(0.6, mouse);
+        mouse.type = InputEvent::Type::MOUSE_DOWN;
+        mouse.mouse.button = 0x04; // VK_MBUTTON
+        mouse.mouse.delta = 0;
+        recording.Add(0.61, mouse);
+
+        InputEvent touch = MakeEvent(InputEvent::Type::TOUCH_MOVE, 700);
+        touch.touch.id = 3;
+        touch.touch.x = 12;
+        touch.touch.y = 800;
+        recording.Add(0.7, touch);
+        return recording;
+    }
+
+    void RoundTrip() {
+        InputRecording recording = MakeRecording();
+        std::vector<unsigned char> data;
+        recording.Save(data);
+
+        InputRecording loaded;
+        CHECK(loaded.Load(data));
+        CHECK(loaded.GetScreenWidth() == 1920 && loaded.GetScreenHeight() == 1080);
+        const std::vector<InputRecording::Entry>& expected = recording.GetEntries();
+        const std::vector<InputRecording::Entry>& entries = loaded.GetEntries();
+        CHECK(entries.size() == expected.size());
+        for (size_t i = 0; i < entries.size() && i < expected.size(); ++i) {
+            CHECK(entries[i].time == expected[i].time);
+            CHECK(SameEvent(entries[i].event, expected[i].event));
+        }
+
+        // Saving what was loaded writes the same bytes
+        std::vector<unsigned char> again;
+        loaded.Save(again);
+        CHECK(again == data);
+    }
+
+    void Typing() {
+        InputRecording recording;
+        recording.AddTyping(U"a\nb", 1.0, 0.25);
+        const std::vector<InputRecording::Entry>& entries = recording.GetEntries();
+        CHECK(entries.size() == 4); // The newline is a return key press and release
+        if (entries.size() != 4) {
+            return;
+        }
+        CHECK(entries[0].event.type == InputEvent::Type::KEY_DOWN && entries[0].event.key.unicode == U'a');
+        CHECK(entries[1].event.type == InputEvent::Type::KEY_DOWN && entries[1].event.key.keyCode == 0x0D);
+        CHECK(entries[2].event.type == InputEvent::Type::KEY_UP && entries[2].event.key.keyCode == 0x0D);
+        CHECK(entries[3].event.key.unicode == U'b' && entries[3].time == 1.5);
+    }
+
+    void BrokenFiles() {
+        std::vector<unsigned char> data;
+        MakeRecording().Save(data);
+
+        InputRecording loaded;
+        for (size_t size = 0; size < data.size(); size += 7) {
+            std::vector<unsigned char> truncated(data.begin(), data.begin() + size);
+            CHECK(!loaded.Load(truncated));
+            CHECK(loaded.GetEntries().empty());
+        }
+
+        std::vector<unsigned char> longer = data;
+        longer.push_back(0);
+        CHECK(!loaded.Load(longer));
+
+        std::vector<unsigned char> wrongMagic = data;
+        wrongMagic[0] ^= 0xFF;
+        CHECK(!loaded.Load(wrongMagic));
+        CHECK(loaded.GetEntries().empty());
+
+        // A good file after a bad one
+        CHECK(loaded.Load(data));
+        CHECK(loaded.GetEntries().size() == MakeRecording().GetEntries().size());
+    }
+}
+
+int main() {
+    static const Test::Case cases[] = {
+        { "InputRecording round trip", RoundTrip },
+        { "InputRecording typing", Typing },
+        { "InputRecording broken files", BrokenFiles },
+    };
+    return Test::RunTests(cases);
+}
@@ -0,0 +1,199 @@
+// LineLayoutCache against layouts made from scratch, while the document is edited under it. Lines are
+// made of narrow and wide letters at a handful of lengths, a layout that stayed on the wrong line
+// after an edit usually has the right length and the wrong positions.
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Document.h"
+#include "Font.h"
+#include "LineLayoutCache.h"
+#include "Test.h"
+
+extern unsigned int Roboto_Size;
+extern unsigned char Roboto[];
+
+using namespace TextEdit;
+
+namespace {
+    std::u32string MakeLine(Test::Random& random) {
+        static const char32_t letters[] = { U'i', U'W', U'm', U'.', U'\t' };
+        std::u32string line;
+        unsigned int length = random.Next(8);
+        for (unsigned int i = 0; i < length; ++i) {
+            line += letters[random.Next(5)];
+        }
+        return line;
+    }
+
+    std::u32string MakeText(Test::Random& random, unsigned int lines) {
+        std::u32string text;
+        for (unsigned int i = 0; i < lines; ++i) {
+            text += MakeLine(random);
+            if (i + 1 < lines) {
+                text += U'\n';
+            }
+        }
+        return text;
+    }
+
+    std::shared_ptr<Font> MakeFont() {
+        std::shared_ptr<Font> font = Font::Create(Roboto, Roboto_Size, 16.0f, 1.0f);
+        if (font) {
+            font->SetAsyncRasterization(false);
+        }
+        return font;
+    }
+
+    // Lines the cache kept against the same lines laid out by a cache that has seen no edits
+    void CheckLines(LineLayoutCache& cache, Document& document, Font& font, unsigned int first, unsigned int last) {
+        LineLayoutCache fresh;
+        last = std::min(last, document.GetLineCount() - 1);
+        for (unsigned int line = first; line <= last; ++line) {
+            const std::vector<float> expected = fresh.GetPositions(document, font, line);
+            CHECK(cache.GetPositions(document, font, line) == expected);
+            CHECK(cache.GetWidth(document, font, line) == expected.back());
+        }
+    }
+
+    float WidestLine(Document& document, Font& font) {
+        LineLayoutCache fresh;
+        float widest = 0.0f;
+        for (unsigned int line = 0; line < document.GetLineCount(); ++line) {
+            widest = std::max(widest, fresh.GetWidth(document, font, line));
+        }
+        return widest;
+    }
+
+    // Typing, pasting lines and deleting across lines, now and then undone, with every line cached
+    void EditReplay() {
+        std::shared_ptr<Font> font = MakeFont();
+        CHECK(font != nullptr);
+        if (!font) {
+            return;
+        }
+        Test::Random random(5);
+        std::shared_ptr<Document> document = Document::Create();
+        document->Load(MakeText(random, 200));
+
+        LineLayoutCache cache;
+        CheckLines(cache, *document, *font, 0, document->GetLineCount());
+        for (unsigned int edit = 0; edit < 300; ++edit) {
+            unsigned int line = random.Next(document->GetLineCount());
+            unsigned int column = random.Next(static_cast<unsigned int>(document->GetLine(line).text.length()) + 1);
+            document->PlaceCursor(Document::Cursor(line, column));
+            switch (random.Next(4)) {
+            case 0:
+                document->Insert(MakeLine(random));
+                break;
+            case 1:
+                document->Insert(MakeLine(random) + U"\n" + MakeLine(random) + U"\n" + MakeLine(random));
+                break;
+            case 2: {
+                unsigned int lastLine = std::min(document->GetLineCount() - 1, line + random.Next(4));
+                document->MoveCursor(Document::Cursor(lastLine, 0));
+                document->Remove();
+                break;
+            }
+            default:
+                if (document->CanUndo()) {
+                    document->Undo();
+                }
+                break;
+            }
+            CheckLines(cache, *document, *font, 0, document->GetLineCount());
+        }
+    }
+
+    // Deleting lines and putting them back, the layouts below have to come back to their lines
+    void DeleteAndReinsert() {
+        std::shared_ptr<Font> font = MakeFont();
+        CHECK(font != nullptr);
+        if (!font) {
+            return;
+        }
+        Test::Random random(6);
+        std::shared_ptr<Document> document = Document::Create();
+        document->Load(MakeText(random, 100));
+        const std::u32string before = document->GetLine(60).text;
+
+        LineLayoutCache cache;
+        CheckLines(cache, *document, *font, 0, 99);
+        document->PlaceCursor(Document::Cursor(10, 0));
+        document->MoveCursor(Document::Cursor(30, 0));
+        document->Remove();
+        CHECK(document->GetLine(40).text == before);
+        CheckLines(cache, *document, *font, 0, 79);
+        document->Undo();
+        CHECK(document->GetLine(60).text == before);
+        CheckLines(cache, *document, *font, 0, 99);
+        document->Redo();
+        CheckLines(cache, *document, *font, 0, 79);
+    }
+
+    // Past the cache's size the least recently used lines go, what stays has to be right
+    void Eviction() {
+        std::shared_ptr<Font> font = MakeFont();
+        CHECK(font != nullptr);
+        if (!font) {
+            return;
+        }
+        Test::Random random(7);
+        std::shared_ptr<Document> document = Document::Create();
+        document->Load(MakeText(random, 20000));
+
+        LineLayoutCache cache;
+        for (unsigned int line = 0; line < document->GetLineCount(); ++line) {
+            cache.GetPositions(*document, *font, line);
+        }
+        document->PlaceCursor(Document::Cursor(19000, 0));
+        document->Insert(U"\n\n");
+        CheckLines(cache, *document, *font, 18900, 19100);
+        CheckLines(cache, *document, *font, 0, 100);
+
+        // More edits than the document remembers, the cache starts over
+        for (unsigned int i = 0; i < 100; ++i) {
+            document->PlaceCursor(Document::Cursor(i * 10, 0));
+            document->Insert(U"\n");
+        }
+        CheckLines(cache, *document, *font, 0, 1100);
+    }
+
+    void MaxWidth() {
+        std::shared_ptr<Font> font = MakeFont();
+        CHECK(font != nullptr);
+        if (!font) {
+            return;
+        }
+        Test::Random random(8);
+        std::shared_ptr<Document> document = Document::Create();
+        document->Load(MakeText(random, 500));
+
+        LineLayoutCache cache;
+        CHECK(cache.GetMaxWidth(*document, *font) == WidestLine(*document, *font));
+
+        // A longer line pasted in is found without measuring everything again
+        document->PlaceCursor(Document::Cursor(250, 0));
+        document->Insert(U"WWWWWWWWWWWWWWWWWWWW\nWWWWWWWWWWWWWWWWWWWWWWWWWWWWWW\n");
+        CHECK(cache.GetMaxWidth(*document, *font) == WidestLine(*document, *font));
+
+        // Shorter lines don't shrink it until everything is measured again
+        float widest = cache.GetMaxWidth(*document, *font);
+        document->PlaceCursor(Document::Cursor(251, 0));
+        document->MoveCursor(Document::Cursor(252, 0));
+        document->Remove();
+        CHECK(cache.GetMaxWidth(*document, *font) == widest);
+        document->Load(MakeText(random, 500));
+        CHECK(cache.GetMaxWidth(*document, *font) == WidestLine(*document, *font));
+    }
+}
+
+int main() {
+    static const Test::Case cases[] = {
+        { "LineLayoutCache edit replay", EditReplay },
+        { "LineLayoutCache delete and reinsert", DeleteAndReinsert },
+        { "LineLayoutCache eviction", Eviction },
+        { "LineLayoutCache max width", MaxWidth },
+    };
+    return Test::RunTests(cases);
+}
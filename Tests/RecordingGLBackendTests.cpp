@@ -0,0 +1,100 @@
+// What drawing a fixed document costs in GL calls, counted by RecordingGLBackend. The numbers are what
+// the renderer batches the view into today, a change that makes them grow should be on purpose.
+#include "RecordingGLBackend.h"
+#include "Test.h"
+#include "TestScene.h"
+
+using namespace TextEdit;
+
+namespace {
+    // Counts start over with every frame
+    struct RecordedScene : Test::Scene {
+        std::shared_ptr<RecordingGLBackend> gl;
+
+        bool Create() {
+            gl = RecordingGLBackend::Create(false);
+            return Scene::Create(gl);
+        }
+
+        void DrawFrame() {
+            gl->Reset();
+            Scene::DrawFrame();
+        }
+    };
+
+    void FirstFrame() {
+        RecordedScene scene;
+        CHECK(scene.Create());
+        if (!scene.view) {
+            return;
+        }
+        scene.renderer->InvalidateAll();
+        scene.DrawFrame();
+
+        const RecordingGLBackend::Stats& stats = scene.gl->GetStats();
+        CHECK(stats.drawCalls == 4); // The whole view in four batches
+        CHECK(stats.stateChanges == 45);
+        CHECK(stats.textureUploads > 0); // The atlas and the glyphs baked for this frame
+        CHECK(stats.drawCalls == scene.renderer->GetLastFrameStats().drawCalls);
+        CHECK(stats.instances == scene.renderer->GetLastFrameStats().quads);
+    }
+
+    void RedrawnFrame() {
+        RecordedScene scene;
+        CHECK(scene.Create());
+        if (!scene.view) {
+            return;
+        }
+        scene.renderer->InvalidateAll();
+        scene.DrawFrame();
+        scene.renderer->InvalidateAll();
+        scene.DrawFrame();
+
+        // Nothing new to upload, the state the renderer already set isn't set again
+        const RecordingGLBackend::Stats& stats = scene.gl->GetStats();
+        CHECK(stats.drawCalls == 4);
+        CHECK(stats.stateChanges == 37);
+        CHECK(stats.textureUploads == 0);
+        CHECK(stats.instances == scene.renderer->GetLastFrameStats().quads);
+        CHECK(stats.instances > 1000); // Most of the screen is text
+    }
+
+    void DamagedLine() {
+        RecordedScene scene;
+        CHECK(scene.Create());
+        if (!scene.view) {
+            return;
+        }
+        scene.renderer->InvalidateAll();
+        scene.DrawFrame();
+        scene.renderer->InvalidateAll();
+        scene.DrawFrame();
+        unsigned long long fullFrameInstances = scene.gl->GetStats().instances;
+
+        // Typing redraws the line, not the screen
+        scene.document->PlaceCursor(Document::Cursor(10, 0));
+        scene.document->Insert(U"x");
+        scene.DrawFrame();
+        const RecordingGLBackend::Stats& stats = scene.gl->GetStats();
+        CHECK(stats.drawCalls >= 1 && stats.drawCalls <= 6);
+        CHECK(stats.instances * 4 < fullFrameInstances);
+
+        // Once the highlighter caught up with the edit nothing is drawn
+        for (int frame = 0; frame < 100 && scene.document->HasPendingHighlight(); ++frame) {
+            scene.DrawFrame();
+        }
+        CHECK(!scene.document->HasPendingHighlight());
+        scene.DrawFrame();
+        CHECK(scene.gl->GetStats().drawCalls == 0);
+        CHECK(scene.gl->GetStats().stateChanges == 0);
+    }
+}
+
+int main() {
+    static const Test::Case cases[] = {
+        { "RecordingGLBackend first frame", FirstFrame },
+        { "RecordingGLBackend redrawn frame", RedrawnFrame },
+        { "RecordingGLBackend damaged line", DamagedLine },
+    };
+    return Test::RunTests(cases);
+}
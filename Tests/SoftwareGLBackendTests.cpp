@@ -0,0 +1,148 @@
+// Pixels SoftwareGLBackend draws, hashed. The expected hash is of a frame checked by eye, a change to
+// text rendering, the styles or the backend's sampling changes it and has to update it on purpose.
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "SoftwareGLBackend.h"
+#include "Test.h"
+#include "TestScene.h"
+
+using namespace TextEdit;
+
+namespace {
+    const uint64_t EXPECTED_SCENE_HASH = 0xFE11CF89F0DE1882ull;
+
+    // FNV-1a
+    uint64_t HashPixels(const SoftwareGLBackend& gl) {
+        const unsigned char* pixels = gl.GetPixels();
+        size_t bytes = static_cast<size_t>(gl.GetWidth()) * gl.GetHeight() * 4;
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (size_t i = 0; i < bytes; ++i) {
+            hash = (hash ^ pixels[i]) * 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    struct SoftwareScene : Test::Scene {
+        std::shared_ptr<SoftwareGLBackend> gl;
+
+        bool Create() {
+            gl = SoftwareGLBackend::Create(WIDTH, HEIGHT);
+            return Scene::Create(gl);
+        }
+
+        // The minimap draws its tiles from the second frame on
+        void DrawSettledFrame() {
+            for (int i = 0; i < 2; ++i) {
+                renderer->InvalidateAll();
+                DrawFrame();
+            }
+        }
+    };
+
+    void SceneHash() {
+        SoftwareScene scene;
+        CHECK(scene.Create());
+        if (!scene.view) {
+            return;
+        }
+        scene.DrawSettledFrame();
+        uint64_t hash = HashPixels(*scene.gl);
+        if (hash != EXPECTED_SCENE_HASH) {
+            printf("Scene hash is 0x%016llXull\n", static_cast<unsigned long long>(hash));
+        }
+        CHECK(hash == EXPECTED_SCENE_HASH);
+
+        // Drawing it again changes nothing
+        scene.renderer->InvalidateAll();
+        scene.DrawFrame();
+        CHECK(HashPixels(*scene.gl) == hash);
+    }
+
+    // Redrawing only the damage has to leave the same pixels as drawing everything
+    void DamageMatchesFullRedraw() {
+        SoftwareScene scene;
+        CHECK(scene.Create());
+        if (!scene.view) {
+            return;
+        }
+        scene.DrawSettledFrame();
+
+        scene.document->PlaceCursor(Document::Cursor(10, 4));
+        scene.document->Insert(U"value");
+        for (int frame = 0; frame < 100 && scene.DrawFrame(); ++frame) {
+        }
+        uint64_t damaged = HashPixels(*scene.gl);
+
+        scene.renderer->InvalidateAll();
+        scene.DrawFrame();
+        CHECK(HashPixels(*scene.gl) == damaged);
+    }
+
+    // Textures uploaded as one channel sample as (r, 0, 0, 1), uploads with a row alignment of 4 skip the padding
+    void SingleChannelTexture() {
+        std::shared_ptr<SoftwareGLBackend> gl = SoftwareGLBackend::Create(4, 4);
+        const unsigned char texels[] = {
+            10, 20, 30, 0, // Rows of three texels padded to four bytes
+            40, 50, 60, 0,
+            70, 80, 90, 0,
+        };
+        GLuint texture = 0;
+        gl->GenTextures(1, &texture);
+        gl->BindTexture(GL_TEXTURE_2D, texture);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gl->TexImage2D(GL_TEXTURE_2D, 0, GL_R8, 3, 3, 0, GL_RED, GL_UNSIGNED_BYTE, texels);
+        const unsigned char middle[] = { 255 };
+        gl->PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        gl->TexSubImage2D(GL_TEXTURE_2D, 0, 1, 1, 1, 1, GL_RED, GL_UNSIGNED_BYTE, middle);
+
+        // A framebuffer backed by it can't be drawn to, it isn't RGBA
+        GLuint framebuffer = 0;
+        gl->GenFramebuffers(1, &framebuffer);
+        gl->BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        gl->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        CHECK(gl->CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE);
+        gl->BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // Drawn through a full screen image quad, the renderer's layout: rect, uv, color with flags in alpha
+        struct Quad {
+            uint16_t rect[4]; // Eighths of a pixel
+            uint16_t uv[4];   // 0 to 65535 across the texture
+            uint8_t color[4]; // Alpha 255 samples uTexture
+        } quad = { { 0, 0, 4 * 8, 4 * 8 }, { 0, 0, 65535, 65535 }, { 255, 255, 255, 255 } };
+        GLuint buffer = 0;
+        gl->GenBuffers(1, &buffer);
+        gl->BindBuffer(GL_ARRAY_BUFFER, buffer);
+        gl->BufferData(GL_ARRAY_BUFFER, sizeof(quad), &quad, GL_STATIC_DRAW);
+        gl->VertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(Quad), reinterpret_cast<const void*>(offsetof(Quad, rect)));
+        gl->VertexAttribPointer(1, 4, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(Quad), reinterpret_cast<const void*>(offsetof(Quad, uv)));
+        gl->VertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Quad), reinterpret_cast<const void*>(offsetof(Quad, color)));
+        GLuint program = gl->CreateProgram("", "");
+        gl->UseProgram(program);
+        gl->Uniform2f(gl->GetUniformLocation(program, "uViewportSize"), 4.0f, 4.0f);
+        gl->Uniform1i(gl->GetUniformLocation(program, "uTexture"), 0);
+        gl->DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1);
+
+        // The first row uploaded is the top of the quad, the framebuffer's rows are bottom up
+        const unsigned char* pixels = gl->GetPixels();
+        const unsigned char* topLeft = pixels + (3 * 4 + 0) * 4;
+        CHECK(topLeft[0] == 10 && topLeft[1] == 0 && topLeft[2] == 0 && topLeft[3] == 255);
+        const unsigned char* bottomRight = pixels + 3 * 4;
+        CHECK(bottomRight[0] == 90);
+        // Three texels across four pixels, the middle two pixels each way sample the replaced texel
+        const unsigned char* center = pixels + (2 * 4 + 1) * 4;
+        CHECK(center[0] == 255 && center[4] == 255);
+        CHECK(pixels[(1 * 4 + 1) * 4] == 255);
+    }
+}
+
+int main() {
+    static const Test::Case cases[] = {
+        { "SoftwareGLBackend scene hash", SceneHash },
+        { "SoftwareGLBackend damage matches full redraw", DamageMatchesFullRedraw },
+        { "SoftwareGLBackend single channel texture", SingleChannelTexture },
+    };
+    return Test::RunTests(cases);
+}
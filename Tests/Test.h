@@ -0,0 +1,55 @@
+#pragma once
+
+// Just enough of a test framework for CTest. Every test file is its own executable, its main runs the
+// cases with RunTests and returns what that does, non zero if any CHECK failed.
+#include <cstddef>
+#include <cstdio>
+
+namespace TextEdit {
+    namespace Test {
+        inline int& FailureCount() {
+            static int failures = 0;
+            return failures;
+        }
+
+        inline void Fail(const char* file, int line, const char* expression) {
+            printf("%s:%d: CHECK(%s) failed\n", file, line, expression);
+            FailureCount() += 1;
+        }
+
+        struct Case {
+            const char* name;
+            void (*run)();
+        };
+
+        template <size_t N>
+        int RunTests(const Case (&cases)[N]) {
+            for (const Case& test : cases) {
+                int failuresBefore = FailureCount();
+                test.run();
+                printf("%-40s %s\n", test.name, FailureCount() == failuresBefore ? "passed" : "FAILED");
+            }
+            return FailureCount() == 0 ? 0 : 1;
+        }
+
+        // Same numbers on every platform, unlike rand
+        class Random {
+        public:
+            explicit Random(unsigned int seed) : mState(seed * 2654435761u + 1u) {
+            }
+
+            unsigned int Next(unsigned int range) { // In [0, range)
+                mState ^= mState << 13;
+                mState ^= mState >> 17;
+                mState ^= mState << 5;
+                return range == 0 ? 0 : mState % range;
+            }
+
+        private:
+            unsigned int mState;
+        };
+    }
+}
+
+// Keeps going after a failure so one run reports all of them
+#define CHECK(expression) do { if (!(expression)) TextEdit::Test::Fail(__FILE__, __LINE__, #expression); } while (0)
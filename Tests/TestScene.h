@@ -0,0 +1,68 @@
+#pragma once
+
+// The same fixed view for the backend tests: 200 lines of generated code highlighted as code, drawn
+// by a DocumentView filling the screen the way Tick draws it, without the file menu and tabs around it.
+#include <memory>
+#include <string>
+
+#include "BenchmarkDocument.h"
+#include "Document.h"
+#include "DocumentView.h"
+#include "Font.h"
+#include "Renderer.h"
+#include "Styles.h"
+
+std::u32string Utf8ToUtf32(const char* utf8_string, unsigned int bytes);
+
+namespace TextEdit {
+    namespace Test {
+        class Scene {
+        public:
+            static constexpr unsigned int WIDTH = 1280;
+            static constexpr unsigned int HEIGHT = 720;
+
+            std::shared_ptr<Font> font;
+            std::shared_ptr<Renderer> renderer;
+            std::shared_ptr<Document> document;
+            std::shared_ptr<DocumentView> view;
+
+            bool Create(std::shared_ptr<GLBackend> gl) {
+                font = Font::Create(Roboto, Roboto_Size, 16.0f, 1.0f);
+                if (!font) {
+                    return false;
+                }
+                font->SetAsyncRasterization(false); // Every run bakes the same glyphs in the same frame
+                renderer = Renderer::Create(1.0f, font, gl);
+                if (!renderer) {
+                    return false;
+                }
+
+                std::string text;
+                MakeBenchmarkDocument(200, text);
+                document = Document::Create();
+                document->Load(Utf8ToUtf32(text.data(), static_cast<unsigned int>(text.size())));
+                document->SetHighlighter(Highlighter::Code);
+                document->UpdateIncrementalHighlight(static_cast<int>(document->GetLineCount()));
+                view = std::make_shared<DocumentView>(renderer, document, font, font);
+                return true;
+            }
+
+            // False if nothing had changed, Tick doesn't draw then either and the last frame is still good
+            bool DrawFrame() {
+                view->Update(0.0f);
+                if (!renderer->HasDamage()) {
+                    return false;
+                }
+                renderer->StartFrame(0, 0, WIDTH, HEIGHT);
+                for (unsigned int pass = 0, passes = renderer->GetDamagePassCount(); pass < passes; ++pass) {
+                    renderer->StartDamagePass(pass);
+                    renderer->GetGL().ClearColor(Styles::BGColor.r, Styles::BGColor.g, Styles::BGColor.b, 1.0f);
+                    renderer->GetGL().Clear(GL_COLOR_BUFFER_BIT);
+                    view->Display(0.0f, 0.0f, static_cast<float>(WIDTH), static_cast<float>(HEIGHT));
+                }
+                renderer->EndFrame();
+                return true;
+            }
+        };
+    }
+}
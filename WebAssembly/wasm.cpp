@@ -11,6 +11,13 @@
 #include "../Code/IncludedDocuments.cpp"
 #include "../Code/Font.cpp"
 #include "../Code/FileMenu.cpp"
+#include "../Code/Minimap.cpp"
+#include "../Code/FoldIndex.cpp"
+#include "../Code/GLBackend.cpp"
+#include "../Code/GlyphRasterizer.cpp"
+#include "../Code/LineLayoutCache.cpp"
+#include "../Code/Profiler.cpp"
+#include "../Code/InputRecording.cpp"
 #include "../Code/DocumentView.cpp"
 #include "../Code/DocumentContainer.cpp"
 #include "../Code/Document.cpp"